@@ -157,6 +157,8 @@ void loop() {
     
   /* Main Testing Code - also used for current draw as a standard sweep measurement */
   demo.AD5940_TDD(test, gainSize); // This version uses the private variables for startFreq, endFreq, etc.
+  demo.setSessionLog(true); // Binary log (.hsl) written while the sweep runs, kept if it stops part-way
+  demo.setBleStreaming(true); // Points reach the phone as they are measured, not after the sweep
   demo.runSweep();
   demo.calculateResistors();
   demo.BLE_transmitResults();
@@ -36,6 +36,9 @@ HELPStat::HELPStat() {}
 AD5940Err HELPStat::AD5940Start(void) {
     uint32_t err = AD5940_MCUResourceInit();
     if(err != 0) return AD5940ERR_ERROR;
+
+    /* Serve AFE config reads from RAM and drop redundant writes (see ad5940.c) */
+    AD5940_ShadowCtrl(bTRUE);
     
     /* PIN DISPLAY */
     delay(5000);
@@ -53,6 +56,7 @@ AD5940Err HELPStat::AD5940Start(void) {
     Serial.print("INTERRUPT PIN: ");
     Serial.println(ESP32_INTERRUPT);
 
+    return AD5940ERR_OK;
 }
 
 int32_t HELPStat::AD5940PlatformCfg(void) {
@@ -157,7 +161,7 @@ int32_t HELPStat::ImpedanceShowResult(uint32_t *pData, uint32_t DataCount) {
   // printf("Freq:%.2f ", freq);
   // printf("Freq, RzMag (ohm), RzPhase (degrees)\n");
   /*Process data*/
-  for(int i=0;i<DataCount;i++)
+  for(uint32_t i=0;i<DataCount;i++)
   {
     // printf("RzMag: %f Ohm , RzPhase: %f \n",pImp[i].Magnitude,pImp[i].Phase*180/MATH_PI);
     // printf("%.2f, %f, %f \n", freq, pImp[i].Magnitude,pImp[i].Phase*180/MATH_PI);
@@ -169,8 +173,6 @@ int32_t HELPStat::ImpedanceShowResult(uint32_t *pData, uint32_t DataCount) {
 }
 
 void HELPStat::AD5940_Main(float startFreq, float endFreq, uint32_t numPoints, uint32_t gainArrSize, calHSTIA* gainArr) {
-  uint32_t temp;  
-
   _gainArrSize = gainArrSize;
   printf("Gain array size: %d\n", _gainArrSize);
   for(uint32_t i = 0; i < _gainArrSize; i++)
@@ -186,6 +188,7 @@ void HELPStat::AD5940_Main(float startFreq, float endFreq, uint32_t numPoints, u
   AD5940ImpedanceStructInit(startFreq, endFreq, numPoints);
   
   AppIMPInit(AppBuff, APPBUFF_SIZE);    /* Initialize IMP application. Provide a buffer, which is used to store sequencer commands */
+  AppIMPStreamInit(&_impStream, _impStreamMem, APPBUFF_SIZE, IMPSTREAM_NUM_BUFF);
   AppIMPCtrl(IMPCTRL_START, 0);          /* Control IMP measurement to start. Second parameter has no meaning with this command. */
   printf("Freq, RzMag (ohm), RzPhase (degrees). Rreal, Rimag\n");
 
@@ -194,11 +197,30 @@ void HELPStat::AD5940_Main(float startFreq, float endFreq, uint32_t numPoints, u
     if(AD5940_GetMCUIntFlag())
     {
       AD5940_ClrMCUIntFlag();
-      temp = APPBUFF_SIZE;
-      AppIMPISR(AppBuff, &temp);
-      ImpedanceShowResult(AppBuff, temp);
+      if(AppIMPStreamISR(&_impStream) == AD5940ERR_BUFF)
+        printf("FIFO stream: %u overruns, %u FIFO overflows\n", _impStream.Overruns, _impStream.FifoOverflows);
     }
+    /* Consumer side; can live in its own task since it only touches the stream's Tail */
+    showStreamResults(&_impStream);
+  }
+}
+
+/* 10/16/2026 - Prints every buffer the stream has published and hands them back. Returns
+   the number of results printed. */
+uint32_t HELPStat::showStreamResults(IMPStream_Type *pStream) {
+  fImpPol_Type *pImp;
+  float freq;
+  uint32_t count, total = 0;
+
+  while((count = AppIMPStreamGet(pStream, &pImp, &freq)) != 0)
+  {
+    for(uint32_t i = 0; i < count; i++)
+      printf("%0.3f, %f, %f, %f, %f, \n", freq, pImp[i].Magnitude, pImp[i].Phase,
+             pImp[i].Magnitude * cos(pImp[i].Phase), -pImp[i].Magnitude * sin(pImp[i].Phase));
+    AppIMPStreamRelease(pStream);
+    total += count;
   }
+  return total;
 }
 
 void HELPStat::DFTPolling_Main(void) {
@@ -295,6 +317,10 @@ void HELPStat::AD5940_TDD(calHSTIA *gainArr, int gainArrSize) {
   float adcClkFreq = 16000000.0; // 16 MHz
   float sineVpp = 200.0; // 200 mV 
 
+  /* No previous point to estimate settling from, no cached Rcal */
+  memset(&_prevEis, 0, sizeof(_prevEis));
+  clearRcalCache();
+
   /* Configuring the Gain Array */
   _gainArrSize = gainArrSize;
   printf("Gain array size: %d\n", _gainArrSize);
@@ -454,6 +480,8 @@ void HELPStat::AD5940_TDD(calHSTIA *gainArr, int gainArrSize) {
   if(_startFreq > _endFreq) _sweepCfg.SweepPoints = (uint32_t)(1.5 + (log10(_startFreq) - log10(_endFreq)) * (_numPoints)) - 1;
   else _sweepCfg.SweepPoints = (uint32_t)(1.5 + (log10(_endFreq) - log10(_startFreq)) * (_numPoints)) - 1;
   printf("Number of points: %d\n", _sweepCfg.SweepPoints);
+  compileSweepPlan();
+  reserveResults(_sweepCfg.SweepPoints, _numCycles);
   Serial.println("Sweep configured successfully.");
 
    /* Configuring LPDAC if necessary */
@@ -594,7 +622,12 @@ void HELPStat::AD5940_TDD(float startFreq, float endFreq, uint32_t numPoints, fl
   float sysClkFreq = 16000000.0; // 16 MHz
   float adcClkFreq = 16000000.0; // 16 MHz
   float sineVpp = 200.0; // 200 mV 
+
+  /* No previous point to estimate settling from, no cached Rcal */
+  memset(&_prevEis, 0, sizeof(_prevEis));
+  clearRcalCache();
   _rcalVal = rcalVal;
+  _resultRcal = rcalVal;
 
   /* Configuring the Gain Array */
   _gainArrSize = gainArrSize;
@@ -764,6 +797,8 @@ void HELPStat::AD5940_TDD(float startFreq, float endFreq, uint32_t numPoints, fl
   if(startFreq > endFreq) _sweepCfg.SweepPoints = (uint32_t)(1.5 + (log10(startFreq) - log10(endFreq)) * (numPoints)) - 1;
   else _sweepCfg.SweepPoints = (uint32_t)(1.5 + (log10(endFreq) - log10(startFreq)) * (numPoints)) - 1;
   printf("Number of points: %d\n", _sweepCfg.SweepPoints);
+  compileSweepPlan();
+  reserveResults(_sweepCfg.SweepPoints, _numCycles);
   Serial.println("Sweep configured successfully.");
 
    /* Configuring LPDAC if necessary */
@@ -891,7 +926,6 @@ void HELPStat::AD5940_TDD(float startFreq, float endFreq, uint32_t numPoints, fl
 
 void HELPStat::AD5940_DFTMeasure(void) {
 
-  SWMatrixCfg_Type sw_cfg;
   impStruct eis;
 
   /* Real / Imaginary components */
@@ -901,31 +935,241 @@ void HELPStat::AD5940_DFTMeasure(void) {
   /* Magnitude / phase */
   float magRcal, phaseRcal; 
   float magRz, phaseRz;
-  float calcMag, calcPhase; // phase in rads 
   // float rcalVal = 9930; // known Rcal - measured with DMM
 
+  /* Settling time for both legs */
+  settleStruct settle = {};
+
   // Serial.print("Recommended clock cycles: ");
   // Serial.println(_waitClcks);
 
   AD5940_Delay10us(_waitClcks * (1/SYSCLCK));
 
+  rangeStruct range = {};
+  int32_t dft[4];
+  bool single = false, compensated = false;
+  bool ok = acquirePoint(dft, &settle, &range, &single);
+  if(ok && _singleLeg) {
+    if(single) _calStats.singleLeg++;
+    else _calStats.twoLeg++;
+  }
+  if(ok) {
+    compensated = calCompensate(dft);
+    if(compensated) _calStats.compensated++;
+  }
+  ok = ok && dftUsable(dft);
+
+  realRcal = dft[0];
+  imageRcal = dft[1];
+  realRz = dft[2];
+  imageRz = dft[3];
+
+  // Serial.println("Measurement sequence finished.");
+
+  getMagPhase(realRcal, imageRcal, &magRcal, &phaseRcal);
+  getMagPhase(realRz, imageRz, &magRz, &phaseRz);
+
+  if(ok) {
+    /* Finding the actual magnitude and phase */
+    eis.magnitude = (magRcal / magRz) * _rcalVal; 
+    eis.phaseRad = phaseRcal - phaseRz;
+    eis.real = eis.magnitude * cos(eis.phaseRad);
+    eis.imag = eis.magnitude * sin(eis.phaseRad) * -1; 
+    eis.phaseDeg = eis.phaseRad * 180 / MATH_PI; 
+    eis.freq = _currentFreq;
+
+    /* Printing Values */
+    printf("%d,", _sweepCfg.SweepIndex);
+    printf("%.2f,", _currentFreq);
+    printf("%.3f,", magRcal);
+    printf("%.3f,", magRz);
+    printf("%f,", eis.magnitude);
+    printf("%.4f,", eis.real);
+    printf("%.4f,", eis.imag);
+    printf("%.4f,", eis.phaseRad);
+    printf("%.1f,", settle.settleMs);
+    printf("%s\n", settle.status == SETTLE_CONVERGED ? "settled" : 
+                   (settle.status == SETTLE_CAPPED ? "capped" : "fixed"));
+  }
+  else printf("%d,%.2f,%.3f,%.3f,,,,,%.1f,failed\n", _sweepCfg.SweepIndex, _currentFreq, magRcal, magRz,
+              settle.settleMs);
+
+  /* A failed point still takes its slot, so the cycle-end processing in fitResult runs */
+  uint32_t resultIdx;
+  if(resultSlot(&resultIdx)) {
+    storeRecord(resultIdx, dft, ok ? DFTREC_VALID | (single || compensated ? DFTREC_CAL : 0) : DFTREC_FAILED);
+    _settleArr[resultIdx] = settle;
+    _rangeArr[resultIdx] = range;
+    logResult(resultIdx);
+    fitResult(resultIdx);
+    streamResult(resultIdx);
+  }
+  if(ok) _prevEis = eis;
+  // printf("Array Index: %d\n",_sweepCfg.SweepIndex + (_currentCycle * _sweepCfg.SweepPoints));
+
+  /* Updating Frequency */
+  logSweep(&_sweepCfg, &_currentFreq);
+}
+
+/*
+  10/16/2026 - Measures the current sweep point: the Rcal leg (unless the calibration table or the
+  Rcal cache has it) and the Rz leg, autoranged if setAutorange is on. Fills pDft with the Rcal and
+  Rz DFT pairs of the kept measurement and sets *pRcalCal if the Rcal pair came from the calibration
+  table. Returns false, with pDft zeroed, if a DFT did not come back. Split out of AD5940_DFTMeasure
+  so calibrateFixture measures the same way.
+*/
+bool HELPStat::acquirePoint(int32_t *pDft, settleStruct *pSettle, rangeStruct *pRange, bool *pRcalCal) {
+  SWMatrixCfg_Type sw_cfg;
+  int32_t realRcal = 0, imageRcal = 0; 
+  int32_t realRz = 0, imageRz = 0; 
+  bool rcalCal = false;
+  bool ok = true;
+
+  /* Autoranging may change the gains for this point; the configured ones are put back after it */
+  int extGain = _extGain, dacGain = _dacGain;
+  bool clipRcal, clipRz;
+  if(_autorange) {
+    /* Start where this point ended last cycle */
+    uint8_t start = _sweepCfg.SweepIndex < ARRAY_SIZE ? _rangeStart[_sweepCfg.SweepIndex] : 0;
+    if(start) applyRange(start & LOG_RANGE_RTIA, (start & LOG_RANGE_EXT) ? EXCITBUFGAIN_0P25 : EXCITBUFGAIN_2,
+                         (start & LOG_RANGE_DAC) ? HSDACGAIN_0P2 : HSDACGAIN_1);
+    else applyRange(_currentRtia, extGain, dacGain);
+
+    if(_rangeComparator) {
+      /* AD5940_DSPCfgS clears the comparator, so it is armed for every point */
+      ADCDigComp_Type comp;
+      uint16_t span = (uint16_t)(_rangeHigh * (AUTORANGE_ADC_MID - 1));
+      comp.ADCMin = AUTORANGE_ADC_MID - span;
+      comp.ADCMinHys = 0;
+      comp.ADCMax = AUTORANGE_ADC_MID + span;
+      comp.ADCMaxHys = 0;
+      AD5940_ADCDigCompCfgS(&comp);
+    }
+  }
+
+  do {
+    /* Rcal only needs measuring if the calibration table or the cache does not have it for this
+       frequency / RTIA / gain */
+    rcalCal = calLookup(&realRcal, &imageRcal);
+    bool rcalCached = rcalCal || rcalCacheLookup(&realRcal, &imageRcal);
+    clipRcal = clipRz = false;
+
+    if(!rcalCached) {
+      ok = measureRcalLeg(pSettle, &realRcal, &imageRcal, &clipRcal);
+      if(ok) rcalCacheStore(realRcal, imageRcal);
+    }
+    else AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
+                         AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
+                         AFECTRL_SINC2NOTCH, bTRUE);
+    if(!ok) {
+      realRz = imageRz = 0;
+      AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
+                      AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
+                      AFECTRL_SINC2NOTCH, bFALSE);
+      break;
+    }
+
+    sw_cfg.Dswitch = SWD_CE0;
+    sw_cfg.Pswitch = SWP_RE0;
+    sw_cfg.Nswitch = SWN_SE0;
+    sw_cfg.Tswitch = SWT_TRTIA|SWT_SE0LOAD;
+    AD5940_SWMatrixCfgS(&sw_cfg);
+    // Serial.println("Switched to SE0.");
+
+    AD5940_AFECtrlS(AFECTRL_ADCPWR|AFECTRL_WG, bTRUE);  /* Enable Waveform generator */
+    // delay(500);
+    adaptiveSettle(_currentFreq, pSettle);
+    if(_rangeComparator) AD5940_INTCClrFlag(AFEINTSRC_ADCMAXERR|AFEINTSRC_ADCMINERR);
+
+    AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT, bTRUE);  /* Start ADC convert and DFT */
+    if(!_adaptiveSettle) settlingDelay(_currentFreq);
+    // delay(500);
+
+    AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
+    AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
+    AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
+    AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
+
+    /* Polling and retrieving data from the DFT */
+    ok = pollDFT(&realRz, &imageRz);
+    if(_rangeComparator) clipRz = AD5940_INTCTestFlag(AFEINTC_1, AFEINTSRC_ADCMAXERR|AFEINTSRC_ADCMINERR);
+
+    // AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
+    // AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
+
+    AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT|AFECTRL_WG|AFECTRL_ADCPWR, bFALSE);  /* Stop ADC convert and DFT */
+    AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
+                  AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
+                  AFECTRL_SINC2NOTCH, bFALSE);
+
+    pDft[0] = realRcal;
+    pDft[1] = imageRcal;
+    pDft[2] = realRz;
+    pDft[3] = imageRz;
+  } while(ok && autorangeStep(pDft, clipRcal, clipRz, extGain, dacGain, pRange));
+
+  _extGain = extGain;
+  _dacGain = dacGain;
+  *pRcalCal = rcalCal;
+  if(!ok) {
+    pDft[0] = pDft[1] = pDft[2] = pDft[3] = 0;
+    return false;
+  }
+  if(_autorange && _sweepCfg.SweepIndex < ARRAY_SIZE)
+    _rangeStart[_sweepCfg.SweepIndex] = logRangePack(pRange->rTIA, pRange->extGain, pRange->dacGain);
+  return true;
+}
+
+/*
+  Stores the current point as DFTREC_FAILED (no impedance). It still takes its slot and goes through
+  logResult / fitResult / streamResult, which leave it out but run their cycle-end processing.
+*/
+void HELPStat::storeFailedPoint(void) {
+  int32_t zero[4] = {0, 0, 0, 0};
+  uint32_t resultIdx;
+  if(resultSlot(&resultIdx)) {
+    storeRecord(resultIdx, zero, DFTREC_FAILED);
+    memset(&_settleArr[resultIdx], 0, sizeof(settleStruct));
+    logResult(resultIdx);
+    fitResult(resultIdx);
+    streamResult(resultIdx);
+  }
+}
+
+/* The stored point was measured; DFTREC_FAILED points are left out of the fits and the BLE frames */
+bool HELPStat::resultValid(uint32_t index) {
+  return index < _resultCap && (eisArr[index].flags & DFTREC_VALID);
+}
+
+/* Both legs have a non-zero DFT, so the impedance can be computed */
+bool HELPStat::dftUsable(const int32_t *pDft) {
+  return (pDft[0] != 0 || pDft[1] != 0) && (pDft[2] != 0 || pDft[3] != 0);
+}
+
+/* Rcal leg of one point with the current RTIA and gains. Sets *pClip if the ADC comparator tripped;
+   returns false, with the pair zeroed, if the DFT did not come back. */
+bool HELPStat::measureRcalLeg(settleStruct *pSettle, int32_t *pReal, int32_t *pImage, bool *pClip) {
+  SWMatrixCfg_Type sw_cfg;
+  *pClip = false;
+
   /* Measuring RCAL */
   sw_cfg.Dswitch = SWD_RCAL0;
   sw_cfg.Pswitch = SWP_RCAL0;
   sw_cfg.Nswitch = SWN_RCAL1;
   sw_cfg.Tswitch = SWT_RCAL1|SWT_TRTIA;
   AD5940_SWMatrixCfgS(&sw_cfg);
-	
-	AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
+
+  AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
                 AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
                 AFECTRL_SINC2NOTCH, bTRUE);
 
   AD5940_AFECtrlS(AFECTRL_WG|AFECTRL_ADCPWR, bTRUE);  /* Enable Waveform generator */
   // delay(500); 
-  settlingDelay(_currentFreq);
+  adaptiveSettle(_currentFreq, pSettle);
+  if(_rangeComparator) AD5940_INTCClrFlag(AFEINTSRC_ADCMAXERR|AFEINTSRC_ADCMINERR);
   
   AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT, bTRUE);  /* Start ADC convert and DFT */
-  settlingDelay(_currentFreq);
+  if(!_adaptiveSettle) settlingDelay(_currentFreq);
 
   AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
   AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
@@ -933,73 +1177,15 @@ void HELPStat::AD5940_DFTMeasure(void) {
   AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
 
   /* Polling and retrieving data from the DFT */
-  pollDFT(&realRcal, &imageRcal);
+  bool ok = pollDFT(pReal, pImage);
+  if(ok && _rangeComparator) *pClip = AD5940_INTCTestFlag(AFEINTC_1, AFEINTSRC_ADCMAXERR|AFEINTSRC_ADCMINERR);
 
   // AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
   // AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
 
   //wait for first data ready
   AD5940_AFECtrlS(AFECTRL_ADCPWR|AFECTRL_ADCCNV|AFECTRL_DFT|AFECTRL_WG, bFALSE);  /* Stop ADC convert and DFT */
-
-  sw_cfg.Dswitch = SWD_CE0;
-  sw_cfg.Pswitch = SWP_RE0;
-  sw_cfg.Nswitch = SWN_SE0;
-  sw_cfg.Tswitch = SWT_TRTIA|SWT_SE0LOAD;
-  AD5940_SWMatrixCfgS(&sw_cfg);
-  // Serial.println("Switched to SE0.");
-
-  AD5940_AFECtrlS(AFECTRL_ADCPWR|AFECTRL_WG, bTRUE);  /* Enable Waveform generator */
-  // delay(500);
-  settlingDelay(_currentFreq);
-
-  AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT, bTRUE);  /* Start ADC convert and DFT */
-  settlingDelay(_currentFreq);
-  // delay(500);
-
-  AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
-  AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
-  AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
-  AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
-
-  /* Polling and retrieving data from the DFT */
-  pollDFT(&realRz, &imageRz);
-
-  // AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
-  // AD5940_Delay10us((_waitClcks / 2) * (1/SYSCLCK));
-
-  AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT|AFECTRL_WG|AFECTRL_ADCPWR, bFALSE);  /* Stop ADC convert and DFT */
-  AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
-                AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
-                AFECTRL_SINC2NOTCH, bFALSE);
-
-  // Serial.println("Measurement sequence finished.");
-
-  getMagPhase(realRcal, imageRcal, &magRcal, &phaseRcal);
-  getMagPhase(realRz, imageRz, &magRz, &phaseRz);
-
-  /* Finding the actual magnitude and phase */
-  eis.magnitude = (magRcal / magRz) * _rcalVal; 
-  eis.phaseRad = phaseRcal - phaseRz;
-  eis.real = eis.magnitude * cos(eis.phaseRad);
-  eis.imag = eis.magnitude * sin(eis.phaseRad) * -1; 
-  eis.phaseDeg = eis.phaseRad * 180 / MATH_PI; 
-  eis.freq = _currentFreq;
-
-  /* Printing Values */
-  printf("%d,", _sweepCfg.SweepIndex);
-  printf("%.2f,", _currentFreq);
-  printf("%.3f,", magRcal);
-  printf("%.3f,", magRz);
-  printf("%f,", eis.magnitude);
-  printf("%.4f,", eis.real);
-  printf("%.4f,", eis.imag);
-  printf("%.4f\n", eis.phaseRad);
-
-  eisArr[_sweepCfg.SweepIndex + (_currentCycle * _sweepCfg.SweepPoints)] = eis; 
-  // printf("Array Index: %d\n",_sweepCfg.SweepIndex + (_currentCycle * _sweepCfg.SweepPoints));
-
-  /* Updating Frequency */
-  logSweep(&_sweepCfg, &_currentFreq);
+  return ok;
 }
 
 void HELPStat::getDFT(int32_t* pReal, int32_t* pImage) { 
@@ -1008,8 +1194,6 @@ void HELPStat::getDFT(int32_t* pReal, int32_t* pImage) {
   /* Data is 18bit in two's complement, bit17 is the sign bit */
   if(*pReal&(1<<17)) *pReal |= 0xfffc0000;     
 
-  delay(200); 
-
   *pImage = AD5940_ReadAfeResult(AFERESULT_DFTIMAGE);
   *pImage &= 0x3ffff;
   /* Data is 18bit in two's complement, bit17 is the sign bit */
@@ -1018,19 +1202,63 @@ void HELPStat::getDFT(int32_t* pReal, int32_t* pImage) {
   // printf("Real: %d, Image: %d\n", *pReal, *pImage);
 }
 
-void HELPStat::pollDFT(int32_t* pReal, int32_t* pImage) {
-  /* Polls the DFT and retrieves the real and imaginary data as ints */
-  while(!AD5940_GetMCUIntFlag()) {
-    delay(1000); // Adding an empirical delay before polling again 
+/*
+  10/16/2026 - Blocks on the DFTRDY interrupt instead of checking it once a second.
+  The DFT takes _waitClcks system clocks, so twice that plus 100 ms is a generous
+  timeout. Returns false, with the results zeroed, on timeout or if the interrupt was not
+  DFTRDY, rather than hanging the sweep.
+*/
+bool HELPStat::pollDFT(int32_t* pReal, int32_t* pImage) {
+  uint32_t timeoutMs = (uint32_t)(2 * _waitClcks / SYSCLCK * 1000) + 100;
+  *pReal = 0;
+  *pImage = 0;
+
+  if(!waitForInt(timeoutMs)) {
+    Serial.println("DFT timed out!");
+    return false;
   }
   
-  if(AD5940_INTCTestFlag(AFEINTC_1,AFEINTSRC_DFTRDY)) {
-    getDFT(pReal, pImage);
-    delay(300);
+  if(!AD5940_INTCTestFlag(AFEINTC_1,AFEINTSRC_DFTRDY)) {
+    Serial.println("Flag not working!");
     AD5940_ClrMCUIntFlag();
-    AD5940_INTCClrFlag(AFEINTSRC_DFTRDY);
+    return false;
   }
-  else Serial.println("Flag not working!");
+  getDFT(pReal, pImage);
+  AD5940_ClrMCUIntFlag();
+  AD5940_INTCClrFlag(AFEINTSRC_DFTRDY);
+  return true;
+}
+
+/*
+  Waits for the AD5940 interrupt and records how long the wait took and how late
+  the task woke up after the ISR fired. Returns false on timeout.
+*/
+bool HELPStat::waitForInt(uint32_t timeoutMs) {
+  uint32_t waitStart = micros();
+  bool gotInt = AD5940_WaitMCUIntFlag(timeoutMs) != 0;
+  uint32_t waitEnd = micros();
+
+  _waitStats.count++;
+  _waitStats.lastWaitUs = waitEnd - waitStart;
+  _waitStats.totalWaitUs += _waitStats.lastWaitUs;
+  if(_waitStats.lastWaitUs > _waitStats.maxWaitUs) _waitStats.maxWaitUs = _waitStats.lastWaitUs;
+
+  if(!gotInt) {
+    _waitStats.timeouts++;
+    return false;
+  }
+
+  _waitStats.lastLatencyUs = waitEnd - AD5940_GetMCUIntTimeUs();
+  if(_waitStats.lastLatencyUs > _waitStats.maxLatencyUs) _waitStats.maxLatencyUs = _waitStats.lastLatencyUs;
+  return true;
+}
+
+waitStats HELPStat::getWaitStats(void) {
+  return _waitStats;
+}
+
+void HELPStat::clearWaitStats(void) {
+  memset(&_waitStats, 0, sizeof(_waitStats));
 }
 
 void HELPStat::getMagPhase(int32_t real, int32_t image, float *pMag, float *pPhase) {
@@ -1046,6 +1274,11 @@ void HELPStat::logSweep(SoftSweepCfg_Type *pSweepCfg, float *pNextFreq) {
   // if(++pSweepCfg->SweepIndex == pSweepCfg->SweepPoints) pSweepCfg->SweepIndex = 0;
   // if you reach last point, end the cycle
   if(++pSweepCfg->SweepIndex == pSweepCfg->SweepPoints) pSweepCfg -> SweepEn = bFALSE;
+  else if(pSweepCfg == &_sweepCfg && sweepPlanValid()) {
+    /* Precompiled point */
+    *pNextFreq = _plan[pSweepCfg->SweepIndex].freq;
+    applySweepPlan(pSweepCfg->SweepIndex);
+  }
   else {
     frequency = pSweepCfg->SweepStart * pow(10, (pSweepCfg->SweepIndex * log10(pSweepCfg->SweepStop/pSweepCfg->SweepStart)/(pSweepCfg->SweepPoints-1)));
     *pNextFreq = frequency;
@@ -1064,44 +1297,23 @@ void HELPStat::logSweep(SoftSweepCfg_Type *pSweepCfg, float *pNextFreq) {
   _delaySecs. These are updated over BLE (see the BLE_settings() function).
 */
 void HELPStat::runSweep(void) {
-  _currentCycle = 0; 
-  /*
-    Need to not run the program if ArraySize < total points 
-    TO DO: ADD A CHECK HERE  
-  */
-  printf("Total points to run: %d\n", (_numCycles + 1) * _sweepCfg.SweepPoints); // since 0 based indexing, add 1
-  printf("Set array size: %d\n", ARRAY_SIZE);
-  printf("Calibration resistor value: %f\n", _rcalVal);
+  runSweep(_numCycles, _delaySecs);
+}
+
+void HELPStat::runSweep(uint32_t numCycles, uint32_t delaySecs) {
+  if(!beginRun(numCycles)) return;
+
+  /* Rcal is measured fresh at the start of every run */
+  clearRcalCache();
+  memset(&_calStats, 0, sizeof(_calStats));
+  memset(&_msineStats, 0, sizeof(_msineStats));
+  AD5940_ShadowClrStat();
 
   // LED to show start of spectroscopy 
   // digitalWrite(LED1, HIGH); 
 
-  for(uint32_t i = 0; i <= _numCycles; i++) {
-    /* 
-      Wakeup AFE by read register, read 10 times at most.
-      Do this because AD594x goes to sleep after each cycle. 
-    */
-    AD5940_SleepKeyCtrlS(SLPKEY_LOCK); // Disables Sleep Mode 
-    if(_delaySecs)
-    {
-      unsigned long prevTime = millis();
-      unsigned long currTime = millis();
-      printf("Delaying for %d seconds\n", _delaySecs);
-      while(currTime - prevTime < _delaySecs * 1000)
-      {
-        currTime = millis();
-        // printf("Curr delay: %d\n", currTime - prevTime);
-      }
-    } 
-    // Timer for cycle time
-    unsigned long timeStart = millis();
-
-    if(i > 0){
-      if(AD5940_WakeUp(10) > 10) Serial.println("Wakeup failed!");       
-       resetSweep(&_sweepCfg, &_currentFreq);
-       delay(300); // empirical settling delay
-       _currentCycle++;
-    }
+  for(uint32_t i = 0; i <= numCycles; i = endCycle(i)) {
+    if(beginCycle(i, delaySecs)) delay(300); // empirical settling delay
     
     /* Calibrates based on frequency */
     // Should calibrate when AFE is active
@@ -1110,103 +1322,101 @@ void HELPStat::runSweep(void) {
     delay(10); // switching delay
 
     printf("Cycle %d\n", i);
-    printf("Index, Frequency (Hz), DFT Cal, DFT Mag, Rz (Ohms), Rreal, Rimag, Rphase (rads)\n");
+    printf("Index, Frequency (Hz), DFT Cal, DFT Mag, Rz (Ohms), Rreal, Rimag, Rphase (rads), Settle (ms), Settled\n");
     
     while(_sweepCfg.SweepEn == bTRUE)
     {
-      AD5940_DFTMeasure();
+      if(msinePoint(_sweepCfg.SweepIndex)) AD5940_MultisineMeasure();  // The whole group
+      else AD5940_DFTMeasure();
       // AD5940_DFTMeasureEIS();
       AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
               AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
               AFECTRL_SINC2NOTCH, bTRUE);
       delay(200);
     }
-
-    unsigned long timeEnd = millis(); 
-    printf("Time spent running Cycle %d (seconds): %lu\n", i, (timeEnd-timeStart)/1000);
   }
+  endRun();
+  printf("Rcal cache: %u hits, %u misses (%u refreshed, %u drift resets)\n",
+         _rcalStats.hits, _rcalStats.misses, _rcalStats.refreshes, _rcalStats.drifts);
+  if(_singleLeg || _openShort)
+    printf("Calibration: %u single-leg, %u two-leg, %u open / short compensated points\n",
+           _calStats.singleLeg, _calStats.twoLeg, _calStats.compensated);
+  if(_msine)
+    printf("Multisine: %u acquisitions, %u points, %u samples, %u remeasured, %u measured point by point\n",
+           _msineStats.acquisitions, _msineStats.points, _msineStats.samples, _msineStats.remeasures,
+           _msineStats.failures);
+  RegShadowStat_Type shadowStat;
+  AD5940_ShadowGetStat(&shadowStat);
+  printf("Register shadow: %u reads / %u writes avoided, %u / %u over SPI\n",
+         shadowStat.ReadsAvoided, shadowStat.WritesAvoided, shadowStat.Reads, shadowStat.Writes);
   
   /* Shutdown to conserve power. This turns off the LP-Loop and resets the AFE. */
   AD5940_ShutDownS();
-  printf("All cycles finished.");
-  printf("AD594x shutting down.");
+  Serial.println("All cycles finished.");
+  Serial.println("AD594x shutting down.");
 
   /* LEDs to show end of cycle */
   // digitalWrite(LED1, LOW);
   // digitalWrite(LED2, HIGH);
 }
-void HELPStat::runSweep(uint32_t numCycles, uint32_t delaySecs) {
+
+/*
+  10/16/2026 - Run bookkeeping shared by runSweep and runSweepSeq. beginRun reserves the
+  result store and opens the session log, fit and stream; beginCycle waits out the delay
+  (not before a repeated cycle) and restarts the sweep; endCycle flushes the log and gives
+  the next cycle to run, the same one again if it failed the KK test; endRun closes it all.
+*/
+bool HELPStat::beginRun(uint32_t numCycles) {
   _numCycles = numCycles; 
   _currentCycle = 0; 
-  /*
-    Need to not run the program if ArraySize < total points 
-    TO DO: ADD A CHECK HERE  
-  */
   printf("Total points to run: %d\n", (_numCycles + 1) * _sweepCfg.SweepPoints); // since 0 based indexing, add 1
-  printf("Set array size: %d\n", ARRAY_SIZE);
+  if(!reserveResults(_sweepCfg.SweepPoints, _numCycles)) return false;
+  _resultRcal = _rcalVal; // Results are decoded with the Rcal they were measured with
+  printf("Result store size: %d\n", _resultCap);
   printf("Calibration resistor value: %f\n", _rcalVal);
+  if(_sessionLog) openSessionLog(_folderName, _fileName);
+  openFit();
+  openStream();
+  return true;
+}
 
-  // LED to show start of spectroscopy 
-  // digitalWrite(LED1, HIGH); 
-
-  for(uint32_t i = 0; i <= numCycles; i++) {
-    /* 
-      Wakeup AFE by read register, read 10 times at most.
-      Do this because AD594x goes to sleep after each cycle. 
-    */
-    AD5940_SleepKeyCtrlS(SLPKEY_LOCK); // Disables Sleep Mode 
-    if(delaySecs)
-    {
-      unsigned long prevTime = millis();
-      unsigned long currTime = millis();
-      printf("Delaying for %d seconds\n", delaySecs);
-      while(currTime - prevTime < delaySecs * 1000)
-      {
-        currTime = millis();
-        // printf("Curr delay: %d\n", currTime - prevTime);
-      }
-    } 
-    // Timer for cycle time
-    unsigned long timeStart = millis();
-
-    if(i > 0){
-      if(AD5940_WakeUp(10) > 10) Serial.println("Wakeup failed!");       
-       resetSweep(&_sweepCfg, &_currentFreq);
-       delay(300); // empirical settling delay
-       _currentCycle++;
-    }
-    
-    /* Calibrates based on frequency */
-    // Should calibrate when AFE is active
-    // checkFreq(_currentFreq);
-    configureFrequency(_currentFreq);
-    delay(10); // switching delay
-
-    printf("Cycle %d\n", i);
-    printf("Index, Frequency (Hz), DFT Cal, DFT Mag, Rz (Ohms), Rreal, Rimag, Rphase (rads)\n");
-    
-    while(_sweepCfg.SweepEn == bTRUE)
-    {
-      AD5940_DFTMeasure();
-      // AD5940_DFTMeasureEIS();
-      AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
-              AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
-              AFECTRL_SINC2NOTCH, bTRUE);
-      delay(200);
-    }
+/* True if the AFE was woken and the sweep restarted (every cycle but the first) */
+bool HELPStat::beginCycle(uint32_t cycle, uint32_t delaySecs) {
+  /* 
+    Wakeup AFE by read register, read 10 times at most.
+    Do this because AD594x goes to sleep after each cycle. 
+  */
+  AD5940_SleepKeyCtrlS(SLPKEY_LOCK); // Disables Sleep Mode 
+  if(delaySecs && _kkAttempt == 0) // A repeated cycle starts right away
+  {
+    printf("Delaying for %d seconds\n", delaySecs);
+    delay(delaySecs * 1000);
+  } 
+  // Timer for cycle time
+  _cycleStartMs = millis();
+
+  if(cycle == 0 && _kkAttempt == 0) return false;
+  if(AD5940_WakeUp(10) > 10) Serial.println("Wakeup failed!");       
+  resetSweep(&_sweepCfg, &_currentFreq);
+  _currentCycle = cycle;
+  return true;
+}
 
-    unsigned long timeEnd = millis(); 
-    printf("Time spent running Cycle %d (seconds): %lu\n", i, (timeEnd-timeStart)/1000);
+uint32_t HELPStat::endCycle(uint32_t cycle) {
+  printf("Time spent running Cycle %d (seconds): %lu\n", cycle, (millis() - _cycleStartMs) / 1000);
+  flushSessionLog();
+  if(repeatCycle()) { // Failed the KK test: measure the same cycle again
+    _kkAttempt++;
+    return cycle;
   }
-  
-  /* Shutdown to conserve power. This turns off the LP-Loop and resets the AFE. */
-  AD5940_ShutDownS();
-  Serial.println("All cycles finished.");
-  Serial.println("AD594x shutting down.");
+  _kkAttempt = 0;
+  return cycle + 1;
+}
 
-  /* LEDs to show end of cycle */
-  // digitalWrite(LED1, LOW);
-  // digitalWrite(LED2, HIGH);
+void HELPStat::endRun(void) {
+  closeSessionLog();
+  closeStream();
+  closeFit();
 }
 
 void HELPStat::resetSweep(SoftSweepCfg_Type *pSweepCfg, float *pNextFreq) {
@@ -1219,50 +1429,1425 @@ void HELPStat::resetSweep(SoftSweepCfg_Type *pSweepCfg, float *pNextFreq) {
   AD5940_WGFreqCtrlS(_startFreq, SYSCLCK);
 }
 
-void HELPStat::settlingDelay(float freq) {
- 
-  // unsigned long constDelay = (4 * 1000 / freq); // delay constant just in case delay is too small
-  unsigned long constDelay = 1000; // 1000 - delay constant just in case delay is too small 
-   /* Getting the delay time based on frequency */
-  if(freq <= 5) {
-    constDelay = 2000; // 2000
-    delay((unsigned long)(2 * 1000 / freq) + constDelay); // Trying 4 periods to improve Zw results instead of 2
-  }
-  else delay((constDelay)); 
-  
+uint32_t HELPStat::getSweepPoints(void) {
+  return _sweepCfg.SweepPoints;
 }
 
-AD5940Err HELPStat::checkFreq(float freq) {
-  /* 
-    Adding a delay after recalibration to improve the switching noise.
-    Sudden switching introduces inaccuracies, but accurate data I feel like
-    is mostly dependent on the HSRTIA depending on the load impedance.
-  */
+impStruct HELPStat::getResult(uint32_t index) {
+  impStruct empty = {};
+  if(index >= _resultCap) return empty;
+  return decodeRecord(&eisArr[index], _resultRcal);
+}
 
-  ADCFilterCfg_Type filter_cfg;
-  DFTCfg_Type dft_cfg;
-  HSDACCfg_Type hsdac_cfg;
-  uint32_t WaitClks;
-  ClksCalInfo_Type clks_cal;
-  FreqParams_Type freq_params;
+/* Single fields, computed from the record without building the whole impStruct */
+float HELPStat::getMagnitude(uint32_t index) {
+  int32_t dft[4];
+  float magRcal, phaseRcal, magRz, phaseRz;
+  if(index >= _resultCap || !(eisArr[index].flags & DFTREC_VALID)) return 0;
+  unpackRecord(&eisArr[index], dft);
+  getMagPhase(dft[0], dft[1], &magRcal, &phaseRcal);
+  getMagPhase(dft[2], dft[3], &magRz, &phaseRz);
+  if(magRz == 0) return 0;
+  return (magRcal / magRz) * _resultRcal;
+}
 
-  float adcClck = 16e6;
+float HELPStat::getPhaseRad(uint32_t index) {
+  int32_t dft[4];
+  if(index >= _resultCap || !(eisArr[index].flags & DFTREC_VALID)) return 0;
+  unpackRecord(&eisArr[index], dft);
+  return atan2(-dft[1], dft[0]) - atan2(-dft[3], dft[2]);
+}
 
-  /* Step 1: Check Frequency */
-  freq_params = AD5940_GetFreqParameters(freq);
-  
-       if(freq < 0.51)
-	{
-    /* Update HSDAC update rate */
-    hsdac_cfg.ExcitBufGain = EXCITBUFGAIN_0P25;
-    hsdac_cfg.HsDacGain = HSDACGAIN_0P2;
-     hsdac_cfg.HsDacUpdateRate = 0x1B;
-    AD5940_HSDacCfgS(&hsdac_cfg);
-    AD5940_HSRTIACfgS(HSTIARTIA_200);
-    // AD5940_HSRTIACfgS(HSTIARTIA_10K);
-    // AD5940_HSRTIACfgS(HSTIARTIA_20K);
-    // AD5940_HSRTIACfgS(HSTIARTIA_40K);
-    // AD5940_HSRTIACfgS(HSTIARTIA_80K);
+float HELPStat::getReal(uint32_t index) {
+  return getResult(index).real;
+}
+
+float HELPStat::getImag(uint32_t index) {
+  return getResult(index).imag;
+}
+
+dftRecord HELPStat::getRecord(uint32_t index) {
+  dftRecord empty = {};
+  if(index >= _resultCap) return empty;
+  return eisArr[index];
+}
+
+/* Rcal value results are decoded with. runSweep sets it to _rcalVal; call this afterwards
+   to recompute a finished sweep with a corrected (e.g. DMM-measured) value. */
+void HELPStat::setResultRcal(float rcalVal) {
+  _resultRcal = rcalVal;
+  _fitOpen = false; // The online fit saw the old values; calculateResistors starts afresh
+  _fitRe.clear();
+  _fitIm.clear();
+}
+
+/* Frequency of sweep point pointIdx, bit-identical to what logSweep / the plan produce. flags are
+   the point's record flags: a DFTREC_MSINE point is at its tone frequency, also once the run is
+   over, and anything else (a group that fell back to AD5940_DFTMeasure) at the planned one */
+float HELPStat::sweepFreq(uint32_t pointIdx, uint8_t flags) {
+  float frequency;
+  if(sweepPlanMatches() && pointIdx < _planSize)
+    return (flags & DFTREC_MSINE) && _plan[pointIdx].msGroup ? _plan[pointIdx].msFreq : _plan[pointIdx].freq;
+  if(_sweepCfg.SweepPoints < 2) return _sweepCfg.SweepStart;
+  frequency = _sweepCfg.SweepStart * pow(10, (pointIdx * log10(_sweepCfg.SweepStop/_sweepCfg.SweepStart)/(_sweepCfg.SweepPoints-1)));
+  return frequency;
+}
+
+/* 10/16/2026 - Record packing lives in sessionlog.h so the host tools decode logs the same way */
+void HELPStat::packRecord(dftRecord *pRec, uint16_t freqIdx, const int32_t *pDft, uint8_t flags) {
+  dftRecordPack(pRec, freqIdx, pDft, flags);
+}
+
+void HELPStat::unpackRecord(const dftRecord *pRec, int32_t *pDft) {
+  dftRecordUnpack(pRec, pDft);
+}
+
+/* Same calculation as AD5940_DFTMeasure */
+impStruct HELPStat::decodeRecord(const dftRecord *pRec, float rcalVal) {
+  impStruct eis = {};
+  int32_t dft[4];
+  float magRcal, phaseRcal; 
+  float magRz, phaseRz;
+
+  if(!(pRec->flags & DFTREC_VALID)) return eis;
+  unpackRecord(pRec, dft);
+  getMagPhase(dft[0], dft[1], &magRcal, &phaseRcal);
+  getMagPhase(dft[2], dft[3], &magRz, &phaseRz);
+  if(magRz == 0) return eis;
+
+  eis.magnitude = (magRcal / magRz) * rcalVal; 
+  eis.phaseRad = phaseRcal - phaseRz;
+  eis.real = eis.magnitude * cos(eis.phaseRad);
+  eis.imag = eis.magnitude * sin(eis.phaseRad) * -1; 
+  eis.phaseDeg = eis.phaseRad * 180 / MATH_PI; 
+  eis.freq = sweepFreq(pRec->freqIdx, pRec->flags);
+  return eis;
+}
+
+void HELPStat::storeRecord(uint32_t index, const int32_t *pDft, uint8_t flags) {
+  packRecord(&eisArr[index], _sweepCfg.SweepIndex, pDft, flags);
+  _rangeArr[index].status = RANGE_NONE;  // AD5940_DFTMeasure fills it in after storing
+}
+
+/*
+  10/16/2026 - Grows the result store (eisArr and _settleArr) so numPoints x (numCycles + 1)
+  points fit, keeping what is already there. Allocated from PSRAM when the board has it,
+  internal heap otherwise. On failure the old store is left exactly as it was and false is
+  returned; runSweep / runSweepSeq do not start in that case.
+*/
+bool HELPStat::reserveResults(uint32_t numPoints, uint32_t numCycles) {
+  uint64_t total = (uint64_t)numPoints * ((uint64_t)numCycles + 1);
+  if(total <= _resultCap) return true;
+
+  size_t eisBytes = total * sizeof(dftRecord);
+  size_t settleBytes = total * sizeof(settleStruct);
+  if(total > UINT32_MAX || eisBytes / sizeof(dftRecord) != total) {
+    printf("Result store: %llu points is too many\n", (unsigned long long)total);
+    return false;
+  }
+
+  bool psram = psramFound();
+  dftRecord *newEis = (dftRecord *)(psram ? ps_realloc(eisArr, eisBytes) : realloc(eisArr, eisBytes));
+  if(newEis == NULL) {
+    printf("Result store: no room for %u points (%u bytes), keeping %u\n", (uint32_t)total, (uint32_t)eisBytes, _resultCap);
+    return false;
+  }
+  eisArr = newEis;
+
+  settleStruct *newSettle = (settleStruct *)(psram ? ps_realloc(_settleArr, settleBytes) : realloc(_settleArr, settleBytes));
+  if(newSettle == NULL) {
+    /* eisArr is bigger than _resultCap now, which is harmless */
+    printf("Result store: no room for %u points (%u bytes), keeping %u\n", (uint32_t)total, (uint32_t)settleBytes, _resultCap);
+    return false;
+  }
+  _settleArr = newSettle;
+
+  size_t kkBytes = total * sizeof(kkResidual);
+  kkResidual *newKK = (kkResidual *)(psram ? ps_realloc(_kkArr, kkBytes) : realloc(_kkArr, kkBytes));
+  if(newKK == NULL) {
+    printf("Result store: no room for %u points (%u bytes), keeping %u\n", (uint32_t)total, (uint32_t)kkBytes, _resultCap);
+    return false;
+  }
+  _kkArr = newKK;
+
+  size_t rangeBytes = total * sizeof(rangeStruct);
+  rangeStruct *newRange = (rangeStruct *)(psram ? ps_realloc(_rangeArr, rangeBytes) : realloc(_rangeArr, rangeBytes));
+  if(newRange == NULL) {
+    printf("Result store: no room for %u points (%u bytes), keeping %u\n", (uint32_t)total, (uint32_t)rangeBytes, _resultCap);
+    return false;
+  }
+  _rangeArr = newRange;
+
+  memset(eisArr + _resultCap, 0, (total - _resultCap) * sizeof(dftRecord));
+  memset(_settleArr + _resultCap, 0, (total - _resultCap) * sizeof(settleStruct));
+  memset(_kkArr + _resultCap, 0, (total - _resultCap) * sizeof(kkResidual));
+  memset(_rangeArr + _resultCap, 0, (total - _resultCap) * sizeof(rangeStruct));
+  _resultCap = (uint32_t)total;
+  printf("Result store: %u points in %s\n", _resultCap, psram ? "PSRAM" : "internal RAM");
+  return true;
+}
+
+uint32_t HELPStat::getResultCapacity(void) {
+  return _resultCap;
+}
+
+/* Index of the current point in the result store. False (and nothing stored) if it does not fit */
+bool HELPStat::resultSlot(uint32_t *pIndex) {
+  uint32_t index = _sweepCfg.SweepIndex + (_currentCycle * _sweepCfg.SweepPoints);
+  if(index >= _resultCap) {
+    printf("Result store: point %u does not fit in %u, not saved\n", index, _resultCap);
+    return false;
+  }
+  *pIndex = index;
+  return true;
+}
+
+/*
+  10/16/2026 - Sequencer sweep. Compiles both legs of AD5940_DFTMeasure (Rcal, then
+  CE0/SE0) into a single sequence, structured like AppIMPSeqMeasureGen in Impedance.c.
+  The settling and DFT waits are SEQ_WAIT pairs whose SRAM addresses are recorded so
+  AD5940_SeqDFTMeasure can patch them for each frequency. Must be called after
+  AD5940_TDD, since the sequence is generated from the AFE state TDD leaves behind.
+*/
+AD5940Err HELPStat::AD5940_SeqSweepInit(void) {
+  FIFOCfg_Type fifo_cfg;
+  SEQCfg_Type seq_cfg;
+  SEQInfo_Type seq_info;
+  SWMatrixCfg_Type sw_cfg;
+  const uint32_t *pSeqCmd;
+  uint32_t seqLen;
+  AD5940Err error;
+
+  /* 2kB of SRAM for the sequencer, the other 4kB for the data FIFO */
+  seq_cfg.SeqMemSize = SEQMEMSIZE_2KB;
+  seq_cfg.SeqBreakEn = bFALSE;
+  seq_cfg.SeqIgnoreEn = bFALSE;
+  seq_cfg.SeqCntCRCClr = bTRUE;
+  seq_cfg.SeqEnable = bFALSE;
+  seq_cfg.SeqWrTimer = 0;
+  AD5940_SEQCfg(&seq_cfg);
+
+  fifo_cfg.FIFOEn = bFALSE;
+  fifo_cfg.FIFOMode = FIFOMODE_FIFO;
+  fifo_cfg.FIFOSize = FIFOSIZE_4KB;
+  fifo_cfg.FIFOSrc = FIFOSRC_DFT;
+  fifo_cfg.FIFOThresh = 4; // Real + imaginary for Rcal, then for Rz
+  AD5940_FIFOCfg(&fifo_cfg);
+  fifo_cfg.FIFOEn = bTRUE;
+  AD5940_FIFOCfg(&fifo_cfg);
+
+  /* INT0 (GPIO0) fires once per point at the end of the sequence instead of per DFT */
+  AD5940_INTCCfg(AFEINTC_0, AFEINTSRC_DFTRDY, bFALSE);
+  AD5940_INTCCfg(AFEINTC_0, AFEINTSRC_ENDSEQ, bTRUE);
+  AD5940_INTCClrFlag(AFEINTSRC_ALLINT);
+  AD5940_ClrMCUIntFlag();
+
+  /* Re-init so the register database is read fresh from the AFE */
+  AD5940_SEQGenInit(_seqBuff, SEQ_BUFF_SIZE);
+  AD5940_SEQGenCtrl(bTRUE);
+
+  /* Measuring RCAL */
+  sw_cfg.Dswitch = SWD_RCAL0;
+  sw_cfg.Pswitch = SWP_RCAL0;
+  sw_cfg.Nswitch = SWN_RCAL1;
+  sw_cfg.Tswitch = SWT_RCAL1|SWT_TRTIA;
+  AD5940_SWMatrixCfgS(&sw_cfg);
+
+  AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
+                AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
+                AFECTRL_SINC2NOTCH, bTRUE);
+  AD5940_AFECtrlS(AFECTRL_WG|AFECTRL_ADCPWR, bTRUE);  /* Enable Waveform generator */
+
+  AD5940_SEQGenFetchSeq(NULL, &_seqSettleAddr[0]); /* Settling wait, patched per frequency */
+  AD5940_SEQGenInsert(SEQ_WAIT(16*10));
+  AD5940_SEQGenInsert(SEQ_WAIT(16*10));
+  AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT, bTRUE);  /* Start ADC convert and DFT */
+
+  AD5940_SEQGenFetchSeq(NULL, &_seqDftAddr[0]); /* DFT wait, patched from _waitClcks */
+  AD5940_SEQGenInsert(SEQ_WAIT(16*10));
+  AD5940_SEQGenInsert(SEQ_WAIT(16*10));
+  AD5940_AFECtrlS(AFECTRL_ADCPWR|AFECTRL_ADCCNV|AFECTRL_DFT|AFECTRL_WG, bFALSE);  /* Stop ADC convert and DFT */
+
+  /* Measuring CE0 / SE0 */
+  sw_cfg.Dswitch = SWD_CE0;
+  sw_cfg.Pswitch = SWP_RE0;
+  sw_cfg.Nswitch = SWN_SE0;
+  sw_cfg.Tswitch = SWT_TRTIA|SWT_SE0LOAD;
+  AD5940_SWMatrixCfgS(&sw_cfg);
+  AD5940_AFECtrlS(AFECTRL_ADCPWR|AFECTRL_WG, bTRUE);  /* Enable Waveform generator */
+
+  AD5940_SEQGenFetchSeq(NULL, &_seqSettleAddr[1]);
+  AD5940_SEQGenInsert(SEQ_WAIT(16*10));
+  AD5940_SEQGenInsert(SEQ_WAIT(16*10));
+  AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT, bTRUE);  /* Start ADC convert and DFT */
+
+  AD5940_SEQGenFetchSeq(NULL, &_seqDftAddr[1]);
+  AD5940_SEQGenInsert(SEQ_WAIT(16*10));
+  AD5940_SEQGenInsert(SEQ_WAIT(16*10));
+  AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT|AFECTRL_WG|AFECTRL_ADCPWR, bFALSE);  /* Stop ADC convert and DFT */
+
+  /* Sequence end. HS loop stays powered for the next point. */
+  error = AD5940_SEQGenFetchSeq(&pSeqCmd, &seqLen);
+  AD5940_SEQGenCtrl(bFALSE);
+  if(error != AD5940ERR_OK) {
+    printf("Sequence generation failed: %d\n", error);
+    return error;
+  }
+
+  /* Write command to SRAM */
+  seq_info.SeqId = SEQID_0;
+  seq_info.SeqRamAddr = 0;
+  seq_info.pSeqCmd = pSeqCmd;
+  seq_info.SeqLen = seqLen;
+  seq_info.WriteSRAM = bTRUE;
+  AD5940_SEQInfoCfg(&seq_info);
+
+  seq_cfg.SeqCntCRCClr = bFALSE;
+  seq_cfg.SeqEnable = bTRUE;
+  AD5940_SEQCfg(&seq_cfg);  /* Enable sequencer, and wait for trigger */
+
+  printf("Measurement sequence loaded: %d commands\n", seqLen);
+  return AD5940ERR_OK;
+}
+
+/*
+  10/16/2026 - One sweep point with the sequencer. Patches the wait times for
+  _currentFreq, triggers the sequence, blocks until ENDSEQ and reads the Rcal and Rz
+  DFT results from the FIFO. Same calculation, printout and eisArr slot as
+  AD5940_DFTMeasure, and it advances the sweep the same way (logSweep).
+*/
+AD5940Err HELPStat::AD5940_SeqDFTMeasure(void) {
+  impStruct eis;
+  uint32_t waitCmd[2];
+  uint32_t fifoData[4];
+  int32_t dftData[4];
+
+  /* Magnitude / phase */
+  float magRcal, phaseRcal; 
+  float magRz, phaseRz;
+
+  /* Settling: a few periods plus a constant, split over two SEQ_WAITs (30-bit each) */
+  float settleSecs = SEQ_SETTLE_CYCLES / _currentFreq + SEQ_SETTLE_MS / 1000.0;
+  float settleClcks = settleSecs * SYSCLCK / 2;
+  if(settleClcks > 0x3fffffff) settleClcks = 0x3fffffff;
+
+  for(uint32_t leg = 0; leg < 2; leg++)
+  {
+    waitCmd[0] = SEQ_WAIT((uint32_t)settleClcks);
+    waitCmd[1] = SEQ_WAIT((uint32_t)settleClcks);
+    AD5940_SEQCmdWrite(_seqSettleAddr[leg], waitCmd, 2);
+
+    waitCmd[0] = SEQ_WAIT(_waitClcks / 2);
+    waitCmd[1] = SEQ_WAIT(_waitClcks - _waitClcks / 2);
+    AD5940_SEQCmdWrite(_seqDftAddr[leg], waitCmd, 2);
+  }
+
+  AD5940_INTCClrFlag(AFEINTSRC_ALLINT);
+  AD5940_ClrMCUIntFlag();
+  AD5940_SEQMmrTrig(SEQID_0);
+
+  /* Nothing to do over SPI until the sequence is done. Give it twice the expected time. */
+  uint32_t timeoutMs = (uint32_t)(2 * (2 * settleSecs + 2 * _waitClcks / SYSCLCK) * 1000) + 100;
+  waitForInt(timeoutMs);
+
+  AD5940_ClrMCUIntFlag();
+  AD5940_INTCClrFlag(AFEINTSRC_ENDSEQ);
+
+  uint32_t fifoCnt = AD5940_FIFOGetCnt();
+  if(fifoCnt != 4)
+  {
+    /* Timed out or a DFT was cut short. Drop whatever is there and move on; the point keeps its slot,
+       flagged failed, so the cycle-end processing in fitResult still runs. */
+    printf("Sequence failed at %.2f Hz: %d FIFO words\n", _currentFreq, fifoCnt);
+    while(fifoCnt--) AD5940_FIFORd(fifoData, 1);
+    storeFailedPoint();
+    logSweep(&_sweepCfg, &_currentFreq);
+    return AD5940ERR_TIMEOUT;
+  }
+  AD5940_FIFORd(fifoData, 4);
+
+  for(uint32_t i = 0; i < 4; i++)
+  {
+    dftData[i] = fifoData[i] & 0x3ffff;
+    /* Data is 18bit in two's complement, bit17 is the sign bit */
+    if(dftData[i]&(1<<17)) dftData[i] |= 0xfffc0000;
+  }
+  if(!dftUsable(dftData)) {
+    printf("Sequence failed at %.2f Hz: zero DFT\n", _currentFreq);
+    storeFailedPoint();
+    logSweep(&_sweepCfg, &_currentFreq);
+    return AD5940ERR_ERROR;
+  }
+
+  getMagPhase(dftData[0], dftData[1], &magRcal, &phaseRcal);
+  getMagPhase(dftData[2], dftData[3], &magRz, &phaseRz);
+
+  /* Finding the actual magnitude and phase */
+  eis.magnitude = (magRcal / magRz) * _rcalVal; 
+  eis.phaseRad = phaseRcal - phaseRz;
+  eis.real = eis.magnitude * cos(eis.phaseRad);
+  eis.imag = eis.magnitude * sin(eis.phaseRad) * -1; 
+  eis.phaseDeg = eis.phaseRad * 180 / MATH_PI; 
+  eis.freq = _currentFreq;
+
+  /* Printing Values */
+  printf("%d,", _sweepCfg.SweepIndex);
+  printf("%.2f,", _currentFreq);
+  printf("%.3f,", magRcal);
+  printf("%.3f,", magRz);
+  printf("%f,", eis.magnitude);
+  printf("%.4f,", eis.real);
+  printf("%.4f,", eis.imag);
+  printf("%.4f\n", eis.phaseRad);
+
+  uint32_t resultIdx;
+  if(resultSlot(&resultIdx)) {
+    storeRecord(resultIdx, dftData, DFTREC_VALID);
+    logResult(resultIdx);
+    fitResult(resultIdx);
+    streamResult(resultIdx);
+  }
+
+  /* Updating Frequency */
+  logSweep(&_sweepCfg, &_currentFreq);
+  return AD5940ERR_OK;
+}
+
+/*
+  10/16/2026 - Drop-in for runSweep. Same cycles, delay and eisArr layout, but each
+  point is one sequencer run, so there are no settlingDelay / pollDFT / per-point
+  delay() calls on the ESP32.
+*/
+void HELPStat::runSweepSeq(void) {
+  runSweepSeq(_numCycles, _delaySecs);
+}
+
+void HELPStat::runSweepSeq(uint32_t numCycles, uint32_t delaySecs) {
+  if(!beginRun(numCycles)) return;
+
+  AD5940_SleepKeyCtrlS(SLPKEY_LOCK); // Disables Sleep Mode 
+  if(AD5940_SeqSweepInit() != AD5940ERR_OK)
+  {
+    Serial.println("Unable to start sequencer sweep.");
+    endRun();
+    return;
+  }
+
+  for(uint32_t i = 0; i <= numCycles; i = endCycle(i)) {
+    beginCycle(i, delaySecs);
+    
+    /* Calibrates based on frequency */
+    configureFrequency(_currentFreq);
+
+    printf("Cycle %d\n", i);
+    printf("Index, Frequency (Hz), DFT Cal, DFT Mag, Rz (Ohms), Rreal, Rimag, Rphase (rads)\n");
+    
+    while(_sweepCfg.SweepEn == bTRUE)
+    {
+      AD5940_SeqDFTMeasure();
+    }
+  }
+  endRun();
+
+  /* Hand INT0 back to DFTRDY for runSweep */
+  AD5940_SEQCtrlS(bFALSE);
+  AD5940_INTCCfg(AFEINTC_0, AFEINTSRC_ENDSEQ, bFALSE);
+  AD5940_INTCCfg(AFEINTC_0, AFEINTSRC_DFTRDY, bTRUE);
+  
+  /* Shutdown to conserve power. This turns off the LP-Loop and resets the AFE. */
+  AD5940_ShutDownS();
+  Serial.println("All cycles finished.");
+  Serial.println("AD594x shutting down.");
+}
+
+void HELPStat::settlingDelay(float freq) {
+ 
+  // unsigned long constDelay = (4 * 1000 / freq); // delay constant just in case delay is too small
+  unsigned long constDelay = 1000; // 1000 - delay constant just in case delay is too small 
+   /* Getting the delay time based on frequency */
+  if(freq <= 5) {
+    constDelay = 2000; // 2000
+    delay((unsigned long)(2 * 1000 / freq) + constDelay); // Trying 4 periods to improve Zw results instead of 2
+  }
+  else delay((constDelay)); 
+  
+}
+
+/*
+  10/16/2026 - Adaptive settling for one leg of AD5940_DFTMeasure, called with the WG
+  running in place of settlingDelay(). Waits SETTLE_MIN_CYCLES periods, or SETTLE_TAU_MULT
+  cell time constants if that is longer. Tau comes from the previous point treated as a
+  parallel RC (tau = |tan(phase)| / 2*pi*f). After that it runs quarter-length DFTs back to
+  back until two in a row agree within SETTLE_TOL, never going past settleMaxMs(freq). If a
+  short DFT would cover less than two periods there is nothing to compare, so only the
+  minimum wait is used. DFTCON is restored and ADCCNV/DFT are left off.
+  Adds the time to pSettle and keeps the worst status of the two legs there.
+*/
+uint8_t HELPStat::adaptiveSettle(float freq, settleStruct *pSettle) {
+  unsigned long timeStart = millis();
+  uint8_t status = SETTLE_UNCHECKED;
+
+  if(!_adaptiveSettle) {
+    settlingDelay(freq);
+    pSettle->settleMs += millis() - timeStart;
+    pSettle->status = SETTLE_UNCHECKED;
+    return SETTLE_UNCHECKED;
+  }
+
+  uint32_t maxMs = settleMaxMs(freq);
+
+  /* Minimum wait */
+  float minMs = SETTLE_MIN_CYCLES * 1000.0 / freq;
+  if(_prevEis.freq > 0) {
+    float tauMs = fabs(tan(_prevEis.phaseRad)) / (2 * MATH_PI * _prevEis.freq) * 1000;
+    if(SETTLE_TAU_MULT * tauMs > minMs) minMs = SETTLE_TAU_MULT * tauMs;
+  }
+  if(minMs > maxMs) minMs = maxMs;
+  delay((unsigned long)ceil(minMs));
+
+  /* Short DFTs: 2^(DFTNUM+2) / 4 samples */
+  uint32_t dftCon = AD5940_ReadReg(REG_AFE_DFTCON);
+  uint32_t dftNum = (dftCon & BITM_AFE_DFTCON_DFTNUM) >> BITP_AFE_DFTCON_DFTNUM;
+  float shortMs = _waitClcks / 4 / SYSCLCK * 1000;
+
+  if(dftNum >= 2 && shortMs * freq / 1000 >= 2) {
+    int32_t real, image;
+    int32_t prevReal = 0, prevImage = 0;
+    uint16_t checks = 0;
+
+    AD5940_WriteReg(REG_AFE_DFTCON, (dftCon & ~BITM_AFE_DFTCON_DFTNUM) | ((dftNum - 2) << BITP_AFE_DFTCON_DFTNUM));
+    status = SETTLE_CAPPED;
+    while(millis() - timeStart + shortMs <= maxMs) {
+      AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT, bTRUE);
+      bool gotDft = pollDFT(&real, &image);
+      AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT, bFALSE);
+      checks++;
+      if(!gotDft) break; // Left capped; the measurement's own DFT reports the failure
+
+      float mag = sqrt((float)real*real + (float)image*image);
+      float diff = sqrt((float)(real - prevReal)*(real - prevReal) + (float)(image - prevImage)*(image - prevImage));
+      if(checks > 1 && mag > 0 && diff <= SETTLE_TOL * mag) {
+        status = SETTLE_CONVERGED;
+        break;
+      }
+      prevReal = real;
+      prevImage = image;
+    }
+    AD5940_WriteReg(REG_AFE_DFTCON, dftCon);
+    pSettle->checks += checks;
+  }
+
+  pSettle->settleMs += millis() - timeStart;
+  if(status > pSettle->status) pSettle->status = status;
+  return status;
+}
+
+/*
+  10/16/2026 - Upper bound on adaptive settling per leg. Never more than the old
+  settlingDelay() for the same frequency.
+*/
+uint32_t HELPStat::settleMaxMs(float freq) {
+  static const struct {
+    float freq;
+    uint32_t maxMs;
+  } bands[] = {
+    {1000, 100},
+    {100,  300},
+    {5,    1000}
+  };
+
+  for(uint32_t i = 0; i < sizeof(bands) / sizeof(bands[0]); i++)
+    if(freq > bands[i].freq) return bands[i].maxMs;
+  return (uint32_t)(2 * 1000 / freq) + 2000;
+}
+
+void HELPStat::setAdaptiveSettling(bool enable) {
+  _adaptiveSettle = enable;
+}
+
+settleStruct HELPStat::getSettle(uint32_t index) {
+  settleStruct empty = {};
+  if(index >= _resultCap) return empty;
+  return _settleArr[index];
+}
+
+/*
+  10/16/2026 - Rcal calibration cache. Rcal and the RTIA path do not change between
+  cycles, so the Rcal DFT is kept per sweep point along with the frequency, RTIA and
+  gains it was measured with. A lookup misses if any of those changed or the entry is
+  older than _rcalRefreshCycles cycles.
+*/
+bool HELPStat::rcalCacheLookup(int32_t *pReal, int32_t *pImage) {
+  uint32_t index = _sweepCfg.SweepIndex;
+  if(!_rcalCacheEn || index >= RCAL_CACHE_SIZE) return false;
+
+  rcalCacheStruct *pEntry = &_rcalCache[index];
+  if(!pEntry->valid || pEntry->freq != _currentFreq || pEntry->rTIA != _currentRtia ||
+     pEntry->extGain != _extGain || pEntry->dacGain != _dacGain) {
+    _rcalStats.misses++;
+    return false;
+  }
+  if(_rcalRefreshCycles && _currentCycle - pEntry->cycle >= _rcalRefreshCycles) {
+    _rcalStats.misses++;
+    _rcalStats.refreshes++;
+    return false;
+  }
+
+  *pReal = pEntry->real;
+  *pImage = pEntry->image;
+  _rcalStats.hits++;
+  return true;
+}
+
+/*
+  Stores a fresh Rcal DFT. If it replaces an entry with the same key and moved by more
+  than _rcalDriftPct, the rest of the cache is dropped too so every point re-measures.
+*/
+void HELPStat::rcalCacheStore(int32_t real, int32_t image) {
+  uint32_t index = _sweepCfg.SweepIndex;
+  if(!_rcalCacheEn || index >= RCAL_CACHE_SIZE) return;
+
+  rcalCacheStruct *pEntry = &_rcalCache[index];
+  if(pEntry->valid && pEntry->freq == _currentFreq && pEntry->rTIA == _currentRtia &&
+     pEntry->extGain == _extGain && pEntry->dacGain == _dacGain) {
+    float oldMag = sqrt((float)pEntry->real*pEntry->real + (float)pEntry->image*pEntry->image);
+    float diff = sqrt((float)(real - pEntry->real)*(real - pEntry->real) + 
+                      (float)(image - pEntry->image)*(image - pEntry->image));
+    if(oldMag > 0 && diff / oldMag * 100 > _rcalDriftPct) {
+      printf("Rcal drifted %.2f%% at %.2f Hz, dropping cache\n", diff / oldMag * 100, _currentFreq);
+      for(uint32_t i = 0; i < RCAL_CACHE_SIZE; i++) _rcalCache[i].valid = false;
+      _rcalStats.drifts++;
+    }
+  }
+
+  pEntry->freq = _currentFreq;
+  pEntry->rTIA = _currentRtia;
+  pEntry->extGain = _extGain;
+  pEntry->dacGain = _dacGain;
+  pEntry->real = real;
+  pEntry->image = image;
+  pEntry->cycle = _currentCycle;
+  pEntry->valid = true;
+}
+
+void HELPStat::setRcalCache(bool enable, uint32_t refreshCycles, float driftPct) {
+  _rcalCacheEn = enable;
+  _rcalRefreshCycles = refreshCycles;
+  _rcalDriftPct = driftPct;
+  clearRcalCache();
+}
+
+void HELPStat::clearRcalCache(void) {
+  memset(_rcalCache, 0, sizeof(_rcalCache));
+  memset(&_rcalStats, 0, sizeof(_rcalStats));
+}
+
+rcalCacheStats HELPStat::getRcalCacheStats(void) {
+  return _rcalStats;
+}
+
+/* Internal RTIA values in HSTIARTIA_xxx order */
+static const float rangeRtiaOhms[] = {200, 1000, 5000, 10000, 20000, 40000, 80000, 160000};
+
+/* Excitation settings, smallest amplitude first: excitation buffer gain x DAC gain */
+static const struct {
+  uint8_t extGain;
+  uint8_t dacGain;
+  float amp;
+} rangeExcitation[] = {
+  {EXCITBUFGAIN_0P25, HSDACGAIN_0P2, 0.25f * 0.2f},
+  {EXCITBUFGAIN_0P25, HSDACGAIN_1,   0.25f},
+  {EXCITBUFGAIN_2,    HSDACGAIN_0P2, 2.0f * 0.2f},
+  {EXCITBUFGAIN_2,    HSDACGAIN_1,   2.0f}
+};
+
+static int rangeExcitationIndex(int extGain, int dacGain) {
+  for(int e = 0; e < (int)(sizeof(rangeExcitation) / sizeof(rangeExcitation[0])); e++)
+    if(rangeExcitation[e].extGain == extGain && rangeExcitation[e].dacGain == dacGain) return e;
+  return 0;
+}
+
+/*
+  10/16/2026 - Puts the HSTIA and excitation stages on one setting for the current point, leaving
+  the rest of its plan entry alone. _extGain / _dacGain follow the hardware so the Rcal cache is
+  keyed on what was really measured; AD5940_DFTMeasure puts the configured gains back afterwards.
+*/
+void HELPStat::applyRange(int rTIA, int extGain, int dacGain) {
+  HSDACCfg_Type hsdac_cfg;
+
+  hsdac_cfg.ExcitBufGain = extGain;
+  hsdac_cfg.HsDacGain = dacGain;
+  hsdac_cfg.HsDacUpdateRate = _currentFreq >= 80000 ? 0x07 : 0x1B;
+  AD5940_HSDacCfgS(&hsdac_cfg);
+  AD5940_HSRTIACfgS(rTIA);
+  __AD5940_SetDExRTIA(0, HSTIADERTIA_OPEN, HSTIADERLOAD_0R);
+  _currentRtia = rTIA;
+  _extGain = extGain;
+  _dacGain = dacGain;
+}
+
+/*
+  10/16/2026 - Autoranging decision after both legs of a point, called by AD5940_DFTMeasure.
+  Fills pRange with the setting and headroom of the measurement just taken and returns true if
+  it applied another setting to measure the point with. A leg is over range when its |DFT| is
+  above _rangeHigh of full scale, a component sits on the 18-bit rail or the comparator tripped;
+  the Rz leg is under range below _rangeLow. Both legs scale with RTIA x excitation amplitude, so
+  the next setting is predicted from the magnitudes instead of stepped to: the largest gain that
+  puts both legs at half the high limit or less. The configured excitation (extGain, dacGain) is
+  kept if any RTIA can do that, otherwise the excitation is lowered; it is never raised past the
+  configured one, which would push the cell harder than asked. A saturated leg only gives a
+  lower bound, so it counts as full scale.
+*/
+bool HELPStat::autorangeStep(const int32_t *pDft, bool clipRcal, bool clipRz, int extGain, int dacGain,
+                             rangeStruct *pRange) {
+  const float fullScale = AUTORANGE_DFT_FS;
+  float magRcal = sqrt((float)pDft[0]*pDft[0] + (float)pDft[1]*pDft[1]);
+  float magRz = sqrt((float)pDft[2]*pDft[2] + (float)pDft[3]*pDft[3]);
+  bool railRcal = clipRcal || abs(pDft[0]) >= AUTORANGE_DFT_FS || abs(pDft[1]) >= AUTORANGE_DFT_FS;
+  bool railRz = clipRz || abs(pDft[2]) >= AUTORANGE_DFT_FS || abs(pDft[3]) >= AUTORANGE_DFT_FS;
+
+  pRange->rTIA = _currentRtia;
+  pRange->extGain = _extGain;
+  pRange->dacGain = _dacGain;
+  pRange->clipped = clipRcal || clipRz;
+  pRange->headroom = fmaxf(magRcal, magRz) / fullScale;
+  if(!_autorange) {
+    pRange->status = RANGE_FIXED;
+    return false;
+  }
+
+  bool high = railRcal || railRz || fmaxf(magRcal, magRz) > _rangeHigh * fullScale;
+  bool low = !high && magRz < _rangeLow * fullScale;
+  pRange->status = high ? RANGE_HIGH : (low ? RANGE_LOW : RANGE_OK);
+  if(pRange->status == RANGE_OK || pRange->remeasures >= AUTORANGE_MAX_STEPS) return false;
+
+  if(railRcal && magRcal < fullScale) magRcal = fullScale;
+  if(railRz && magRz < fullScale) magRz = fullScale;
+  float peak = fmaxf(magRcal, magRz);
+  float gain = rangeRtiaOhms[_currentRtia & 7] * rangeExcitation[rangeExcitationIndex(_extGain, _dacGain)].amp;
+
+  /* Configured excitation first, then each smaller one */
+  int bestRtia = -1, bestExc = 0;
+  float bestGain = 0;
+  for(int e = rangeExcitationIndex(extGain, dacGain); e >= 0 && bestRtia < 0; e--) {
+    for(int r = 0; r < (int)(sizeof(rangeRtiaOhms) / sizeof(rangeRtiaOhms[0])); r++) {
+      float g = rangeRtiaOhms[r] * rangeExcitation[e].amp;
+      if(peak * g / gain <= _rangeHigh / 2 * fullScale && g > bestGain) {
+        bestRtia = r;
+        bestExc = e;
+        bestGain = g;
+      }
+    }
+  }
+  if(bestRtia < 0) bestRtia = HSTIARTIA_200;  // Even the smallest gain is too much: take it anyway
+
+  if(bestRtia == _currentRtia && rangeExcitation[bestExc].extGain == _extGain &&
+     rangeExcitation[bestExc].dacGain == _dacGain) return false;  // Nothing better to try
+
+  printf("Autorange %.2f Hz: Rcal %.0f, Rz %.0f of %d, RTIA %d -> %d, gains %d/%d -> %d/%d\n", _currentFreq,
+         magRcal, magRz, AUTORANGE_DFT_FS, _currentRtia, bestRtia, _extGain, _dacGain,
+         rangeExcitation[bestExc].extGain, rangeExcitation[bestExc].dacGain);
+  applyRange(bestRtia, rangeExcitation[bestExc].extGain, rangeExcitation[bestExc].dacGain);
+  pRange->remeasures++;
+  return true;
+}
+
+/*
+  Autoranges every AD5940_DFTMeasure point of the next runs. high / low are fractions of
+  AUTORANGE_DFT_FS. useComparator also arms the ADC digital comparator at high of the ADC
+  range, which catches clipping the DFT of a clipped sine can hide. Forgets the settings
+  points ended on in earlier runs.
+*/
+void HELPStat::setAutorange(bool enable, bool useComparator, float high, float low) {
+  _autorange = enable;
+  _rangeComparator = enable && useComparator;
+  _rangeHigh = high;
+  _rangeLow = low;
+  memset(_rangeStart, 0, sizeof(_rangeStart));
+}
+
+/* RTIA / excitation setting and headroom of one stored point (status RANGE_NONE if not recorded) */
+rangeStruct HELPStat::getRange(uint32_t index) {
+  rangeStruct none = {};
+  if(index >= _resultCap) return none;
+  return _rangeArr[index];
+}
+
+/*
+  10/16/2026 - Persistent RTIA calibration. The two-leg measurement divides out everything common to
+  both legs (excitation amplitude, RTIA and CTIA, the analog path delay) by measuring Rcal at every
+  point. Those do not change from one power-up to the next, so calibrateRtia measures the Rcal leg
+  once per sweep point and HSTIARTIA setting and the table is kept in NVS. A point measured
+  single-leg then only needs its Rz DFT, which is scaled against the stored Rcal DFT exactly as if
+  both had just been measured. The table is keyed on the sweep, Rcal value and excitation it was
+  taken with; calValid / calLookup refuse it for anything else.
+*/
+bool HELPStat::calValid(void) {
+  return _cal.version == CAL_VERSION && _cal.points != 0 && _cal.points == _sweepCfg.SweepPoints &&
+         _cal.startFreq == _sweepCfg.SweepStart && _cal.endFreq == _sweepCfg.SweepStop && _cal.rcalVal == _rcalVal;
+}
+
+/* Rcal DFT of the current point, RTIA and gains from the table; false if it does not cover them */
+bool HELPStat::calLookup(int32_t *pReal, int32_t *pImage) {
+  uint32_t index = _sweepCfg.SweepIndex;
+  if(!_singleLeg || !calValid() || index >= _cal.points) return false;
+
+  const calPointStruct *pPoint = &_cal.point[index];
+  if(pPoint->freq != _currentFreq || _currentRtia < 0 || _currentRtia >= CAL_RTIA_COUNT ||
+     !(pPoint->rtiaMask & (1 << _currentRtia)) || _extGain != _cal.extGain || _dacGain != _cal.dacGain) return false;
+
+  *pReal = pPoint->rcal[_currentRtia][0];
+  *pImage = pPoint->rcal[_currentRtia][1];
+  return true;
+}
+
+/* Impedance of a DFT pair in the usual Rcal x Rcal DFT / Rz DFT form (DFT imag is stored negated) */
+static fImpCar_Type calImpedance(const int32_t *pDft, float rcalVal) {
+  fImpCar_Type rcal = {(float)pDft[0] * rcalVal, -(float)pDft[1] * rcalVal};
+  fImpCar_Type rz = {(float)pDft[2], -(float)pDft[3]};
+  return AD5940_ComplexDivFloat(&rcal, &rz);
+}
+
+/*
+  Open / short compensation of the current point, Z = (Zm - Zs) / (1 - (Zm - Zs) Yo), with Zs the
+  shorted and Yo = 1 / (Zopen - Zs) the open leads. The corrected Z is written back as a new Rcal
+  DFT against the measured Rz DFT, so the record decodes to it like any other; the pair is scaled so
+  its largest value is at full scale, as in AD5940_DFTMeasureEIS, to keep the rounding out of the
+  result. Returns false, leaving pDft alone, if there is nothing to apply.
+*/
+bool HELPStat::calCompensate(int32_t *pDft) {
+  uint32_t index = _sweepCfg.SweepIndex;
+  if(!_openShort || !calValid() || index >= _cal.points) return false;
+
+  const calPointStruct *pPoint = &_cal.point[index];
+  if(pPoint->freq != _currentFreq || !pPoint->fixtures || (pDft[2] == 0 && pDft[3] == 0)) return false;
+
+  fImpCar_Type one = {1.0f, 0};
+  fImpCar_Type zs = {0, 0}, yo = {0, 0};
+  if(pPoint->fixtures & CAL_FIXTURE_SHORT) zs = pPoint->zShort;
+  if(pPoint->fixtures & CAL_FIXTURE_OPEN) {
+    /* Yo = Yopen / (1 - Zs Yopen) takes the short out of the open measurement */
+    fImpCar_Type zsYo = AD5940_ComplexMulFloat(&zs, (fImpCar_Type *)&pPoint->yOpen);
+    fImpCar_Type den = AD5940_ComplexSubFloat(&one, &zsYo);
+    yo = AD5940_ComplexDivFloat((fImpCar_Type *)&pPoint->yOpen, &den);
+  }
+
+  fImpCar_Type zm = calImpedance(pDft, _rcalVal);
+  fImpCar_Type diff = AD5940_ComplexSubFloat(&zm, &zs);
+  fImpCar_Type diffYo = AD5940_ComplexMulFloat(&diff, &yo);
+  fImpCar_Type den = AD5940_ComplexSubFloat(&one, &diffYo);
+  fImpCar_Type z = AD5940_ComplexDivFloat(&diff, &den);
+
+  /* Rcal DFT that gives z against the measured Rz DFT */
+  fImpCar_Type rz = {(float)pDft[2] / _rcalVal, -(float)pDft[3] / _rcalVal};
+  fImpCar_Type rcal = AD5940_ComplexMulFloat(&z, &rz);
+  float peak = fmaxf(fmaxf(fabsf(rcal.Real), fabsf(rcal.Image)), fmaxf(abs(pDft[2]), abs(pDft[3])));
+  float scale = AUTORANGE_DFT_FS / peak;
+  pDft[0] = (int32_t)lroundf(rcal.Real * scale);
+  pDft[1] = (int32_t)lroundf(-rcal.Image * scale);
+  pDft[2] = (int32_t)lroundf(pDft[2] * scale);
+  pDft[3] = (int32_t)lroundf(pDft[3] * scale);
+  return true;
+}
+
+/* Moves the sweep to plan point index without measuring it */
+void HELPStat::calSetPoint(uint32_t index) {
+  _sweepCfg.SweepIndex = index;
+  _currentFreq = _plan[index].freq;
+  applySweepPlan(index);
+}
+
+/*
+  Characterises every HSTIARTIA setting at every point of the configured sweep: the Rcal leg is
+  measured with each RTIA, smallest first, and kept while it is between CAL_RANGE_LOW and
+  AUTORANGE_HIGH of full scale; a larger RTIA only has more gain, so the first one over the top
+  ends the point. Uses the configured excitation. Call after AD5940_TDD; replaces the table in
+  memory (saveCalibration stores it) and leaves the sweep at its first point for runSweep.
+*/
+bool HELPStat::calibrateRtia(void) {
+  uint32_t points = _sweepCfg.SweepPoints;
+  if(!sweepPlanValid() || points > CAL_MAX_POINTS) {
+    printf("RTIA calibration: needs a compiled sweep of at most %d points\n", CAL_MAX_POINTS);
+    return false;
+  }
+
+  memset(&_cal, 0, sizeof(_cal));
+  _cal.version = CAL_VERSION;
+  _cal.startFreq = _sweepCfg.SweepStart;
+  _cal.endFreq = _sweepCfg.SweepStop;
+  _cal.rcalVal = _rcalVal;
+  _cal.extGain = _extGain;
+  _cal.dacGain = _dacGain;
+
+  impStruct prevEis = _prevEis;
+  memset(&_prevEis, 0, sizeof(_prevEis));  // Only Rcal is measured; no cell time constant to wait for
+  bool comparator = _rangeComparator;
+  _rangeComparator = false;
+
+  printf("RTIA calibration: %u points x %d RTIA settings, Rcal %.1f\n", points, CAL_RTIA_COUNT, _rcalVal);
+  printf("Index, Frequency (Hz), RTIA in range (mask), Largest Rcal DFT\n");
+  bool ok = true;
+  for(uint32_t i = 0; i < points && ok; i++) {
+    calSetPoint(i);
+    calPointStruct *pPoint = &_cal.point[i];
+    pPoint->freq = _currentFreq;
+    float largest = 0;
+
+    for(int r = 0; r < CAL_RTIA_COUNT; r++) {
+      settleStruct settle = {};
+      int32_t real, image;
+      bool clip;
+      applyRange(r, _cal.extGain, _cal.dacGain);
+      if(!measureRcalLeg(&settle, &real, &image, &clip)) {
+        printf("RTIA calibration: no DFT at %.2f Hz, RTIA %d\n", _currentFreq, r);
+        ok = false;
+        break;
+      }
+
+      float mag = sqrt((float)real*real + (float)image*image);
+      bool rail = abs(real) >= AUTORANGE_DFT_FS || abs(image) >= AUTORANGE_DFT_FS;
+      if(rail || mag > AUTORANGE_HIGH * AUTORANGE_DFT_FS) break;
+      if(mag >= CAL_RANGE_LOW * AUTORANGE_DFT_FS) {
+        pPoint->rcal[r][0] = real;
+        pPoint->rcal[r][1] = image;
+        pPoint->rtiaMask |= 1 << r;
+        largest = mag;
+      }
+    }
+    printf("%d,%.2f,0x%02X,%.0f\n", i, pPoint->freq, pPoint->rtiaMask, largest);
+  }
+  if(ok) _cal.points = points;
+  else memset(&_cal, 0, sizeof(_cal));  // No half-filled table to save
+
+  _rangeComparator = comparator;
+  _prevEis = prevEis;
+  resetSweep(&_sweepCfg, &_currentFreq);
+  configureFrequency(_currentFreq);
+  return ok;
+}
+
+/*
+  Measures the leads with nothing connected (CAL_FIXTURE_OPEN) or shorted (CAL_FIXTURE_SHORT) at
+  every point of the table's sweep, two legs and autoranged so the nearly zero (open) and nearly
+  infinite (short) currents both get a usable RTIA. Needs calibrateRtia first; the configured
+  excitation is the most autoranging will use.
+*/
+bool HELPStat::calibrateFixture(uint8_t fixture) {
+  if((fixture != CAL_FIXTURE_OPEN && fixture != CAL_FIXTURE_SHORT) || !calValid() || !sweepPlanValid()) {
+    printf("Fixture calibration: needs calibrateRtia on this sweep first\n");
+    return false;
+  }
+
+  impStruct prevEis = _prevEis;
+  bool autorange = _autorange, comparator = _rangeComparator, singleLeg = _singleLeg;
+  memset(&_prevEis, 0, sizeof(_prevEis));
+  _autorange = true;
+  _rangeComparator = false;
+  _singleLeg = false;
+  memset(_rangeStart, 0, sizeof(_rangeStart));
+
+  printf("%s calibration: %u points\n", fixture == CAL_FIXTURE_OPEN ? "Open" : "Short", _cal.points);
+  printf("Index, Frequency (Hz), Real, Imag, RTIA\n");
+  bool ok = true;
+  for(uint32_t i = 0; i < _cal.points; i++) {
+    settleStruct settle = {};
+    rangeStruct range = {};
+    int32_t dft[4];
+    bool rcalCal;
+    calSetPoint(i);
+    /* A zero Rz leg is a good open; a zero Rcal leg (or no DFT) is not */
+    bool got = acquirePoint(dft, &settle, &range, &rcalCal);
+    if(!got || (fixture == CAL_FIXTURE_OPEN ? dft[0] == 0 && dft[1] == 0 : !dftUsable(dft))) {
+      printf("%s calibration: no DFT at %.2f Hz\n", fixture == CAL_FIXTURE_OPEN ? "Open" : "Short", _currentFreq);
+      ok = false;
+      break;
+    }
+
+    calPointStruct *pPoint = &_cal.point[i];
+    fImpCar_Type rcal = {(float)dft[0] * _rcalVal, -(float)dft[1] * _rcalVal};
+    fImpCar_Type rz = {(float)dft[2], -(float)dft[3]};
+    if(fixture == CAL_FIXTURE_OPEN) {
+      /* Admittance, so an open that leaves the Rz leg at zero is simply Yo = 0 */
+      pPoint->yOpen = AD5940_ComplexDivFloat(&rz, &rcal);
+      printf("%d,%.2f,%g,%g,%d\n", i, pPoint->freq, pPoint->yOpen.Real, pPoint->yOpen.Image, range.rTIA);
+    }
+    else {
+      pPoint->zShort = calImpedance(dft, _rcalVal);
+      printf("%d,%.2f,%g,%g,%d\n", i, pPoint->freq, pPoint->zShort.Real, pPoint->zShort.Image, range.rTIA);
+    }
+    pPoint->fixtures |= fixture;
+  }
+  if(!ok) for(uint32_t i = 0; i < _cal.points; i++) _cal.point[i].fixtures &= ~fixture;
+
+  _autorange = autorange;
+  _rangeComparator = comparator;
+  _singleLeg = singleLeg;
+  memset(_rangeStart, 0, sizeof(_rangeStart));  // Those were the fixture's settings
+  _prevEis = prevEis;
+  resetSweep(&_sweepCfg, &_currentFreq);
+  configureFrequency(_currentFreq);
+  return ok;
+}
+
+/* Writes the table (header and the points in use) to NVS */
+bool HELPStat::saveCalibration(void) {
+  Preferences prefs;
+  if(_cal.points == 0) return false;
+  if(!prefs.begin(CAL_NVS_NAMESPACE, false)) {
+    printf("Calibration: NVS not available\n");
+    return false;
+  }
+  size_t len = offsetof(calTableStruct, point) + _cal.points * sizeof(calPointStruct);
+  bool ok = prefs.putBytes(CAL_NVS_KEY, &_cal, len) == len;
+  prefs.end();
+  printf("Calibration: %s %u points (%u bytes)\n", ok ? "saved" : "could not save", _cal.points, (unsigned)len);
+  return ok;
+}
+
+/* Reads the table back from NVS; false (and no table) if there is none or it has another layout */
+bool HELPStat::loadCalibration(void) {
+  Preferences prefs;
+  memset(&_cal, 0, sizeof(_cal));
+  if(!prefs.begin(CAL_NVS_NAMESPACE, true)) return false;
+  size_t len = prefs.getBytesLength(CAL_NVS_KEY);
+  bool ok = len >= offsetof(calTableStruct, point) && len <= sizeof(_cal) &&
+            prefs.getBytes(CAL_NVS_KEY, &_cal, sizeof(_cal)) == len;
+  prefs.end();
+
+  ok = ok && _cal.version == CAL_VERSION && _cal.points <= CAL_MAX_POINTS &&
+       len == offsetof(calTableStruct, point) + _cal.points * sizeof(calPointStruct);
+  if(!ok) {
+    memset(&_cal, 0, sizeof(_cal));
+    printf("Calibration: no stored table\n");
+    return false;
+  }
+  printf("Calibration: loaded %u points, %.2f - %.2f Hz, Rcal %.1f\n", _cal.points, _cal.startFreq,
+         _cal.endFreq, _cal.rcalVal);
+  return true;
+}
+
+void HELPStat::clearCalibration(void) {
+  memset(&_cal, 0, sizeof(_cal));
+}
+
+/*
+  singleLeg takes each point's Rcal DFT from the table, openShort applies the open / short
+  compensation; both only where the table covers the point (AD5940_DFTMeasure, not runSweepSeq).
+*/
+void HELPStat::setCalibration(bool singleLeg, bool openShort) {
+  _singleLeg = singleLeg;
+  _openShort = openShort;
+}
+
+calPointStruct HELPStat::getCalPoint(uint32_t index) {
+  calPointStruct empty = {};
+  if(index >= _cal.points) return empty;
+  return _cal.point[index];
+}
+
+calStats HELPStat::getCalStats(void) {
+  return _calStats;
+}
+
+/*
+  10/16/2026 - Multisine acquisition. Below about 1 Hz a point costs an 8192-point DFT at the SINC2
+  rate plus settling, for each leg. Instead, the low-frequency points are grouped (planMultisine) so
+  each is an integer bin of one waveform period of N = MSINE_STEPS x step SINC2 samples, and the
+  sequencer steps HSDACDAT (WG in MMR mode) through the sum of those tones while the SINC2 samples
+  stream into the FIFO. Each leg runs the waveform until it has settled and records one period,
+  whose bins are the tone DFTs: exact, with no leakage, because the period is whole. The staircase
+  and SINC2 averaging are the same in both legs, so they divide out as the RTIA and excitation do in
+  the DFT measurement.
+*/
+void HELPStat::setMultisine(bool enable, float maxFreq) {
+  _msine = enable;
+  _msineMaxFreq = maxFreq;
+  planMultisine();
+}
+
+msineStats HELPStat::getMultisineStats(void) {
+  return _msineStats;
+}
+
+/* The current sweep point starts (or is part of) a multisine group */
+bool HELPStat::msinePoint(uint32_t index) {
+  return _msine && sweepPlanValid() && index < _planSize && _plan[index].msGroup != 0;
+}
+
+/*
+  One leg of a multisine group, with the switch matrix already set: triggers seqId, reads the
+  recorded period out of the FIFO as it arrives and runs each tone's Goertzel recurrence on it,
+  the same values as those bins of an N-point FFT without keeping the samples. pPeak gets the
+  largest sample as a fraction of ADC full scale. Returns false if the period did not arrive.
+
+  10/16/2026 - Sleeps in waitForInt between chunks instead of polling the FIFO count every
+  200 ms: INTC0 carries the data FIFO threshold (MSINE_FIFO_CHUNK words) and the end of the
+  sequence, which brings in the last, partial chunk. As in pollDFT a timeout or an interrupt
+  without either flag (or with a FIFO overflow) fails the leg.
+*/
+bool HELPStat::msineLeg(uint32_t seqId, uint32_t settleSteps, uint32_t step, const uint16_t *pBins, uint32_t tones,
+                        double *pRe, double *pIm, float *pPeak) {
+  double coef[MSINE_STEPS / 2], s1[MSINE_STEPS / 2] = {0}, s2[MSINE_STEPS / 2] = {};
+  uint32_t buff[MSINE_FIFO_CHUNK];
+  uint32_t samples = MSINE_STEPS * step;
+  uint32_t got = 0;
+  int32_t peak = 0;
+  bool ended = false;
+
+  for(uint32_t k = 0; k < tones; k++) coef[k] = 2.0 * cos(2.0 * MATH_PI * pBins[k] / samples);
+
+  float legMs = (float)(settleSteps + MSINE_STEPS) * step * MSINE_SAMPLE_CLKS / SYSCLCK * 1000;
+  uint32_t timeoutMs = (uint32_t)(2 * legMs) + 1000;
+  unsigned long timeStart = millis();
+
+  AD5940_INTCClrFlag(AFEINTSRC_ALLINT);
+  AD5940_ClrMCUIntFlag();
+  AD5940_SEQMmrTrig(seqId);
+  while(got < samples || !ended) {
+    uint32_t count = got < samples ? AD5940_FIFOGetCnt() : 0;
+    if(got == samples || (count < MSINE_FIFO_CHUNK && count < samples - got)) {
+      /* Not a chunk yet, or the period is in and the ADC still to be turned off: wait for the AFE */
+      unsigned long elapsed = millis() - timeStart;
+      if(elapsed > timeoutMs || !waitForInt(timeoutMs - elapsed)) {
+        if(got < samples) printf("Multisine: leg timed out after %u of %u samples\n", got, samples);
+        else printf("Multisine: sequence did not end\n");
+        return false;
+      }
+      /* MCU flag first, then only the flags that were read: one raised in between keeps its
+         AFE flag and gives a new edge, instead of being cleared unseen */
+      AD5940_ClrMCUIntFlag();
+      uint32_t flags = AD5940_INTCGetFlag(AFEINTC_1);
+      AD5940_INTCClrFlag(flags & (AFEINTSRC_DATAFIFOTHRESH | AFEINTSRC_ENDSEQ));
+      if(flags & AFEINTSRC_DATAFIFOOF) {
+        printf("Multisine: FIFO overflowed after %u of %u samples\n", got, samples);
+        return false;
+      }
+      if(!(flags & (AFEINTSRC_DATAFIFOTHRESH | AFEINTSRC_ENDSEQ))) {
+        printf("Multisine: interrupt without a FIFO or sequence flag (0x%x)\n", flags);
+        return false;
+      }
+      if(flags & AFEINTSRC_ENDSEQ) ended = true;
+      _msineStats.fifoWaits++;
+      continue;
+    }
+    if(count > MSINE_FIFO_CHUNK) count = MSINE_FIFO_CHUNK;
+    if(count > samples - got) count = samples - got;
+    AD5940_FIFORd(buff, count);
+
+    for(uint32_t i = 0; i < count; i++) {
+      int32_t x = (int32_t)(buff[i] & 0xFFFF) - AUTORANGE_ADC_MID;
+      if(abs(x) > peak) peak = abs(x);
+      for(uint32_t k = 0; k < tones; k++) {
+        double s0 = x + coef[k] * s1[k] - s2[k];
+        s2[k] = s1[k];
+        s1[k] = s0;
+      }
+    }
+    got += count;
+  }
+
+  AD5940_FIFOCtrlS(FIFOSRC_SINC2NOTCH, bFALSE); // Else the next leg streams its settling period too
+
+  for(uint32_t k = 0; k < tones; k++) {
+    double w = 2.0 * MATH_PI * pBins[k] / samples;
+    pRe[k] = s1[k] * cos(w) - s2[k];
+    pIm[k] = s1[k] * sin(w);
+  }
+  *pPeak = (float)peak / (AUTORANGE_ADC_MID - 1);
+  _msineStats.samples += samples;
+  return true;
+}
+
+/*
+  Measures the multisine group the sweep is at and advances the sweep past it, storing every point
+  as AD5940_DFTMeasure does (status "multisine" in the printout, DFTREC_MSINE in the record). One
+  sequence serves both legs: SEQ0 settles for a whole period and records the next, SEQ1 starts
+  MSINE_RCAL_STEPS before the recorded period (Rcal has nothing to settle). The FIFO is switched on
+  half a sample into the recorded period and the ADC off half a sample after it, so exactly one
+  period of samples arrives. The waveform is a Schroeder-phased sum of the group's tones, its peak
+  the sine sweep's amplitude. Autoranging (setAutorange) picks the RTIA from the sample peaks of
+  both legs and measures the whole group again; the excitation stays as configured. If a leg times
+  out the group is measured point by point instead.
+*/
+void HELPStat::AD5940_MultisineMeasure(void) {
+  uint32_t first = _sweepCfg.SweepIndex;
+  uint8_t group = _plan[first].msGroup;
+  uint32_t tones = 0;
+  while(first + tones < _planSize && _plan[first + tones].msGroup == group) tones++;
+
+  uint32_t step = _plan[first].msStep;
+  uint32_t stepClks = step * MSINE_SAMPLE_CLKS;
+  uint32_t half = MSINE_SAMPLE_CLKS / 2;
+  uint16_t bins[MSINE_STEPS / 2];
+  int rTIA = _plan[first].rTIA;
+  for(uint32_t k = 0; k < tones; k++) {
+    bins[k] = _plan[first + k].msBin;
+    if(_plan[first + k].rTIA >= 0 && (rTIA < 0 || _plan[first + k].rTIA < rTIA)) rTIA = _plan[first + k].rTIA;
+  }
+  if(_autorange && first < ARRAY_SIZE && _rangeStart[first]) rTIA = _rangeStart[first] & LOG_RANGE_RTIA;
+  if(rTIA < 0) rTIA = HSTIARTIA_200;
+
+  /* Waveform: tones at the step centres, Schroeder phases for a low crest factor */
+  float wave[MSINE_STEPS], wavePeak = 0;
+  for(uint32_t m = 0; m < MSINE_STEPS; m++) {
+    wave[m] = 0;
+    for(uint32_t k = 0; k < tones; k++)
+      wave[m] += cosf(2 * MATH_PI * bins[k] * (m + 0.5f) / MSINE_STEPS - MATH_PI * k * (k + 1) / tones);
+    wavePeak = fmaxf(wavePeak, fabsf(wave[m]));
+  }
+  uint32_t amplitude = AD5940_ReadReg(REG_AFE_WGAMPLITUDE) & 0x7FF;
+  if(amplitude > MSINE_PEAK_MAX) amplitude = MSINE_PEAK_MAX;
+
+  /* LP mode, SINC2 samples (notch bypassed) into the FIFO, HSDAC from HSDACDAT */
+  ADCFilterCfg_Type filter_cfg;
+  AD5940_HPModeEn(bFALSE);
+  filter_cfg.ADCRate = ADCRATE_800KHZ;
+  filter_cfg.ADCAvgNum = ADCAVGNUM_16;
+  filter_cfg.ADCSinc2Osr = ADCSINC2OSR_1333;
+  filter_cfg.ADCSinc3Osr = ADCSINC3OSR_4;
+  filter_cfg.BpSinc3 = bFALSE;
+  filter_cfg.BpNotch = bTRUE;
+  filter_cfg.Sinc2NotchEnable = bTRUE;
+  AD5940_ADCFilterCfgS(&filter_cfg);
+
+  uint32_t wgCon = AD5940_ReadReg(REG_AFE_WGCON);
+  WGCfg_Type wg_cfg = {};
+  wg_cfg.WgType = WGTYPE_MMR;
+  wg_cfg.GainCalEn = bTRUE;
+  wg_cfg.OffsetCalEn = bTRUE;
+  wg_cfg.WgCode = 0x800;
+  AD5940_WGCfgS(&wg_cfg);
+
+  uint32_t fifoCon = AD5940_ReadReg(REG_AFE_FIFOCON);
+  FIFOCfg_Type fifo_cfg;
+  fifo_cfg.FIFOEn = bFALSE;
+  fifo_cfg.FIFOMode = FIFOMODE_FIFO;
+  fifo_cfg.FIFOSize = FIFOSIZE_4KB;
+  fifo_cfg.FIFOSrc = FIFOSRC_SINC2NOTCH;
+  fifo_cfg.FIFOThresh = MSINE_FIFO_CHUNK;
+  AD5940_FIFOCfg(&fifo_cfg);
+  uint32_t fifoOn = AD5940_ReadReg(REG_AFE_FIFOCON) | BITM_AFE_FIFOCON_DATAFIFOEN;
+
+  /* The legs sleep until a FIFO chunk is in or the sequence has ended (msineLeg) */
+  uint32_t intcSel0 = AD5940_INTCGetCfg(AFEINTC_0);
+  AD5940_INTCCfg(AFEINTC_0, AFEINTSRC_ALLINT, bFALSE);
+  AD5940_INTCCfg(AFEINTC_0, AFEINTSRC_DATAFIFOTHRESH | AFEINTSRC_ENDSEQ, bTRUE);
+
+  SEQCfg_Type seq_cfg;
+  seq_cfg.SeqMemSize = SEQMEMSIZE_2KB;
+  seq_cfg.SeqBreakEn = bFALSE;
+  seq_cfg.SeqIgnoreEn = bFALSE;
+  seq_cfg.SeqCntCRCClr = bTRUE;
+  seq_cfg.SeqEnable = bFALSE;
+  seq_cfg.SeqWrTimer = 0;
+  AD5940_SEQCfg(&seq_cfg);
+
+  AD5940_AFECtrlS(AFECTRL_HSTIAPWR|AFECTRL_INAMPPWR|AFECTRL_EXTBUFPWR|\
+                AFECTRL_WG|AFECTRL_DACREFPWR|AFECTRL_HSDACPWR|\
+                AFECTRL_SINC2NOTCH, bTRUE);
+  AD5940_AFECtrlS(AFECTRL_WG|AFECTRL_ADCPWR, bTRUE);
+  uint32_t afeCon = AD5940_ReadReg(REG_AFE_AFECON) & ~(BITM_AFE_AFECON_ADCCONVEN | BITM_AFE_AFECON_DFTEN);
+
+  /* Settling period, then the recorded one; every step is MSINE_SAMPLE_CLKS x step clocks long */
+  uint32_t n = 0, rcalStart = 0;
+  uint32_t codes[MSINE_STEPS];
+  for(uint32_t m = 0; m < MSINE_STEPS; m++) codes[m] = 0x800 + (int32_t)lroundf(wave[m] / wavePeak * amplitude);
+
+  _msineSeq[n++] = SEQ_WR(REG_AFE_AFECON, afeCon | BITM_AFE_AFECON_ADCCONVEN);
+  for(uint32_t m = 0; m < MSINE_STEPS; m++) {
+    bool rcalNext = m + 1 == MSINE_STEPS - MSINE_RCAL_STEPS;
+    _msineSeq[n++] = SEQ_WR(REG_AFE_HSDACDAT, codes[m]);
+    _msineSeq[n++] = SEQ_WAIT(stepClks - (rcalNext ? 2 : 1));
+    if(rcalNext) {
+      /* SEQ1 starts here: the same ADC write as SEQ0's first, which SEQ0 just repeats */
+      rcalStart = n;
+      _msineSeq[n++] = SEQ_WR(REG_AFE_AFECON, afeCon | BITM_AFE_AFECON_ADCCONVEN);
+    }
+  }
+  for(uint32_t m = 0; m < MSINE_STEPS; m++) {
+    _msineSeq[n++] = SEQ_WR(REG_AFE_HSDACDAT, codes[m]);
+    if(m == 0) {
+      _msineSeq[n++] = SEQ_WAIT(half - 1);
+      _msineSeq[n++] = SEQ_WR(REG_AFE_FIFOCON, fifoOn);
+      _msineSeq[n++] = SEQ_WAIT(stepClks - half - 1);
+    }
+    else _msineSeq[n++] = SEQ_WAIT(stepClks - 1 + (m == MSINE_STEPS - 1 ? half : 0));
+  }
+  _msineSeq[n++] = SEQ_WR(REG_AFE_AFECON, afeCon);
+  _msineSeq[n++] = SEQ_WR(REG_AFE_HSDACDAT, 0x800);
+
+  SEQInfo_Type seq_info;
+  seq_info.SeqId = SEQID_0;
+  seq_info.SeqRamAddr = 0;
+  seq_info.pSeqCmd = _msineSeq;
+  seq_info.SeqLen = n;
+  seq_info.WriteSRAM = bTRUE;
+  AD5940_SEQInfoCfg(&seq_info);
+  seq_info.SeqId = SEQID_1;
+  seq_info.SeqRamAddr = rcalStart;
+  seq_info.pSeqCmd = _msineSeq + rcalStart;
+  seq_info.SeqLen = n - rcalStart;
+  seq_info.WriteSRAM = bFALSE;
+  AD5940_SEQInfoCfg(&seq_info);
+  seq_cfg.SeqCntCRCClr = bFALSE;
+  seq_cfg.SeqEnable = bTRUE;
+  AD5940_SEQCfg(&seq_cfg);
+
+  double rcalRe[MSINE_STEPS / 2], rcalIm[MSINE_STEPS / 2];
+  double rzRe[MSINE_STEPS / 2], rzIm[MSINE_STEPS / 2];
+  float peakRcal = 0, peakRz = 0;
+  rangeStruct range = {};
+  SWMatrixCfg_Type sw_cfg;
+  bool ok, again;
+
+  do {
+    applyRange(rTIA, _extGain, _dacGain);
+
+    sw_cfg.Dswitch = SWD_RCAL0;
+    sw_cfg.Pswitch = SWP_RCAL0;
+    sw_cfg.Nswitch = SWN_RCAL1;
+    sw_cfg.Tswitch = SWT_RCAL1|SWT_TRTIA;
+    AD5940_SWMatrixCfgS(&sw_cfg);
+    ok = msineLeg(SEQID_1, MSINE_RCAL_STEPS, step, bins, tones, rcalRe, rcalIm, &peakRcal);
+
+    sw_cfg.Dswitch = SWD_CE0;
+    sw_cfg.Pswitch = SWP_RE0;
+    sw_cfg.Nswitch = SWN_SE0;
+    sw_cfg.Tswitch = SWT_TRTIA|SWT_SE0LOAD;
+    AD5940_SWMatrixCfgS(&sw_cfg);
+    ok = ok && msineLeg(SEQID_0, MSINE_STEPS, step, bins, tones, rzRe, rzIm, &peakRz);
+
+    /* Samples scale with RTIA, so the next RTIA is predicted as in autorangeStep */
+    float peak = fmaxf(peakRcal, peakRz);
+    range.rTIA = rTIA;
+    range.extGain = _extGain;
+    range.dacGain = _dacGain;
+    range.clipped = peak >= 1.0f;
+    range.headroom = peak;
+    range.status = !_autorange ? RANGE_FIXED :
+                   (peak > _rangeHigh ? RANGE_HIGH : (peakRz < _rangeLow ? RANGE_LOW : RANGE_OK));
+
+    again = false;
+    if(ok && (range.status == RANGE_HIGH || range.status == RANGE_LOW) && range.remeasures < AUTORANGE_MAX_STEPS) {
+      int best = HSTIARTIA_200;
+      for(int r = 0; r < (int)(sizeof(rangeRtiaOhms) / sizeof(rangeRtiaOhms[0])); r++)
+        if(peak * rangeRtiaOhms[r] / rangeRtiaOhms[rTIA & 7] <= _rangeHigh / 2) best = r;
+      if(best != rTIA) {
+        printf("Autorange multisine %.3f-%.3f Hz: peak %.3f of full scale, RTIA %d -> %d\n",
+               _plan[first + tones - 1].msFreq, _plan[first].msFreq, peak, rTIA, best);
+        rTIA = best;
+        range.remeasures++;
+        _msineStats.remeasures++;
+        again = true;
+      }
+    }
+  } while(again);
+
+  AD5940_AFECtrlS(AFECTRL_ADCCNV|AFECTRL_DFT|AFECTRL_WG|AFECTRL_ADCPWR, bFALSE);
+  AD5940_SEQCtrlS(bFALSE);
+  AD5940_WriteReg(REG_AFE_WGCON, wgCon);
+  AD5940_WriteReg(REG_AFE_FIFOCON, fifoCon);
+  AD5940_INTCCfg(AFEINTC_0, AFEINTSRC_ALLINT, bFALSE);
+  AD5940_INTCCfg(AFEINTC_0, intcSel0, bTRUE);
+  AD5940_INTCClrFlag(AFEINTSRC_ALLINT);
+  AD5940_ClrMCUIntFlag();
+  if(_autorange && first < ARRAY_SIZE) _rangeStart[first] = logRangePack(rTIA, _extGain, _dacGain);
+
+  if(!ok) {
+    _msineStats.failures++;
+    _currentFreq = _plan[first].freq;
+    applySweepPlan(first);
+    for(uint32_t k = 0; k < tones && _sweepCfg.SweepEn == bTRUE; k++) AD5940_DFTMeasure();
+    return;
+  }
+  _msineStats.acquisitions++;
+  _msineStats.points += tones;
+
+  settleStruct settle = {};
+  settle.settleMs = (float)MSINE_STEPS * stepClks / SYSCLCK * 1000;
+  settle.status = SETTLE_UNCHECKED;
+
+  for(uint32_t k = 0; k < tones; k++) {
+    impStruct eis;
+    float magRcal, phaseRcal, magRz, phaseRz;
+    int32_t dft[4];
+
+    /* Each tone starts at its own Schroeder phase: turn both legs back by the Rcal phase, as if the tone
+       started at zero like the DFT sweep's sine, so the phase difference the record decodes to stays within
+       +-180 deg. Then scaled like calCompensate: the largest value at full scale keeps the rounding out */
+    double rcalMag = hypot(rcalRe[k], rcalIm[k]);
+    double rotRe = rcalMag > 0 ? rcalRe[k] / rcalMag : 1, rotIm = rcalMag > 0 ? -rcalIm[k] / rcalMag : 0;
+    double zRe = rzRe[k] * rotRe - rzIm[k] * rotIm, zIm = rzRe[k] * rotIm + rzIm[k] * rotRe;
+    double peak = fmax(rcalMag, fmax(fabs(zRe), fabs(zIm)));
+    double scale = peak > 0 ? AUTORANGE_DFT_FS / peak : 0;
+    dft[0] = (int32_t)lround(rcalMag * scale);
+    dft[1] = 0;
+    dft[2] = (int32_t)lround(zRe * scale);
+    dft[3] = (int32_t)lround(-zIm * scale);
+
+    _currentFreq = _plan[_sweepCfg.SweepIndex].msFreq;
+    if(!dftUsable(dft)) {
+      printf("%d,%.4f,,,,,,,,failed\n", _sweepCfg.SweepIndex, _currentFreq);
+      storeFailedPoint();
+      logSweep(&_sweepCfg, &_currentFreq);
+      continue;
+    }
+    getMagPhase(dft[0], dft[1], &magRcal, &phaseRcal);
+    getMagPhase(dft[2], dft[3], &magRz, &phaseRz);
+    eis.magnitude = (magRcal / magRz) * _rcalVal;
+    eis.phaseRad = phaseRcal - phaseRz;
+    eis.real = eis.magnitude * cos(eis.phaseRad);
+    eis.imag = eis.magnitude * sin(eis.phaseRad) * -1;
+    eis.phaseDeg = eis.phaseRad * 180 / MATH_PI;
+    eis.freq = _currentFreq;
+
+    printf("%d,%.4f,%.3f,%.3f,%f,%.4f,%.4f,%.4f,%.1f,multisine\n", _sweepCfg.SweepIndex, _currentFreq, magRcal,
+           magRz, eis.magnitude, eis.real, eis.imag, eis.phaseRad, settle.settleMs);
+
+    uint32_t resultIdx;
+    if(resultSlot(&resultIdx)) {
+      storeRecord(resultIdx, dft, DFTREC_VALID | DFTREC_MSINE);
+      _settleArr[resultIdx] = settle;
+      _rangeArr[resultIdx] = range;
+      logResult(resultIdx);
+      fitResult(resultIdx);
+      streamResult(resultIdx);
+    }
+    _prevEis = eis;
+    logSweep(&_sweepCfg, &_currentFreq);
+  }
+}
+
+AD5940Err HELPStat::checkFreq(float freq) {
+  /* 
+    Adding a delay after recalibration to improve the switching noise.
+    Sudden switching introduces inaccuracies, but accurate data I feel like
+    is mostly dependent on the HSRTIA depending on the load impedance.
+  */
+
+  ADCFilterCfg_Type filter_cfg;
+  DFTCfg_Type dft_cfg;
+  HSDACCfg_Type hsdac_cfg;
+  ClksCalInfo_Type clks_cal;
+  FreqParams_Type freq_params;
+
+  float adcClck = 16e6;
+
+  /* Step 1: Check Frequency */
+  freq_params = AD5940_GetFreqParameters(freq);
+  
+       if(freq < 0.51)
+	{
+    /* Update HSDAC update rate */
+    hsdac_cfg.ExcitBufGain = EXCITBUFGAIN_0P25;
+    hsdac_cfg.HsDacGain = HSDACGAIN_0P2;
+     hsdac_cfg.HsDacUpdateRate = 0x1B;
+    AD5940_HSDacCfgS(&hsdac_cfg);
+    AD5940_HSRTIACfgS(HSTIARTIA_200);
+    // AD5940_HSRTIACfgS(HSTIARTIA_10K);
+    // AD5940_HSRTIACfgS(HSTIARTIA_20K);
+    // AD5940_HSRTIACfgS(HSTIARTIA_40K);
+    // AD5940_HSRTIACfgS(HSTIARTIA_80K);
     // AD5940_HSRTIACfgS(HSTIARTIA_160K);
 	__AD5940_SetDExRTIA(0, HSTIADERTIA_OPEN, HSTIADERLOAD_0R);
     
@@ -1507,17 +3092,27 @@ void HELPStat::printData(void) {
   printf("Printing entire array now...\n");
   for(uint32_t i = 0; i <= _numCycles; i++)
   {
-    printf("Cycle %d\n", i);
-    printf("Index, Freq, Mag, Real, Imag, Phase (rad)\n");
+    kkCycle kk = getKKResult(i);
+    if(kk.attempts) printf("Cycle %d (KK %s, %u attempts)\n", i, kk.kk.pass ? "pass" : "FAIL", kk.attempts);
+    else printf("Cycle %d\n", i);
+    printf("Index, Freq, Mag, Real, Imag, Phase (rad)%s%s\n", kk.attempts ? ", KK Real (%), KK Imag (%)" : "",
+           _autorange ? ", RTIA, Ext Gain, DAC Gain, Headroom (%)" : "");
     for(uint32_t j = 0; j < _sweepCfg.SweepPoints; j++)
     {
-      eis = eisArr[j + (i * _sweepCfg.SweepPoints)];
+      eis = getResult(j + (i * _sweepCfg.SweepPoints));
       printf("%d,", j);
       printf("%.2f,", eis.freq);
       printf("%f,", eis.magnitude);
       printf("%.4f,", eis.real);
       printf("%.4f,", eis.imag);
-      printf("%.4f\n", eis.phaseRad);
+      printf("%.4f", eis.phaseRad);
+      float kkRe, kkIm;
+      if(getKKResidual(j + (i * _sweepCfg.SweepPoints), &kkRe, &kkIm)) printf(",%.3f,%.3f", kkRe * 100, kkIm * 100);
+      if(_autorange) {
+        rangeStruct range = getRange(j + (i * _sweepCfg.SweepPoints));
+        printf(",%u,%u,%u,%.1f", range.rTIA, range.extGain, range.dacGain, range.headroom * 100);
+      }
+      printf("\n");
     }
   }
 }
@@ -1542,64 +3137,429 @@ void HELPStat::printData(void) {
   06/13/2024 - Two overloaded functions were made. One where the user manually inputs what estimates
   to use, and the other that uses private variables. These private variables are updated in the
   BLE_settings() function.
+
+  10/16/2026 - Both resistances now come from one joint fit (fit_Randles); calculate_Rct and
+  calculate_Rs are still in lma.h for comparison.
 */
 void HELPStat::calculateResistors() {
+  if(onlineFitReady()) {
+    // Warm start from the online fit, on the points it collected during the run
+    float rct = _provRct, rs = _provRs;
+    _fit = fit_Randles(rct, rs, _fitRe, _fitIm);
+    applyRandlesFit();
+    return;
+  }
+  calculateResistors(_rct_estimate, _rs_estimate);
+}
+void HELPStat::calculateResistors(float rct_estimate, float rs_estimate) {
+  uint32_t total = _sweepCfg.SweepPoints * (_numCycles + 1);
   std::vector<float> Z_real;
   std::vector<float> Z_imag;
+  Z_real.reserve(total);
+  Z_imag.reserve(total);
 
-  // Should append each real and imaginary data point
+  // Should append each real and imaginary data point (failed points have no impedance to fit)
   for(uint32_t i = 0; i < _sweepCfg.SweepPoints; i++) {
     for(uint32_t j = 0; j <= _numCycles; j++) {
       impStruct eis;
-      eis = eisArr[i + (j * _sweepCfg.SweepPoints)];
+      if(!resultValid(i + (j * _sweepCfg.SweepPoints))) continue;
+      eis = getResult(i + (j * _sweepCfg.SweepPoints));
       Z_real.push_back(eis.real);
       Z_imag.push_back(eis.imag);
     }
   }
 
-  _calculated_Rct = calculate_Rct(_rct_estimate, _rs_estimate, Z_real, Z_imag);
-  _calculated_Rs  = calculate_Rs(_rct_estimate, _rs_estimate, Z_real, Z_imag);
+  // One joint fit of Rs and Rct (see fit_Randles in lma.h)
+  _fit = fit_Randles(rct_estimate, rs_estimate, Z_real, Z_imag);
+  applyRandlesFit();
+}
+
+void HELPStat::applyRandlesFit(void) {
+  _calculated_Rct = _fit.rct;
+  _calculated_Rs  = _fit.rs;
 
   Serial.print("Calculated Rct: ");
   Serial.println(_calculated_Rct);
   Serial.print("Calculated Rs:  ");
   Serial.println(_calculated_Rs);
+  printf("Fit: %d iterations, rms error %.3f ohms, status %d%s\n", _fit.iterations, _fit.rmsError, _fit.status,
+         _fit.converged() ? "" : " (not converged)");
+}
+
+/*
+  10/16/2026 - Online fit. openFit starts a run (next to openStream), fitResult takes each point
+  as it is stored: one update of the running sums, a copy of (real, imag) into vectors reserved
+  for the whole run, and a new provisional Rct / Rs.
+*/
+void HELPStat::openFit(void) {
+  /* Per-cycle fit: the worker finished the last run in closeFit, so the store is ours to resize */
+  _cycleFitOpen = false;
+  __atomic_store_n(&_cycleReq, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&_cycleDone, 0, __ATOMIC_RELEASE);
+  _cycleFits.clear();
+  if(_cycleFitMode && _sweepCfg.SweepPoints > 0) {
+    uint32_t cycles = _numCycles + 1;
+    if(cycles > _resultCap / _sweepCfg.SweepPoints) cycles = _resultCap / _sweepCfg.SweepPoints;
+    cycleFit empty = {0, 0, 0, 0, 0, LM_NOT_STARTED, 0, false};
+    _cycleFits.assign(cycles, empty);
+    for(uint32_t c = 0; c < cycles; c++) _cycleFits[c].cycle = c;
+    _cycleRe.reserve(_sweepCfg.SweepPoints);
+    _cycleIm.reserve(_sweepCfg.SweepPoints);
+    startFitTask();
+    _cycleFitOpen = true;
+  }
+
+  /* KK check: a verdict per cycle of this run */
+  _kkAttempt = 0;
+  _kkRepeat = false;
+  _kkCycles.clear();
+  if(_kkTest && _sweepCfg.SweepPoints > 0) {
+    kkCycle untested = {{0, 0, 0, 0, 0, 1.0f, true}, 0};
+    uint32_t cycles = _numCycles + 1;
+    if(cycles > _resultCap / _sweepCfg.SweepPoints) cycles = _resultCap / _sweepCfg.SweepPoints;
+    _kkCycles.assign(cycles, untested);
+  }
 
-  return;
+  _fitOpen = false;
+  _fitCycleStart = 0;
+  _provValid = false;
+  _fitRe.clear();
+  _fitIm.clear();
+  if(!_onlineFit) return;
+  _fitTotal = _sweepCfg.SweepPoints * (_numCycles + 1);
+  if(_fitTotal > _resultCap) _fitTotal = _resultCap;
+  _fitRe.reserve(_fitTotal);
+  _fitIm.reserve(_fitTotal);
+  randles_online_reset(&_online);
+  _fitOpen = true;
 }
-void HELPStat::calculateResistors(float rct_estimate, float rs_estimate) {
-  std::vector<float> Z_real;
-  std::vector<float> Z_imag;
 
-  // Should append each real and imaginary data point
-  for(uint32_t i = 0; i < _sweepCfg.SweepPoints; i++) {
-    for(uint32_t j = 0; j <= _numCycles; j++) {
-      impStruct eis;
-      eis = eisArr[i + (j * _sweepCfg.SweepPoints)];
-      Z_real.push_back(eis.real);
-      Z_imag.push_back(eis.imag);
+void HELPStat::fitResult(uint32_t index) {
+  uint32_t points = _sweepCfg.SweepPoints;
+  if(points == 0) return;
+  if(index % points == 0) _fitCycleStart = _fitRe.size();
+
+  if(_fitOpen && _fitRe.size() < _fitTotal && resultValid(index)) {
+    impStruct eis = getResult(index);
+    _fitRe.push_back(eis.real);
+    _fitIm.push_back(eis.imag);
+    randles_online_add(&_online, eis.real, eis.imag);
+
+    float rct, rs;
+    if(randles_online_estimate(&_online, &rct, &rs)) {
+      _provRct = rct;
+      _provRs = rs;
+      _provValid = true;
     }
   }
 
-  _calculated_Rct = calculate_Rct(rct_estimate, rs_estimate, Z_real, Z_imag);
-  _calculated_Rs  = calculate_Rs(rct_estimate, rs_estimate, Z_real, Z_imag);
+  if(index % points == points - 1) {
+    uint32_t cycle = index / points;
+    if(!kkCheckCycle(cycle)) return; // Measured again; the fits never see this attempt
+    if(_cycleFitOpen) cycleFinished(cycle);
+  }
+}
+
+/* The online fit has every measured point of the run and an estimate to start from */
+bool HELPStat::onlineFitReady(void) {
+  if(!_fitOpen || !_provValid) return false;
+  uint32_t valid = 0;
+  for(uint32_t i = 0; i < _fitTotal; i++)
+    if(resultValid(i)) valid++;
+  return valid > 0 && _fitRe.size() == valid;
+}
+
+void HELPStat::setOnlineFit(bool enable) {
+  _onlineFit = enable;
+  if(!enable) _fitOpen = false;
+}
+
+/*
+  Provisional Rct / Rs from the points measured so far in this run. False until the points
+  describe an arc (three points or more, spread along the real axis).
+*/
+bool HELPStat::getProvisionalFit(float *pRct, float *pRs) {
+  if(!_provValid) return false;
+  *pRct = _provRct;
+  *pRs = _provRs;
+  return true;
+}
+
+/*
+  10/16/2026 - Per-cycle fit. fitResult calls cycleFinished when the last point of a cycle is
+  stored: the cycle is stamped and released to the worker task through _cycleReq, and the
+  measurement carries on with the next cycle. The worker (cycleFitService) fits every released
+  cycle in order from its own copy of the points, starting from the previous cycle's result, and
+  publishes each one by advancing _cycleDone. closeFit waits for the last cycle, like
+  flushSessionLog waits for the storage task.
+*/
+void HELPStat::cycleFinished(uint32_t cycle) {
+  if(cycle >= _cycleFits.size()) return;
+  uint32_t req = __atomic_load_n(&_cycleReq, __ATOMIC_ACQUIRE);
+  if(cycle < req) return;
+  unsigned long now = millis();
+  for(uint32_t c = req; c <= cycle; c++) _cycleFits[c].timeMs = now; // Includes cycles whose last point was lost
+  __atomic_store_n(&_cycleReq, cycle + 1, __ATOMIC_RELEASE);
+  if(_fitTask) xTaskNotifyGive(_fitTask);
+  else cycleFitService();
+}
+
+void HELPStat::closeFit(void) {
+  if(!_cycleFitOpen) return;
+  uint32_t req = __atomic_load_n(&_cycleReq, __ATOMIC_ACQUIRE);
+  if(_fitTask) {
+    xTaskNotifyGive(_fitTask);
+    waitWorker(&_cycleDone, req);
+  }
+  else cycleFitService();
+  _cycleFitOpen = false;
+
+  printf("Cycle, Time (ms), Rct (Ohms), Rs (Ohms), Iterations, Fit (us)\n");
+  for(uint32_t c = 0; c < req; c++) {
+    const cycleFit &cf = _cycleFits[c];
+    printf("%u,%lu,%.2f,%.2f,%d,%lu%s\n", cf.cycle, cf.timeMs, cf.rct, cf.rs, cf.iterations, cf.fitUs,
+           cf.converged() ? "" : " (not converged)");
+  }
+}
+
+/*
+  10/16/2026 - Hand-off back from the workers (storage, BLE sender, cycle fit). A task that needs
+  a worker to catch up (flushSessionLog, closeStream, closeFit) blocks on its task notification
+  until the worker's done counter reaches req; the worker notifies whoever is waiting each time
+  it advances the counter. Both sides are sequentially consistent, so either the waiter sees the
+  new count or the worker sees the waiter.
+*/
+void HELPStat::waitWorker(uint32_t *pDone, uint32_t req) {
+  __atomic_store_n(&_workerWaiter, xTaskGetCurrentTaskHandle(), __ATOMIC_SEQ_CST);
+  while(__atomic_load_n(pDone, __ATOMIC_SEQ_CST) != req) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  __atomic_store_n(&_workerWaiter, (TaskHandle_t)NULL, __ATOMIC_SEQ_CST);
+}
+
+void HELPStat::workerDone(uint32_t *pDone, uint32_t done) {
+  __atomic_store_n(pDone, done, __ATOMIC_SEQ_CST);
+  TaskHandle_t waiter = __atomic_load_n(&_workerWaiter, __ATOMIC_SEQ_CST);
+  if(waiter) xTaskNotifyGive(waiter);
+}
+
+/* Worker side: fits one cycle's points on their own */
+void HELPStat::fitCycle(uint32_t cycle) {
+  uint32_t points = _sweepCfg.SweepPoints;
+  randlesOnline online;
+  randles_online_reset(&online);
+  _cycleRe.clear();
+  _cycleIm.clear();
+  for(uint32_t k = 0; k < points; k++) {
+    if(!resultValid(cycle * points + k)) continue;
+    impStruct eis = getResult(cycle * points + k);
+    _cycleRe.push_back(eis.real);
+    _cycleIm.push_back(eis.imag);
+    randles_online_add(&online, eis.real, eis.imag);
+  }
+
+  /* Drift between cycles is small, so the previous cycle is the best place to start */
+  float rct = _rct_estimate, rs = _rs_estimate;
+  if(cycle > 0 && _cycleFits[cycle - 1].converged()) {
+    rct = _cycleFits[cycle - 1].rct;
+    rs = _cycleFits[cycle - 1].rs;
+  }
+  else randles_online_estimate(&online, &rct, &rs);
+
+  cycleFit &cf = _cycleFits[cycle];
+  unsigned long timeStart = micros();
+  randlesFit fit = fit_Randles(rct, rs, _cycleRe, _cycleIm);
+  cf.fitUs = micros() - timeStart;
+  cf.rct = fit.rct;
+  cf.rs = fit.rs;
+  cf.iterations = fit.iterations;
+  cf.status = fit.status;
+  cf.background = _fitTask != NULL;
+}
+
+void HELPStat::cycleFitService(void) {
+  uint32_t req = __atomic_load_n(&_cycleReq, __ATOMIC_ACQUIRE);
+  while(_cycleDone != req) {
+    fitCycle(_cycleDone);
+    workerDone(&_cycleDone, _cycleDone + 1);
+  }
+}
+
+void HELPStat::fitTask(void *pArg) {
+  HELPStat *pStat = (HELPStat *)pArg;
+  for(;;) {
+    /* Woken by cycleFinished / closeFit */
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    pStat->cycleFitService();
+  }
+}
+
+/* Pins the fit worker to the core the sketch is not running on. Falls back to fitting inline */
+bool HELPStat::startFitTask(void) {
+  if(_fitTask || _fitInline) return _fitTask != NULL;
+  if(xTaskCreatePinnedToCore(fitTask, "helpstat_fit", FIT_TASK_STACK, this, FIT_TASK_PRIO,
+                             &_fitTask, FIT_TASK_CORE) != pdPASS)
+  {
+    _fitTask = NULL;
+    _fitInline = true;
+    Serial.println("Fit task not started, cycles are fitted inline.");
+    return false;
+  }
+  return true;
+}
+
+/* Fit each cycle of the next runs on its own (in addition to the pooled calculateResistors fit) */
+void HELPStat::setCycleFit(bool enable) {
+  _cycleFitMode = enable;
+}
+
+/* Cycles of the last run fitted so far; each one is final once counted */
+uint32_t HELPStat::getCycleFitCount(void) {
+  return __atomic_load_n(&_cycleDone, __ATOMIC_ACQUIRE);
+}
+
+cycleFit HELPStat::getCycleFit(uint32_t cycle) {
+  cycleFit none = {cycle, 0, 0, 0, 0, LM_NOT_STARTED, 0, false};
+  if(cycle >= getCycleFitCount()) return none;
+  return _cycleFits[cycle];
+}
+
+/*
+  10/16/2026 - Kramers-Kronig check, called by fitResult when the last point of a cycle is
+  stored. Runs kk_test on the cycle, keeps the residuals next to the results and the verdict in
+  _kkCycles. Returns false when the cycle failed and is to be measured again: its points are
+  dropped from the online fit and repeatCycle() tells the run loop to go round once more. After
+  _kkMaxRepeats repeats the last attempt is kept, marked as failed.
+*/
+bool HELPStat::kkCheckCycle(uint32_t cycle) {
+  if(!_kkTest || cycle >= _kkCycles.size()) return true;
+
+  uint32_t points = _sweepCfg.SweepPoints;
+  uint32_t first = cycle * points;
+  std::vector<float> freq(points), re(points), im(points), resRe(points), resIm(points);
+  for(uint32_t k = 0; k < points; k++) {
+    impStruct eis = getResult(first + k);
+    freq[k] = eis.freq;
+    re[k] = eis.real;
+    im[k] = eis.imag;
+  }
+  kkResult kk = kk_test(freq.data(), re.data(), im.data(), points, _kkMaxResidual, resRe.data(), resIm.data());
+  for(uint32_t k = 0; k < points; k++) {
+    _kkArr[first + k].re = resRe[k];
+    _kkArr[first + k].im = resIm[k];
+  }
+  _kkCycles[cycle].kk = kk;
+  _kkCycles[cycle].attempts = _kkAttempt + 1;
+  printf("KK test, cycle %u attempt %u: max residual %.2f %% at %.2f Hz, rms %.2f %%, mu %.2f, %s\n", cycle,
+         _kkAttempt + 1, kk.maxResidual * 100, freq[kk.worstPoint], kk.rmsResidual * 100, kk.mu,
+         kk.pass ? "pass" : "FAIL");
+
+  if(kk.pass || _kkAttempt >= _kkMaxRepeats) return true;
+  _kkRepeat = true; // endCycle counts the attempt, so every hook of this point still sees the old one
+
+  /* Take the attempt back out of the online fit */
+  if(_fitOpen && _fitRe.size() > _fitCycleStart) {
+    _fitRe.resize(_fitCycleStart);
+    _fitIm.resize(_fitCycleStart);
+    randles_online_reset(&_online);
+    for(size_t k = 0; k < _fitRe.size(); k++) randles_online_add(&_online, _fitRe[k], _fitIm[k]);
+    float rct, rs;
+    _provValid = randles_online_estimate(&_online, &rct, &rs);
+    if(_provValid) {
+      _provRct = rct;
+      _provRs = rs;
+    }
+  }
+  return false;
+}
+
+/* True once after a cycle failed the KK test: the run loop measures that cycle again */
+bool HELPStat::repeatCycle(void) {
+  bool repeat = _kkRepeat;
+  _kkRepeat = false;
+  return repeat;
+}
+
+/*
+  Checks every cycle of the next runs with a linear Kramers-Kronig test (kk.h). A cycle passes
+  when no point's real or imaginary residual exceeds maxResidual (a fraction of |Z|); one that
+  fails is measured again up to maxRepeats times.
+*/
+void HELPStat::setKKTest(bool enable, float maxResidual, uint8_t maxRepeats) {
+  _kkTest = enable;
+  _kkMaxResidual = maxResidual;
+  _kkMaxRepeats = maxRepeats;
+}
+
+/* Verdict for one cycle of the last run (attempts is 0 if it was not tested) */
+kkCycle HELPStat::getKKResult(uint32_t cycle) {
+  kkCycle untested = {{0, 0, 0, 0, 0, 1.0f, true}, 0};
+  if(cycle >= _kkCycles.size()) return untested;
+  return _kkCycles[cycle];
+}
+
+/* KK residuals of one stored point, as fractions of |Z|. False if its cycle was not tested */
+bool HELPStat::getKKResidual(uint32_t index, float *pRe, float *pIm) {
+  if(_sweepCfg.SweepPoints == 0 || index >= _resultCap) return false;
+  if(getKKResult(index / _sweepCfg.SweepPoints).attempts == 0) return false;
+  *pRe = _kkArr[index].re;
+  *pIm = _kkArr[index].im;
+  return true;
+}
+
+/*
+  Iterations, final cost and status of the last calculateResistors fit.
+*/
+randlesFit HELPStat::getRandlesFit(void) {
+  return _fit;
+}
+
+/*
+  Fits an equivalent circuit to the complex impedance of every stored point (all cycles), with
+  frequency, so Cdl or a CPE and a Warburg tail come out alongside Rs and Rct. model is a set of
+  CNLS_MODEL_* flags (cnls.h). The fit starts from the data (cnls_estimate) and also updates
+  _calculated_Rct / _calculated_Rs, which BLE_transmitResults sends.
+*/
+cnlsFit HELPStat::fitCircuit(uint8_t model) {
+  uint32_t total = _sweepCfg.SweepPoints * (_numCycles + 1);
+  if(total > CNLS_MAX_POINTS) {
+    printf("fitCircuit: %u points, at most %d fit at once\n", total, CNLS_MAX_POINTS);
+    total = 0;
+  }
+  std::vector<float> freq, Z_real, Z_imag;
+  freq.reserve(total);
+  Z_real.reserve(total);
+  Z_imag.reserve(total);
+  for(uint32_t i = 0; i < total; i++) {
+    if(!resultValid(i)) continue; // fit_CNLS takes no point without a frequency
+    impStruct eis = getResult(i);
+    freq.push_back(eis.freq);
+    Z_real.push_back(eis.real);
+    Z_imag.push_back(eis.imag);
+  }
+
+  _circuitFit = fit_CNLS(freq.data(), Z_real.data(), Z_imag.data(), (int)freq.size(), model, NULL, NULL, &_cnlsWork);
+  if(_circuitFit.converged()) {
+    _calculated_Rct = _circuitFit.p.rct;
+    _calculated_Rs  = _circuitFit.p.rs;
+  }
 
-  Serial.print("Calculated Rct: ");
-  Serial.println(_calculated_Rct);
-  Serial.print("Calculated Rs:  ");
-  Serial.println(_calculated_Rs);
+  printf("Circuit fit: Rs %.3f, Rct %.3f, %s %.4g", _circuitFit.p.rs, _circuitFit.p.rct,
+         (model & CNLS_MODEL_CPE) ? "Q" : "Cdl", _circuitFit.p.q);
+  if(model & CNLS_MODEL_CPE) printf(", n %.4f", _circuitFit.p.n);
+  if(model & CNLS_MODEL_WARBURG) printf(", sigma %.3f", _circuitFit.p.sigma);
+  printf("\n  %d iterations, %lu us, rms error %.3f %%, status %d%s\n", _circuitFit.iterations,
+         (unsigned long)_circuitFit.timeUs, _circuitFit.rmsRel * 100, _circuitFit.status,
+         _circuitFit.converged() ? "" : " (not converged)");
+  return _circuitFit;
+}
 
-  return;
+cnlsFit HELPStat::getCircuitFit(void) {
+  return _circuitFit;
 }
 
 void HELPStat::saveDataEIS() {
   String directory = "/" + _folderName;
   
-  if(!SD.begin(CS_SD))
-  {
-    Serial.println("Card mount failed.");
-    return;
-  }
+  if(!mountSD()) return;
 
   if(!SD.exists(directory))
   {
@@ -1633,7 +3593,7 @@ void HELPStat::saveDataEIS() {
       for(uint32_t j = 0; j <= _numCycles; j++)
       {
         impStruct eis;
-        eis = eisArr[i + (j * _sweepCfg.SweepPoints)];
+        eis = getResult(i + (j * _sweepCfg.SweepPoints));
         dataFile.print(eis.freq);
         dataFile.print(",");
         dataFile.print(eis.magnitude);
@@ -1658,11 +3618,7 @@ void HELPStat::saveDataEIS() {
 void HELPStat::saveDataEIS(String dirName, String fileName) {
   String directory = "/" + dirName;
   
-  if(!SD.begin(CS_SD))
-  {
-    Serial.println("Card mount failed.");
-    return;
-  }
+  if(!mountSD()) return;
 
   if(!SD.exists(directory))
   {
@@ -1696,7 +3652,7 @@ void HELPStat::saveDataEIS(String dirName, String fileName) {
       for(uint32_t j = 0; j <= _numCycles; j++)
       {
         impStruct eis;
-        eis = eisArr[i + (j * _sweepCfg.SweepPoints)];
+        eis = getResult(i + (j * _sweepCfg.SweepPoints));
         dataFile.print(eis.freq);
         dataFile.print(",");
         dataFile.print(eis.magnitude);
@@ -1718,7 +3674,275 @@ void HELPStat::saveDataEIS(String dirName, String fileName) {
   }
 }
 
-void HELPStat::AD5940_BiasCfg(float startFreq, float endFreq, uint32_t numPoints, float biasVolt, float zeroVolt, int delaySecs) {
+/* 10/16/2026 - Mounts the card once. Also hands SCK / MOSI back to the SD card's SPI host */
+bool HELPStat::mountSD(void) {
+  AD5940_SPIRelease();
+  if(_sdMounted) return true;
+  if(!SD.begin(CS_SD))
+  {
+    Serial.println("Card mount failed.");
+    return false;
+  }
+  _sdMounted = true;
+  return true;
+}
+
+void HELPStat::setSessionLog(bool enable) {
+  _sessionLog = enable;
+}
+
+/*
+  10/16/2026 - Starts a binary session log (dirName/fileName.hsl, format in sessionlog.h).
+  The header block records the sweep configuration and gain table so the log can be
+  decoded without the firmware. Called by runSweep / runSweepSeq when setSessionLog(true).
+  Points are handed to the storage task (startStorageTask) through _logQueue from here on.
+*/
+bool HELPStat::openSessionLog(String dirName, String fileName) {
+  String directory = "/" + dirName;
+
+  closeSessionLog();
+  if(!mountSD()) return false;
+  if(!SD.exists(directory) && !SD.mkdir(directory))
+  {
+    Serial.println("Couldn't make a directory for the session log.");
+    return false;
+  }
+
+  String filePath = directory + "/" + fileName + ".hsl";
+  _logFile = SD.open(filePath, FILE_WRITE);
+  if(!_logFile)
+  {
+    Serial.println("Couldn't open the session log.");
+    return false;
+  }
+
+  logSessionHdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.version = LOG_FORMAT_VERSION;
+  strncpy(hdr.firmware, HELPSTAT_FW_VERSION, sizeof(hdr.firmware) - 1);
+  hdr.startMs = millis();
+  hdr.startFreq = _startFreq;
+  hdr.endFreq = _endFreq;
+  hdr.numPoints = _numPoints;
+  hdr.sweepPoints = _sweepCfg.SweepPoints;
+  hdr.numCycles = _numCycles;
+  hdr.delaySecs = _delaySecs;
+  hdr.rcalVal = _rcalVal;
+  hdr.biasVolt = _biasVolt;
+  hdr.zeroVolt = _zeroVolt;
+  hdr.extGain = _extGain;
+  hdr.dacGain = _dacGain;
+  hdr.gainArrSize = _gainArrSize < LOG_MAX_GAINS ? _gainArrSize : LOG_MAX_GAINS;
+  for(uint32_t i = 0; i < hdr.gainArrSize; i++) {
+    hdr.gains[i].freq = _gainArr[i].freq;
+    hdr.gains[i].rTIA = _gainArr[i].rTIA;
+  }
+
+  _logCount = 0;
+  _logSeq = 0;
+  _logPoints = 0;
+  memset(&_storageStats, 0, sizeof(_storageStats));
+  pointQueueInit(&_logQueue, _logQueueMem, LOG_QUEUE_DEPTH);
+  if(!writeLogBlock(LOG_BLOCK_SESSION, 1, &hdr, sizeof(hdr))) return false;
+  flushCard();
+
+  startStorageTask();
+  __atomic_store_n(&_logActive, true, __ATOMIC_RELEASE);
+  printf("Session log: %s (%s)\n", filePath.c_str(), _storageTask ? "storage task" : "inline");
+  return true;
+}
+
+/* Header + payload + CRC-32 of both, with the SPI bus taken from the AD5940. Closes the log if the card stops taking data */
+bool HELPStat::writeLogBlock(uint16_t type, uint16_t count, const void *pPayload, uint32_t length) {
+  logBlockHdr blk;
+  uint32_t crc;
+
+  if(!_logFile) return false;
+  blk.magic = LOG_MAGIC;
+  blk.type = type;
+  blk.count = count;
+  blk.seq = _logSeq++;
+  blk.length = length;
+  crc = logCrc32(0, &blk, sizeof(blk));
+  crc = logCrc32(crc, pPayload, length);
+
+  unsigned long timeStart = micros();
+  AD5940_BusLock();
+  unsigned long timeLocked = micros();
+  size_t written = _logFile.write((const uint8_t *)&blk, sizeof(blk));
+  written += _logFile.write((const uint8_t *)pPayload, length);
+  written += _logFile.write((const uint8_t *)&crc, sizeof(crc));
+  bool ok = written == sizeof(blk) + length + sizeof(crc);
+  if(!ok) _logFile.close();
+  AD5940_BusUnlock();
+  storageTime(timeStart, timeLocked);
+
+  if(!ok)
+  {
+    Serial.println("Session log write failed, logging stopped.");
+    __atomic_store_n(&_logActive, false, __ATOMIC_RELEASE);
+    return false;
+  }
+  _storageStats.blocks++;
+  _logDirty = true;
+  return true;
+}
+
+/* Pushes the card's buffers out (FAT / cluster updates happen here, the slow part) */
+void HELPStat::flushCard(void) {
+  unsigned long timeStart = micros();
+  AD5940_BusLock();
+  unsigned long timeLocked = micros();
+  if(_logFile) _logFile.flush();
+  AD5940_BusUnlock();
+  storageTime(timeStart, timeLocked);
+  _logFlushTime = millis();
+  _logDirty = false;
+}
+
+/* Bus wait and worst-case latency of one SD access, from before AD5940_BusLock to now */
+void HELPStat::storageTime(unsigned long timeStart, unsigned long timeLocked) {
+  unsigned long elapsed = micros() - timeStart;
+  _storageStats.busWaitUs += timeLocked - timeStart;
+  if(elapsed > _storageStats.maxWriteUs) _storageStats.maxWriteUs = elapsed;
+}
+
+/*
+  10/16/2026 - Consumer side of _logQueue: packs queued points into blocks of
+  LOG_POINTS_PER_BLOCK, writes full blocks, and flushes the card every LOG_FLUSH_MS or
+  when flushSessionLog asks. Runs in the storage task, or inline on the measurement
+  thread if the task could not be started.
+*/
+void HELPStat::storageService(void) {
+  logPoint point;
+  /* Read before draining: everything pushed before the request is written by this pass */
+  uint32_t flushReq = __atomic_load_n(&_logFlushReq, __ATOMIC_ACQUIRE);
+
+  if(__atomic_load_n(&_logActive, __ATOMIC_ACQUIRE)) {
+    while(pointQueuePop(&_logQueue, &point)) {
+      _logBuf[_logCount++] = point;
+      if(_logCount == LOG_POINTS_PER_BLOCK) {
+        writeLogBlock(LOG_BLOCK_POINTS, _logCount, _logBuf, _logCount * sizeof(logPoint));
+        _logPoints += _logCount;
+        _logCount = 0;
+      }
+    }
+    if(flushReq != _logFlushDone && _logCount) {
+      writeLogBlock(LOG_BLOCK_POINTS, _logCount, _logBuf, _logCount * sizeof(logPoint));
+      _logPoints += _logCount;
+      _logCount = 0;
+    }
+    if(flushReq != _logFlushDone || (_logDirty && millis() - _logFlushTime >= LOG_FLUSH_MS)) flushCard();
+  }
+  workerDone(&_logFlushDone, flushReq);
+}
+
+void HELPStat::storageTask(void *pArg) {
+  HELPStat *pStat = (HELPStat *)pArg;
+  for(;;) {
+    /* Woken when a block is queued or a flush is requested, at least every LOG_FLUSH_MS */
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_FLUSH_MS));
+    pStat->storageService();
+  }
+}
+
+/* Pins the storage task to the core the sketch is not running on. Falls back to inline writes */
+bool HELPStat::startStorageTask(void) {
+  if(_storageTask || _storageInline) return _storageTask != NULL;
+  if(xTaskCreatePinnedToCore(storageTask, "helpstat_sd", LOG_TASK_STACK, this, LOG_TASK_PRIO,
+                             &_storageTask, LOG_TASK_CORE) != pdPASS)
+  {
+    _storageTask = NULL;
+    _storageInline = true;
+    Serial.println("Storage task not started, session log is written inline.");
+    return false;
+  }
+  return true;
+}
+
+/*
+  10/16/2026 - Producer side: queues one finished point for the storage task. The
+  measurement thread only blocks (a producer stall) if the whole queue is full.
+*/
+void HELPStat::logResult(uint32_t index) {
+  if(!__atomic_load_n(&_logActive, __ATOMIC_ACQUIRE)) return;
+  if(!(eisArr[index].flags & DFTREC_VALID)) return; // Failed point: nothing to log
+
+  logPoint point = {};
+  point.timeMs = millis();
+  point.freq = sweepFreq(eisArr[index].freqIdx, eisArr[index].flags);
+  point.cycle = index / _sweepCfg.SweepPoints;
+  point.settleStatus = _settleArr[index].status;
+  point.range = 0;
+  if(_rangeArr[index].status != RANGE_NONE)
+    point.range = logRangePack(_rangeArr[index].rTIA, _rangeArr[index].extGain, _rangeArr[index].dacGain);
+  point.settleMs = _settleArr[index].settleMs;
+  point.rec = eisArr[index];
+  point.attempt = _kkAttempt;
+
+  _storageStats.queued++;
+  if(!pointQueuePush(&_logQueue, &point)) {
+    unsigned long timeStart = micros();
+    _storageStats.stalls++;
+    do {
+      if(_storageTask) {
+        xTaskNotifyGive(_storageTask);
+        vTaskDelay(1);
+      }
+      else storageService();
+    } while(!pointQueuePush(&_logQueue, &point));
+    _storageStats.stallUs += micros() - timeStart;
+  }
+
+  if(pointQueueDepth(&_logQueue) >= LOG_POINTS_PER_BLOCK) {
+    if(_storageTask) xTaskNotifyGive(_storageTask);
+    else storageService();
+  }
+}
+
+/* Writes the partial block and flushes the card, waiting for the storage task. Called at the end of every cycle */
+void HELPStat::flushSessionLog(void) {
+  if(!__atomic_load_n(&_logActive, __ATOMIC_ACQUIRE)) return;
+
+  uint32_t req = _logFlushReq + 1;
+  __atomic_store_n(&_logFlushReq, req, __ATOMIC_RELEASE);
+  if(_storageTask) {
+    xTaskNotifyGive(_storageTask);
+    waitWorker(&_logFlushDone, req);
+  }
+  else storageService();
+}
+
+void HELPStat::closeSessionLog(void) {
+  if(!__atomic_load_n(&_logActive, __ATOMIC_ACQUIRE)) {
+    if(_logFile) _logFile.close(); // Stopped after a failed write
+    return;
+  }
+  flushSessionLog();
+  __atomic_store_n(&_logActive, false, __ATOMIC_RELEASE);
+
+  logEnd end;
+  end.points = _logPoints;
+  end.endMs = millis();
+  if(writeLogBlock(LOG_BLOCK_END, 1, &end, sizeof(end))) {
+    AD5940_BusLock();
+    _logFile.close();
+    AD5940_BusUnlock();
+    storageStats st = getStorageStats();
+    printf("Session log closed: %u points in %u blocks\n", _logPoints, st.blocks);
+    printf("Storage: queue max %u / %u, %u producer stalls (%lu us), worst SD access %lu us, %lu us waiting for the bus\n",
+           st.maxDepth, LOG_QUEUE_DEPTH - 1, st.stalls, st.stallUs, st.maxWriteUs, st.busWaitUs);
+  }
+}
+
+storageStats HELPStat::getStorageStats(void) {
+  storageStats st = _storageStats;
+  st.maxDepth = _logQueue.maxDepth;
+  st.background = _storageTask != NULL;
+  return st;
+}
+
+void HELPStat::AD5940_BiasCfg(float startFreq, float endFreq, uint32_t numPoints, float biasVolt, float zeroVolt, int /* delaySecs */) {
 
   // SETUP Cfgs
   CLKCfg_Type clk_cfg;
@@ -1867,6 +4091,8 @@ void HELPStat::AD5940_BiasCfg(float startFreq, float endFreq, uint32_t numPoints
   if(startFreq > endFreq) _sweepCfg.SweepPoints = (uint32_t)(1.5 + (log10(startFreq) - log10(endFreq)) * (numPoints)) - 1;
   else _sweepCfg.SweepPoints = (uint32_t)(1.5 + (log10(endFreq) - log10(startFreq)) * (numPoints)) - 1;
   printf("Number of points: %d\n", _sweepCfg.SweepPoints);
+  compileSweepPlan();
+  reserveResults(_sweepCfg.SweepPoints, _numCycles);
   Serial.println("Sweep configured successfully.");
 
   /* Configuring LPDAC if necessary */
@@ -2006,7 +4232,6 @@ void HELPStat::AD5940_BiasCfg(float startFreq, float endFreq, uint32_t numPoints
 void HELPStat::AD5940_DFTMeasureEIS(void) {
 
   SWMatrixCfg_Type sw_cfg;
-  LPAmpCfg_Type LpAmpCfg;
   impStruct eis;
 
   /* Real / Imaginary components */
@@ -2161,8 +4386,22 @@ void HELPStat::AD5940_DFTMeasureEIS(void) {
   // printf("rLoad phase: %.3f,", AD5940_ComplexPhase(&rLoad));
   // printf("rzRload: %.3f\n", AD5940_ComplexPhase(&rzRload));
 
-  /* Saving to an array */
-  eisArr[_sweepCfg.SweepIndex + (_currentCycle * _sweepCfg.SweepPoints)] = eis; 
+  /* Saving to an array. Only the ratio is known here, so store a DFT pair that reproduces it:
+     the larger of the two at full scale. */
+  uint32_t resultIdx;
+  if(resultSlot(&resultIdx)) {
+    float ratio = AD5940_ComplexMag(&res);
+    float scale = 131071.0f / (ratio > 1.0f ? ratio : 1.0f);
+    int32_t dft[4];
+    dft[0] = (int32_t)lroundf(scale * ratio * cos(eis.phaseRad));
+    dft[1] = (int32_t)lroundf(-scale * ratio * sin(eis.phaseRad));
+    dft[2] = (int32_t)lroundf(scale);
+    dft[3] = 0;
+    storeRecord(resultIdx, dft, DFTREC_VALID | DFTREC_SYNTH);
+    logResult(resultIdx);
+    fitResult(resultIdx);
+    streamResult(resultIdx);
+  }
 
   /* Updating Frequency */
   logSweep(&_sweepCfg, &_currentFreq);
@@ -2175,7 +4414,7 @@ void HELPStat::configureDFT(float freq) {
   ClksCalInfo_Type clks_cal;
   ADCFilterCfg_Type filter_cfg;
   DFTCfg_Type dft_cfg;
-  float adcClck; 
+  float adcClck = 16e6; 
 
   /* Getting optimal freq parameters */
   freq_params = AD5940_GetFreqParameters(freq);
@@ -2232,7 +4471,7 @@ AD5940Err HELPStat::setHSTIA(float freq) {
   ClksCalInfo_Type clks_cal;
   ADCFilterCfg_Type filter_cfg;
   DFTCfg_Type dft_cfg;
-  float adcClck; 
+  float adcClck = 16e6; 
 
   AD5940Err exitStatus = AD5940ERR_ERROR;
 
@@ -2263,6 +4502,7 @@ AD5940Err HELPStat::setHSTIA(float freq) {
         AD5940_HSDacCfgS(&hsdac_cfg);
         AD5940_HSRTIACfgS(_gainArr[i].rTIA);
       __AD5940_SetDExRTIA(0, HSTIADERTIA_OPEN, HSTIADERLOAD_0R);
+        _currentRtia = _gainArr[i].rTIA;
         
         // AD5940_HPModeEn(bTRUE);
         // printf("Setting HSTIA to: %d for %.2f Hz\n", _gainArr[i].rTIA, freq);
@@ -2281,6 +4521,7 @@ AD5940Err HELPStat::setHSTIA(float freq) {
         AD5940_HSDacCfgS(&hsdac_cfg);
         AD5940_HSRTIACfgS(_gainArr[i].rTIA);
       __AD5940_SetDExRTIA(0, HSTIADERTIA_OPEN, HSTIADERLOAD_0R);
+        _currentRtia = _gainArr[i].rTIA;
 
         // AD5940_HPModeEn(bFALSE);
         // printf("Setting HSTIA to: %d for %.2f Hz\n", _gainArr[i].rTIA, freq);
@@ -2329,6 +4570,12 @@ AD5940Err HELPStat::setHSTIA(float freq) {
 }
 
 void HELPStat::configureFrequency(float freq) {
+  /* Use the compiled entry when freq is the current sweep point */
+  if(sweepPlanValid() && _plan[_sweepCfg.SweepIndex].freq == freq) {
+    applySweepPlan(_sweepCfg.SweepIndex);
+    return;
+  }
+
   AD5940Err check = setHSTIA(freq);
   // configureDFT(freq);
 
@@ -2336,15 +4583,236 @@ void HELPStat::configureFrequency(float freq) {
   // else Serial.println("Configured successfully.");
 }
 
+/*
+  10/16/2026 - Compiles the sweep in _sweepCfg into _plan. Works out everything
+  logSweep + setHSTIA used to recompute at each point: the log-spaced frequency, the
+  WG frequency word, the RTIA from _gainArr, HP mode, the SINC3/SINC2/DFT settings
+  from AD5940_GetFreqParameters and the wait clocks from AD5940_ClksCalculate.
+  Called at the end of sweep setup in AD5940_TDD / AD5940_BiasCfg, after _gainArr is set.
+*/
+void HELPStat::compileSweepPlan(void) {
+  FreqParams_Type freq_params;
+  ClksCalInfo_Type clks_cal;
+  uint32_t numPoints = _sweepCfg.SweepPoints;
+
+  _planSize = 0;
+  if(numPoints > ARRAY_SIZE) {
+    printf("Sweep plan: %d points does not fit in %d, planning disabled\n", numPoints, ARRAY_SIZE);
+    return;
+  }
+
+  for(uint32_t i = 0; i < numPoints; i++) {
+    planStruct *pPlan = &_plan[i];
+    float freq = (i == 0) ? _sweepCfg.SweepStart : 
+      _sweepCfg.SweepStart * pow(10, (i * log10(_sweepCfg.SweepStop/_sweepCfg.SweepStart)/(numPoints-1)));
+
+    pPlan->freq = freq;
+    pPlan->wgFcw = AD5940_WGFreqWordCal(freq, SYSCLCK);
+    pPlan->hpMode = freq >= 80000;
+
+    /* Same rule as setHSTIA: first gain table entry whose cutoff is >= freq */
+    pPlan->rTIA = -1;
+    for(uint32_t j = 0; j < _gainArrSize; j++) {
+      if(freq <= _gainArr[j].freq) {
+        pPlan->rTIA = _gainArr[j].rTIA;
+        break;
+      }
+    }
+
+    freq_params = AD5940_GetFreqParameters(freq);
+    pPlan->sinc3Osr = freq_params.ADCSinc3Osr;
+    pPlan->sinc2Osr = freq_params.ADCSinc2Osr;
+    pPlan->dftNum = freq_params.DftNum;
+    pPlan->dftSrc = freq_params.DftSrc;
+
+    clks_cal.DataType = DATATYPE_DFT;
+    clks_cal.DftSrc = freq_params.DftSrc;
+    clks_cal.DataCount = 1L<<(freq_params.DftNum+2); /* 2^(DFTNUMBER+2) */
+    clks_cal.ADCSinc2Osr = freq_params.ADCSinc2Osr;
+    clks_cal.ADCSinc3Osr = freq_params.ADCSinc3Osr;
+    clks_cal.ADCAvgNum = 0;
+    clks_cal.RatioSys2AdcClk = SYSCLCK/(pPlan->hpMode ? 32e6 : 16e6);
+    AD5940_ClksCalculate(&clks_cal, &pPlan->waitClcks);
+  }
+
+  _planSize = numPoints;
+  _planStop = _sweepCfg.SweepStop;
+  memset(_rangeStart, 0, sizeof(_rangeStart));  // Autorange settings were for the old points
+  planMultisine();
+}
+
+/*
+  10/16/2026 - Groups the points at or below _msineMaxFreq for AD5940_MultisineMeasure, lowest
+  frequency first. A group's lowest point sets its period, N = MSINE_STEPS x step SINC2 samples with
+  the point at bin MSINE_CYCLES (more when the points are too close for that to separate them); the
+  next points take the nearest free bin up to MSINE_STEPS / 2, where a new group starts. msFreq is
+  the bin's frequency, within a few percent of the planned one. A point too high for a group of its
+  own stays a DFT point, as does everything above it.
+*/
+void HELPStat::planMultisine(void) {
+  const float fs = SYSCLCK / MSINE_SAMPLE_CLKS;
+  const uint32_t maxStep = 0x3FFFFFFF / MSINE_SAMPLE_CLKS;  // Longest step one SEQ_WAIT holds
+
+  for(uint32_t i = 0; i < _planSize; i++) {
+    _plan[i].msGroup = 0;
+    _plan[i].msBin = 0;
+    _plan[i].msStep = 0;
+    _plan[i].msFreq = _plan[i].freq;
+  }
+  if(!_msine || _planSize < 2) return;
+
+  /* Fewest bins per point step that still keeps neighbouring points apart */
+  bool down = _plan[0].freq > _plan[_planSize - 1].freq;
+  float ratio = down ? _plan[0].freq / _plan[1].freq : _plan[1].freq / _plan[0].freq;
+  long firstBin = ratio > 1 ? lroundf(ceilf(1 / (ratio - 1))) : MSINE_CYCLES;
+  if(firstBin < MSINE_CYCLES) firstBin = MSINE_CYCLES;
+
+  uint8_t group = 0;
+  long step = 0, bin = 0;
+  for(uint32_t j = 0; j < _planSize; j++) {
+    planStruct *pPlan = &_plan[down ? _planSize - 1 - j : j];
+    if(pPlan->freq > _msineMaxFreq) break;
+
+    if(group) {
+      long next = lroundf(pPlan->freq * MSINE_STEPS * step / fs);
+      bin = next > bin ? next : bin + 1;
+    }
+    if(!group || bin >= MSINE_STEPS / 2) {
+      if(group == UINT8_MAX) break;
+      step = lroundf(firstBin * fs / (pPlan->freq * MSINE_STEPS));
+      if(step < 1) step = 1;
+      if(step > (long)maxStep) step = maxStep;
+      bin = lroundf(pPlan->freq * MSINE_STEPS * step / fs);
+      if(bin < 1) bin = 1;
+      if(bin >= MSINE_STEPS / 2) break;
+      group++;
+    }
+
+    pPlan->msGroup = group;
+    pPlan->msBin = bin;
+    pPlan->msStep = step;
+    pPlan->msFreq = bin * fs / (MSINE_STEPS * step);
+  }
+}
+
+/* The plan only applies to the sweep it was compiled from */
+bool HELPStat::sweepPlanValid(void) {
+  return sweepPlanMatches() && _sweepCfg.SweepIndex < _planSize;
+}
+
+/* Same without the sweep position, which only the measurement thread may read */
+bool HELPStat::sweepPlanMatches(void) {
+  return _planSize != 0 && _planSize == _sweepCfg.SweepPoints &&
+         _plan[0].freq == _sweepCfg.SweepStart && _planStop == _sweepCfg.SweepStop;
+}
+
+/*
+  Applies one plan entry: the register writes setHSTIA + AD5940_WGFreqCtrlS would do,
+  without the calculations. Gains come from _extGain / _dacGain so BLE updates still apply.
+*/
+void HELPStat::applySweepPlan(uint32_t index) {
+  HSDACCfg_Type hsdac_cfg;
+  ADCFilterCfg_Type filter_cfg;
+  DFTCfg_Type dft_cfg;
+  const planStruct *pPlan = &_plan[index];
+
+  AD5940_WriteReg(REG_AFE_WGFCW, pPlan->wgFcw);
+
+  if(pPlan->rTIA >= 0) {
+    hsdac_cfg.ExcitBufGain = _extGain;
+    hsdac_cfg.HsDacGain = _dacGain;
+    hsdac_cfg.HsDacUpdateRate = pPlan->hpMode ? 0x07 : 0x1B;
+    AD5940_HSDacCfgS(&hsdac_cfg);
+    AD5940_HSRTIACfgS(pPlan->rTIA);
+    __AD5940_SetDExRTIA(0, HSTIADERTIA_OPEN, HSTIADERLOAD_0R);
+    _currentRtia = pPlan->rTIA;
+  }
+  else Serial.println("Unable to configure.");
+
+  AD5940_HPModeEn(pPlan->hpMode ? bTRUE : bFALSE);
+
+  filter_cfg.ADCRate = pPlan->hpMode ? ADCRATE_1P6MHZ : ADCRATE_800KHZ;
+  filter_cfg.ADCAvgNum = ADCAVGNUM_16;  // Not using this so it doesn't matter 
+  filter_cfg.ADCSinc2Osr = pPlan->sinc2Osr;
+  filter_cfg.ADCSinc3Osr = pPlan->sinc3Osr;
+  filter_cfg.BpSinc3 = bFALSE;
+  filter_cfg.BpNotch = bTRUE; // Not using onboard 60 Hz Notch Filter
+  filter_cfg.Sinc2NotchEnable = bTRUE;
+
+  dft_cfg.DftNum = pPlan->dftNum;
+  dft_cfg.DftSrc = pPlan->dftSrc;
+  dft_cfg.HanWinEn = bTRUE;
+
+  AD5940_ADCFilterCfgS(&filter_cfg);
+  AD5940_DFTCfgS(&dft_cfg);
+
+  _waitClcks = pPlan->waitClcks;
+}
+
+/* Dumps the plan as CSV so configurations can be diffed */
+void HELPStat::printSweepPlan(void) {
+  printf("Sweep plan: %d points\n", _planSize);
+  printf("Index, Frequency (Hz), WGFCW, RTIA, HP, SINC3 OSR, SINC2 OSR, DFTNUM, DFT Src, Wait Clocks, "
+         "MS Group, MS Bin, MS Step, MS Freq (Hz)\n");
+  for(uint32_t i = 0; i < _planSize; i++) {
+    const planStruct *pPlan = &_plan[i];
+    printf("%d,%.4f,0x%06X,%d,%d,%d,%d,%d,%d,%u,%d,%d,%d,%.4f\n", i, pPlan->freq, (unsigned)pPlan->wgFcw, pPlan->rTIA,
+           pPlan->hpMode, pPlan->sinc3Osr, pPlan->sinc2Osr, pPlan->dftNum, pPlan->dftSrc, (unsigned)pPlan->waitClcks,
+           pPlan->msGroup, pPlan->msBin, pPlan->msStep, pPlan->msFreq);
+  }
+}
+
+planStruct HELPStat::getPlanEntry(uint32_t index) {
+  planStruct empty = {};
+  if(index >= _planSize) return empty;
+  return _plan[index];
+}
+
+/* 10/16/2026 - Times the SPI transport as the driver uses it: single 32-bit register reads
+   (FIFOCNTSTA) and writes (SEQ3INFO), neither of which the register shadow serves, and
+   data FIFO drains of fifoWords words. Leaves SEQ3INFO at its reset value and clears the
+   FIFO flags afterwards. */
+spiBenchStruct HELPStat::spiBenchmark(uint32_t numOps, uint32_t fifoWords) {
+  spiBenchStruct result = {};
+  static uint32_t fifoBuff[SPI_BENCH_FIFO_WORDS];
+  unsigned long t0;
+
+  if(numOps == 0) numOps = 1;
+  if(fifoWords == 0) fifoWords = 1;
+  if(fifoWords > SPI_BENCH_FIFO_WORDS) fifoWords = SPI_BENCH_FIFO_WORDS;
+
+  t0 = micros();
+  for(uint32_t i = 0; i < numOps; i++) AD5940_ReadReg(REG_AFE_FIFOCNTSTA);
+  result.regReadUs = (float)(micros() - t0) / numOps;
+
+  t0 = micros();
+  for(uint32_t i = 0; i < numOps; i++) AD5940_WriteReg(REG_AFE_SEQ3INFO, i & 0x7FF);
+  result.regWriteUs = (float)(micros() - t0) / numOps;
+  AD5940_WriteReg(REG_AFE_SEQ3INFO, REG_AFE_SEQ3INFO_RESET);
+
+  t0 = micros();
+  AD5940_FIFORd(fifoBuff, fifoWords);
+  unsigned long fifoUs = micros() - t0;
+  result.fifoWordUs = (float)fifoUs / fifoWords;
+  result.fifoMBs = fifoUs ? (4.0f * fifoWords) / fifoUs : 0;
+
+  AD5940_INTCClrFlag(AFEINTSRC_DATAFIFOOF | AFEINTSRC_DATAFIFOUF | AFEINTSRC_DATAFIFOTHRESH);
+
+  printf("SPI benchmark: read %.2f us, write %.2f us, FIFO %.3f us/word (%.2f MB/s over %u words)\n",
+         result.regReadUs, result.regWriteUs, result.fifoWordUs, result.fifoMBs, fifoWords);
+  return result;
+}
+
 /* Current noise measurements */
 float HELPStat::getADCVolt(uint32_t gainPGA, float vRef1p82) { 
   /* Bypassing SINC3 gets us ADC data */
   uint32_t adcCode = AD5940_ReadAfeResult(AFERESULT_SINC3);
   float vOut = AD5940_ADCCode2Volt(adcCode, gainPGA, vRef1p82);
+  return vOut;
 }
 
-float HELPStat::pollADC(uint32_t gainPGA, float vRef1p82) {
-  float vOut;
+float HELPStat::pollADC(uint32_t /* gainPGA */, float vRef1p82) {
+  float vOut = 0;
   float kFactor = 1.835/1.82;
   /* Polls ADC and returns a voltage and the ADCcode */
   while(!AD5940_GetMCUIntFlag()) {
@@ -2375,8 +4843,10 @@ float HELPStat::pollADC(uint32_t gainPGA, float vRef1p82) {
         float diff_volt = temp * vRef1p82 / 32768 * kFactor;
         printf("ADC Code:%d, diff-volt: %.4f, volt:%.4f\n",rd, diff_volt, diff_volt+1.11);
       }
+      vOut = (rd - 32768) * vRef1p82 / 32768 * kFactor;
     }
   else Serial.println("Flag not working!");
+  return vOut;
 }
 
 void HELPStat::AD5940_TDDNoise(float biasVolt, float zeroVolt) {
@@ -2536,7 +5006,7 @@ void HELPStat::AD5940_TDDNoise(float biasVolt, float zeroVolt) {
   HsLoopCfg.WgCfg.WgType = WGTYPE_SIN;
   HsLoopCfg.WgCfg.GainCalEn = bTRUE;          // Gain calibration
   HsLoopCfg.WgCfg.OffsetCalEn = bTRUE;        // Offset calibration
-  printf("Current Freq: %f\n", 100);
+  printf("Current Freq: %f\n", 100.0);
   HsLoopCfg.WgCfg.SinCfg.SinFreqWord = AD5940_WGFreqWordCal(100, sysClkFreq);
   HsLoopCfg.WgCfg.SinCfg.SinAmplitudeWord = (uint32_t)((sineVpp/800.0f)*2047 + 0.5f);
   HsLoopCfg.WgCfg.SinCfg.SinOffsetWord = 0;
@@ -2701,6 +5171,7 @@ void HELPStat::AD5940_ADCMeasure(void) {
 
   Serial.println("Polling ADC!");
   float vOut = pollADC(gainPGA, vRef1p82);
+  adcCode = AD5940_ReadAfeResult(AFERESULT_SINC2);
 
   // AD5940_AFECtrlS(AFECTRL_ADCPWR|AFECTRL_ADCCNV, bFALSE);  /* Stop ADC convert */
   AD5940_ADCPowerCtrlS(bFALSE);
@@ -2751,8 +5222,6 @@ void HELPStat::ADCNoiseTest(void) {
 
   /* Constants for sampling rate at 120 Hz */
   uint32_t SAMPLESIZE = 7200; 
-  uint32_t runTime = 60;
-  float currentArr[SAMPLESIZE];
   float fSample = 120; 
   uint32_t delaySample = (1/fSample) * 1000; 
   
@@ -2828,8 +5297,7 @@ void HELPStat::ADCNoiseTest(void) {
   uint32_t i = 0; 
   while(i < SAMPLESIZE) 
   {
-    uint32_t rd;
-    uint32_t rd_re0;
+    uint32_t rd = 0;
     unsigned long currTime = millis(); 
 
     if(currTime - timeStart >= delaySample)
@@ -2902,11 +5370,7 @@ void HELPStat::ADCNoiseTest(void) {
 void HELPStat::saveDataNoise(String dirName, String fileName) {
   String directory = "/" + dirName;
   
-  if(!SD.begin(CS_SD))
-  {
-    Serial.println("Card mount failed.");
-    return;
-  }
+  if(!mountSD()) return;
 
   if(!SD.exists(directory))
   {
@@ -2997,6 +5461,7 @@ void HELPStat::BLE_setup() {
   Serial.begin(115200);
 
   BLEDevice::init("HELPStat");
+  BLEDevice::setMTU(BLE_MTU); // Centrals that ask for a bigger MTU get up to this much
 
   // Create the BLE Server
   pServer = BLEDevice::createServer();
@@ -3109,6 +5574,28 @@ void HELPStat::BLE_setup() {
                       BLECharacteristic::PROPERTY_READ |
                       BLECharacteristic::PROPERTY_NOTIFY
                     ); 
+  pCharacteristicBulk = pService->createCharacteristic(
+                      CHARACTERISTIC_UUID_BULK,
+                      BLECharacteristic::PROPERTY_READ |
+                      BLECharacteristic::PROPERTY_NOTIFY
+                    );
+  pCharacteristicBulk->setCallbacks(&_bulkCallbacks);
+  pCharacteristicConfig = pService->createCharacteristic(
+                      CHARACTERISTIC_UUID_CONFIG,
+                      BLECharacteristic::PROPERTY_READ |
+                      BLECharacteristic::PROPERTY_WRITE
+                    );
+
+  // Settings are parsed once per write into _bleCfg, START wakes BLE_settings
+  _configCallbacks.owner = this;
+  _bleCfg = getBleConfig();
+  BLECharacteristic* settings[] = {pCharacteristicStart, pCharacteristicRct, pCharacteristicRs, pCharacteristicNumCycles,
+                                   pCharacteristicNumPoints, pCharacteristicStartFreq, pCharacteristicEndFreq,
+                                   pCharacteristicRcalVal, pCharacteristicBiasVolt, pCharacteristicZeroVolt,
+                                   pCharacteristicDelaySecs, pCharacteristicExtGain, pCharacteristicDacGain,
+                                   pCharacteristicFolderName, pCharacteristicFileName, pCharacteristicConfig};
+  for(BLECharacteristic* c : settings) c->setCallbacks(&_configCallbacks);
+  bleConfigPublish();
 
   // https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.descriptor.gatt.client_characteristic_configuration.xml
   // Create a BLE Descriptor
@@ -3133,6 +5620,8 @@ void HELPStat::BLE_setup() {
   pCharacteristicImag->addDescriptor(new BLE2902());
   pCharacteristicPhase->addDescriptor(new BLE2902());
   pCharacteristicMagnitude->addDescriptor(new BLE2902());
+  _bulkCccd = new BLE2902();
+  pCharacteristicBulk->addDescriptor(_bulkCccd);
 
   // Start the service
   pService->start();
@@ -3150,44 +5639,129 @@ void HELPStat::BLE_setup() {
 }
 
 /*
-  This function allows the user to adjust settings over BLE until a start signal is sent.
-  Note that this is practically an infinite loop if the BLE signal is never sent.
+  onWrite handler for the settings characteristics, CONFIG and START (runs on the BLE stack's
+  task). Each value is parsed once, here, into the pending _bleCfg; nothing touches the sweep
+  settings until BLE_settings applies it. Empty writes are ignored, like the old polling loop.
+*/
+void HELPStat::bleConfigWrite(BLECharacteristic* pCharacteristic) {
+  size_t len = pCharacteristic->getLength();
+  const uint8_t* pData = pCharacteristic->getData();
+  if(len == 0) return;
+
+  if(pCharacteristic == pCharacteristicStart) {
+    if(!pData[0]) return;
+    __atomic_store_n(&_startReq, _startReq + 1, __ATOMIC_RELEASE);
+    TaskHandle_t task = __atomic_load_n(&_settingsTask, __ATOMIC_ACQUIRE);
+    if(task != NULL) xTaskNotifyGive(task);
+    return;
+  }
+
+  if(pCharacteristic == pCharacteristicConfig) {
+    bleConfig cfg;
+    if(bleConfigDecode(pData, len, &cfg) != BLE_FRAME_OK)
+      printf("CONFIG write rejected (%u bytes)\n", (unsigned)len);
+    else {
+      portENTER_CRITICAL(&_bleCfgMux);
+      _bleCfg = cfg;
+      portEXIT_CRITICAL(&_bleCfgMux);
+    }
+    bleConfigPublish();
+    return;
+  }
+
+  // Single setting: the app writes it as text
+  char text[BLE_CONFIG_NAME_LEN + 1];
+  size_t n = len < BLE_CONFIG_NAME_LEN ? len : BLE_CONFIG_NAME_LEN;
+  memcpy(text, pData, n);
+  text[n] = 0;
+  float v = atof(text);
+
+  portENTER_CRITICAL(&_bleCfgMux);
+  if(pCharacteristic == pCharacteristicRct)             _bleCfg.rctEstimate = v;
+  else if(pCharacteristic == pCharacteristicRs)         _bleCfg.rsEstimate = v;
+  else if(pCharacteristic == pCharacteristicNumCycles)  _bleCfg.numCycles = v;
+  else if(pCharacteristic == pCharacteristicNumPoints)  _bleCfg.numPoints = v;
+  else if(pCharacteristic == pCharacteristicStartFreq)  _bleCfg.startFreq = v;
+  else if(pCharacteristic == pCharacteristicEndFreq)    _bleCfg.endFreq = v;
+  else if(pCharacteristic == pCharacteristicRcalVal)    _bleCfg.rcalVal = v;
+  else if(pCharacteristic == pCharacteristicBiasVolt)   _bleCfg.biasVolt = v;
+  else if(pCharacteristic == pCharacteristicZeroVolt)   _bleCfg.zeroVolt = v;
+  else if(pCharacteristic == pCharacteristicDelaySecs)  _bleCfg.delaySecs = v;
+  else if(pCharacteristic == pCharacteristicExtGain)    _bleCfg.extGain = v;
+  else if(pCharacteristic == pCharacteristicDacGain)    _bleCfg.dacGain = v;
+  else if(pCharacteristic == pCharacteristicFolderName) memcpy(_bleCfg.folderName, text, n + 1);
+  else if(pCharacteristic == pCharacteristicFileName)   memcpy(_bleCfg.fileName, text, n + 1);
+  portEXIT_CRITICAL(&_bleCfgMux);
+  bleConfigPublish();
+}
+
+/*
+  Refreshes the CONFIG characteristic with the pending configuration so a central can read back
+  what the next BLE_settings will apply.
+*/
+void HELPStat::bleConfigPublish(void) {
+  uint8_t buf[BLE_CONFIG_SIZE];
+  portENTER_CRITICAL(&_bleCfgMux);
+  bleConfig cfg = _bleCfg;
+  portEXIT_CRITICAL(&_bleCfgMux);
+  bleConfigEncode(buf, &cfg);
+  pCharacteristicConfig->setValue(buf, BLE_CONFIG_SIZE);
+}
+
+/*
+  Returns the settings currently applied (what the next sweep will use) in CONFIG form.
+*/
+bleConfig HELPStat::getBleConfig(void) {
+  bleConfig cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.rctEstimate = _rct_estimate;
+  cfg.rsEstimate = _rs_estimate;
+  cfg.numCycles = _numCycles;
+  cfg.numPoints = _numPoints;
+  cfg.startFreq = _startFreq;
+  cfg.endFreq = _endFreq;
+  cfg.rcalVal = _rcalVal;
+  cfg.biasVolt = _biasVolt;
+  cfg.zeroVolt = _zeroVolt;
+  cfg.delaySecs = _delaySecs;
+  cfg.extGain = _extGain;
+  cfg.dacGain = _dacGain;
+  strncpy(cfg.folderName, _folderName.c_str(), BLE_CONFIG_NAME_LEN);
+  strncpy(cfg.fileName, _fileName.c_str(), BLE_CONFIG_NAME_LEN);
+  return cfg;
+}
+
+/*
+  This function waits until a start signal is sent over BLE (or the button is pressed) and then
+  applies the settings written since BLE_setup. The writes themselves are handled by
+  bleConfigWrite; here the task just sleeps on a notification, waking every BLE_BUTTON_POLL_MS to
+  check the button. Note that this still waits forever if neither ever happens.
 */
 void HELPStat::BLE_settings() {
-  bool buttonStatus;
-  do{
-    old_start_value = start_value;
-    start_value = *(pCharacteristicStart->getData());
-    buttonStatus = digitalRead(BUTTON);
-    delay(3);
-
-    if(pCharacteristicRct->getValue() != NULL)
-      _rct_estimate = pCharacteristicRct->getValue().toFloat();
-    if(pCharacteristicRs->getValue() != NULL)
-      _rs_estimate  = pCharacteristicRs->getValue().toFloat();
-    if(pCharacteristicNumCycles->getValue() != NULL)
-      _numCycles = pCharacteristicNumCycles->getValue().toFloat();
-    if(pCharacteristicNumPoints->getValue() != NULL)
-      _numPoints = pCharacteristicNumPoints->getValue().toFloat();
-    if(pCharacteristicStartFreq->getValue() != NULL)
-      _startFreq = pCharacteristicStartFreq->getValue().toFloat();
-    if(pCharacteristicEndFreq->getValue() != NULL)
-      _endFreq   = pCharacteristicEndFreq->getValue().toFloat();
-    if(pCharacteristicRcalVal->getValue() != NULL)
-      _rcalVal   = pCharacteristicRcalVal->getValue().toFloat();
-    if(pCharacteristicBiasVolt->getValue() != NULL)
-      _biasVolt   = pCharacteristicBiasVolt->getValue().toFloat();
-    if(pCharacteristicZeroVolt->getValue() != NULL)
-      _zeroVolt   = pCharacteristicZeroVolt->getValue().toFloat();
-    if(pCharacteristicDelaySecs->getValue() != NULL)
-      _delaySecs   = pCharacteristicDelaySecs->getValue().toFloat();
-    if(pCharacteristicExtGain->getValue() != NULL)
-      _extGain   = pCharacteristicExtGain->getValue().toFloat();
-    if(pCharacteristicDacGain->getValue() != NULL)
-      _dacGain   = pCharacteristicDacGain->getValue().toFloat();
-    _folderName = String((pCharacteristicFolderName->getValue()).c_str());
-    _fileName = String((pCharacteristicFileName->getValue()).c_str());
-  }while((!start_value || old_start_value == start_value) && buttonStatus); // Maybe remove the old_start_value stuff? (&& digitalRead(BUTTON))
+  __atomic_store_n(&_settingsTask, xTaskGetCurrentTaskHandle(), __ATOMIC_RELEASE);
+  while(__atomic_load_n(&_startReq, __ATOMIC_ACQUIRE) == _startDone && digitalRead(BUTTON))
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BLE_BUTTON_POLL_MS));
+  __atomic_store_n(&_settingsTask, (TaskHandle_t)NULL, __ATOMIC_RELEASE);
+  _startDone = __atomic_load_n(&_startReq, __ATOMIC_ACQUIRE);
+
+  portENTER_CRITICAL(&_bleCfgMux);
+  bleConfig cfg = _bleCfg;
+  portEXIT_CRITICAL(&_bleCfgMux);
+
+  _rct_estimate = cfg.rctEstimate;
+  _rs_estimate  = cfg.rsEstimate;
+  _numCycles    = cfg.numCycles;
+  _numPoints    = cfg.numPoints;
+  _startFreq    = cfg.startFreq;
+  _endFreq      = cfg.endFreq;
+  _rcalVal      = cfg.rcalVal;
+  _biasVolt     = cfg.biasVolt;
+  _zeroVolt     = cfg.zeroVolt;
+  _delaySecs    = cfg.delaySecs;
+  _extGain      = cfg.extGain;
+  _dacGain      = cfg.dacGain;
+  _folderName   = String(cfg.folderName);
+  _fileName     = String(cfg.fileName);
 }
 
 /*
@@ -3204,11 +5778,27 @@ void HELPStat::BLE_transmitResults() {
   pCharacteristicRs->setValue(buffer);
   pCharacteristicRs->notify();
 
+  // Every point already went out while the sweep ran (setBleStreaming), only the summary is left
+  if(_streamDone) {
+    _bleStats.complete = bleSendSummary(_streamFrameMax);
+    _streamDone = false;
+    return;
+  }
+
+  // Clients that subscribed to the bulk characteristic get binary frames instead, unless
+  // the MTU was never raised and a frame cannot hold a single point
+  size_t frameMax = bleFrameMax();
+  if(frameMax) {
+    BLE_transmitBulk(frameMax);
+    return;
+  }
+
   // Transmit freq, Zreal, and Zimag for all sampled points
   for(uint32_t i = 0; i < _sweepCfg.SweepPoints; i++) {
     for(uint32_t j = 0; j <= _numCycles; j++) {
       impStruct eis;
-      eis = eisArr[i + (j * _sweepCfg.SweepPoints)];
+      if(!resultValid(i + (j * _sweepCfg.SweepPoints))) continue; // Failed point: nothing to send
+      eis = getResult(i + (j * _sweepCfg.SweepPoints));
       
       // Transmit Frequency
       dtostrf(eis.freq,1,2,buffer);
@@ -3243,6 +5833,323 @@ void HELPStat::BLE_transmitResults() {
   }
 }
 
+/*
+  10/16/2026 - Largest frame the connected client can take (MTU - 3), or 0 if it has not
+  subscribed to the bulk characteristic or the MTU is too small for a single point.
+*/
+size_t HELPStat::bleFrameMax(void) {
+  if(pServer == NULL || _bulkCccd == NULL || !_bulkCccd->getNotifications()) return 0;
+  uint16_t mtu = pServer->getPeerMTU(pServer->getConnId());
+  size_t frameMax = mtu > 3 ? mtu - 3 : 0;
+  if(frameMax > sizeof(_bleFrame)) frameMax = sizeof(_bleFrame);
+  return bleFrameCapacity(_bleFormat, frameMax) ? frameMax : 0;
+}
+
+/*
+  10/16/2026 - Sends one frame from _bleFrame on the bulk characteristic. On the ESP32, notify()
+  returns once the stack has taken the notification and reports it through onStatus, so the
+  next frame only goes out after this one completed. A congested link (ERROR_GATT) gets the
+  same frame again after BLE_BULK_BACKOFF_MS; anything else ends the transfer.
+*/
+bool HELPStat::bleSendFrame(size_t len) {
+  for(uint32_t attempt = 0; attempt < BLE_BULK_RETRIES; attempt++) {
+    if(pServer->getConnectedCount() == 0) return false;
+    if(attempt) {
+      _bleStats.retries++;
+      delay(BLE_BULK_BACKOFF_MS);
+    }
+
+    _bulkCallbacks.status = -1;
+    pCharacteristicBulk->setValue(_bleFrame, len);
+    pCharacteristicBulk->notify();
+
+    if(_bulkCallbacks.status == BLECharacteristicCallbacks::SUCCESS_NOTIFY) {
+      _bleStats.frames++;
+      _bleStats.bytes += len;
+      return true;
+    }
+    if(_bulkCallbacks.status != BLECharacteristicCallbacks::ERROR_GATT) return false;
+  }
+  return false;
+}
+
+/*
+  Point frames with results first .. first + count - 1 (count must fit frameMax) of the cycle's
+  given KK attempt. Failed points (DFTREC_FAILED) are left out: each run of measured points
+  between them goes in a frame of its own, so the phone sees a gap in the indices, not a 0 Hz point.
+*/
+bool HELPStat::bleSendPoints(uint32_t first, uint32_t count, size_t frameMax, uint8_t attempt) {
+  uint32_t end = first + count;
+  while(first < end) {
+    while(first < end && !resultValid(first)) first++;
+    uint32_t run = 0;
+    while(first + run < end && resultValid(first + run)) run++;
+    if(run == 0) break;
+
+    bleFrameHdr hdr = {};
+    hdr.type = _bleFormat;
+    hdr.flags = bleFrameAttemptFlags(attempt);
+    hdr.seq = _bleSeq++;
+    hdr.sweepPoints = _sweepCfg.SweepPoints;
+    hdr.first = first;
+    hdr.count = run;
+    for(uint32_t k = 0; k < run; k++) {
+      impStruct eis = getResult(first + k);
+      _blePoints[k].freq = eis.freq;
+      _blePoints[k].real = eis.real;
+      _blePoints[k].imag = eis.imag;
+    }
+    if(!bleSendFrame(bleFrameEncodePoints(_bleFrame, frameMax, &hdr, _blePoints))) return false;
+    _bleStats.points += run;
+    for(uint32_t k = first; k < first + run && k < _streamSent.size(); k++) {
+      if(_streamSent[k]) _bleStats.resent++;
+      _streamSent[k] = true;
+    }
+    first += run;
+  }
+  return true;
+}
+
+/* Last frame of a transfer: Rct / Rs and the number of points sent */
+bool HELPStat::bleSendSummary(size_t frameMax) {
+  bleFrameHdr hdr = {};
+  bleSummary summary = {_calculated_Rct, _calculated_Rs, _bleStats.points - _bleStats.resent};
+  hdr.seq = _bleSeq++;
+  hdr.flags = BLE_FRAME_LAST;
+  hdr.sweepPoints = _sweepCfg.SweepPoints;
+  hdr.first = summary.points;
+  return bleSendFrame(bleFrameEncodeSummary(_bleFrame, frameMax, &hdr, &summary));
+}
+
+/*
+  10/16/2026 - Binary version of the point loop in BLE_transmitResults. Results go out in
+  index order (point + cycle * points), as many per frame as frameMax (MTU - 3) holds, followed by a
+  summary frame with Rct / Rs and the point count. Frame format in bleframe.h.
+*/
+bool HELPStat::BLE_transmitBulk(size_t frameMax) {
+  unsigned long timeStart = millis();
+  uint32_t perFrame = bleFrameCapacity(_bleFormat, frameMax);
+
+  uint32_t total = _sweepCfg.SweepPoints * (_numCycles + 1);
+  if(total > _resultCap) total = _resultCap;
+
+  memset(&_bleStats, 0, sizeof(_bleStats));
+  _bleStats.mtu = frameMax + 3;
+  _bleSeq = 0;
+  _streamSent.clear(); // One pass, nothing is sent twice
+  if(perFrame == 0) return false;
+
+  bool ok = true;
+  for(uint32_t first = 0; ok && first < total; first += perFrame)
+    ok = bleSendPoints(first, total - first < perFrame ? total - first : perFrame, frameMax, 0);
+  if(ok) ok = bleSendSummary(frameMax);
+
+  _bleStats.complete = ok;
+  _bleStats.timeMs = millis() - timeStart;
+  printf("BLE: %u points in %u frames (%u bytes, MTU %u), %u retries, %lu ms%s\n",
+         _bleStats.points, _bleStats.frames, _bleStats.bytes, _bleStats.mtu, _bleStats.retries, _bleStats.timeMs,
+         ok ? "" : " - transfer aborted");
+  return ok;
+}
+
+/*
+  10/16/2026 - Streams each point to the phone while runSweep / runSweepSeq are still running.
+  Clients subscribed to the bulk characteristic get point frames; every client gets
+  SWEEPINDEX / CURRENTFREQ updates. Needs BLE_setup and a connected client at the start of
+  the run.
+*/
+void HELPStat::setBleStreaming(bool enable) {
+  _bleStream = enable;
+}
+
+/* Called at the start of a run. Sets up the point queue and the BLE sender task */
+void HELPStat::openStream(void) {
+  __atomic_store_n(&_streamActive, false, __ATOMIC_RELEASE);
+  _streamDone = false;
+  if(!_bleStream || pServer == NULL || pServer->getConnectedCount() == 0) return;
+
+  _streamFrameMax = bleFrameMax();
+  _streamFrames = _streamFrameMax != 0;
+  _streamTotal = _sweepCfg.SweepPoints * (_numCycles + 1);
+  if(_streamTotal > _resultCap) _streamTotal = _resultCap;
+  _streamNext = 0;
+  _streamCount = 0;
+  _streamAttempt = 0;
+  _streamSent.assign(_streamTotal, false);
+  _streamEnd = false;
+  _bleSeq = 0;
+  memset(&_bleStats, 0, sizeof(_bleStats));
+  _bleStats.mtu = _streamFrames ? _streamFrameMax + 3 : 0;
+  _bleStats.streamed = true;
+  _bleStats.timeMs = millis(); // Start of the stream until closeStream
+  pointQueueInit(&_bleQueue, _bleQueueMem, BLE_QUEUE_DEPTH);
+
+  startBleTask();
+  _bleStats.background = _bleTask != NULL;
+  __atomic_store_n(&_streamActive, true, __ATOMIC_RELEASE);
+  printf("BLE streaming: %s (%s)\n", _streamFrames ? "bulk frames" : "progress only",
+         _bleTask ? "sender task" : "inline");
+}
+
+/*
+  10/16/2026 - Producer side: queues one finished point for the BLE sender. Never waits; a
+  point that finds the queue full is still in the result store, and the sender reads it from
+  there when it sees the gap.
+*/
+void HELPStat::streamResult(uint32_t index) {
+  if(!__atomic_load_n(&_streamActive, __ATOMIC_ACQUIRE)) return;
+  if(!(eisArr[index].flags & DFTREC_VALID)) return; // Failed point: nothing to send
+
+  logPoint point = {};
+  point.timeMs = millis();
+  point.freq = sweepFreq(eisArr[index].freqIdx, eisArr[index].flags);
+  point.cycle = index / _sweepCfg.SweepPoints;
+  point.settleStatus = _settleArr[index].status;
+  point.range = 0;       // Not sent in BLE frames
+  point.settleMs = _settleArr[index].settleMs;
+  point.rec = eisArr[index];
+  point.attempt = _kkAttempt;
+  if(!pointQueuePush(&_bleQueue, &point)) _bleStats.requeued++;
+
+  if(_bleTask) xTaskNotifyGive(_bleTask);
+  else streamService();
+}
+
+/*
+  10/16/2026 - Consumer side of _bleQueue. Points are sent in index order: a frame goes out
+  when it is full, when its oldest point has waited BLE_STREAM_FLUSH_MS, or when closeStream
+  asks. A point of another KK attempt than the one being sent starts its cycle over
+  (streamRewind). Runs in the BLE sender task, or inline on the measurement thread, which sends
+  every point as soon as it is queued.
+*/
+void HELPStat::streamService(void) {
+  logPoint point;
+  uint32_t flushReq = __atomic_load_n(&_streamFlushReq, __ATOMIC_ACQUIRE);
+  bool flush = flushReq != _streamFlushDone;
+
+  if(__atomic_load_n(&_streamActive, __ATOMIC_ACQUIRE)) {
+    uint32_t perFrame = _streamFrames ? bleFrameCapacity(_bleFormat, _streamFrameMax) : 1;
+
+    while(pointQueuePop(&_bleQueue, &point)) {
+      uint32_t index = point.rec.freqIdx + point.cycle * _sweepCfg.SweepPoints;
+      if(point.attempt != _streamAttempt) streamRewind(point.cycle * _sweepCfg.SweepPoints, point.attempt);
+      if(index < _streamNext + _streamCount || index >= _streamTotal) continue;
+      if(_streamCount == 0) _streamTime = point.timeMs;
+      _streamCount = index + 1 - _streamNext; // Includes any points the full queue turned away
+    }
+    if(flush && _streamEnd) _streamCount = _streamTotal - _streamNext;
+    if(_bleTask == NULL) flush = true; // Inline: nothing wakes up later to send a partial frame
+
+    while(_streamCount && (flush || _streamCount >= perFrame || millis() - _streamTime >= BLE_STREAM_FLUSH_MS))
+      streamSend(_streamCount < perFrame ? _streamCount : perFrame);
+  }
+  workerDone(&_streamFlushDone, flushReq);
+}
+
+/* Sends the next count pending points and moves SWEEPINDEX / CURRENTFREQ to the last of them */
+void HELPStat::streamSend(uint32_t count) {
+  char buffer[20];
+  uint32_t last = _streamNext + count - 1;
+
+  if(_streamFrames && !bleSendPoints(_streamNext, count, _streamFrameMax, _streamAttempt)) {
+    _streamFrames = false; // Link lost: BLE_transmitResults sends the whole run at the end
+    Serial.println("BLE streaming stopped, results will be sent after the sweep.");
+  }
+
+  pCharacteristicSweepIndex->setValue(String(last));
+  pCharacteristicSweepIndex->notify();
+  dtostrf(sweepFreq(last % _sweepCfg.SweepPoints, last < _resultCap ? eisArr[last].flags : 0),1,2,buffer);
+  pCharacteristicCurrentFreq->setValue(buffer);
+  pCharacteristicCurrentFreq->notify();
+
+  /* Provisional fit, overwritten by BLE_transmitResults at the end. The two values can be a
+     point apart; they are only for display. */
+  float rct, rs;
+  if(getProvisionalFit(&rct, &rs)) {
+    dtostrf(rct,4,3,buffer);
+    pCharacteristicRct->setValue(buffer);
+    pCharacteristicRct->notify();
+    dtostrf(rs,4,3,buffer);
+    pCharacteristicRs->setValue(buffer);
+    pCharacteristicRs->notify();
+  }
+
+  unsigned long latency = millis() - _streamTime;
+  if(latency > _bleStats.maxLatencyMs) _bleStats.maxLatencyMs = latency;
+  _streamNext += count;
+  _streamCount -= count;
+  if(_streamCount) _streamTime = millis();
+}
+
+/*
+  10/16/2026 - The cycle starting at index first is now sent as the given KK attempt. Pending
+  points before it go out first; the rejected attempt's points are dropped, and if some of
+  them were already sent the stream goes back to first, so the phone gets the whole cycle
+  again with the new attempt number (bleSendPoints counts those in _bleStats.resent).
+*/
+void HELPStat::streamRewind(uint32_t first, uint8_t attempt) {
+  uint32_t perFrame = _streamFrames ? bleFrameCapacity(_bleFormat, _streamFrameMax) : 1;
+  if(_streamNext + _streamCount > first) _streamCount = _streamNext < first ? first - _streamNext : 0;
+  while(_streamCount) streamSend(_streamCount < perFrame ? _streamCount : perFrame);
+  if(_streamNext > first) _streamNext = first;
+  _streamAttempt = attempt;
+}
+
+/* Called at the end of a run: sends everything still pending and waits for the sender */
+void HELPStat::closeStream(void) {
+  if(!__atomic_load_n(&_streamActive, __ATOMIC_ACQUIRE)) return;
+
+  _streamEnd = true;
+  uint32_t req = _streamFlushReq + 1;
+  __atomic_store_n(&_streamFlushReq, req, __ATOMIC_RELEASE);
+  if(_bleTask) {
+    xTaskNotifyGive(_bleTask);
+    waitWorker(&_streamFlushDone, req);
+  }
+  else streamService();
+  __atomic_store_n(&_streamActive, false, __ATOMIC_RELEASE);
+
+  _streamDone = _streamFrames && _streamNext == _streamTotal;
+  _bleStats.timeMs = millis() - _bleStats.timeMs;
+  printf("BLE streaming: %u / %u points sent live in %u frames, %u from the store, worst latency %lu ms\n",
+         _bleStats.points, _streamTotal, _bleStats.frames, _bleStats.requeued, _bleStats.maxLatencyMs);
+}
+
+void HELPStat::bleTask(void *pArg) {
+  HELPStat *pStat = (HELPStat *)pArg;
+  for(;;) {
+    /* Woken for every queued point, at least every BLE_STREAM_FLUSH_MS */
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BLE_STREAM_FLUSH_MS));
+    pStat->streamService();
+  }
+}
+
+/* Pins the BLE sender task to the core the sketch is not running on. Falls back to inline sends */
+bool HELPStat::startBleTask(void) {
+  if(_bleTask || _bleInline) return _bleTask != NULL;
+  if(xTaskCreatePinnedToCore(bleTask, "helpstat_ble", BLE_TASK_STACK, this, BLE_TASK_PRIO,
+                             &_bleTask, BLE_TASK_CORE) != pdPASS)
+  {
+    _bleTask = NULL;
+    _bleInline = true;
+    Serial.println("BLE sender task not started, points are sent inline.");
+    return false;
+  }
+  return true;
+}
+
+/*
+  Point encoding for the bulk characteristic: BLE_FRAME_POINTS_F32 (default) or
+  BLE_FRAME_POINTS_S16, which fits a third more points per frame.
+*/
+void HELPStat::setBleFormat(uint8_t type) {
+  if(bleFramePointSize(type)) _bleFormat = type;
+}
+
+bleStats HELPStat::getBleStats(void) {
+  return _bleStats;
+}
+
 /*
   This function simply prints what the private variable settings are currently set to.
 */
@@ -43,6 +43,19 @@
 
 // Levenberg-Marquardt Functionality
 #include "lma.h"
+#include "cnls.h"
+#include "circuit.h"
+#include "kk.h"
+
+// Calibration table in NVS
+#include <Preferences.h>
+
+// Binary session log and the raw DFT record (shared with the host tools)
+#include "sessionlog.h"
+#include "pointqueue.h"
+
+// Binary BLE result frames (shared with the host tools)
+#include "bleframe.h"
 
 // BLE
 #include <BLEDevice.h>
@@ -56,6 +69,164 @@ extern "C" {
 }
 
 /*  
+    10/16/2026: Multisine acquisition of the sub-hertz band. With setMultisine(true) the sweep
+    points at or below maxFreq are grouped so each group's frequencies are distinct bins of one
+    periodic waveform. runSweep measures a group with AD5940_MultisineMeasure: the sequencer steps
+    the HSDAC (WG in MMR mode) through a Schroeder-phased sum of sines while SINC2 samples stream
+    into the FIFO, and every tone's bin is evaluated on the fly (Goertzel), one period per leg after
+    the waveform has settled. A decade of points takes a few periods of its lowest frequency instead
+    of one 8192-point DFT plus settling per point and leg. Points are reported at the tone
+    frequency (getPlanEntry().msFreq), which the plan rounds to a bin of the group; a group that
+    falls back to AD5940_DFTMeasure reports its points at their planned frequencies.
+
+    10/16/2026: Persistent RTIA calibration and calibrated single-leg measurement. calibrateRtia
+    measures the Rcal leg of every sweep point with each HSTIARTIA setting that keeps it in range;
+    calibrateFixture adds an open and a short measurement of the leads per point for open / short
+    compensation. saveCalibration / loadCalibration keep the table in NVS, so it survives a power
+    cycle. With setCalibration(true) AD5940_DFTMeasure takes a point's Rcal DFT from the table
+    instead of measuring it, one DFT per point instead of two; points the table does not cover
+    (another sweep, Rcal value, excitation or an RTIA that was not in range) measure both legs.
+
+    10/16/2026: Closed-loop autoranging. With setAutorange(true) AD5940_DFTMeasure checks both legs'
+    raw DFT magnitude against headroom limits (and, optionally, the ADC digital comparator for
+    clipping) after each point. A leg above AUTORANGE_HIGH of full scale, or an Rz leg below
+    AUTORANGE_LOW, gets the RTIA (and, past the ends of the RTIA range, a smaller excitation) that
+    puts it back in range, and only that point is measured again. The setting a point ended on is
+    kept per point (getRange, printData, the session log) and is where the same point starts in
+    the next cycle.
+
+    10/16/2026: Kramers-Kronig quality gate. With setKKTest(true) each finished cycle is checked
+    with a linear KK test (kk.h: fixed RC series, one linear least-squares solve) before the
+    online and per-cycle fits see it. Per-point residuals are kept next to the results
+    (getKKResidual, printData) and the verdict per cycle in getKKResult. A cycle that fails
+    (drift or a disturbance while it ran) is measured again straight away, up to maxRepeats
+    times, instead of being fitted, saved and sent like a good one. The repeat is logged and
+    streamed again with its attempt number (logPoint.attempt, format 2; the top bits of the BLE
+    frame flags, from the cycle's first point), so the phone and hsl2csv keep the last attempt.
+
+    10/16/2026: circuit.h describes equivalent circuits as types built from R, C, L, CPE and W
+    elements with Series<> / Parallel<>; each model evaluates Z(w) with its exact parameter
+    Jacobian, inlined and allocation-free, and fit_circuit<Model>() fits it with the fit_CNLS
+    Marquardt loop, so a new model needs no hand-written functor or numerical df().
+
+    10/16/2026: Per-cycle Rs / Rct fit. With setCycleFit(true) each cycle of a multi-cycle run is
+    fitted on its own (fit_Randles, starting from the previous cycle) by a worker task on the
+    other core (FIT_TASK_CORE), dispatched as soon as the cycle's last point is stored, while
+    the next cycle is measured. getCycleFit(n) returns cycle n's Rs / Rct with the time the
+    cycle finished, so drift between cycles is kept instead of averaged into one pooled fit.
+    calculateResistors() still fits all cycles together.
+
+    10/16/2026: Online Rs / Rct fit. Every stored point updates running sums of an algebraic
+    semicircle fit (randlesOnline in lma.h), so provisional Rct / Rs are known after each point
+    (getProvisionalFit; sent on the RCT / RS characteristics while streaming) and
+    calculateResistors() starts fit_Randles from them on the points collected during the run,
+    which takes one or two iterations instead of starting from _rct_estimate / _rs_estimate.
+    setOnlineFit(false) turns it off.
+
+    10/16/2026: fitCircuit(model) fits the complex impedance of the stored sweep with frequency
+    (CNLS, cnls.h): Rs + (Rct [+ Warburg sigma]) || Cdl or CPE (Q, n), modulus weighted, analytic
+    Jacobian, bounded, fixed-size workspace. It returns Rs, Rct, Cdl / Q, n and sigma with the
+    iteration count, cost and time; getCircuitFit() returns the last one.
+
+    10/16/2026: calculateResistors fits Rs and Rct jointly in one Levenberg-Marquardt run
+    (fit_Randles in lma.h: distance-from-semicircle residual, closed-form Jacobian, 2x2 normal
+    equations, no per-iteration allocation) instead of the calculate_Rct and calculate_Rs passes
+    with numerical Jacobians. getRandlesFit() reports iterations, final cost and status.
+
+    10/16/2026: BLE settings are event driven. Each settings characteristic has an onWrite handler
+    that parses the value once into a pending bleConfig; BLE_settings blocks on a task
+    notification until START is written (or the button is pressed) and then applies the whole
+    configuration in one go, instead of re-reading and re-parsing every characteristic every 3 ms.
+    The new CONFIG characteristic takes all settings in one CRC-checked write (bleframe.h) and
+    reads back the settings currently pending.
+
+    10/16/2026: Live BLE streaming. With setBleStreaming(true), runSweep / runSweepSeq hand every
+    finished point to a BLE sender task on the other core through a second point queue
+    (pointqueue.h, never blocks the measurement: a point that finds it full is picked up from
+    the result store instead). The task sends bulk frames of whatever has arrived at least every
+    BLE_STREAM_FLUSH_MS and updates SWEEPINDEX / CURRENTFREQ, so a long low-frequency sweep shows
+    up on the phone as it runs. When every point went out during the sweep, BLE_transmitResults
+    only sends Rct / Rs and the summary frame.
+
+    10/16/2026: Bulk BLE result transfer. BLE_transmitResults packs the sweep into binary frames
+    (bleframe.h: sequence number, point count, float32 or int16 x 2^exp fields, CRC-32) on one
+    characteristic (CHARACTERISTIC_UUID_BULK), as many points per notification as the negotiated
+    MTU allows. Each frame is sent once the previous notification completed (onStatus); a
+    congested link is retried after BLE_BULK_BACKOFF_MS instead of sleeping 100 ms per point.
+    Clients that have not subscribed to the bulk characteristic, or never raised the MTU above
+    the 23-byte default, still get the ASCII characteristics as before. getBleStats() reports frames, bytes, retries and time.
+
+    10/16/2026: The session log is written by a storage task pinned to the other core
+    (LOG_TASK_CORE). logResult pushes each finished point into a lock-free single-producer /
+    single-consumer queue (pointqueue.h) and the task writes the blocks, so a slow FAT update
+    no longer holds up the sweep. The SD card and the AD5940 share SCK / MOSI; every SD access
+    runs between AD5940_BusLock / AD5940_BusUnlock, which wait for the AD5940 frame in progress.
+    getStorageStats() reports queue depth, producer stalls and the worst SD access time. If the
+    task cannot be created the log is written inline as before.
+    flushSessionLog, closeStream and closeFit block on a task notification that the storage,
+    BLE sender or fit worker gives when it has caught up (waitWorker / workerDone), instead of
+    polling with vTaskDelay(1).
+
+    10/16/2026: Binary session log. With setSessionLog(true), runSweep / runSweepSeq write a
+    .hsl file (sessionlog.h) next to the CSV: a header with the configuration, gain table and
+    firmware version, then 28-byte point records in CRC-checked blocks of LOG_POINTS_PER_BLOCK
+    as each point completes, flushed every LOG_FLUSH_MS and at the end of each cycle. A run that
+    stops part-way keeps everything up to the last flush. Software/HostSim/tools/hsl2csv converts
+    logs to CSV. mountSD() replaces the SD.begin calls, so the card is only mounted once.
+
+    10/16/2026: Results are kept as 12-byte dftRecords (sweep point index + the four raw 18-bit
+    Rcal / Rz DFT values) instead of 24-byte impStructs. getResult() and the getMagnitude /
+    getPhaseRad / getReal / getImag accessors compute the impedance when asked, and
+    setResultRcal() re-decodes a finished sweep with a corrected Rcal value.
+
+    10/16/2026: Sweep results (eisArr and the per-point settle data) live in a store allocated
+    from PSRAM instead of fixed ARRAY_SIZE arrays. reserveResults() grows it to points x cycles
+    in AD5940_TDD / AD5940_BiasCfg and again in runSweep / runSweepSeq, which refuse to start
+    if the run does not fit. Every write is bounds checked, so nothing past the store is ever
+    touched.
+
+    10/16/2026: AD5940_Main reads the sequencer's DFT words through the streaming FIFO reader in
+    Impedance.c (AppIMPStreamISR). The interrupt side drains the FIFO into ping-pong buffers
+    while the consumer (showStreamResults) prints the other one; overruns and FIFO overflows
+    are counted and reported instead of being truncated, and any FIFO threshold works.
+
+    10/16/2026: ad5940.c sends each SPI frame as one AD5940_ReadWriteBurst call, which the
+    ESP32 port runs as a DMA transaction on SPI3 with hardware chip-select; FIFO reads go out
+    in 64-word bursts. AD5940_SPIRelease() hands the shared SCK / MOSI pins back to the SD
+    card before SD.begin. spiBenchmark() times register reads / writes and FIFO drains.
+
+    10/16/2026: Register shadow in ad5940.c (AD5940_ShadowCtrl, enabled in AD5940Start). Reads of
+    AFE configuration registers come from RAM and unchanged writes are dropped, so the AFECTRL /
+    switch toggles in AD5940_DFTMeasure cost far less SPI. runSweep prints the avoided accesses.
+
+    10/16/2026: Sweep plan. AD5940_TDD compiles every point of the sweep once (frequency, WG
+    frequency word, RTIA, HP mode, filter / DFT settings, wait clocks) into _plan, and logSweep /
+    configureFrequency just apply the entry instead of redoing pow/log10, the gain table scan,
+    AD5940_GetFreqParameters and AD5940_ClksCalculate at every point. printSweepPlan() dumps it.
+
+    10/16/2026: Rcal calibration cache. The Rcal leg of AD5940_DFTMeasure is only measured when
+    there is no cached Rcal DFT for the same frequency, RTIA, excitation gain and DAC gain, so
+    after the first cycle of runSweep only the Rz leg runs. Entries are re-measured every
+    RCAL_REFRESH_CYCLES cycles; if a re-measurement moved more than RCAL_DRIFT_PCT the whole
+    cache is dropped. Hit/miss counts are printed after the sweep (getRcalCacheStats).
+
+    10/16/2026: Adaptive settling replaces the fixed settlingDelay() in AD5940_DFTMeasure. Each
+    leg waits a few periods (or a few cell time constants estimated from the previous point),
+    then takes short DFTs until two in a row agree, capped per frequency band. Settle time and
+    status are printed with each point and kept per point (getSettle). setAdaptiveSettling(false)
+    brings back the old delays.
+
+    10/16/2026: pollDFT blocks on the AD5940 interrupt (AD5940_WaitMCUIntFlag) with a timeout
+    sized from _waitClcks instead of polling every second. Removed the empirical delay(200) /
+    delay(300) around reading DFT results. getWaitStats() reports how long each wait took and
+    the interrupt-to-wakeup latency. A timed-out point is stored flagged DFTREC_FAILED instead of
+    DFTREC_VALID and is left out of the session log, the fits and the BLE stream.
+
+    10/16/2026: Added runSweepSeq(), a drop-in for runSweep() that compiles the Rcal and Rz
+    legs into one AD5940 sequence. Settling and DFT waits are SEQ_WAITs on the AFE and both
+    DFT results go through the data FIFO, so the ESP32 only retunes the frequency and reads
+    four words per point.
+
     07/01/2024: Added transmission of phase and magnitude
 
     06/19/2024: Started adjusting HELPStat::AD5940_DFTMeasure() to transmit index (of measurement), 
@@ -176,11 +347,96 @@ extern "C" {
 
 #define SYSCLCK 16000000.0  // System Clock frequency (16 MHz)
 #define APPBUFF_SIZE 512    // Buffer for impedance, probs don't need this
+#define IMPSTREAM_NUM_BUFF 2  // FIFO stream buffers for AD5940_Main (APPBUFF_SIZE words each)
 
-/* CHANGE ARRAY SIZE TO ACCOMODATE DESIRED NUM OF POINTS */
+/* CHANGE ARRAY SIZE TO ACCOMODATE DESIRED NUM OF POINTS (per sweep; results are in the PSRAM store) */
 #define ARRAY_SIZE 200      // Constant for array size of data
 #define NOISE_ARRAY 7200
 
+/* Adaptive settling (AD5940_DFTMeasure) */
+#define SETTLE_MIN_CYCLES 3      // Minimum wait before the first check, in excitation periods...
+#define SETTLE_TAU_MULT   5      // ...or in cell time constants, whichever is longer
+#define SETTLE_TOL        0.002  // Successive short DFTs must agree within 0.2 %
+
+#define SETTLE_CONVERGED  0      // Short DFTs agreed
+#define SETTLE_UNCHECKED  1      // DFT too long to check, minimum wait only
+#define SETTLE_CAPPED     2      // Hit the band cap before agreeing
+
+/* Rcal calibration cache (AD5940_DFTMeasure) */
+#define RCAL_CACHE_SIZE     ARRAY_SIZE  // One entry per sweep point
+#define RCAL_REFRESH_CYCLES 10          // Re-measure Rcal every n cycles (0 = never)
+#define RCAL_DRIFT_PCT      0.5         // Drop the cache if a re-measured Rcal moved more than this
+
+/* SPI transport benchmark (spiBenchmark) */
+#define SPI_BENCH_FIFO_WORDS 256   // Largest FIFO drain timed per call
+
+// Binary session log (sessionlog.h)
+#define HELPSTAT_FW_VERSION  "2.0"
+#define LOG_POINTS_PER_BLOCK 16      // Point records per CRC block
+#define LOG_FLUSH_MS         2000    // Longest a written block waits before the card is flushed
+#define LOG_QUEUE_DEPTH      64      // Points in flight to the storage task, power of two
+#define LOG_TASK_CORE        0       // Storage task core (Arduino loop() runs on 1)
+#define LOG_TASK_STACK       4096
+#define LOG_TASK_PRIO        1
+
+// Bulk BLE result transfer (bleframe.h)
+#define BLE_MTU             517   // ATT MTU requested in BLE_setup; frames fill MTU - 3
+#define BLE_BULK_RETRIES    50    // Attempts per frame while the link reports congestion
+#define BLE_BULK_BACKOFF_MS 5     // Wait before retrying a congested frame
+#define BLE_QUEUE_DEPTH     64    // Points in flight to the BLE sender task, power of two
+#define BLE_STREAM_FLUSH_MS 250   // Longest a streamed point waits for others to share its frame
+#define BLE_TASK_CORE       0     // BLE sender task core (Arduino loop() runs on 1)
+#define BLE_TASK_STACK      4096
+#define BLE_TASK_PRIO       1
+
+// Per-cycle Rs / Rct fit (setCycleFit)
+#define FIT_TASK_CORE       0     // Fit worker task core (Arduino loop() runs on 1)
+#define FIT_TASK_STACK      4096
+#define FIT_TASK_PRIO       1
+
+// Kramers-Kronig check of each cycle (setKKTest, kk.h)
+#define KK_MAX_REPEATS      2     // Times a cycle that fails is measured again before its result is kept
+
+// Closed-loop RTIA / excitation autoranging (setAutorange, AD5940_DFTMeasure)
+#define AUTORANGE_DFT_FS    131071  // Raw DFT full scale (18-bit two's complement)
+#define AUTORANGE_HIGH      0.9f  // Measure again with less gain when a leg is above this fraction of full scale...
+#define AUTORANGE_LOW       0.1f  // ...or with more when the Rz leg is below this one
+#define AUTORANGE_MAX_STEPS 3     // Extra measurements of one point at most
+#define AUTORANGE_ADC_MID   32768 // ADC code at 0 V; the comparator limits sit AUTORANGE_HIGH of full scale either side
+
+#define RANGE_NONE        0      // Not measured by AD5940_DFTMeasure
+#define RANGE_FIXED       1      // Autoranging off, gain table setting
+#define RANGE_OK          2      // Both legs within the headroom limits
+#define RANGE_HIGH        3      // Still above the high limit (no smaller gain left, or out of steps)
+#define RANGE_LOW         4      // Still below the low limit (no larger gain left, or out of steps)
+
+// Persistent RTIA calibration and single-leg measurement (calibrateRtia, setCalibration)
+#define CAL_MAX_POINTS      100   // Sweep points the table covers; the whole table has to fit the NVS partition
+#define CAL_RTIA_COUNT      8     // HSTIARTIA_200 .. HSTIARTIA_160K
+#define CAL_VERSION         1     // Layout of calTableStruct; a stored table with another version is ignored
+#define CAL_NVS_NAMESPACE   "helpstat"
+#define CAL_NVS_KEY         "rtiacal"
+#define CAL_RANGE_LOW       0.0005f // An RTIA is kept for a point when its Rcal leg is above this fraction of
+                                  // AUTORANGE_DFT_FS and below AUTORANGE_HIGH
+
+#define CAL_FIXTURE_OPEN    0x01  // calPointStruct.fixtures: leads open...
+#define CAL_FIXTURE_SHORT   0x02  // ...and shorted were measured
+
+// Multisine acquisition of the low-frequency points (setMultisine, AD5940_MultisineMeasure)
+#define MSINE_MAX_FREQ      1.0f  // Default: points at or below this frequency (Hz) are measured as multisines
+#define MSINE_STEPS         100   // HSDACDAT steps per waveform period; tones sit below bin MSINE_STEPS / 2
+#define MSINE_CYCLES        4     // Lowest bin of a group (periods of its lowest tone per waveform period)
+#define MSINE_RCAL_STEPS    10    // Steps the Rcal leg runs before recording (the Rz leg runs a whole period)
+#define MSINE_PEAK_MAX      0x600 // Largest HSDACDAT excursion from mid-scale (valid codes are 0x200..0xE00)
+#define MSINE_SAMPLE_CLKS   (20*4*1333)  // System clocks per SINC2 sample: 800 kHz ADC, SINC3 4, SINC2 1333
+#define MSINE_SEQ_SIZE      (4*MSINE_STEPS+8)  // Sequence: settling and recorded period, ADC / FIFO writes
+#define MSINE_FIFO_CHUNK    64    // FIFO words read at a time, and the FIFO threshold interrupt that wakes a leg
+
+/* Sequencer sweep (runSweepSeq) */
+#define SEQ_BUFF_SIZE     128   // Sequence generator buffer (commands + register records)
+#define SEQ_SETTLE_CYCLES 2.0   // Hardware settling wait per leg, in excitation periods...
+#define SEQ_SETTLE_MS     10.0  // ...plus a constant (ms)
+
 /* Default LPDAC resolution(2.5V internal reference). */
 #define DAC12BITVOLT_1LSB   (2200.0f/4095)  //mV
 #define DAC6BITVOLT_1LSB    (DAC12BITVOLT_1LSB*64)  //mV
@@ -211,6 +467,10 @@ extern "C" {
 #define CHARACTERISTIC_UUID_IMAG        "e080f979-bb39-4151-8082-755e3ae6f055"
 #define CHARACTERISTIC_UUID_PHASE       "6a5a437f-4e3c-4a57-bf99-c4859f6ac411"
 #define CHARACTERISTIC_UUID_MAGNITUDE   "06192c1e-8588-4808-91b8-c4f1d650893d"
+#define CHARACTERISTIC_UUID_BULK        "c7a3e5b1-2f48-4d96-9a0e-6b1d53f8e247" // Binary result frames (bleframe.h)
+#define CHARACTERISTIC_UUID_CONFIG      "3e0f6a2c-9d71-4b58-8c24-f15b7a9e0d36" // Full configuration (bleConfig in bleframe.h)
+
+#define BLE_BUTTON_POLL_MS 20   // BLE_settings checks the start button this often while waiting for START
 
 typedef struct _impStruct {
     float freq;
@@ -221,12 +481,163 @@ typedef struct _impStruct {
     float phaseDeg; 
 }impStruct;
 
+typedef struct _storageStats {
+    uint32_t queued;        // Points handed to the storage task
+    uint32_t maxDepth;      // Deepest the point queue got
+    uint32_t stalls;        // Points that found the queue full
+    unsigned long stallUs;  // Measurement time spent waiting for room
+    uint32_t blocks;        // Blocks written
+    unsigned long maxWriteUs;   // Worst SD access (block write or flush), including the bus wait
+    unsigned long busWaitUs;    // Time the storage side waited for an AD5940 frame to finish
+    bool background;        // Storage task running on LOG_TASK_CORE (false: written inline)
+}storageStats;
+
+typedef struct _cycleFit {
+    uint32_t cycle;
+    unsigned long timeMs;   // millis() when the cycle's last point was stored
+    float rct;
+    float rs;
+    int iterations;
+    int status;             // LM_* (lma.h), LM_NOT_STARTED if the cycle had too few points
+    unsigned long fitUs;    // Time spent in fit_Randles
+    bool background;        // Fitted by the worker task on FIT_TASK_CORE (false: inline)
+    bool converged() const { return status == LM_RELATIVE_REDUCTION_SMALL || status == LM_RELATIVE_ERROR_SMALL ||
+                                    status == LM_GTOL_SMALL; }
+}cycleFit;
+
+typedef struct _kkCycle {
+    kkResult kk;            // Verdict on the attempt that was kept
+    uint8_t attempts;       // Times the cycle was measured (0: not tested)
+}kkCycle;
+
+typedef struct _kkResidual {
+    float re;               // (Zmeas - Zkk) / |Zmeas|, real part
+    float im;               // ...and -imaginary, like impStruct.imag
+}kkResidual;
+
+typedef struct _rangeStruct {
+    uint8_t rTIA;           // HSTIARTIA_xxx the kept measurement used
+    uint8_t extGain;        // EXCITBUFGAIN_xxx
+    uint8_t dacGain;        // HSDACGAIN_xxx
+    uint8_t status;         // RANGE_*
+    uint8_t remeasures;     // Extra measurements autoranging took
+    bool clipped;           // ADC comparator tripped on the kept measurement
+    float headroom;         // Larger leg |DFT| as a fraction of AUTORANGE_DFT_FS
+}rangeStruct;
+
+typedef struct _bleStats {
+    uint16_t mtu;           // ATT MTU of the last transfer
+    uint32_t frames;        // Frames sent (including the summary)
+    uint32_t points;
+    uint32_t bytes;
+    uint32_t retries;       // Notifications that failed and were sent again
+    unsigned long timeMs;   // Duration of the last transfer
+    bool complete;          // Last transfer got every frame out
+    bool streamed;          // Points went out during the sweep (setBleStreaming)
+    bool background;        // Streamed from the BLE sender task (false: inline)
+    uint32_t requeued;      // Streamed points that found the queue full and were sent from the store
+    unsigned long maxLatencyMs; // Worst point completion to notification while streaming
+    uint32_t resent;        // Streamed points sent again for a cycle measured again (KK test)
+}bleStats;
+
 typedef struct _calHSTIA
 {
     float freq; 
     int rTIA; 
 }calHSTIA; 
 
+typedef struct _settleStruct {
+    float settleMs;     // Settling time for the point (Rcal + Rz legs)
+    uint16_t checks;    // Short DFTs taken
+    uint8_t status;     // Worst leg: SETTLE_CONVERGED, SETTLE_UNCHECKED or SETTLE_CAPPED
+}settleStruct;
+
+typedef struct _planStruct {
+    float freq;
+    uint32_t wgFcw;      // WGFCW word
+    int rTIA;            // HSTIARTIA_xxx, -1 if the gain table has no entry for freq
+    uint8_t hpMode;      // >= 80 kHz: high power mode, 1.6 MHz ADC, faster HSDAC update
+    uint8_t sinc3Osr;
+    uint8_t sinc2Osr;
+    uint8_t dftNum;
+    uint8_t dftSrc;
+    uint32_t waitClcks;  // DFT duration in system clocks
+    uint8_t msGroup;     // Multisine group (setMultisine), 1 = lowest frequencies; 0 = measured with its own DFT
+    uint16_t msBin;      // Tone bin in the group's waveform period
+    uint16_t msStep;     // SINC2 samples per HSDACDAT step of the group
+    float msFreq;        // Tone frequency the point is measured and reported at
+}planStruct;
+
+typedef struct _rcalCacheStruct {
+    float freq;         // Key: frequency, RTIA, excitation gain, DAC gain
+    int rTIA;
+    int extGain;
+    int dacGain;
+    int32_t real;       // Rcal DFT
+    int32_t image;
+    uint32_t cycle;     // Cycle it was measured in
+    bool valid;
+}rcalCacheStruct;
+
+typedef struct _rcalCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t refreshes;  // Misses because the entry was older than the refresh interval
+    uint32_t drifts;     // Refreshes that moved more than the drift threshold
+}rcalCacheStats;
+
+typedef struct _calPointStruct {
+    float freq;
+    int32_t rcal[CAL_RTIA_COUNT][2];  // Rcal leg DFT (real, image) with each HSTIARTIA setting
+    fImpCar_Type zShort;    // Impedance of the shorted leads (ohms)
+    fImpCar_Type yOpen;     // Admittance of the open leads (siemens)
+    uint8_t rtiaMask;       // Bit r set: rcal[r] was in range
+    uint8_t fixtures;       // CAL_FIXTURE_* measured
+}calPointStruct;
+
+typedef struct _calTableStruct {
+    uint16_t version;       // CAL_VERSION
+    uint16_t points;        // Sweep points in point[], 0 = no table
+    float startFreq;        // Sweep the table was taken on...
+    float endFreq;
+    float rcalVal;          // ...with this Rcal...
+    uint8_t extGain;        // ...and excitation
+    uint8_t dacGain;
+    calPointStruct point[CAL_MAX_POINTS];
+}calTableStruct;
+
+typedef struct _calStats {
+    uint32_t singleLeg;     // Points measured with the Rcal leg from the table
+    uint32_t twoLeg;        // Points setCalibration wanted single-leg but the table did not cover
+    uint32_t compensated;   // Points corrected with open / short data
+}calStats;
+
+typedef struct _msineStats {
+    uint32_t acquisitions;  // Multisine groups measured
+    uint32_t points;        // Points they covered
+    uint32_t samples;       // SINC2 samples evaluated (both legs, remeasures included)
+    uint32_t remeasures;    // Groups measured again with another RTIA
+    uint32_t failures;      // Groups that timed out and were measured point by point instead
+    uint32_t fifoWaits;     // FIFO threshold / end-of-sequence interrupts the legs slept on
+}msineStats;
+
+typedef struct _waitStats {
+    uint32_t count;          // Waits on the AD5940 interrupt
+    uint32_t timeouts; 
+    uint32_t lastWaitUs;     // Time spent blocked in the last wait
+    uint32_t maxWaitUs;
+    uint64_t totalWaitUs;
+    uint32_t lastLatencyUs;  // Interrupt to task wakeup in the last wait
+    uint32_t maxLatencyUs;
+}waitStats;
+
+typedef struct _spiBenchStruct {
+    float regReadUs;     // Average time per 32-bit register read
+    float regWriteUs;    // Average time per 32-bit register write
+    float fifoWordUs;    // Average time per FIFO word in a drain
+    float fifoMBs;       // FIFO drain throughput (MB/s)
+}spiBenchStruct;
+
 typedef struct _adcStruct {
     unsigned long interval;
     uint32_t idx; 
@@ -239,18 +650,32 @@ typedef struct _adcStruct {
 class HELPStat {
     private:
         class MyServerCallbacks: public BLEServerCallbacks { // BLE Callback (just says "Device Connected" or "Device Disconnected")
-            void onConnect(BLEServer* pServer) {
-                bool deviceConnected = true;
+            void onConnect(BLEServer* /* pServer */) {
                 Serial.println("Device Connected");
             };
 
             void onDisconnect(BLEServer* pServer) {
-                bool deviceConnected = false;
                 pServer->startAdvertising();
                 Serial.println("Device Disconnected");
             };
         };
 
+        class BulkCallbacks: public BLECharacteristicCallbacks { // Completion of the last bulk frame notification
+            public:
+                volatile int status = -1;
+                void onStatus(BLECharacteristic* /* pCharacteristic */, Status s, uint32_t /* code */) {
+                    status = s;
+                };
+        };
+
+        class ConfigCallbacks: public BLECharacteristicCallbacks { // Settings, CONFIG and START writes
+            public:
+                HELPStat* owner = NULL;
+                void onWrite(BLECharacteristic* pCharacteristic) {
+                    owner->bleConfigWrite(pCharacteristic);
+                };
+        };
+
         uint32_t _waitClcks; // clock cycles to wait for
         SoftSweepCfg_Type _sweepCfg;
         float _currentFreq; 
@@ -262,8 +687,19 @@ class HELPStat {
         float _rct_estimate = 150000; // Initialize w/ default values 
         float _rs_estimate  = 150;
 
-        // Array for EIS data
-        impStruct eisArr[ARRAY_SIZE];
+        // EIS results as raw DFT records, index = point + cycle * points. Grown in PSRAM by reserveResults
+        dftRecord *eisArr = NULL;
+        float _resultRcal = 1000;     // Rcal the records are decoded with (setResultRcal)
+
+        // Adaptive settling, per point in the same layout as eisArr
+        settleStruct *_settleArr = NULL;
+        kkResidual *_kkArr = NULL;    // Per-point Kramers-Kronig residuals
+        rangeStruct *_rangeArr = NULL;  // Per-point RTIA / excitation setting
+        uint32_t _resultCap = 0;      // Points eisArr / _settleArr can hold
+        bool resultSlot(uint32_t *pIndex);
+        void storeRecord(uint32_t index, const int32_t *pDft, uint8_t flags);
+        impStruct _prevEis = {}; // Previous point, for the cell time constant estimate
+        bool _adaptiveSettle = true;
 
         // Keeping track of cycles 
         uint32_t _numCycles = 0; // Initialize w/ default values  
@@ -277,6 +713,7 @@ class HELPStat {
 
         int _extGain = 1; // Initialize w/ default values 
         int _dacGain = 1;
+        int _currentRtia = 0; // RTIA picked by setHSTIA for _currentFreq
 
         // Bias voltage for LPDAC 
         float _biasVolt = 0.0;  // Initialize w/ default values  
@@ -291,10 +728,131 @@ class HELPStat {
         // Calculated Rct/Rs
         float _calculated_Rct;
         float _calculated_Rs;     
+        randlesFit _fit = {0, 0, 0, 0, 0, 0, LM_NOT_STARTED};
+        cnlsFit _circuitFit = {{0, 0, 0, 0, 0}, 0, 0, 0, 0, 0, LM_NOT_STARTED, 0};
+
+        // Online Rs / Rct fit, fed as points are stored
+        bool _onlineFit = true;
+        bool _fitOpen = false;        // Run in progress, taking points
+        uint32_t _fitTotal = 0;       // Points in the run
+        randlesOnline _online;
+        std::vector<float> _fitRe;    // Every point of the run, in storage order, for the final fit
+        std::vector<float> _fitIm;
+        volatile float _provRct = 0;  // Provisional values (read by the BLE sender task)
+        volatile float _provRs = 0;
+        volatile bool _provValid = false;
+        void openFit(void);
+        void fitResult(uint32_t index);
+        bool onlineFitReady(void);
+        void applyRandlesFit(void);
+        cnlsWorkspace _cnlsWork;      // fitCircuit scratch, kept here so the fit does not allocate
+
+        // Per-cycle fit, handed to a worker task on the other core as each cycle finishes
+        bool _cycleFitMode = false;
+        bool _cycleFitOpen = false;   // Run in progress, dispatching cycles
+        std::vector<cycleFit> _cycleFits;  // One per cycle, sized when the run opens
+        std::vector<float> _cycleRe;  // Worker scratch, one cycle of points
+        std::vector<float> _cycleIm;
+        uint32_t _cycleReq = 0;       // Cycles finished by the measurement...
+        uint32_t _cycleDone = 0;      // ...and fitted by the worker
+        TaskHandle_t _fitTask = NULL;
+        bool _fitInline = false;      // Task could not be started, fit from the measurement thread
+        void cycleFinished(uint32_t cycle);
+        void closeFit(void);
+        void fitCycle(uint32_t cycle);
+        void cycleFitService(void);
+        bool startFitTask(void);
+        static void fitTask(void *pArg);
+        TaskHandle_t _workerWaiter = NULL;  // Task blocked in waitWorker
+        void waitWorker(uint32_t *pDone, uint32_t req);
+        void workerDone(uint32_t *pDone, uint32_t done);
+
+        // Kramers-Kronig check of each finished cycle, before anything is fitted from it
+        bool _kkTest = false;
+        float _kkMaxResidual = KK_MAX_RESIDUAL;
+        uint8_t _kkMaxRepeats = KK_MAX_REPEATS;
+        std::vector<kkCycle> _kkCycles;  // One per cycle, sized when the run opens
+        uint8_t _kkAttempt = 0;       // Repeats of the cycle being measured
+        bool _kkRepeat = false;       // The cycle just measured failed and is to be measured again
+        uint32_t _fitCycleStart = 0;  // Online fit points before the current cycle (a repeat drops the rest)
+        bool kkCheckCycle(uint32_t cycle);
+        bool repeatCycle(void);
+
+        // Run bookkeeping shared by runSweep / runSweepSeq
+        unsigned long _cycleStartMs = 0;
+        bool beginRun(uint32_t numCycles);
+        bool beginCycle(uint32_t cycle, uint32_t delaySecs);
+        uint32_t endCycle(uint32_t cycle);
+        void endRun(void);
+
+        // Closed-loop autoranging of each AD5940_DFTMeasure point
+        bool _autorange = false;
+        bool _rangeComparator = false;  // Also watch the ADC digital comparator
+        float _rangeHigh = AUTORANGE_HIGH;
+        float _rangeLow = AUTORANGE_LOW;
+        uint8_t _rangeStart[ARRAY_SIZE] = {};  // Setting each sweep point ended on (logRangePack), 0 = none yet
+        void applyRange(int rTIA, int extGain, int dacGain);
+        bool autorangeStep(const int32_t *pDft, bool clipRcal, bool clipRz, int extGain, int dacGain,
+                           rangeStruct *pRange);
+        bool acquirePoint(int32_t *pDft, settleStruct *pSettle, rangeStruct *pRange, bool *pRcalCal);
+        bool measureRcalLeg(settleStruct *pSettle, int32_t *pReal, int32_t *pImage, bool *pClip);
+        static bool dftUsable(const int32_t *pDft);
+        void storeFailedPoint(void);
+        bool resultValid(uint32_t index);
+
+        // Persistent RTIA calibration (NVS) and calibrated single-leg measurement
+        calTableStruct _cal = {};
+        bool _singleLeg = false;      // Take the Rcal leg from _cal
+        bool _openShort = false;      // Apply the open / short compensation in _cal
+        calStats _calStats = {};
+        bool calValid(void);
+        bool calLookup(int32_t *pReal, int32_t *pImage);
+        bool calCompensate(int32_t *pDft);
+        void calSetPoint(uint32_t index);
+
+        // Multisine acquisition of the low-frequency points
+        bool _msine = false;
+        float _msineMaxFreq = MSINE_MAX_FREQ;
+        msineStats _msineStats = {};
+        uint32_t _msineSeq[MSINE_SEQ_SIZE];
+        void planMultisine(void);
+        bool msinePoint(uint32_t index);
+        bool msineLeg(uint32_t seqId, uint32_t settleSteps, uint32_t step, const uint16_t *pBins, uint32_t tones,
+                      double *pRe, double *pIm, float *pPeak);
 
         // Noise array
         adcStruct _noiseArr[NOISE_ARRAY];
 
+        // Streaming FIFO reader for AD5940_Main (AppIMPStreamISR)
+        IMPStream_Type _impStream;
+        uint32_t _impStreamMem[IMPSTREAM_NUM_BUFF * APPBUFF_SIZE];
+
+        // Interrupt wait timing (pollDFT / AD5940_SeqDFTMeasure)
+        waitStats _waitStats = {};
+        bool waitForInt(uint32_t timeoutMs);
+
+        // Sweep plan, one entry per point (compileSweepPlan)
+        planStruct _plan[ARRAY_SIZE];
+        uint32_t _planSize = 0;
+        float _planStop = 0;
+        bool sweepPlanValid(void);
+        bool sweepPlanMatches(void);
+        void applySweepPlan(uint32_t index);
+
+        // Rcal calibration cache, indexed by sweep point
+        rcalCacheStruct _rcalCache[RCAL_CACHE_SIZE];
+        rcalCacheStats _rcalStats = {};
+        bool _rcalCacheEn = true;
+        uint32_t _rcalRefreshCycles = RCAL_REFRESH_CYCLES;
+        float _rcalDriftPct = RCAL_DRIFT_PCT;
+        bool rcalCacheLookup(int32_t *pReal, int32_t *pImage);
+        void rcalCacheStore(int32_t real, int32_t image);
+
+        // Sequencer sweep - SRAM addresses of the SEQ_WAIT pairs patched per frequency
+        uint32_t _seqBuff[SEQ_BUFF_SIZE];
+        uint32_t _seqSettleAddr[2]; // [0] = Rcal leg, [1] = Rz leg
+        uint32_t _seqDftAddr[2];
+
         // Bluetooth Characteristics
         BLEServer* pServer = NULL;
         BLECharacteristic* pCharacteristicStart       = NULL;
@@ -318,15 +876,95 @@ class HELPStat {
         BLECharacteristic* pCharacteristicImag        = NULL;
         BLECharacteristic* pCharacteristicPhase       = NULL;
         BLECharacteristic* pCharacteristicMagnitude   = NULL;
+        BLECharacteristic* pCharacteristicBulk        = NULL;
+        BLECharacteristic* pCharacteristicConfig      = NULL;
+
+        // Settings written over BLE, applied by BLE_settings
+        ConfigCallbacks _configCallbacks;
+        bleConfig _bleCfg;            // Pending configuration, written from the BLE stack's task
+        portMUX_TYPE _bleCfgMux = portMUX_INITIALIZER_UNLOCKED;
+        uint32_t _startReq = 0;       // START writes so far...
+        uint32_t _startDone = 0;      // ...and how many BLE_settings has consumed
+        TaskHandle_t _settingsTask = NULL;    // Task blocked in BLE_settings
+        void bleConfigWrite(BLECharacteristic* pCharacteristic);
+        void bleConfigPublish(void);
+
+        // Bulk result transfer
+        BLE2902* _bulkCccd = NULL;    // Client subscribed to the bulk characteristic
+        BulkCallbacks _bulkCallbacks;
+        uint8_t _bleFormat = BLE_FRAME_POINTS_F32;
+        uint8_t _bleFrame[BLE_MTU - 3];
+        bleStats _bleStats = {};
+        uint16_t _bleSeq = 0;         // Next frame number of the transfer
+        blePoint _blePoints[BLE_FRAME_MAX_COUNT];
+        bool bleSendFrame(size_t len);
+        bool bleSendPoints(uint32_t first, uint32_t count, size_t frameMax, uint8_t attempt);
+        bool bleSendSummary(size_t frameMax);
+        size_t bleFrameMax(void);
+        bool BLE_transmitBulk(size_t frameMax);
+
+        // Live streaming to the BLE sender task (other core)
+        bool _bleStream = false;      // Stream points during runSweep / runSweepSeq
+        bool _streamActive = false;   // Stream open and taking points
+        bool _streamFrames = false;   // Client takes bulk frames (else progress characteristics only)
+        bool _streamDone = false;     // Every point of the last run went out as frames
+        bool _streamEnd = false;      // Run finished, send up to _streamTotal on the next flush
+        size_t _streamFrameMax = 0;
+        uint32_t _streamTotal = 0;    // Points in the run
+        uint32_t _streamNext = 0;     // Next index to send
+        uint32_t _streamCount = 0;    // Points waiting for a frame...
+        unsigned long _streamTime = 0;    // ...and when the oldest of them completed
+        uint8_t _streamAttempt = 0;   // KK attempt of the cycle being sent
+        std::vector<bool> _streamSent;    // Indices streamed at least once (bleStats.resent)
+        uint32_t _streamFlushReq = 0;
+        uint32_t _streamFlushDone = 0;
+        pointQueue _bleQueue = {};
+        logPoint _bleQueueMem[BLE_QUEUE_DEPTH];
+        TaskHandle_t _bleTask = NULL;
+        bool _bleInline = false;      // Task could not be started, send from the measurement thread
+        void openStream(void);
+        void streamResult(uint32_t index);
+        void streamService(void);
+        void streamSend(uint32_t count);
+        void streamRewind(uint32_t first, uint8_t attempt);
+        void closeStream(void);
+        bool startBleTask(void);
+        static void bleTask(void *pArg);
 
         // bool deviceConnected = false;
-        bool start_value     = false;
-        bool old_start_value = false;
 
         // File and FolderNames
         String _folderName = "folder-name-here"; 
         String _fileName = "file-name-here"; 
 
+        // SD card and binary session log
+        bool _sdMounted = false;
+        bool _sessionLog = false;     // Write a .hsl log during runSweep / runSweepSeq
+        File _logFile;
+        logPoint _logBuf[LOG_POINTS_PER_BLOCK];
+        uint32_t _logCount = 0;       // Records waiting in _logBuf
+        uint32_t _logSeq = 0;         // Next block number
+        uint32_t _logPoints = 0;      // Records written this session
+        unsigned long _logFlushTime = 0;
+        bool _logDirty = false;       // Blocks written since the last flush
+        bool writeLogBlock(uint16_t type, uint16_t count, const void *pPayload, uint32_t length);
+        void flushCard(void);
+        void logResult(uint32_t index);
+
+        // Storage task (other core), fed through a single-producer / single-consumer point queue
+        pointQueue _logQueue = {};
+        logPoint _logQueueMem[LOG_QUEUE_DEPTH];
+        bool _logActive = false;      // Session log open and taking points
+        uint32_t _logFlushReq = 0;    // flushSessionLog requests...
+        uint32_t _logFlushDone = 0;   // ...and the last one the storage side finished
+        TaskHandle_t _storageTask = NULL;
+        bool _storageInline = false;  // Task could not be started, log from the measurement thread
+        storageStats _storageStats = {};
+        bool startStorageTask(void);
+        void storageService(void);
+        void storageTime(unsigned long timeStart, unsigned long timeLocked);
+        static void storageTask(void *pArg);
+
     public:
         HELPStat();
         AD5940Err AD5940Start(void); 
@@ -335,6 +973,7 @@ class HELPStat {
         int32_t AD5940PlatformCfg(void);
         void AD5940ImpedanceStructInit(float startFreq, float endFreq, uint32_t numPoints);
         int32_t ImpedanceShowResult(uint32_t *pData, uint32_t DataCount);
+        uint32_t showStreamResults(IMPStream_Type *pStream);
         void DFTPolling_Main(void);
         void AD5940_Main(float startFreq, float endFreq, uint32_t numPoints, uint32_t gainArrSize, calHSTIA* gainArr);
 
@@ -344,8 +983,10 @@ class HELPStat {
         void AD5940_TDD(float startFreq, float endFreq, uint32_t numPoints, float biasVolt, float zeroVolt, float rcalVal, calHSTIA *gainArr, int gainArrSize, int extGain, int dacGain); // works
         
         void AD5940_DFTMeasure(void); // works
-        void pollDFT(int32_t* pReal, int32_t* pImage); // works
+        bool pollDFT(int32_t* pReal, int32_t* pImage); // False (and zeros) on timeout
         void getDFT(int32_t* pReal, int32_t* pImage); // works
+        waitStats getWaitStats(void);
+        void clearWaitStats(void);
 
         /* Helper Functions */
         void getMagPhase(int32_t real, int32_t image, float* pMag, float* pPhase); // works 
@@ -353,9 +994,44 @@ class HELPStat {
         void runSweep(void);
         void runSweep(uint32_t numCycles, uint32_t delaySecs); // sweep works now and cycles correctly 
         void resetSweep(SoftSweepCfg_Type *pSweepCfg, float *pNextFreq); // works
+
+        /* Sequencer-driven sweep. Same setup (AD5940_TDD) and results (eisArr) as runSweep */
+        AD5940Err AD5940_SeqSweepInit(void);
+        AD5940Err AD5940_SeqDFTMeasure(void);
+        void runSweepSeq(void);
+        void runSweepSeq(uint32_t numCycles, uint32_t delaySecs);
+
+        /* Result store (PSRAM), grown to points x cycles before a run */
+        bool reserveResults(uint32_t numPoints, uint32_t numCycles);
+        uint32_t getResultCapacity(void);
+
+        /* Read-only access to sweep results (index = point + cycle * points) */
+        uint32_t getSweepPoints(void);
+        impStruct getResult(uint32_t index);
+        float getMagnitude(uint32_t index);
+        float getPhaseRad(uint32_t index);
+        float getReal(uint32_t index);
+        float getImag(uint32_t index);
+        dftRecord getRecord(uint32_t index);
+        void setResultRcal(float rcalVal);
+        float sweepFreq(uint32_t pointIdx, uint8_t flags = 0);
+
+        /* Raw DFT record packing (4 x 18 bits) and decoding */
+        void packRecord(dftRecord *pRec, uint16_t freqIdx, const int32_t *pDft, uint8_t flags);
+        void unpackRecord(const dftRecord *pRec, int32_t *pDft);
+        impStruct decodeRecord(const dftRecord *pRec, float rcalVal);
         
         /* Both these functions need better optimization but they work for now */
         void settlingDelay(float freq);
+        uint8_t adaptiveSettle(float freq, settleStruct *pSettle);
+        uint32_t settleMaxMs(float freq);
+        void setAdaptiveSettling(bool enable);
+        settleStruct getSettle(uint32_t index);
+
+        /* Rcal calibration cache */
+        void setRcalCache(bool enable, uint32_t refreshCycles, float driftPct);
+        void clearRcalCache(void);
+        rcalCacheStats getRcalCacheStats(void);
         AD5940Err checkFreq(float freq);
 
         /* SD Card Functions */
@@ -364,10 +1040,50 @@ class HELPStat {
         void printData(void); 
         void saveDataEIS(void);
         void saveDataEIS(String dirName, String fileName);
+        bool mountSD(void);
+
+        /* Binary session log (.hsl), written while the sweep runs */
+        void setSessionLog(bool enable);
+        bool openSessionLog(String dirName, String fileName);
+        void flushSessionLog(void);
+        void closeSessionLog(void);
+        storageStats getStorageStats(void);
 
         /* LMA for Rct / Rs Calculation */
         void calculateResistors(void);
         void calculateResistors(float rct_estimate, float rs_estimate);
+        randlesFit getRandlesFit(void);
+        void setOnlineFit(bool enable);
+        bool getProvisionalFit(float *pRct, float *pRs);
+        cnlsFit fitCircuit(uint8_t model);
+        cnlsFit getCircuitFit(void);
+        void setCycleFit(bool enable);
+        uint32_t getCycleFitCount(void);
+        cycleFit getCycleFit(uint32_t cycle);
+
+        /* Kramers-Kronig quality gate, run after every cycle */
+        void setKKTest(bool enable, float maxResidual = KK_MAX_RESIDUAL, uint8_t maxRepeats = KK_MAX_REPEATS);
+        kkCycle getKKResult(uint32_t cycle);
+        bool getKKResidual(uint32_t index, float *pRe, float *pIm);
+
+        /* Closed-loop RTIA / excitation autoranging of each point (AD5940_DFTMeasure) */
+        void setAutorange(bool enable, bool useComparator = false, float high = AUTORANGE_HIGH, float low = AUTORANGE_LOW);
+        rangeStruct getRange(uint32_t index);
+
+        /* Persistent per-RTIA calibration and calibrated single-leg measurement (AD5940_DFTMeasure) */
+        bool calibrateRtia(void);
+        bool calibrateFixture(uint8_t fixture);
+        bool saveCalibration(void);
+        bool loadCalibration(void);
+        void clearCalibration(void);
+        void setCalibration(bool singleLeg, bool openShort = true);
+        calPointStruct getCalPoint(uint32_t index);
+        calStats getCalStats(void);
+
+        /* Multisine acquisition of the sub-hertz points (runSweep) */
+        void setMultisine(bool enable, float maxFreq = MSINE_MAX_FREQ);
+        void AD5940_MultisineMeasure(void);
+        msineStats getMultisineStats(void);
 
         /* Functions to test bias voltage */
         void AD5940_BiasCfg(float startFreq, float endFreq, uint32_t numPoints, float biasVolt, float zeroVolt, int delaySecs);
@@ -380,6 +1096,14 @@ class HELPStat {
         AD5940Err setHSTIA(float freq);
         void configureFrequency(float freq);
 
+        /* Precomputed sweep plan */
+        void compileSweepPlan(void);
+        void printSweepPlan(void);
+        planStruct getPlanEntry(uint32_t index);
+
+        /* SPI transport timing */
+        spiBenchStruct spiBenchmark(uint32_t numOps, uint32_t fifoWords);
+
         /* Current noise measurements */
         void AD5940_TDDNoise(float biasVolt, float zeroVolt);
         float pollADC(uint32_t gainPGA, float vRef1p82);
@@ -395,6 +1119,10 @@ class HELPStat {
         void BLE_setup(void);
         void BLE_settings(void);
         void BLE_transmitResults(void);
+        void setBleFormat(uint8_t type);
+        void setBleStreaming(bool enable);
+        bleStats getBleStats(void);
+        bleConfig getBleConfig(void);
 
         void print_settings(void);       
 };  
@@ -694,8 +694,8 @@ int32_t AppIMPRegModify(int32_t * const pData, uint32_t *pDataCount)
   return AD5940ERR_OK;
 }
 
-/* Depending on the data type, do appropriate data pre-process before return back to controller */
-int32_t AppIMPDataProcess(int32_t * const pData, uint32_t *pDataCount)
+/* Converts Rcal / Rz DFT pairs to impedance in place. *pDataCount goes from FIFO words to results */
+static int32_t AppIMPDataConvert(int32_t * const pData, uint32_t *pDataCount)
 {
   uint32_t DataCount = *pDataCount;
   uint32_t ImpResCount = DataCount/4;
@@ -738,6 +738,13 @@ int32_t AppIMPDataProcess(int32_t * const pData, uint32_t *pDataCount)
     pOut[i].Phase = RzPhase;
   }
   *pDataCount = ImpResCount; 
+  return 0;
+}
+
+/* Depending on the data type, do appropriate data pre-process before return back to controller */
+int32_t AppIMPDataProcess(int32_t * const pData, uint32_t *pDataCount)
+{
+  AppIMPDataConvert(pData, pDataCount);
   AppIMPCfg.FreqofData = AppIMPCfg.SweepCurrFreq;
   /* Calculate next frequency point */
   if(AppIMPCfg.SweepCfg.SweepEn == bTRUE)
@@ -758,6 +765,7 @@ int32_t AppIMPISR(void *pBuff, uint32_t *pCount)
 {
   uint32_t BuffCount;
   uint32_t FifoCnt;
+  int32_t ret = 0;
   BuffCount = *pCount;
   
   *pCount = 0;
@@ -773,7 +781,10 @@ int32_t AppIMPISR(void *pBuff, uint32_t *pCount)
     
     if(FifoCnt > BuffCount)
     {
-      ///@todo buffer is limited.
+      /* Buffer is limited: take what fits, the rest stays in the FIFO for the next call.
+         Use AppIMPStreamISR for runs that can outpace the caller. */
+      FifoCnt = (BuffCount/4)*4;
+      ret = AD5940ERR_BUFF;
     }
     AD5940_FIFORd((uint32_t *)pBuff, FifoCnt);
     AD5940_INTCClrFlag(AFEINTSRC_DATAFIFOTHRESH);
@@ -783,12 +794,146 @@ int32_t AppIMPISR(void *pBuff, uint32_t *pCount)
     /* Process data */ 
     AppIMPDataProcess((int32_t*)pBuff,&FifoCnt); 
     *pCount = FifoCnt;
-    return 0;
+    return ret;
   }
   
   return 0;
 } 
 
+/**
+   Sets up a stream over NumBuff buffers of BuffWords words, carved in order out of pMem
+   (NumBuff*BuffWords words). BuffWords is rounded down to whole Rcal/Rz groups.
+*/
+int32_t AppIMPStreamInit(IMPStream_Type *pStream, uint32_t *pMem, uint32_t BuffWords, uint32_t NumBuff)
+{
+  if(pStream == 0 || pMem == 0) return AD5940ERR_NULLP;
+  BuffWords = (BuffWords/4)*4;
+  if(BuffWords == 0 || NumBuff < 2 || NumBuff > IMPSTREAM_MAX_BUFF) return AD5940ERR_PARA;
+
+  memset(pStream, 0, sizeof(IMPStream_Type));
+  for(uint32_t i=0; i<NumBuff; i++)
+    pStream->pBuff[i] = pMem + i*BuffWords;
+  pStream->BuffWords = BuffWords;
+  pStream->NumBuff = NumBuff;
+  return AD5940ERR_OK;
+}
+
+/* Hands the buffer being filled to the consumer */
+static void AppIMPStreamPublish(IMPStream_Type *pStream, float Freq)
+{
+  uint32_t Idx = pStream->Head % pStream->NumBuff;
+  uint32_t Pending = pStream->Head - pStream->Tail + 1;
+
+  pStream->Count[Idx] = pStream->Fill;
+  pStream->Freq[Idx] = Freq;
+  __sync_synchronize();     /* Buffer contents before Head */
+  pStream->Head++;
+  pStream->Fill = 0;
+  if(Pending > pStream->MaxPending) pStream->MaxPending = Pending;
+}
+
+/**
+   Call when the AFE interrupt fires. Drains every whole Rcal/Rz group in the data FIFO into
+   the free buffers, so any FIFO threshold works; a partial group stays in the FIFO until the
+   rest of it arrives. A buffer is published when it is full, and at the end of the call if
+   the consumer is idle or the sweep is about to move to the next frequency (so a buffer never
+   mixes frequencies). If every buffer is waiting on the consumer the remaining words are left
+   in the AFE FIFO, Overruns is counted and AD5940ERR_BUFF returned; the sweep is not advanced
+   until the FIFO has been drained, so every word was measured at its buffer's Freq. A data
+   FIFO overflow (words actually lost) is counted in FifoOverflows and also returns
+   AD5940ERR_BUFF.
+*/
+int32_t AppIMPStreamISR(IMPStream_Type *pStream)
+{
+  int32_t ret = AD5940ERR_OK;
+  uint32_t FifoCnt, Words, Idx;
+  float Freq;
+
+  if(AD5940_WakeUp(10) > 10)  /* Wakeup AFE by read register, read 10 times at most */
+    return AD5940ERR_WAKEUP;  /* Wakeup Failed */
+  AD5940_SleepKeyCtrlS(SLPKEY_LOCK);  /* Prohibit AFE to enter sleep mode. */
+
+  if(AD5940_INTCTestFlag(AFEINTC_0, AFEINTSRC_DATAFIFOOF) == bTRUE)
+  {
+    pStream->FifoOverflows++;
+    ret = AD5940ERR_BUFF;
+  }
+  /* Clear before reading the count so words that land during the read raise it again */
+  AD5940_INTCClrFlag(AFEINTSRC_DATAFIFOTHRESH|AFEINTSRC_DATAFIFOOF);
+
+  Freq = (AppIMPCfg.SweepCfg.SweepEn == bTRUE) ? AppIMPCfg.SweepCurrFreq : AppIMPCfg.SinFreq;
+  FifoCnt = (AD5940_FIFOGetCnt()/4)*4;
+  while(FifoCnt)
+  {
+    if(pStream->Head - pStream->Tail >= pStream->NumBuff)
+    {
+      pStream->Overruns++;
+      ret = AD5940ERR_BUFF;
+      break;
+    }
+    Idx = pStream->Head % pStream->NumBuff;
+    Words = pStream->BuffWords - pStream->Fill;
+    if(Words > FifoCnt) Words = FifoCnt;
+    AD5940_FIFORd(pStream->pBuff[Idx] + pStream->Fill, Words);
+    pStream->Fill += Words;
+    pStream->WordsRead += Words;
+    pStream->Backlog += Words;
+    FifoCnt -= Words;
+    if(pStream->Fill == pStream->BuffWords)
+      AppIMPStreamPublish(pStream, Freq);
+  }
+
+  if(FifoCnt == 0 && pStream->Backlog)
+  {
+    if(pStream->Fill && (AppIMPCfg.SweepCfg.SweepEn == bTRUE || pStream->Head == pStream->Tail))
+      AppIMPStreamPublish(pStream, Freq);
+    AppIMPRegModify(0, &pStream->Backlog);  /* Count data / retune while AFE is in active state */
+    AppIMPCfg.FreqofData = AppIMPCfg.SweepCurrFreq;
+    if(AppIMPCfg.SweepCfg.SweepEn == bTRUE)
+    {
+      AppIMPCfg.SweepCurrFreq = AppIMPCfg.SweepNextFreq;
+      logSweep(&AppIMPCfg.SweepCfg, &AppIMPCfg.SweepNextFreq);
+    }
+    pStream->Backlog = 0;
+  }
+  AD5940_SleepKeyCtrlS(SLPKEY_UNLOCK);  /* Allow AFE to enter sleep mode. */
+  return ret;
+}
+
+/* ISR side: publishes a partly filled buffer, e.g. once the sequencer has stopped */
+void AppIMPStreamFlush(IMPStream_Type *pStream)
+{
+  if(pStream->Fill == 0 || pStream->Head - pStream->Tail >= pStream->NumBuff) return;
+  AppIMPStreamPublish(pStream, (AppIMPCfg.SweepCfg.SweepEn == bTRUE) ? AppIMPCfg.FreqofData : AppIMPCfg.SinFreq);
+}
+
+/**
+   Oldest published buffer, converted in place to impedance results. Returns the number of
+   results (0 if nothing is waiting) and the frequency they were measured at. Call
+   AppIMPStreamRelease once done with *ppRes.
+*/
+uint32_t AppIMPStreamGet(IMPStream_Type *pStream, fImpPol_Type **ppRes, float *pFreq)
+{
+  uint32_t Idx, Count;
+
+  if(pStream->Head == pStream->Tail) return 0;
+  __sync_synchronize();       /* Head before buffer contents */
+  Idx = pStream->Tail % pStream->NumBuff;
+  Count = pStream->Count[Idx];
+  AppIMPDataConvert((int32_t*)pStream->pBuff[Idx], &Count);
+  *ppRes = (fImpPol_Type*)pStream->pBuff[Idx];
+  if(pFreq) *pFreq = pStream->Freq[Idx];
+  return Count;
+}
+
+/* Hands the buffer from AppIMPStreamGet back to the ISR side */
+void AppIMPStreamRelease(IMPStream_Type *pStream)
+{
+  if(pStream->Head == pStream->Tail) return;
+  __sync_synchronize();
+  pStream->Tail++;
+}
+
 /* Custom log sweep function */
 void logSweep(SoftSweepCfg_Type *pSweepCfg, float *pNextFreq) {
   float frequency; 
@@ -82,11 +82,41 @@ typedef struct
 #define IMPCTRL_SHUTDOWN       4   /* Note: shutdown here means turn off everything and put AFE to hibernate mode. The word 'SHUT DOWN' is only used here. */
 
 
+/* Streaming FIFO reader. The AFE interrupt side (AppIMPStreamISR) drains the data FIFO into
+   one of NumBuff rotating buffers while a consumer works on another (AppIMPStreamGet /
+   AppIMPStreamRelease). Head is only written by the ISR side and Tail only by the consumer,
+   so the two can run in different tasks without a lock. */
+#define IMPSTREAM_MAX_BUFF   4     /* Most buffers a stream can rotate through */
+
+typedef struct
+{
+  uint32_t *pBuff[IMPSTREAM_MAX_BUFF];  /* Buffers, BuffWords each */
+  uint32_t BuffWords;                   /* Capacity of each buffer in FIFO words, multiple of 4 */
+  uint32_t NumBuff;                     /* Buffers in rotation, 2 = ping-pong */
+  uint32_t Count[IMPSTREAM_MAX_BUFF];   /* FIFO words in each published buffer */
+  float Freq[IMPSTREAM_MAX_BUFF];       /* Excitation frequency the words were measured at */
+  volatile uint32_t Head;               /* Buffers published by AppIMPStreamISR */
+  volatile uint32_t Tail;               /* Buffers released by the consumer */
+  uint32_t Fill;                        /* Words in the buffer being filled (not yet published) */
+  uint32_t Backlog;                     /* FIFO words read but not yet counted by AppIMPRegModify */
+  /* Statistics */
+  uint32_t WordsRead;
+  uint32_t Overruns;                    /* ISR calls that found every buffer full. Words stay in the AFE FIFO */
+  uint32_t FifoOverflows;               /* AFE data FIFO overflows. DFT words were lost */
+  uint32_t MaxPending;                  /* Most published buffers waiting at once */
+}IMPStream_Type;
+
 int32_t AppIMPInit(uint32_t *pBuffer, uint32_t BufferSize);
 int32_t AppIMPGetCfg(void *pCfg);
 int32_t AppIMPISR(void *pBuff, uint32_t *pCount);
 int32_t AppIMPCtrl(uint32_t Command, void *pPara);
 
+int32_t AppIMPStreamInit(IMPStream_Type *pStream, uint32_t *pMem, uint32_t BuffWords, uint32_t NumBuff);
+int32_t AppIMPStreamISR(IMPStream_Type *pStream);
+void AppIMPStreamFlush(IMPStream_Type *pStream);
+uint32_t AppIMPStreamGet(IMPStream_Type *pStream, fImpPol_Type **ppRes, float *pFreq);
+void AppIMPStreamRelease(IMPStream_Type *pStream);
+
 /* Custom Sweep Function */
 void logSweep(SoftSweepCfg_Type *pSweepCfg, float *pNextFreq);
 
@@ -78,6 +78,10 @@ static void AD5940_D2DWriteReg(uint16_t RegAddr, uint32_t RegData);
 */
 
 #define SEQUENCE_GENERATOR  /*!< Build sequence generator part in to lib. Comment this line to remove this feature  */
+#define REG_SHADOW          /*!< Build register shadow part in to lib. Comment this line to remove this feature  */
+#ifndef AD5940_SPI_BYTEWISE
+#define SPI_BURST_TRANSFER  /*!< Send whole SPI frames through AD5940_ReadWriteBurst. Define AD5940_SPI_BYTEWISE to use the byte-wise AD5940_ReadWriteNBytes path */
+#endif
 
 #ifdef SEQUENCE_GENERATOR
 /**
@@ -134,7 +138,7 @@ static AD5940Err AD5940_SEQGenSearchReg(uint32_t RegAddr, uint32_t *pIndex)
   uint32_t i;
 
   RegAddr = (RegAddr>>2)&0xff;
-  for(i=0;i<SeqGenDB.SeqLen;i++)
+  for(i=0;i<SeqGenDB.RegCount;i++)  /* Only RegCount records are valid */
   {
     if(RegAddr == SeqGenDB.pRegInfo[i].RegAddr)
     {
@@ -884,6 +888,121 @@ void AD5940_FIFORd(uint32_t *pBuffer, uint32_t uiReadCount)
  * @{
 */
 
+#ifdef SPI_BURST_TRANSFER
+#define SPI_BURST_WORDS   64  /* FIFO words per AD5940_ReadWriteBurst call */
+
+/**
+ * @brief Set the register address for the next read / write. One frame.
+ * @param RegAddr: The register address.
+ * @return Return None.
+**/
+static void AD5940_SPISetAddr(uint16_t RegAddr)
+{
+  uint8_t tx[3], rx[3];
+  tx[0] = SPICMD_SETADDR;
+  tx[1] = RegAddr>>8;
+  tx[2] = RegAddr&0xff;
+  AD5940_ReadWriteBurst(tx, rx, 3, bFALSE);
+}
+
+/**
+ * @brief Write register through SPI. Each frame goes out as a single burst.
+ * @param RegAddr: The register address.
+ * @param RegData: The register data.
+ * @return Return None.
+**/
+static void AD5940_SPIWriteReg(uint16_t RegAddr, uint32_t RegData)
+{
+  uint8_t tx[5], rx[5];
+  AD5940_SPISetAddr(RegAddr);
+  tx[0] = SPICMD_WRITEREG;
+  if(((RegAddr>=0x1000)&&(RegAddr<=0x3014)))
+  {
+    tx[1] = (RegData>>24)&0xff;
+    tx[2] = (RegData>>16)&0xff;
+    tx[3] = (RegData>> 8)&0xff;
+    tx[4] = (RegData    )&0xff;
+    AD5940_ReadWriteBurst(tx, rx, 5, bFALSE);
+  }
+  else
+  {
+    tx[1] = (RegData>> 8)&0xff;
+    tx[2] = (RegData    )&0xff;
+    AD5940_ReadWriteBurst(tx, rx, 3, bFALSE);
+  }
+}
+
+/**
+ * @brief Read register through SPI. Each frame goes out as a single burst.
+ * @param RegAddr: The register address.
+ * @return Return register data.
+**/
+static uint32_t AD5940_SPIReadReg(uint16_t RegAddr)
+{
+  uint8_t tx[6] = {SPICMD_READREG, 0, 0, 0, 0, 0};
+  uint8_t rx[6];
+  AD5940_SPISetAddr(RegAddr);
+  /* Command, dummy byte, then the data */
+  if((RegAddr>=0x1000)&&(RegAddr<=0x3014))
+  {
+    AD5940_ReadWriteBurst(tx, rx, 6, bFALSE);
+    return (((uint32_t)rx[2])<<24)|(((uint32_t)rx[3])<<16)|(((uint32_t)rx[4])<<8)|rx[5];
+  }
+  AD5940_ReadWriteBurst(tx, rx, 4, bFALSE);
+  return (((uint32_t)rx[2])<<8)|rx[3];
+}
+
+/**
+  @brief Read specific number of data from FIFO. The READFIFO frame is kept open across
+         bursts of SPI_BURST_WORDS words, so the whole drain is one chip-select period.
+  @param pBuffer: Pointer to a buffer that used to store data read back.
+  @param uiReadCount: How much data to be read.
+  @return none.
+**/
+void AD5940_FIFORd(uint32_t *pBuffer, uint32_t uiReadCount)   
+{
+  uint8_t tx[7 + 4*SPI_BURST_WORDS], rx[7 + 4*SPI_BURST_WORDS];
+  uint32_t i, done = 0;
+  
+  if(uiReadCount < 3)
+  {
+    /* This method is more efficient when readcount < 3 */
+    AD5940_SPISetAddr(REG_AFE_DATAFIFORD);
+    memset(tx, 0, 6);
+    tx[0] = SPICMD_READREG;
+    for(i=0;i<uiReadCount;i++)
+    {
+      AD5940_ReadWriteBurst(tx, rx, 6, bFALSE);
+      pBuffer[i] = (((uint32_t)rx[2])<<24)|(((uint32_t)rx[3])<<16)|(((uint32_t)rx[4])<<8)|rx[5];
+    }
+    return;
+  }
+
+  while(done < uiReadCount)
+  {
+    uint32_t words = uiReadCount - done;
+    uint32_t header = (done == 0) ? 7 : 0;  /* Command + 6 dummy bytes on the first burst */
+    uint32_t last;
+    if(words > SPI_BURST_WORDS) words = SPI_BURST_WORDS;
+    last = (done + words == uiReadCount);
+
+    memset(tx, 0, header + 4*words);
+    if(header) tx[0] = SPICMD_READFIFO;
+    /* Last two FIFO words are read with non-zero offset */
+    for(i=0;i<words;i++)
+      if(done + i >= uiReadCount - 2)
+        memset(&tx[header + 4*i], 0x44, 4);
+
+    AD5940_ReadWriteBurst(tx, rx, header + 4*words, last ? bFALSE : bTRUE);
+    for(i=0;i<words;i++)
+    {
+      uint8_t *p = &rx[header + 4*i];
+      pBuffer[done + i] = (((uint32_t)p[0])<<24)|(((uint32_t)p[1])<<16)|(((uint32_t)p[2])<<8)|p[3];
+    }
+    done += words;
+  }
+}
+#else
 /**
   @brief Using SPI to transmit one byte and return the received byte. 
   @param data: The 8-bit data SPI will transmit.
@@ -1026,15 +1145,179 @@ void AD5940_FIFORd(uint32_t *pBuffer, uint32_t uiReadCount)
    }
 }
 
+#endif /* SPI_BURST_TRANSFER */
+
 /**
  * @} SPI_Block_Functions
  * @} SPI_Block
 */
 #endif
 
+#ifdef REG_SHADOW
+/**
+ * @defgroup Register_Shadow
+ * @brief RAM copy of configuration registers that only the host (or a sequence) writes.
+ * @details Reads of these registers are served from RAM and writes of an unchanged value are
+ *          dropped, which removes most of the SPI traffic of the read-modify-write *S helpers.
+ *          Status, result, FIFO, flag and trigger registers are never shadowed. The shadow is
+ *          invalidated on reset (AD5940_HWReset, SWRSTCON), on entering sleep and whenever a
+ *          sequence is triggered, and it is bypassed while the sequencer is enabled, because
+ *          the sequencer writes registers behind the host's back.
+ * @{
+*/
+static const uint16_t ShadowRegTable[] =
+{
+  REG_AFE_AFECON, REG_AFE_SWCON, REG_AFE_HSDACCON, REG_AFE_WGCON,
+  REG_AFE_WGFCW, REG_AFE_WGPHASE, REG_AFE_WGOFFSET, REG_AFE_WGAMPLITUDE,
+  REG_AFE_ADCFILTERCON, REG_AFE_LPREFBUFCON, REG_AFE_DFTCON, REG_AFE_LPTIASW0,
+  REG_AFE_LPTIACON0, REG_AFE_HSRTIACON, REG_AFE_DE1RESCON, REG_AFE_DE0RESCON,
+  REG_AFE_HSTIACON, REG_AFE_LPDACDAT0, REG_AFE_LPDACSW0, REG_AFE_LPDACCON0,
+  REG_AFE_DSWFULLCON, REG_AFE_NSWFULLCON, REG_AFE_PSWFULLCON, REG_AFE_TSWFULLCON,
+  REG_AFE_BUFSENCON, REG_AFE_ADCCON, REG_AFE_DATAFIFOTHRES, REG_AFE_PMBW,
+  REG_AFE_ADCBUFCON, REG_INTC_INTCPOL, REG_INTC_INTCSEL0, REG_INTC_INTCSEL1,
+};
+#define SHADOW_REG_COUNT  (sizeof(ShadowRegTable)/sizeof(ShadowRegTable[0]))
+/* ValidMask has one bit per entry: the build fails here if the table outgrows it */
+typedef char ShadowRegTable_FitsValidMask[(SHADOW_REG_COUNT <= 32) ? 1 : -1];
+
+static struct
+{
+  BoolFlag Enable;                      /**< Runtime switch, off by default */
+  BoolFlag SeqEn;                       /**< Sequencer enabled, shadow bypassed */
+  uint32_t Value[SHADOW_REG_COUNT];     /**< Last value written or read */
+  uint32_t ValidMask;                   /**< Bit n set if Value[n] matches the device */
+  RegShadowStat_Type Stat;
+}ShadowDB;
+
+/* Index of RegAddr in ShadowRegTable, or -1 if it is not shadowed */
+static int32_t AD5940_ShadowIndex(uint16_t RegAddr)
+{
+  uint32_t i;
+  if(RegAddr < REG_AFE_AFECON)
+    return -1;
+  for(i=0;i<SHADOW_REG_COUNT;i++)
+    if(ShadowRegTable[i] == RegAddr)
+      return i;
+  return -1;
+}
+
+/**
+ * @brief Enable or disable the register shadow. The shadow starts out empty either way.
+ * @param Enable: bTRUE to serve configuration reads from RAM and drop redundant writes.
+ * @return return none.
+*/
+void AD5940_ShadowCtrl(BoolFlag Enable)
+{
+  ShadowDB.Enable = Enable;
+  ShadowDB.ValidMask = 0;
+}
+
+/**
+ * @brief Forget all shadowed values. Call after anything that changes registers without going
+ *        through AD5940_WriteReg.
+ * @return return none.
+*/
+void AD5940_ShadowInvalidate(void)
+{
+  if(ShadowDB.ValidMask)
+    ShadowDB.Stat.Invalidations++;
+  ShadowDB.ValidMask = 0;
+}
+
+/**
+ * @brief Get the shadow counters (SPI register accesses avoided and issued).
+ * @param pStat: Pointer to the structure that receives the counters.
+ * @return return none.
+*/
+void AD5940_ShadowGetStat(RegShadowStat_Type *pStat)
+{
+  *pStat = ShadowDB.Stat;
+}
+
+/**
+ * @brief Clear the shadow counters.
+ * @return return none.
+*/
+void AD5940_ShadowClrStat(void)
+{
+  memset(&ShadowDB.Stat, 0, sizeof(ShadowDB.Stat));
+}
+
+/* Called before every real register write. Returns bTRUE if the write can be skipped. */
+static BoolFlag AD5940_ShadowWrite(uint16_t RegAddr, uint32_t RegData)
+{
+  int32_t index;
+
+  /* Writes that reset, sleep or start the sequencer change registers we cannot see */
+  if(RegAddr == REG_AFECON_SWRSTCON || RegAddr == REG_AFE_SEQTRGSLP || RegAddr == REG_AFECON_TRIGSEQ)
+  {
+    AD5940_ShadowInvalidate();
+    return bFALSE;
+  }
+  if(RegAddr == REG_AFE_SEQCON)
+  {
+    ShadowDB.SeqEn = (RegData & BITM_AFE_SEQCON_SEQEN) ? bTRUE : bFALSE;
+    AD5940_ShadowInvalidate();
+    return bFALSE;
+  }
+
+  if(ShadowDB.Enable == bFALSE || ShadowDB.SeqEn == bTRUE)
+    return bFALSE;
+  index = AD5940_ShadowIndex(RegAddr);
+  if(index < 0)
+    return bFALSE;
+
+  if((ShadowDB.ValidMask & (1UL<<index)) && ShadowDB.Value[index] == RegData)
+  {
+    ShadowDB.Stat.WritesAvoided++;
+    return bTRUE;
+  }
+  ShadowDB.Value[index] = RegData;
+  ShadowDB.ValidMask |= 1UL<<index;
+  ShadowDB.Stat.Writes++;
+  return bFALSE;
+}
+
+/* Returns bTRUE and the value if RegAddr can be served from RAM */
+static BoolFlag AD5940_ShadowRead(uint16_t RegAddr, uint32_t *pRegData)
+{
+  int32_t index;
+  if(ShadowDB.Enable == bFALSE || ShadowDB.SeqEn == bTRUE)
+    return bFALSE;
+  index = AD5940_ShadowIndex(RegAddr);
+  if(index < 0)
+    return bFALSE;
+  if((ShadowDB.ValidMask & (1UL<<index)) == 0)
+  {
+    ShadowDB.Stat.Reads++;
+    return bFALSE;
+  }
+  *pRegData = ShadowDB.Value[index];
+  ShadowDB.Stat.ReadsAvoided++;
+  return bTRUE;
+}
+
+/* Fills the shadow with a value read from the device */
+static void AD5940_ShadowFill(uint16_t RegAddr, uint32_t RegData)
+{
+  int32_t index;
+  if(ShadowDB.Enable == bFALSE || ShadowDB.SeqEn == bTRUE)
+    return;
+  index = AD5940_ShadowIndex(RegAddr);
+  if(index < 0)
+    return;
+  ShadowDB.Value[index] = RegData;
+  ShadowDB.ValidMask |= 1UL<<index;
+}
+/**
+ * @} Register_Shadow
+*/
+#endif
+
 /**
  * @brief Write register. If sequencer generator is enabled, the register write is recorded. 
- *        Otherwise, the data is written to AD5940 by SPI.
+ *        Otherwise, the data is written to AD5940 by SPI. With the register shadow enabled,
+ *        writes that would not change a shadowed register are dropped.
  * @param RegAddr: The register address.
  * @param RegData: The register data.
  * @return Return None.
@@ -1046,6 +1329,11 @@ void AD5940_WriteReg(uint16_t RegAddr, uint32_t RegData)
     AD5940_SEQWriteReg(RegAddr, RegData);
   else
 #endif
+#ifdef REG_SHADOW
+  if(AD5940_ShadowWrite(RegAddr, RegData) == bTRUE)
+    return;
+  else
+#endif
 #ifdef CHIPSEL_M355
     AD5940_D2DWriteReg(RegAddr, RegData);
 #else
@@ -1055,22 +1343,30 @@ void AD5940_WriteReg(uint16_t RegAddr, uint32_t RegData)
 
 /**
  * @brief Read register. If sequencer generator is enabled, read current register value from data-base. 
- *        Otherwise, read register value by SPI.
+ *        Otherwise, read register value by SPI, or from the register shadow if it holds it.
  * @param RegAddr: The register address.
  * @return Return register value.
 **/
 uint32_t AD5940_ReadReg(uint16_t RegAddr)
 {
+  uint32_t RegData;
 #ifdef SEQUENCE_GENERATOR
   if(SeqGenDB.EngineStart == bTRUE)
     return AD5940_SEQReadReg(RegAddr);
-  else
+#endif
+#ifdef REG_SHADOW
+  if(AD5940_ShadowRead(RegAddr, &RegData) == bTRUE)
+    return RegData;
 #endif
 #ifdef CHIPSEL_M355
-    return AD5940_D2DReadReg(RegAddr);
+  RegData = AD5940_D2DReadReg(RegAddr);
 #else
-    return AD5940_SPIReadReg(RegAddr);
+  RegData = AD5940_SPIReadReg(RegAddr);
+#endif
+#ifdef REG_SHADOW
+  AD5940_ShadowFill(RegAddr, RegData);
 #endif
+  return RegData;
 }
 
 
@@ -3006,6 +3302,9 @@ AD5940Err  AD5940_SoftRst(void)
 */
 void AD5940_HWReset(void)
 {
+#ifdef REG_SHADOW
+  AD5940_ShadowInvalidate();
+#endif
 #ifndef CHIPSEL_M355
   AD5940_RstClr();
   AD5940_Delay10us(200); /* Delay some time */
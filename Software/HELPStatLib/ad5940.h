@@ -32,6 +32,13 @@ extern "C" {
 //#define CHIPSEL_M355      /**< ADuCM355 */
 #define CHIPSEL_594X      /**< AD5940 or AD5941 */
 
+/**
+ * SPI transport. By default each SPI frame is handed to the port as one AD5940_ReadWriteBurst
+ * call and the port drives chip-select. Define this to go back to AD5940_ReadWriteNBytes with
+ * AD5940_CsClr / AD5940_CsSet around every frame.
+*/
+//#define AD5940_SPI_BYTEWISE
+
 /* library version number */
 #define AD5940LIB_VER_MAJOR       0    /**< Major number */
 #define AD5940LIB_VER_MINOR       2    /**< Minor number */
@@ -4761,6 +4768,18 @@ typedef struct
 	uint32_t NumClks;
 }FreqParams_Type;
 
+/**
+ * RegShadowStat_Type - Register shadow counters (see AD5940_ShadowCtrl)
+*/
+typedef struct
+{
+  uint32_t ReadsAvoided;    /**< Register reads served from RAM */
+  uint32_t WritesAvoided;   /**< Writes dropped because the value did not change */
+  uint32_t Reads;           /**< Shadowed-register reads that went to the device */
+  uint32_t Writes;          /**< Shadowed-register writes that went to the device */
+  uint32_t Invalidations;   /**< Times the shadow was dropped (reset, sleep, sequencer) */
+}RegShadowStat_Type;
+
 /**
  * @} TypeDefinitions
 */
@@ -4772,6 +4791,10 @@ typedef struct
 /* 1. Basic SPI functions */
 void      AD5940_WriteReg(uint16_t RegAddr, uint32_t RegData);
 uint32_t  AD5940_ReadReg(uint16_t RegAddr);
+void      AD5940_ShadowCtrl(BoolFlag Enable);   /* Register shadow: serve config reads from RAM, drop redundant writes */
+void      AD5940_ShadowInvalidate(void);
+void      AD5940_ShadowGetStat(RegShadowStat_Type *pStat);
+void      AD5940_ShadowClrStat(void);
 void      AD5940_FIFORd(uint32_t *pBuffer,uint32_t uiReadCount);
 
 /* 2. AD5940 Top Control functions */
@@ -4928,9 +4951,23 @@ void      AD5940_MCUGpioWrite(uint32_t data);   /*  */
 uint32_t  AD5940_MCUGpioRead(uint32_t);
 void      AD5940_MCUGpioCtrl(uint32_t, BoolFlag);
 void      AD5940_ReadWriteNBytes(unsigned char *pSendBuffer,unsigned char *pRecvBuff,unsigned long length);
+/* Whole-frame transfer: CS is asserted by the port for the buffer and released afterwards unless
+   bKeepCs is set, in which case the next call continues the same frame. Used when SPI_BURST_TRANSFER
+   is built (ad5940.c). */
+void      AD5940_ReadWriteBurst(unsigned char *pSendBuffer,unsigned char *pRecvBuff,unsigned long length,BoolFlag bKeepCs);
+/* Hand the shared SCK / MOSI pins back to other users of the bus (SD card). The next burst takes them again. */
+void      AD5940_SPIRelease(void);
+/* Exclusive use of the shared SPI bus for another device (SD card) from another task. Waits for the
+   AD5940 frame in progress to finish; AD5940 frames started meanwhile wait for AD5940_BusUnlock. */
+void      AD5940_BusLock(void);
+void      AD5940_BusUnlock(void);
 /* Below functions are frequently used in example code but not necessary for library */
 uint32_t  AD5940_GetMCUIntFlag(void);
 uint32_t  AD5940_ClrMCUIntFlag(void);
+/* Block until the MCU interrupt flag is set or TimeoutMs elapses. Returns the flag. */
+uint32_t  AD5940_WaitMCUIntFlag(uint32_t TimeoutMs);
+/* Timestamp (us) taken in the interrupt handler when the flag was last set */
+uint32_t  AD5940_GetMCUIntTimeUs(void);
 
 /* Changed to void instead of void *pCfg */
 uint32_t  AD5940_MCUResourceInit(void);
@@ -13,20 +13,74 @@ based on FreiStat and Analog Device documentations / recommendations.
 
 09/07/2023: Changed code to include constants from AD5940ino.h to have a singular place 
 to make edits.
+
+10/16/2026: interruptISR now gives a binary semaphore. AD5940_WaitMCUIntFlag blocks the
+calling task on it (with a timeout) instead of the caller polling the flag with delay().
+The ISR also timestamps the interrupt so callers can measure wakeup latency.
+
+10/16/2026: AD5940_ReadWriteBurst sends whole SPI frames through the ESP-IDF SPI master
+on SPI3 (HSPI) with DMA and hardware chip-select, instead of one SPI.transfer() per byte.
+FIFO drains that span several bursts keep CS low with SPI_TRANS_CS_KEEP_ACTIVE. The
+Arduino SPI object (FSPI) stays with the SD card; SCK and MOSI are shared, so whichever
+side is about to use them routes them to its peripheral (AD5940_SPIRelease gives them back).
+Define AD5940_SPI_BYTEWISE in ad5940.h for the old byte-wise path.
+
+10/16/2026: SPI bus arbitration for the SD card writer task. A FreeRTOS mutex is held for
+every AD5940 frame (burst: first to last call of a frame, byte-wise: CsClr to CsSet) and by
+AD5940_BusLock / AD5940_BusUnlock around SD card access, so frames on the two devices never
+interleave even though the storage task runs on the other core.
 */
 
 #include "Arduino.h"
 #include "SPI.h"
 #include <constants.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/spi_master.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_gpio.h"
+#include "soc/spi_periph.h"
+
 extern "C" { 
 #include <ad5940.h> 
 }
 
 
 volatile uint32_t uCInterrupt = 0;
+volatile uint32_t uCInterruptUs = 0;         // micros() when the ISR last ran
+static SemaphoreHandle_t uCIntSemaphore = NULL;
 void IRAM_ATTR interruptISR();
 
+static SemaphoreHandle_t spiBusMutex = NULL;  // Shared SCK / MOSI: one AD5940 frame or SD access at a time
+static bool frameHeld = false;               // AD5940 frame in progress holds spiBusMutex
+
+static void frameBegin()
+{
+    if(spiBusMutex && !frameHeld) {
+        xSemaphoreTake(spiBusMutex, portMAX_DELAY);
+        frameHeld = true;
+    }
+}
+
+static void frameEnd()
+{
+    if(frameHeld) {
+        frameHeld = false;
+        xSemaphoreGive(spiBusMutex);
+    }
+}
+
+#ifndef AD5940_SPI_BYTEWISE
+#define AD5940_SPI_HOST   SPI3_HOST          // FSPI (SPI2) stays with the Arduino SPI object / SD card
+#define AD5940_DMA_BUFF   ((7 + 4 * 64 + 4 + 3) & ~3)   // Largest burst ad5940.c sends, rounded up to words
+
+static spi_device_handle_t ad5940Spi = NULL;
+static uint8_t *dmaTx = NULL;
+static uint8_t *dmaRx = NULL;
+static bool spiRouted = false;               // SCK / MOSI currently driven by AD5940_SPI_HOST
+#endif
+
 void AD5940_RstClr()
 {
     digitalWrite(RESET, LOW); 
@@ -39,12 +93,14 @@ void AD5940_RstSet()
 
 void AD5940_CsClr()
 {
+    frameBegin();
     digitalWrite(CS, LOW); 
 }
 
 void AD5940_CsSet()
 {
     digitalWrite(CS, HIGH); 
+    frameEnd();
 }
 
 // from FreiStat - not sure if necessary but
@@ -64,6 +120,100 @@ void AD5940_Delay10us(uint32_t iTime)
     }
 }
 
+#ifndef AD5940_SPI_BYTEWISE
+// Connects the shared SCK / MOSI outputs to the SPI host given
+static void spiRoute(spi_host_device_t host)
+{
+    esp_rom_gpio_connect_out_signal(SCK, spi_periph_signal[host].spiclk_out, false, false);
+    esp_rom_gpio_connect_out_signal(MOSI, spi_periph_signal[host].spid_out, false, false);
+}
+
+static uint32_t spiBurstInit()
+{
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num = MOSI;
+    bus.miso_io_num = MISO;
+    bus.sclk_io_num = SCK;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    bus.max_transfer_sz = AD5940_DMA_BUFF;
+
+    spi_device_interface_config_t dev = {};
+    dev.clock_speed_hz = CLCK;
+    dev.mode = 0;                 // SPIMODE
+    dev.spics_io_num = CS;        // Hardware chip-select
+    dev.cs_ena_pretrans = 1;      // AD5940 needs CS low a little before the first edge
+    dev.cs_ena_posttrans = 1;
+    dev.queue_size = 1;
+
+    if(spi_bus_initialize(AD5940_SPI_HOST, &bus, SPI_DMA_CH_AUTO) != ESP_OK) return 1;
+    if(spi_bus_add_device(AD5940_SPI_HOST, &dev, &ad5940Spi) != ESP_OK) return 1;
+    /* Only device on this host: hold the bus so polling transactions skip the lock */
+    spi_device_acquire_bus(ad5940Spi, portMAX_DELAY);
+
+    dmaTx = (uint8_t *)heap_caps_malloc(AD5940_DMA_BUFF, MALLOC_CAP_DMA);
+    dmaRx = (uint8_t *)heap_caps_malloc(AD5940_DMA_BUFF, MALLOC_CAP_DMA);
+    if(dmaTx == NULL || dmaRx == NULL) return 1;
+
+    spiRouted = true;
+    return 0;
+}
+
+// One or more whole SPI frames in a single DMA transaction. With bKeepCs the
+// chip-select stays low so the next call continues the same frame.
+void AD5940_ReadWriteBurst(unsigned char *pSendBuffer, unsigned char *pRecvBuff, unsigned long numBytes, BoolFlag bKeepCs)
+{
+    frameBegin();
+    if(!spiRouted) {
+        spiRoute(AD5940_SPI_HOST);
+        spiRouted = true;
+    }
+
+    while(numBytes) {
+        unsigned long n = numBytes > AD5940_DMA_BUFF ? AD5940_DMA_BUFF : numBytes;
+        spi_transaction_t t = {};
+
+        /* Whole-buffer chunks are word multiples; the DMA may write the last chunk's rx up to
+           the next word, which the rounded-up buffers have room for */
+        memcpy(dmaTx, pSendBuffer, n);
+        t.length = n * 8;
+        t.tx_buffer = dmaTx;
+        t.rx_buffer = dmaRx;
+        if(bKeepCs || numBytes > n) t.flags = SPI_TRANS_CS_KEEP_ACTIVE;
+        spi_device_polling_transmit(ad5940Spi, &t);
+        if(pRecvBuff) memcpy(pRecvBuff, dmaRx, n);
+
+        pSendBuffer += n;
+        if(pRecvBuff) pRecvBuff += n;
+        numBytes -= n;
+    }
+    if(!bKeepCs) frameEnd();
+}
+
+void AD5940_SPIRelease()
+{
+    if(spiRouted) {
+        spiRoute(SPI2_HOST);
+        spiRouted = false;
+    }
+}
+#else
+void AD5940_SPIRelease()
+{
+}
+#endif
+
+void AD5940_BusLock()
+{
+    if(spiBusMutex) xSemaphoreTake(spiBusMutex, portMAX_DELAY);
+    AD5940_SPIRelease();
+}
+
+void AD5940_BusUnlock()
+{
+    if(spiBusMutex) xSemaphoreGive(spiBusMutex);
+}
+
 // writing to SPI 
 // Putting the begin / end transactions here were from FreiStat
 
@@ -80,11 +230,16 @@ void AD5940_ReadWriteNBytes(unsigned char *pSendBuffer, unsigned char *pRecvBuff
 
 /* IINTERRUPT FUNCTIONS */
 void IRAM_ATTR interruptISR() {
+    BaseType_t woken = pdFALSE;
     uCInterrupt = 1;
+    uCInterruptUs = micros();
+    xSemaphoreGiveFromISR(uCIntSemaphore, &woken);
+    if(woken == pdTRUE) portYIELD_FROM_ISR();
 }
 
 uint32_t AD5940_ClrMCUIntFlag() {
     uCInterrupt = 0;
+    if(uCIntSemaphore) xSemaphoreTake(uCIntSemaphore, 0); // Drop a give left over from an earlier interrupt
     return 0;
 }
 
@@ -92,24 +247,53 @@ uint32_t AD5940_GetMCUIntFlag() {
     return uCInterrupt;
 }
 
+// Blocks the calling task until the interrupt fires or timeoutMs passes.
+// Returns the flag, so 0 means it timed out.
+uint32_t AD5940_WaitMCUIntFlag(uint32_t timeoutMs) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeoutMs);
+    while(!uCInterrupt) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if(elapsed >= timeout) break;
+        // A stale give just loops back to the flag check
+        xSemaphoreTake(uCIntSemaphore, timeout - elapsed);
+    }
+    return uCInterrupt;
+}
+
+uint32_t AD5940_GetMCUIntTimeUs() {
+    return uCInterruptUs;
+}
+
 uint32_t AD5940_MCUResourceInit() {
     Serial.begin(SERIAL_BAUD);
 
+    if(spiBusMutex == NULL) spiBusMutex = xSemaphoreCreateMutex();
+
     // Initializing Pins
     SPI.begin(SCK, MISO, MOSI, CS);
+#ifndef AD5940_SPI_BYTEWISE
+    // CS belongs to the SPI3 peripheral from here on; SD card keeps FSPI
+    if(spiBurstInit() != 0) return 1;
+#else
     pinMode(CS, OUTPUT);
+#endif
     pinMode(RESET, OUTPUT);
 
     /* DOUBLE CHECK IF CHOSEN INTERRUPT CAN HAVE INPUT PULLUP */
     pinMode(ESP32_INTERRUPT, INPUT_PULLUP);
     
     // Initializing Interrupts 
+    // Semaphore has to exist before the first edge can reach the ISR
+    if(uCIntSemaphore == NULL) uCIntSemaphore = xSemaphoreCreateBinary();
     // AD5940 does FALLING interrupts by default
     attachInterrupt(digitalPinToInterrupt(ESP32_INTERRUPT), interruptISR, FALLING);
 
     // Sets Reset and CS pins high as a default
     AD5940_RstSet();
+#ifdef AD5940_SPI_BYTEWISE
     AD5940_CsSet();
+#endif
 
     return 0;
 }
@@ -0,0 +1,322 @@
+/*
+    FILENAME: bleframe.h
+
+    Binary result frames for the bulk BLE characteristic (CHARACTERISTIC_UUID_BULK).
+    BLE_transmitResults packs as many sweep points into one notification as the
+    negotiated MTU allows instead of sending five ASCII characteristics per point.
+    Plain C with no Arduino dependencies so host tools decode frames with the same
+    code as the firmware.
+
+    A frame is:
+
+        header (BLE_FRAME_HDR_SIZE) | payload | CRC-32 of header + payload
+
+    header: version u8, type u8, flags u8, count u8, seq u16, sweepPoints u16, first u32
+
+    seq counts frames within one transfer from 0, so a receiver can spot a gap.
+    Point frames carry count consecutive results starting at index first
+    (index = point + cycle * sweepPoints, as in HELPStat::getResult); a point that
+    failed to measure is not sent, so its index is missing. The transfer
+    ends with a BLE_FRAME_SUMMARY frame (Rct, Rs, points sent) flagged
+    BLE_FRAME_LAST. A cycle measured again after failing the Kramers-Kronig test
+    is sent again from its first point with the attempt number in the top bits
+    of flags (BLE_FRAME_ATTEMPT); a receiver keeps, for each index, the point of
+    the highest attempt. The CRC is the IEEE CRC-32 of sessionlog.h (java.util.zip.CRC32
+    on Android).
+
+    The full configuration characteristic (CHARACTERISTIC_UUID_CONFIG) takes every
+    sweep setting in one write, in the same style:
+
+        version u8 | 3 reserved bytes | 12 x 4-byte fields | folder[32] | file[32] | CRC-32
+
+    BLE_CONFIG_SIZE bytes in all; at the default MTU the central sends it as a long
+    (prepared) write. Names are NUL-padded and need not be NUL-terminated.
+
+    All fields are little-endian and packed byte by byte, so the layout does not
+    depend on the compiler.
+*/
+
+#ifndef BLEFRAME_H
+#define BLEFRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#include "sessionlog.h"
+
+#define BLE_FRAME_VERSION   1
+
+#define BLE_FRAME_POINTS_F32  1   // freq, real, imag as float32 (12 bytes / point)
+#define BLE_FRAME_POINTS_S16  2   // freq float32, real / imag int16 x 2^exp (9 bytes / point)
+#define BLE_FRAME_SUMMARY     3   // Rct float32, Rs float32, points u32
+
+#define BLE_FRAME_LAST      0x01  // Last frame of the transfer
+#define BLE_FRAME_ATTEMPT_SHIFT 4 // flags bits 4..7: attempt of the points' cycle (0 = first, at most 15)
+
+static inline uint8_t bleFrameAttempt(uint8_t flags) { return (uint8_t)(flags >> BLE_FRAME_ATTEMPT_SHIFT); }
+static inline uint8_t bleFrameAttemptFlags(uint8_t attempt)
+{
+    return (uint8_t)((attempt > 15 ? 15 : attempt) << BLE_FRAME_ATTEMPT_SHIFT);
+}
+
+#define BLE_FRAME_HDR_SIZE  12
+#define BLE_FRAME_CRC_SIZE  4
+#define BLE_FRAME_SUMMARY_SIZE 12
+#define BLE_FRAME_MAX_COUNT 255
+
+#define BLE_FRAME_OK         0
+#define BLE_FRAME_ERR_LEN   -1    // Shorter than the header / count says
+#define BLE_FRAME_ERR_CRC   -2
+#define BLE_FRAME_ERR_VER   -3    // Unknown version or type
+
+typedef struct _bleFrameHdr {
+    uint8_t version;      // BLE_FRAME_VERSION
+    uint8_t type;         // BLE_FRAME_*
+    uint8_t flags;        // BLE_FRAME_LAST, attempt (bleFrameAttempt)
+    uint8_t count;        // Points in the payload (0 for a summary)
+    uint16_t seq;         // Frame number within the transfer
+    uint16_t sweepPoints; // Points per cycle
+    uint32_t first;       // Result index of the first point
+}bleFrameHdr;
+
+typedef struct _blePoint {
+    float freq;
+    float real;
+    float imag;
+}blePoint;
+
+typedef struct _bleSummary {
+    float rct;
+    float rs;
+    uint32_t points;      // Results sent in the transfer (a point sent again counts once)
+}bleSummary;
+
+static inline void blePut16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static inline void blePut32(uint8_t *p, uint32_t v) { for(int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i)); }
+static inline void blePutF(uint8_t *p, float v) { uint32_t u; memcpy(&u, &v, 4); blePut32(p, u); }
+static inline uint16_t bleGet16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t bleGet32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline float bleGetF(const uint8_t *p) { uint32_t u = bleGet32(p); float v; memcpy(&v, &u, 4); return v; }
+
+/* Payload bytes per point, 0 for an unknown type */
+static inline size_t bleFramePointSize(uint8_t type)
+{
+    if(type == BLE_FRAME_POINTS_F32) return 12;
+    if(type == BLE_FRAME_POINTS_S16) return 9;
+    return 0;
+}
+
+/* Points of the given type that fit in a frame of frameMax bytes (ATT MTU - 3) */
+static inline uint32_t bleFrameCapacity(uint8_t type, size_t frameMax)
+{
+    size_t size = bleFramePointSize(type);
+    if(!size || frameMax <= BLE_FRAME_HDR_SIZE + BLE_FRAME_CRC_SIZE) return 0;
+    size_t n = (frameMax - BLE_FRAME_HDR_SIZE - BLE_FRAME_CRC_SIZE) / size;
+    return n > BLE_FRAME_MAX_COUNT ? BLE_FRAME_MAX_COUNT : (uint32_t)n;
+}
+
+/*
+  real and imag share one exponent: both are stored as int16 x 2^exp, with exp picked so the
+  larger of the two just fits. That keeps about 4.5 significant digits whatever the magnitude.
+*/
+static inline void bleS16Pack(uint8_t *p, float real, float imag)
+{
+    float m = fabsf(real) > fabsf(imag) ? fabsf(real) : fabsf(imag);
+    int e = 0;
+    if(m > 0 && isfinite(m)) {
+        frexpf(m, &e);   // m = f x 2^e, 0.5 <= f < 1
+        e -= 15;
+        if(e < -128) e = -128;
+        if(e > 127) e = 127;
+    }
+    long r = isfinite(real) ? lrintf(ldexpf(real, -e)) : 0;
+    long i = isfinite(imag) ? lrintf(ldexpf(imag, -e)) : 0;
+    if(r > 32767) r = 32767;
+    if(r < -32767) r = -32767;
+    if(i > 32767) i = 32767;
+    if(i < -32767) i = -32767;
+    blePut16(p, (uint16_t)(int16_t)r);
+    blePut16(p + 2, (uint16_t)(int16_t)i);
+    p[4] = (uint8_t)(int8_t)e;
+}
+
+static inline void bleS16Unpack(const uint8_t *p, float *pReal, float *pImag)
+{
+    int e = (int8_t)p[4];
+    *pReal = ldexpf((float)(int16_t)bleGet16(p), e);
+    *pImag = ldexpf((float)(int16_t)bleGet16(p + 2), e);
+}
+
+static inline size_t bleFrameFinish(uint8_t *pBuf, const bleFrameHdr *pHdr, size_t payload)
+{
+    pBuf[0] = BLE_FRAME_VERSION;
+    pBuf[1] = pHdr->type;
+    pBuf[2] = pHdr->flags;
+    pBuf[3] = pHdr->count;
+    blePut16(pBuf + 4, pHdr->seq);
+    blePut16(pBuf + 6, pHdr->sweepPoints);
+    blePut32(pBuf + 8, pHdr->first);
+    size_t len = BLE_FRAME_HDR_SIZE + payload;
+    blePut32(pBuf + len, logCrc32(0, pBuf, len));
+    return len + BLE_FRAME_CRC_SIZE;
+}
+
+/* Encodes pHdr->count points (pHdr->type F32 or S16). Returns the frame length, 0 if it does not fit bufSize */
+static inline size_t bleFrameEncodePoints(uint8_t *pBuf, size_t bufSize, const bleFrameHdr *pHdr, const blePoint *pPoints)
+{
+    size_t size = bleFramePointSize(pHdr->type);
+    size_t payload = size * pHdr->count;
+    if(!size || BLE_FRAME_HDR_SIZE + payload + BLE_FRAME_CRC_SIZE > bufSize) return 0;
+    uint8_t *p = pBuf + BLE_FRAME_HDR_SIZE;
+    for(uint32_t k = 0; k < pHdr->count; k++, p += size) {
+        blePutF(p, pPoints[k].freq);
+        if(pHdr->type == BLE_FRAME_POINTS_F32) {
+            blePutF(p + 4, pPoints[k].real);
+            blePutF(p + 8, pPoints[k].imag);
+        }
+        else bleS16Pack(p + 4, pPoints[k].real, pPoints[k].imag);
+    }
+    return bleFrameFinish(pBuf, pHdr, payload);
+}
+
+/* Encodes a BLE_FRAME_SUMMARY frame (type and count in pHdr are ignored) */
+static inline size_t bleFrameEncodeSummary(uint8_t *pBuf, size_t bufSize, const bleFrameHdr *pHdr, const bleSummary *pSummary)
+{
+    if(BLE_FRAME_HDR_SIZE + BLE_FRAME_SUMMARY_SIZE + BLE_FRAME_CRC_SIZE > bufSize) return 0;
+    bleFrameHdr hdr = *pHdr;
+    hdr.type = BLE_FRAME_SUMMARY;
+    hdr.count = 0;
+    uint8_t *p = pBuf + BLE_FRAME_HDR_SIZE;
+    blePutF(p, pSummary->rct);
+    blePutF(p + 4, pSummary->rs);
+    blePut32(p + 8, pSummary->points);
+    return bleFrameFinish(pBuf, &hdr, BLE_FRAME_SUMMARY_SIZE);
+}
+
+/*
+  Checks and decodes one frame. Point frames fill pPoints (up to maxPoints; pHdr->count says how
+  many the frame held), summary frames fill pSummary. Either pointer may be NULL. Returns
+  BLE_FRAME_OK or BLE_FRAME_ERR_*.
+*/
+static inline int bleFrameDecode(const uint8_t *pBuf, size_t len, bleFrameHdr *pHdr,
+                                 blePoint *pPoints, uint32_t maxPoints, bleSummary *pSummary)
+{
+    if(len < BLE_FRAME_HDR_SIZE + BLE_FRAME_CRC_SIZE) return BLE_FRAME_ERR_LEN;
+    if(bleGet32(pBuf + len - BLE_FRAME_CRC_SIZE) != logCrc32(0, pBuf, len - BLE_FRAME_CRC_SIZE))
+        return BLE_FRAME_ERR_CRC;
+    pHdr->version = pBuf[0];
+    pHdr->type = pBuf[1];
+    pHdr->flags = pBuf[2];
+    pHdr->count = pBuf[3];
+    pHdr->seq = bleGet16(pBuf + 4);
+    pHdr->sweepPoints = bleGet16(pBuf + 6);
+    pHdr->first = bleGet32(pBuf + 8);
+    if(pHdr->version != BLE_FRAME_VERSION) return BLE_FRAME_ERR_VER;
+
+    size_t payload = len - BLE_FRAME_HDR_SIZE - BLE_FRAME_CRC_SIZE;
+    const uint8_t *p = pBuf + BLE_FRAME_HDR_SIZE;
+    if(pHdr->type == BLE_FRAME_SUMMARY) {
+        if(payload != BLE_FRAME_SUMMARY_SIZE) return BLE_FRAME_ERR_LEN;
+        if(pSummary) {
+            pSummary->rct = bleGetF(p);
+            pSummary->rs = bleGetF(p + 4);
+            pSummary->points = bleGet32(p + 8);
+        }
+        return BLE_FRAME_OK;
+    }
+
+    size_t size = bleFramePointSize(pHdr->type);
+    if(!size) return BLE_FRAME_ERR_VER;
+    if(payload != size * pHdr->count) return BLE_FRAME_ERR_LEN;
+    for(uint32_t k = 0; pPoints && k < pHdr->count && k < maxPoints; k++, p += size) {
+        pPoints[k].freq = bleGetF(p);
+        if(pHdr->type == BLE_FRAME_POINTS_F32) {
+            pPoints[k].real = bleGetF(p + 4);
+            pPoints[k].imag = bleGetF(p + 8);
+        }
+        else bleS16Unpack(p + 4, &pPoints[k].real, &pPoints[k].imag);
+    }
+    return BLE_FRAME_OK;
+}
+
+/* Full configuration (CHARACTERISTIC_UUID_CONFIG) */
+#define BLE_CONFIG_VERSION  1
+#define BLE_CONFIG_NAME_LEN 32
+#define BLE_CONFIG_SIZE     (4 + 12 * 4 + 2 * BLE_CONFIG_NAME_LEN + BLE_FRAME_CRC_SIZE)
+
+typedef struct _bleConfig {
+    float rctEstimate;
+    float rsEstimate;
+    uint32_t numCycles;     // Cycles after the first
+    uint32_t numPoints;     // Points per decade
+    float startFreq;
+    float endFreq;
+    float rcalVal;
+    float biasVolt;
+    float zeroVolt;
+    uint32_t delaySecs;
+    int32_t extGain;
+    int32_t dacGain;
+    char folderName[BLE_CONFIG_NAME_LEN + 1];   // Always NUL-terminated here
+    char fileName[BLE_CONFIG_NAME_LEN + 1];
+}bleConfig;
+
+/* Writes BLE_CONFIG_SIZE bytes. Names longer than BLE_CONFIG_NAME_LEN are cut */
+static inline size_t bleConfigEncode(uint8_t *pBuf, const bleConfig *pCfg)
+{
+    uint8_t *p = pBuf;
+    memset(pBuf, 0, BLE_CONFIG_SIZE);
+    p[0] = BLE_CONFIG_VERSION;
+    p += 4;
+    blePutF(p, pCfg->rctEstimate);  p += 4;
+    blePutF(p, pCfg->rsEstimate);   p += 4;
+    blePut32(p, pCfg->numCycles);   p += 4;
+    blePut32(p, pCfg->numPoints);   p += 4;
+    blePutF(p, pCfg->startFreq);    p += 4;
+    blePutF(p, pCfg->endFreq);      p += 4;
+    blePutF(p, pCfg->rcalVal);      p += 4;
+    blePutF(p, pCfg->biasVolt);     p += 4;
+    blePutF(p, pCfg->zeroVolt);     p += 4;
+    blePut32(p, pCfg->delaySecs);   p += 4;
+    blePut32(p, (uint32_t)pCfg->extGain); p += 4;
+    blePut32(p, (uint32_t)pCfg->dacGain); p += 4;
+    memset(p, 0, 2 * BLE_CONFIG_NAME_LEN);  // Unterminated when a name fills its field
+    memcpy(p, pCfg->folderName, strnlen(pCfg->folderName, BLE_CONFIG_NAME_LEN)); p += BLE_CONFIG_NAME_LEN;
+    memcpy(p, pCfg->fileName, strnlen(pCfg->fileName, BLE_CONFIG_NAME_LEN));     p += BLE_CONFIG_NAME_LEN;
+    blePut32(p, logCrc32(0, pBuf, p - pBuf));
+    return BLE_CONFIG_SIZE;
+}
+
+/* Returns BLE_FRAME_OK or BLE_FRAME_ERR_*; pCfg is only written when the whole block checks out */
+static inline int bleConfigDecode(const uint8_t *pBuf, size_t len, bleConfig *pCfg)
+{
+    const uint8_t *p = pBuf + 4;
+    if(len != BLE_CONFIG_SIZE) return BLE_FRAME_ERR_LEN;
+    if(bleGet32(pBuf + len - BLE_FRAME_CRC_SIZE) != logCrc32(0, pBuf, len - BLE_FRAME_CRC_SIZE))
+        return BLE_FRAME_ERR_CRC;
+    if(pBuf[0] != BLE_CONFIG_VERSION) return BLE_FRAME_ERR_VER;
+    pCfg->rctEstimate = bleGetF(p);  p += 4;
+    pCfg->rsEstimate = bleGetF(p);   p += 4;
+    pCfg->numCycles = bleGet32(p);   p += 4;
+    pCfg->numPoints = bleGet32(p);   p += 4;
+    pCfg->startFreq = bleGetF(p);    p += 4;
+    pCfg->endFreq = bleGetF(p);      p += 4;
+    pCfg->rcalVal = bleGetF(p);      p += 4;
+    pCfg->biasVolt = bleGetF(p);     p += 4;
+    pCfg->zeroVolt = bleGetF(p);     p += 4;
+    pCfg->delaySecs = bleGet32(p);   p += 4;
+    pCfg->extGain = (int32_t)bleGet32(p); p += 4;
+    pCfg->dacGain = (int32_t)bleGet32(p); p += 4;
+    memcpy(pCfg->folderName, p, BLE_CONFIG_NAME_LEN); p += BLE_CONFIG_NAME_LEN;
+    memcpy(pCfg->fileName, p, BLE_CONFIG_NAME_LEN);
+    pCfg->folderName[BLE_CONFIG_NAME_LEN] = 0;
+    pCfg->fileName[BLE_CONFIG_NAME_LEN] = 0;
+    return BLE_FRAME_OK;
+}
+
+#endif /* BLEFRAME_H */
@@ -0,0 +1,313 @@
+//=================================================================================================================
+// Compile-time equivalent circuits
+//
+// Elements R, C, L, CPE and W (Warburg) combine with Series<...> and Parallel<...> into a circuit type:
+//
+//   typedef circuit::Series<circuit::R, circuit::Parallel<circuit::C, circuit::R> > Randles;   // Rs, Cdl, Rct
+//
+// Model::N is the number of parameters, taken in the order the elements appear. Model::eval(p, w, dZ) returns
+// Z(w) and fills dZ[k] = dZ / dp[k] by the chain rule through the combinators, so the Jacobian is exact and
+// comes with the impedance. Everything is sized at compile time: an evaluation is inlined complex arithmetic on
+// the stack, with no allocation and no per-model code. fit_circuit<Model>() fits any such model to measured
+// data with the Marquardt loop of fit_CNLS (cnls.cpp) on fixed-size N x N normal equations.
+//
+// Data use HELPStat's convention: imag is -Im(Z), positive for a capacitive cell (see HELPStat::getResult).
+//=================================================================================================================
+#ifndef CIRCUIT_H
+#define CIRCUIT_H
+
+#include <complex>
+#include <math.h>
+#include <string.h>
+#include "eigen.h"
+#include "Arduino.h"
+#include "lma.h"
+
+#define CIRCUIT_MAX_ITER  100
+#define CIRCUIT_FTOL      1e-7f   // Relative cost reduction treated as converged
+#define CIRCUIT_XTOL      1e-5f   // Largest relative parameter step treated as converged
+
+namespace circuit {
+
+typedef std::complex<float> cfloat;
+
+static const float kHalfPi = 1.57079632679f;
+
+//=================================================================================================================
+// Elements. Each has N parameters, default bounds, and eval(p, w, dZ) returning Z at angular frequency w with
+// dZ[0..N-1] = dZ / dp.
+//=================================================================================================================
+struct R {                  // Resistor: R (ohms)
+	static const int N = 1;
+	static void bounds(float *lo, float *hi) { lo[0] = 0.0f; hi[0] = INFINITY; }
+	static inline cfloat eval(const float *p, float w, cfloat *dZ) {
+		(void)w;
+		dZ[0] = 1.0f;
+		return p[0];
+	}
+};
+
+struct C {                  // Capacitor: C (F)
+	static const int N = 1;
+	static void bounds(float *lo, float *hi) { lo[0] = 0.0f; hi[0] = INFINITY; }
+	static inline cfloat eval(const float *p, float w, cfloat *dZ) {
+		cfloat z(0.0f, -1.0f / (w * p[0]));
+		dZ[0] = -z / p[0];
+		return z;
+	}
+};
+
+struct L {                  // Inductor: L (H)
+	static const int N = 1;
+	static void bounds(float *lo, float *hi) { lo[0] = 0.0f; hi[0] = INFINITY; }
+	static inline cfloat eval(const float *p, float w, cfloat *dZ) {
+		dZ[0] = cfloat(0.0f, w);
+		return cfloat(0.0f, w * p[0]);
+	}
+};
+
+struct CPE {                // Constant phase element: Q (F s^(n-1)), n
+	static const int N = 2;
+	static void bounds(float *lo, float *hi) { lo[0] = 0.0f; hi[0] = INFINITY; lo[1] = 0.3f; hi[1] = 1.0f; }
+	static inline cfloat eval(const float *p, float w, cfloat *dZ) {
+		float lnW = logf(w);
+		cfloat z = std::polar(1.0f / (p[0] * expf(p[1] * lnW)), -p[1] * kHalfPi);  // 1 / (Q (jw)^n)
+		dZ[0] = -z / p[0];
+		dZ[1] = -z * cfloat(lnW, kHalfPi);
+		return z;
+	}
+};
+
+struct W {                  // Semi-infinite Warburg: sigma (ohm s^-1/2)
+	static const int N = 1;
+	static void bounds(float *lo, float *hi) { lo[0] = 0.0f; hi[0] = INFINITY; }
+	static inline cfloat eval(const float *p, float w, cfloat *dZ) {
+		float s = 1.0f / sqrtf(w);
+		dZ[0] = cfloat(s, -s);
+		return p[0] * dZ[0];
+	}
+};
+
+//=================================================================================================================
+// Combinators. Series<A, B, ...> adds impedances. Parallel<A, B, ...> combines them as Za Zb / (Za + Zb), which
+// scales A's derivatives by (Zb / (Za + Zb))^2 and B's by (Za / (Za + Zb))^2.
+//=================================================================================================================
+template<class... E> struct Series;
+
+template<class A> struct Series<A> : A {};
+
+template<class A, class... Rest> struct Series<A, Rest...> {
+	typedef Series<Rest...> B;
+	static const int N = A::N + B::N;
+	static void bounds(float *lo, float *hi) {
+		A::bounds(lo, hi);
+		B::bounds(lo + A::N, hi + A::N);
+	}
+	static inline cfloat eval(const float *p, float w, cfloat *dZ) {
+		return A::eval(p, w, dZ) + B::eval(p + A::N, w, dZ + A::N);
+	}
+};
+
+template<class... E> struct Parallel;
+
+template<class A> struct Parallel<A> : A {};
+
+template<class A, class... Rest> struct Parallel<A, Rest...> {
+	typedef Parallel<Rest...> B;
+	static const int N = A::N + B::N;
+	static void bounds(float *lo, float *hi) {
+		A::bounds(lo, hi);
+		B::bounds(lo + A::N, hi + A::N);
+	}
+	static inline cfloat eval(const float *p, float w, cfloat *dZ) {
+		cfloat za = A::eval(p, w, dZ);
+		cfloat zb = B::eval(p + A::N, w, dZ + A::N);
+		cfloat inv = 1.0f / (za + zb);
+		cfloat ga = zb * inv;
+		cfloat gb = za * inv;
+		ga *= ga;
+		gb *= gb;
+		for(int k = 0; k < A::N; k++) dZ[k] *= ga;
+		for(int k = 0; k < B::N; k++) dZ[A::N + k] *= gb;
+		return za * zb * inv;
+	}
+};
+
+// Common cells
+typedef Series<R, Parallel<C, R> > Randles;                           // Rs, Cdl, Rct
+typedef Series<R, Parallel<CPE, R> > RandlesCPE;                      // Rs, Q, n, Rct
+typedef Series<R, Parallel<CPE, Series<R, W> > > RandlesCPEWarburg;   // Rs, Q, n, Rct, sigma
+
+//=================================================================================================================
+// impedance
+// Description: Model impedance at freq (Hz), returned as real and -Im(Z) like the measured data.
+//=================================================================================================================
+template<class Model>
+inline void impedance(const float *p, float freq, float *pRe, float *pIm)
+{
+	cfloat dZ[Model::N];
+	cfloat z = Model::eval(p, 2.0f * (float)M_PI * freq, dZ);
+	*pRe = z.real();
+	*pIm = -z.imag();
+}
+
+template<class Model>
+struct fit {
+	float p[Model::N];  // Parameters in element order
+	float chi2;         // Weighted sum of squares at the end
+	float rmsRel;       // sqrt(chi2 / 2m): typical relative misfit per component
+	int iterations;     // Jacobian evaluations
+	int evaluations;    // Model evaluations (including rejected steps)
+	int status;         // LM_* (lma.h)
+	uint32_t timeUs;    // micros() spent in fit_circuit
+	bool converged() const { return status == LM_RELATIVE_REDUCTION_SMALL || status == LM_RELATIVE_ERROR_SMALL ||
+	                                status == LM_GTOL_SMALL; }
+};
+
+//=================================================================================================================
+// The fit works on u = ln(p), so every parameter stays positive and one step tolerance fits ohms and farads
+// alike; dZ/du = dZ/dp * p. Residuals are modulus weighted as in fit_CNLS: (Zmodel - Zmeas) / |Zmeas|.
+//=================================================================================================================
+template<class Model>
+float residuals(const Eigen::Matrix<float, Model::N, 1> &u, const float *freq, const float *zRe, const float *zIm,
+                int m, Eigen::Matrix<float, Model::N, Model::N> *jtj, Eigen::Matrix<float, Model::N, 1> *jte)
+{
+	const int n = Model::N;
+	float p[n];
+	for(int k = 0; k < n; k++) p[k] = expf(u(k));
+	float cost = 0;
+	if(jtj) {
+		jtj->setZero();
+		jte->setZero();
+	}
+	for(int i = 0; i < m; i++) {
+		cfloat dZ[n];
+		cfloat zMeas(zRe[i], -zIm[i]);
+		float weight = 1.0f / std::abs(zMeas);
+		cfloat r = (Model::eval(p, 2.0f * (float)M_PI * freq[i], dZ) - zMeas) * weight;
+		cost += std::norm(r);
+		if(!jtj) continue;
+
+		Eigen::Matrix<float, n, 1> jr, ji;
+		for(int k = 0; k < n; k++) {
+			cfloat d = dZ[k] * (p[k] * weight);
+			jr(k) = d.real();
+			ji(k) = d.imag();
+		}
+		*jtj += jr * jr.transpose() + ji * ji.transpose();
+		*jte += jr * r.real() + ji * r.imag();
+	}
+	return cost;
+}
+
+}  // namespace circuit
+
+//=================================================================================================================
+// fit_circuit
+// Description: Levenberg-Marquardt fit of Model to m points.
+// Inputs:
+// * const float *freq, *zRe, *zIm - Frequency (Hz), real and -Im impedance (ohms) of each point
+// * int m                         - Number of points, at least 3
+// * const float *pInit            - Model::N starting values, all > 0
+// * const float *pLo, *pHi        - Bounds, NULL for each element's defaults
+// Output:
+// * circuit::fit<Model>           - Parameters, cost, iterations, time and status (get_LM_status() as well)
+//=================================================================================================================
+template<class Model>
+circuit::fit<Model> fit_circuit(const float *freq, const float *zRe, const float *zIm, int m, const float *pInit,
+                                const float *pLo = NULL, const float *pHi = NULL)
+{
+	extern int status;  // lma.cpp, read with get_LM_status()
+	typedef Eigen::Matrix<float, Model::N, Model::N> matrix;
+	typedef Eigen::Matrix<float, Model::N, 1> vector;
+	const int n = Model::N;
+
+	unsigned long t0 = micros();
+	circuit::fit<Model> fit;
+	memset(&fit, 0, sizeof(fit));
+	memcpy(fit.p, pInit, sizeof(fit.p));
+	fit.status = LM_IMPROPER_INPUT;
+
+	float loP[n], hiP[n];
+	Model::bounds(loP, hiP);
+	if(pLo) memcpy(loP, pLo, sizeof(loP));
+	if(pHi) memcpy(hiP, pHi, sizeof(hiP));
+	vector u, lo, hi;
+	for(int k = 0; k < n; k++) {
+		if(!(pInit[k] > 0)) {
+			status = fit.status;
+			return fit;
+		}
+		u(k) = logf(pInit[k]);
+		lo(k) = loP[k] > 0 ? logf(loP[k]) : -INFINITY;
+		hi(k) = logf(hiP[k]);
+		u(k) = fminf(fmaxf(u(k), lo(k)), hi(k));
+	}
+	bool valid = m >= 3;
+	for(int i = 0; valid && i < m; i++) valid = freq[i] > 0 && zRe[i] * zRe[i] + zIm[i] * zIm[i] > 0;
+	if(!valid) {
+		status = fit.status;
+		return fit;
+	}
+
+	matrix jtj;
+	vector jte;
+	float lambda = 1e-3f;
+	float cost = circuit::residuals<Model>(u, freq, zRe, zIm, m, &jtj, &jte);
+	fit.evaluations = 1;
+	fit.status = LM_TOO_MANY_EVALUATIONS;
+
+	while(fit.iterations < CIRCUIT_MAX_ITER) {
+		fit.iterations++;
+		if(jte.cwiseAbs().maxCoeff() <= 1e-10f * (cost + 1e-20f)) {
+			fit.status = LM_GTOL_SMALL;
+			break;
+		}
+
+		/* Raise lambda until a (clamped) step lowers the cost */
+		bool accepted = false;
+		float newCost = cost;
+		vector trial;
+		while(lambda < 1e10f) {
+			matrix a = jtj;
+			for(int k = 0; k < n; k++) a(k, k) += lambda * fmaxf(jtj(k, k), 1e-12f);
+			trial = (u + a.ldlt().solve(-jte)).cwiseMax(lo).cwiseMin(hi);
+			newCost = circuit::residuals<Model>(trial, freq, zRe, zIm, m, NULL, NULL);
+			fit.evaluations++;
+			if(newCost < cost) {
+				accepted = true;
+				lambda = fmaxf(lambda * 0.1f, 1e-7f);
+				break;
+			}
+			if((trial - u).cwiseAbs().maxCoeff() <= CIRCUIT_XTOL) break;  // Damped below anything that matters
+			lambda *= 10.0f;
+		}
+		if(!accepted) {
+			fit.status = LM_RELATIVE_REDUCTION_SMALL;  // No step helps: at the minimum to float precision
+			break;
+		}
+
+		float step = (trial - u).cwiseAbs().maxCoeff();
+		float reduction = (cost - newCost) / fmaxf(cost, 1e-30f);
+		u = trial;
+		cost = circuit::residuals<Model>(u, freq, zRe, zIm, m, &jtj, &jte);
+		fit.evaluations++;
+		if(step <= CIRCUIT_XTOL) {
+			fit.status = LM_RELATIVE_ERROR_SMALL;
+			break;
+		}
+		if(reduction <= CIRCUIT_FTOL) {
+			fit.status = LM_RELATIVE_REDUCTION_SMALL;
+			break;
+		}
+	}
+
+	for(int k = 0; k < n; k++) fit.p[k] = expf(u(k));
+	fit.chi2 = cost;
+	fit.rmsRel = sqrtf(cost / (2.0f * m));
+	fit.timeUs = micros() - t0;
+	status = fit.status;
+	return fit;
+}
+
+#endif /* CIRCUIT_H */
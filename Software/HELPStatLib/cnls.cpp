@@ -0,0 +1,272 @@
+//=================================================================================================================
+// Complex nonlinear least-squares (CNLS) fitting of Randel cell equivalent circuits. See cnls.h.
+//=================================================================================================================
+#include <complex>
+#include "eigen.h"
+#include "Arduino.h"
+#include "cnls.h"
+
+typedef std::complex<float> cfloat;
+typedef Eigen::Matrix<float, CNLS_PARAMS, CNLS_PARAMS> cnlsMatrix;
+typedef Eigen::Matrix<float, CNLS_PARAMS, 1> cnlsVector;
+
+extern int status;  // lma.cpp, read with get_LM_status()
+
+static const float kHalfPi = 1.57079632679f;
+
+//=================================================================================================================
+// cnlsActive
+// Description: Which parameters the model fits. Rs, Rct and Q always; n and sigma only when asked for.
+//=================================================================================================================
+static void cnlsActive(uint8_t model, bool *active)
+{
+	active[CNLS_RS] = true;
+	active[CNLS_RCT] = true;
+	active[CNLS_Q] = true;
+	active[CNLS_N] = (model & CNLS_MODEL_CPE) != 0;
+	active[CNLS_SIGMA] = (model & CNLS_MODEL_WARBURG) != 0;
+}
+
+//=================================================================================================================
+// The fit works on u = (Rs / zs, Rct / zs, ln Q, n, sigma / zs), zs being the largest |Z|, so every parameter is of
+// order one and one step tolerance fits all of them.
+//=================================================================================================================
+static void cnlsToU(const cnlsParams *p, float zs, cnlsVector &u)
+{
+	u(CNLS_RS) = p->rs / zs;
+	u(CNLS_RCT) = p->rct / zs;
+	u(CNLS_Q) = logf(p->q);
+	u(CNLS_N) = p->n;
+	u(CNLS_SIGMA) = p->sigma / zs;
+}
+
+static void cnlsFromU(const cnlsVector &u, float zs, cnlsParams *p)
+{
+	p->rs = u(CNLS_RS) * zs;
+	p->rct = u(CNLS_RCT) * zs;
+	p->q = expf(u(CNLS_Q));
+	p->n = u(CNLS_N);
+	p->sigma = u(CNLS_SIGMA) * zs;
+}
+
+static void cnlsClamp(cnlsVector &u, const cnlsVector &lo, const cnlsVector &hi)
+{
+	for(int k = 0; k < CNLS_PARAMS; k++) {
+		if(u(k) < lo(k)) u(k) = lo(k);
+		if(u(k) > hi(k)) u(k) = hi(k);
+	}
+}
+
+//=================================================================================================================
+// cnlsResiduals
+// Description: Weighted cost at u and, with jtj / jte non-NULL, the normal equations J'J and J'r. With
+//              Zf = Rct + sigma (1 - j) / sqrt(w), Ydl = Q w^n e^(j n pi/2), Zp = 1 / (1 / Zf + Ydl):
+//                dZ/dRs    = 1
+//                dZ/dRct   = Zp^2 / Zf^2
+//                dZ/dsigma = Zp^2 / Zf^2 * (1 - j) / sqrt(w)
+//                dZ/dlnQ   = -Zp^2 * Ydl
+//                dZ/dn     = -Zp^2 * Ydl * (ln w + j pi/2)
+//              Each complex derivative gives one Jacobian row for the real part and one for the imaginary part.
+// Output:
+// * float - sum over points of |(Zmodel - Zmeas) / |Zmeas||^2
+//=================================================================================================================
+static float cnlsResiduals(const cnlsVector &u, const bool *active, float zs, const float *zRe, const float *zIm,
+                           int m, const cnlsWorkspace *pWork, cnlsMatrix *jtj, cnlsVector *jte)
+{
+	const cfloat j(0.0f, 1.0f);
+	float rs = u(CNLS_RS) * zs;
+	float rct = u(CNLS_RCT) * zs;
+	float q = expf(u(CNLS_Q));
+	float n = u(CNLS_N);
+	float sigma = u(CNLS_SIGMA) * zs;
+	cfloat rot = std::polar(1.0f, n * kHalfPi);  // j^n
+	float cost = 0;
+
+	if(jtj) {
+		jtj->setZero();
+		jte->setZero();
+	}
+	for(int i = 0; i < m; i++) {
+		cfloat warburg = pWork->invSqrtW[i] * (1.0f - j);
+		cfloat zf = rct + sigma * warburg;
+		cfloat yf = 1.0f / zf;
+		cfloat ydl = q * expf(n * pWork->lnW[i]) * rot;
+		cfloat zp = 1.0f / (yf + ydl);
+		cfloat r = (rs + zp - cfloat(zRe[i], -zIm[i])) * pWork->weight[i];
+		cost += std::norm(r);
+		if(!jtj) continue;
+
+		cfloat zp2 = zp * zp;
+		cfloat dz[CNLS_PARAMS];
+		dz[CNLS_RS] = zs;
+		dz[CNLS_RCT] = zp2 * yf * yf * zs;
+		dz[CNLS_Q] = -zp2 * ydl;
+		dz[CNLS_N] = -zp2 * ydl * cfloat(pWork->lnW[i], kHalfPi);
+		dz[CNLS_SIGMA] = dz[CNLS_RCT] * warburg;
+		cnlsVector jr, ji;
+		for(int k = 0; k < CNLS_PARAMS; k++) {
+			cfloat d = active[k] ? dz[k] * pWork->weight[i] : cfloat(0.0f);
+			jr(k) = d.real();
+			ji(k) = d.imag();
+		}
+		*jtj += jr * jr.transpose() + ji * ji.transpose();
+		*jte += jr * r.real() + ji * r.imag();
+	}
+	return cost;
+}
+
+cnlsBounds cnls_default_bounds(float zMax)
+{
+	cnlsBounds b;
+	b.lo[CNLS_RS] = 1e-6f * zMax;      b.hi[CNLS_RS] = 100.0f * zMax;
+	b.lo[CNLS_RCT] = 1e-6f * zMax;     b.hi[CNLS_RCT] = 100.0f * zMax;
+	b.lo[CNLS_Q] = 1e-12f;             b.hi[CNLS_Q] = 1.0f;
+	b.lo[CNLS_N] = 0.4f;               b.hi[CNLS_N] = 1.0f;
+	b.lo[CNLS_SIGMA] = 0.0f;           b.hi[CNLS_SIGMA] = 100.0f * zMax;
+	return b;
+}
+
+cnlsParams cnls_estimate(const float *freq, const float *zRe, const float *zIm, int m)
+{
+	cnlsParams p = {0, 0, 1e-6f, 1.0f, 0};
+	if(m < 1) return p;
+	int hi = 0, peak = 0;
+	for(int i = 1; i < m; i++) {
+		if(freq[i] > freq[hi]) hi = i;
+		if(zIm[i] > zIm[peak]) peak = i;
+	}
+	p.rs = zRe[hi] > 0 ? zRe[hi] : 1.0f;
+	p.rct = 2.0f * (zRe[peak] - p.rs);
+	if(p.rct <= 0.01f * p.rs) p.rct = p.rs;  // No semicircle to speak of; let the fit find it
+	p.q = 1.0f / (2.0f * (float)M_PI * freq[peak] * p.rct);
+	return p;
+}
+
+void cnls_impedance(const cnlsParams *pParams, float freq, float *pRe, float *pIm)
+{
+	const cfloat j(0.0f, 1.0f);
+	float w = 2.0f * (float)M_PI * freq;
+	cfloat zf = pParams->rct + pParams->sigma * (1.0f - j) / sqrtf(w);
+	cfloat ydl = pParams->q * powf(w, pParams->n) * std::polar(1.0f, pParams->n * kHalfPi);
+	cfloat z = pParams->rs + 1.0f / (1.0f / zf + ydl);
+	*pRe = z.real();
+	*pIm = -z.imag();
+}
+
+//=================================================================================================================
+// fit_CNLS
+// Description: See cnls.h. Same Marquardt loop as fit_Randles (lma.cpp), with every trial point clamped to the
+//              bounds before it is evaluated.
+//=================================================================================================================
+cnlsFit fit_CNLS(const float *freq, const float *zRe, const float *zIm, int m, uint8_t model,
+                 const cnlsParams *pInit, const cnlsBounds *pBounds, cnlsWorkspace *pWork)
+{
+	unsigned long t0 = micros();
+	cnlsFit fit;
+	memset(&fit, 0, sizeof(fit));
+	fit.model = model;
+	fit.status = LM_IMPROPER_INPUT;
+	if(m < 3 || m > CNLS_MAX_POINTS || pWork == NULL) {
+		status = fit.status;
+		return fit;
+	}
+
+	/* Per-point constants */
+	float zs = 0;
+	for(int i = 0; i < m; i++) {
+		float mag = sqrtf(zRe[i] * zRe[i] + zIm[i] * zIm[i]);
+		if(!(freq[i] > 0) || !(mag > 0)) {
+			status = fit.status;
+			return fit;
+		}
+		float w = 2.0f * (float)M_PI * freq[i];
+		pWork->lnW[i] = logf(w);
+		pWork->invSqrtW[i] = 1.0f / sqrtf(w);
+		pWork->weight[i] = 1.0f / mag;
+		if(mag > zs) zs = mag;
+	}
+
+	bool active[CNLS_PARAMS];
+	cnlsActive(model, active);
+	cnlsBounds bounds = pBounds ? *pBounds : cnls_default_bounds(zs);
+	cnlsParams init = pInit ? *pInit : cnls_estimate(freq, zRe, zIm, m);
+	if(!(model & CNLS_MODEL_CPE)) init.n = 1.0f;
+	if(!(model & CNLS_MODEL_WARBURG)) init.sigma = 0.0f;
+
+	cnlsParams loP, hiP;
+	memcpy(&loP, bounds.lo, sizeof(loP));
+	memcpy(&hiP, bounds.hi, sizeof(hiP));
+	cnlsVector u, lo, hi;
+	cnlsToU(&loP, zs, lo);
+	cnlsToU(&hiP, zs, hi);
+	cnlsToU(&init, zs, u);
+	for(int k = 0; k < CNLS_PARAMS; k++)
+		if(!active[k]) lo(k) = hi(k) = u(k);  // Frozen
+	cnlsClamp(u, lo, hi);
+	if(!u.allFinite()) {
+		status = fit.status;
+		return fit;
+	}
+
+	cnlsMatrix jtj;
+	cnlsVector jte;
+	float lambda = 1e-3f;
+	float cost = cnlsResiduals(u, active, zs, zRe, zIm, m, pWork, &jtj, &jte);
+	fit.evaluations = 1;
+	fit.status = LM_TOO_MANY_EVALUATIONS;
+
+	while(fit.iterations < CNLS_MAX_ITER) {
+		fit.iterations++;
+		if(jte.cwiseAbs().maxCoeff() <= 1e-10f * (cost + 1e-20f)) {
+			fit.status = LM_GTOL_SMALL;
+			break;
+		}
+
+		/* Raise lambda until a (clamped) step lowers the cost */
+		bool accepted = false;
+		float newCost = cost;
+		cnlsVector trial;
+		while(lambda < 1e10f) {
+			cnlsMatrix a = jtj;
+			for(int k = 0; k < CNLS_PARAMS; k++) {
+				if(!active[k]) a(k, k) = 1.0f;
+				else a(k, k) += lambda * fmaxf(jtj(k, k), 1e-12f);
+			}
+			trial = u + a.ldlt().solve(-jte);
+			cnlsClamp(trial, lo, hi);
+			newCost = cnlsResiduals(trial, active, zs, zRe, zIm, m, pWork, NULL, NULL);
+			fit.evaluations++;
+			if(newCost < cost) {
+				accepted = true;
+				lambda = fmaxf(lambda * 0.1f, 1e-7f);
+				break;
+			}
+			lambda *= 10.0f;
+		}
+		if(!accepted) {
+			fit.status = LM_RELATIVE_REDUCTION_SMALL;  // No step helps: at the minimum to float precision
+			break;
+		}
+
+		float stepNorm = (trial - u).norm();
+		float reduction = (cost - newCost) / fmaxf(cost, 1e-30f);
+		u = trial;
+		cost = cnlsResiduals(u, active, zs, zRe, zIm, m, pWork, &jtj, &jte);
+		fit.evaluations++;
+		if(stepNorm <= CNLS_XTOL * (u.norm() + CNLS_XTOL)) {
+			fit.status = LM_RELATIVE_ERROR_SMALL;
+			break;
+		}
+		if(reduction <= CNLS_FTOL) {
+			fit.status = LM_RELATIVE_REDUCTION_SMALL;
+			break;
+		}
+	}
+
+	cnlsFromU(u, zs, &fit.p);
+	fit.chi2 = cost;
+	fit.rmsRel = sqrtf(cost / (2.0f * m));
+	fit.timeUs = micros() - t0;
+	status = fit.status;
+	return fit;
+}
@@ -0,0 +1,113 @@
+//=================================================================================================================
+// Complex nonlinear least-squares (CNLS) fitting of Randel cell equivalent circuits
+//
+// lma.h fits the geometry of the Nyquist semicircle and ignores frequency. This fits the complex impedance itself,
+//
+//   Z(w) = Rs + 1 / ( 1 / (Rct + sigma * (1 - j) / sqrt(w))  +  Q * (j * w)^n )
+//
+// so the double layer (Cdl, or a CPE with Q and n) and a Warburg tail (sigma) come out of the same fit as Rs and
+// Rct, and low-frequency diffusion points no longer bend the semicircle. n is only fitted with CNLS_MODEL_CPE
+// (otherwise n = 1 and Q is Cdl in farads), sigma only with CNLS_MODEL_WARBURG (otherwise 0).
+//
+// Each point gives two residuals, (Zmodel - Zmeas) / |Zmeas| for the real and imaginary parts (modulus
+// weighting, so a 100 kohm point at 1 Hz counts as much as a 150 ohm one at 100 kHz). The Jacobian is analytic,
+// the normal equations are a fixed 5x5 system with the unused parameters frozen, Q is fitted as ln(Q), and every
+// step is clamped to the bounds. Per-point constants live in a caller-owned cnlsWorkspace of CNLS_MAX_POINTS,
+// so a fit allocates nothing and two fits can run at once with their own workspaces.
+//
+// Data use HELPStat's convention: imag is -Im(Z), positive for a capacitive cell (see HELPStat::getResult).
+//=================================================================================================================
+#ifndef CNLS_H
+#define CNLS_H
+
+#include <stdint.h>
+#include "lma.h"
+
+#define CNLS_MAX_POINTS  512     // Points one fit can take (all cycles together)
+#define CNLS_MAX_ITER    100
+#define CNLS_FTOL        1e-7f   // Relative cost reduction treated as converged
+#define CNLS_XTOL        1e-6f   // Relative step treated as converged
+
+// Parameters, in the order of cnlsBounds.lo / hi
+#define CNLS_RS      0
+#define CNLS_RCT     1
+#define CNLS_Q       2
+#define CNLS_N       3
+#define CNLS_SIGMA   4
+#define CNLS_PARAMS  5
+
+// Model flags
+#define CNLS_MODEL_RC       0x00  // Rs + (Rct || Cdl)
+#define CNLS_MODEL_CPE      0x01  // Fit the CPE exponent n
+#define CNLS_MODEL_WARBURG  0x02  // Fit a Warburg coefficient in series with Rct
+
+typedef struct _cnlsParams {
+	float rs;           // Solution resistance (ohms)
+	float rct;          // Charge transfer resistance (ohms)
+	float q;            // Cdl (F) when n = 1, else CPE Q (F s^(n-1))
+	float n;            // CPE exponent
+	float sigma;        // Warburg coefficient (ohm s^-1/2)
+}cnlsParams;
+
+typedef struct _cnlsBounds {
+	float lo[CNLS_PARAMS];
+	float hi[CNLS_PARAMS];
+}cnlsBounds;
+
+typedef struct _cnlsFit {
+	cnlsParams p;
+	uint8_t model;      // CNLS_MODEL_* flags the fit used
+	float chi2;         // Weighted sum of squares at the end
+	float rmsRel;       // sqrt(chi2 / 2m): typical relative misfit per component
+	int iterations;     // Jacobian evaluations
+	int evaluations;    // Model evaluations (including rejected steps)
+	int status;         // LM_* (lma.h)
+	uint32_t timeUs;    // micros() spent in fit_CNLS
+	bool converged() const { return status == LM_RELATIVE_REDUCTION_SMALL || status == LM_RELATIVE_ERROR_SMALL ||
+	                                status == LM_GTOL_SMALL; }
+}cnlsFit;
+
+typedef struct _cnlsWorkspace {
+	float lnW[CNLS_MAX_POINTS];     // ln of the angular frequency
+	float invSqrtW[CNLS_MAX_POINTS];
+	float weight[CNLS_MAX_POINTS];  // 1 / |Zmeas|
+}cnlsWorkspace;
+
+//=================================================================================================================
+// cnls_default_bounds
+// Description: Bounds wide enough for any cell the HELPStat can measure, scaled to the data's largest |Z|: all
+//              resistances and sigma in [0, 100 * |Z|max] (Rct and Rs kept just above 0), Q in [1e-12, 1],
+//              n in [0.4, 1].
+//=================================================================================================================
+cnlsBounds cnls_default_bounds(float zMax);
+
+//=================================================================================================================
+// cnls_estimate
+// Description: Starting point from the data alone: Rs from the highest-frequency real part, Rct and Cdl from the
+//              -Im(Z) peak of the semicircle (w_peak = 1 / (Rct Cdl)), n = 1 and sigma = 0.
+//=================================================================================================================
+cnlsParams cnls_estimate(const float *freq, const float *zRe, const float *zIm, int m);
+
+//=================================================================================================================
+// cnls_impedance
+// Description: Model impedance at freq (Hz), returned as real and -Im(Z) like the measured data.
+//=================================================================================================================
+void cnls_impedance(const cnlsParams *pParams, float freq, float *pRe, float *pIm);
+
+//=================================================================================================================
+// fit_CNLS
+// Description: Levenberg-Marquardt fit of the model above to m points.
+// Inputs:
+// * const float *freq, *zRe, *zIm - Frequency (Hz), real and -Im impedance (ohms) of each point
+// * int m                         - Number of points, 3 to CNLS_MAX_POINTS
+// * uint8_t model                 - CNLS_MODEL_* flags
+// * const cnlsParams *pInit       - Starting point, NULL for cnls_estimate()
+// * const cnlsBounds *pBounds     - NULL for cnls_default_bounds()
+// * cnlsWorkspace *pWork          - Scratch space, not kept between calls
+// Output:
+// * cnlsFit                       - Parameters, cost, iterations, time and status (get_LM_status() as well)
+//=================================================================================================================
+cnlsFit fit_CNLS(const float *freq, const float *zRe, const float *zIm, int m, uint8_t model,
+                 const cnlsParams *pInit, const cnlsBounds *pBounds, cnlsWorkspace *pWork);
+
+#endif /* CNLS_H */
@@ -0,0 +1,128 @@
+//=================================================================================================================
+// Linear Kramers-Kronig test of a measured spectrum. See kk.h.
+//=================================================================================================================
+#include <math.h>
+#include "eigen.h"
+#include "kk.h"
+
+#define KK_MAX_PARAMS (KK_MAX_RC + 2)
+
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, KK_MAX_PARAMS, KK_MAX_PARAMS> kkMatrix;
+typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, KK_MAX_PARAMS, 1> kkVector;
+
+//=================================================================================================================
+// kkRow
+// Description: One point's row of the design matrix, real and imaginary parts, for x = (R0, L * wMax, R1..RM).
+//              The L column is scaled by 1 / wMax so it is of order one like the others.
+//=================================================================================================================
+static void kkRow(double w, double wMax, const double *tau, int rc, double *aRe, double *aIm)
+{
+	aRe[0] = 1.0;
+	aIm[0] = 0.0;
+	aRe[1] = 0.0;
+	aIm[1] = w / wMax;
+	for(int k = 0; k < rc; k++) {
+		double wt = w * tau[k];
+		double d = 1.0 / (1.0 + wt * wt);
+		aRe[k + 2] = d;
+		aIm[k + 2] = -wt * d;
+	}
+}
+
+//=================================================================================================================
+// kkUsable
+// Description: True for a point the fit can use: a finite, positive frequency and a finite, non-zero |Z|. A
+//              point that failed to measure is stored with zero impedance and is left out this way.
+//=================================================================================================================
+static bool kkUsable(float f, float re, float im)
+{
+	double mag2 = (double)re * re + (double)im * im;
+	return f > 0 && isfinite(f) && mag2 > 0 && isfinite(mag2);
+}
+
+kkResult kk_test(const float *freq, const float *zRe, const float *zIm, int m, float maxResidual,
+                 float *pResRe, float *pResIm)
+{
+	kkResult res = {0, 0, 0, 0, 0, 1.0f, true};
+	if(pResRe) for(int i = 0; i < m; i++) pResRe[i] = 0;
+	if(pResIm) for(int i = 0; i < m; i++) pResIm[i] = 0;
+
+	/* Band and basis size, over the usable points only */
+	double fMin = INFINITY, fMax = 0;
+	for(int i = 0; i < m; i++) {
+		if(!kkUsable(freq[i], zRe[i], zIm[i])) continue;
+		res.points++;
+		if(freq[i] < fMin) fMin = freq[i];
+		if(freq[i] > fMax) fMax = freq[i];
+	}
+	int used = res.points;
+	if(used < m && used < 3) {  // Points were lost and too few are left to say anything: fail the sweep
+		res.pass = false;
+		return res;
+	}
+	if(used < 3) return res;
+	int rc = (int)ceil(log10(fMax / fMin) * KK_RC_PER_DECADE) + 1;
+	if(rc > KK_MAX_RC) rc = KK_MAX_RC;
+	if(rc > 2 * used / 3) rc = 2 * used / 3;  // Keep 2m equations well above the rc + 2 unknowns
+	if(rc < 1) return res;
+
+	double tau[KK_MAX_RC];
+	double wMin = 2.0 * M_PI * fMin, wMax = 2.0 * M_PI * fMax;
+	for(int k = 0; k < rc; k++)
+		tau[k] = rc > 1 ? exp(-log(wMax) + k * log(wMax / wMin) / (rc - 1)) : 1.0 / sqrt(wMin * wMax);
+
+	/* Normal equations of the modulus-weighted fit */
+	int n = rc + 2;
+	kkMatrix ata = kkMatrix::Zero(n, n);
+	kkVector atb = kkVector::Zero(n);
+	double aRe[KK_MAX_PARAMS], aIm[KK_MAX_PARAMS];
+	for(int i = 0; i < m; i++) {
+		if(!kkUsable(freq[i], zRe[i], zIm[i])) continue;
+		double wgt = 1.0 / sqrt((double)zRe[i] * zRe[i] + (double)zIm[i] * zIm[i]);
+		kkRow(2.0 * M_PI * freq[i], wMax, tau, rc, aRe, aIm);
+		double bRe = zRe[i] * wgt, bIm = -zIm[i] * wgt;
+		for(int r = 0; r < n; r++) {
+			double uRe = aRe[r] * wgt, uIm = aIm[r] * wgt;
+			atb(r) += uRe * bRe + uIm * bIm;
+			for(int c = 0; c <= r; c++) ata(r, c) += uRe * aRe[c] * wgt + uIm * aIm[c] * wgt;
+		}
+	}
+	for(int r = 0; r < n; r++) {
+		for(int c = r + 1; c < n; c++) ata(r, c) = ata(c, r);
+		ata(r, r) *= 1.0 + 1e-12;  // The RC columns are close to collinear; keep the factorisation definite
+	}
+	kkVector x = ata.ldlt().solve(atb);
+
+	/* Residuals */
+	double sumSq = 0, pos = 0, neg = 0;
+	for(int i = 0; i < m; i++) {
+		if(!kkUsable(freq[i], zRe[i], zIm[i])) continue;
+		double mag = sqrt((double)zRe[i] * zRe[i] + (double)zIm[i] * zIm[i]);
+		kkRow(2.0 * M_PI * freq[i], wMax, tau, rc, aRe, aIm);
+		double fitRe = 0, fitIm = 0;
+		for(int k = 0; k < n; k++) {
+			fitRe += aRe[k] * x(k);
+			fitIm += aIm[k] * x(k);
+		}
+		float dRe = (float)((zRe[i] - fitRe) / mag);
+		float dIm = (float)((zIm[i] + fitIm) / mag);  // zIm is -Im(Z)
+		if(pResRe) pResRe[i] = dRe;
+		if(pResIm) pResIm[i] = dIm;
+		sumSq += (double)dRe * dRe + (double)dIm * dIm;
+		float worst = fmaxf(fabsf(dRe), fabsf(dIm));
+		if(worst > res.maxResidual) {
+			res.maxResidual = worst;
+			res.worstPoint = i;
+		}
+	}
+	for(int k = 0; k < rc; k++) {
+		if(x(k + 2) >= 0) pos += x(k + 2);
+		else neg -= x(k + 2);
+	}
+
+	res.rcCount = rc;
+	res.rmsResidual = (float)sqrt(sumSq / (2.0 * used));
+	res.mu = pos > 0 ? (float)(1.0 - neg / pos) : 0.0f;
+	res.pass = res.maxResidual <= maxResidual;
+	return res;
+}
@@ -0,0 +1,52 @@
+//=================================================================================================================
+// Linear Kramers-Kronig test of a measured spectrum
+//
+// A causal, linear, stationary system has an impedance that a series of RC elements can reproduce:
+//
+//   Z(w) = R0 + j w L + sum_k Rk / (1 + j w tau_k)
+//
+// With the time constants tau_k fixed (log spaced over the measured band, KK_RC_PER_DECADE per decade) the model
+// is linear in R0, L and Rk, so it is fitted by one linear least-squares solve instead of an iterative fit
+// (Boukamp, J. Electrochem. Soc. 142 (1995) 1885; Schoenleber et al., Electrochim. Acta 131 (2014) 20). What the
+// RC series cannot follow is drift or a disturbance during the sweep: the residuals (Zmeas - Zfit) / |Zmeas| of
+// such a sweep grow well past the noise. A sweep passes when no residual, real or imaginary, exceeds the
+// threshold.
+//
+// The normal equations are accumulated in double and solved on the stack (at most KK_MAX_RC + 2 unknowns), so
+// the test allocates nothing. Data use HELPStat's convention: imag is -Im(Z), positive for a capacitive cell.
+//=================================================================================================================
+#ifndef KK_H
+#define KK_H
+
+#include <stdint.h>
+
+#define KK_RC_PER_DECADE   3       // RC elements per decade of the measured band
+#define KK_MAX_RC          32      // RC elements at most (also limited to 2m / 3 for m points)
+#define KK_MAX_RESIDUAL    0.03f   // Default pass threshold: largest |residual| as a fraction of |Z| (above the noise)
+
+typedef struct _kkResult {
+	int points;         // Usable points tested (non-positive or NaN frequency, zero or NaN |Z| are left out)
+	int rcCount;        // RC elements in the basis (0: too few points to test, counted as a pass)
+	float maxResidual;  // Largest |real| or |imag| residual, as a fraction of |Z|
+	float rmsResidual;  // RMS over every real and imaginary residual
+	int worstPoint;     // Index (into the data given) of maxResidual
+	float mu;           // 1 - sum |Rk < 0| / sum Rk >= 0; well below 1 means the basis is fitting noise
+	bool pass;          // maxResidual <= the threshold; false when points were left out and fewer than 3 remain
+}kkResult;
+
+//=================================================================================================================
+// kk_test
+// Description: Fits the RC series to m points and reports the residuals. Points that cannot be used (a failed
+//              measurement) are left out of the fit and get zero residuals.
+// Inputs:
+// * const float *freq, *zRe, *zIm - Frequency (Hz), real and -Im impedance (ohms) of each point, any order
+// * int m                         - Number of points
+// * float maxResidual             - Pass threshold (fraction of |Z|), e.g. KK_MAX_RESIDUAL
+// * float *pResRe, *pResIm        - m residuals each, (Zmeas - Zfit) / |Zmeas| (imag as -Im); either may be NULL
+// Output:
+// * kkResult                      - Residual summary and the verdict
+//=================================================================================================================
+kkResult kk_test(const float *freq, const float *zRe, const float *zIm, int m, float maxResidual,
+                 float *pResRe, float *pResIm);
+
+#endif /* KK_H */
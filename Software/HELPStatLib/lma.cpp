@@ -27,8 +27,9 @@
 #include <vector>
 #include "eigen.h"
 #include "Arduino.h"
+#include "lma.h"
 
-// Internal variable used to monitor status of Levenberg-Marquardt algorithm. No related functionality (yet)
+// Status of the last Levenberg-Marquardt run, read with get_LM_status()
 // -2: NotStarted
 // -1: Running
 //  0: ImproperInputParameters
@@ -41,7 +42,7 @@
 //  7: XtolTooSmall
 //  8: GtolTooSmall
 //  9: UserAsked
-int status;
+int status = LM_NOT_STARTED;
 
 //=================================================================================================================
 // LMFunctorRct
@@ -210,12 +211,12 @@ struct LMFunctorRs {
 // Inputs:
 // * float rct_estimate        - Initial estimate for Rct (charge transfer resistance) in ohms
 // * float rs_estimate         - Initial estimate for Rs  (solution resistance) in ohms
-// * std::vector<float> r_data - Vector of real impedence data in ohms
-// * std::vector<float> i_data - Vector of imaginary impedence data in ohms
+// * const std::vector<float> &r_data - Vector of real impedence data in ohms
+// * const std::vector<float> &i_data - Vector of imaginary impedence data in ohms
 // Output:
 // * float Rct                 - Optimized value for Rct (charge transfer resistance) in ohms
 //=================================================================================================================
-float calculate_Rct(float rct_estimate, float rs_estimate, std::vector<float> r_data, std::vector<float> i_data) {
+float calculate_Rct(float rct_estimate, float rs_estimate, const std::vector<float> &r_data, const std::vector<float> &i_data) {
 	Eigen::VectorXf param_rct(2); // Estimates
 	param_rct(0) = rct_estimate;
 	param_rct(1) = rs_estimate;
@@ -247,12 +248,12 @@ float calculate_Rct(float rct_estimate, float rs_estimate, std::vector<float> r_
 // Inputs:
 // * float rct_estimate        - Initial estimate for Rct (charge transfer resistance) in ohms
 // * float rs_estimate         - Initial estimate for Rs  (series resistance) in ohms
-// * std::vector<float> r_data - Vector of real impedence data in ohms
-// * std::vector<float> i_data - Vector of imaginary impedence data in ohms
+// * const std::vector<float> &r_data - Vector of real impedence data in ohms
+// * const std::vector<float> &i_data - Vector of imaginary impedence data in ohms
 // Output:
 // * float Rs                  - Optimized value for Rs (solution resistance) in ohms
 //=================================================================================================================
-float calculate_Rs(float rct_estimate, float rs_estimate, std::vector<float> r_data, std::vector<float> i_data) {
+float calculate_Rs(float rct_estimate, float rs_estimate, const std::vector<float> &r_data, const std::vector<float> &i_data) {
 	Eigen::VectorXf param_rs(2); // Estimates
 	param_rs(0) = rct_estimate;
 	param_rs(1) = rs_estimate;
@@ -275,4 +276,168 @@ float calculate_Rs(float rct_estimate, float rs_estimate, std::vector<float> r_d
 	status = lm_rs.minimize(param_rs);
 	
 	return(param_rs(1));
-  }
\ No newline at end of file
+  }
+
+//=================================================================================================================
+// randlesResiduals
+// Description: Residuals of fit_Randles for parameters (rct, rs) on data scaled by 1/scale. With jtj / jte non-NULL
+//              it also accumulates the 2x2 normal equations J'J and J'e. For point (x, y), with c = Rs + Rct/2
+//              and d = sqrt((x - c)^2 + y^2):
+//                e       = d - Rct/2
+//                de/dRct = -0.5 * (x - c) / d - 0.5
+//                de/dRs  = -(x - c) / d
+// Output:
+// * float - 0.5 * sum(e^2)
+//=================================================================================================================
+static float randlesResiduals(float rct, float rs, const float *r_data, const float *i_data, int m, float scale,
+                              Eigen::Matrix2f *jtj, Eigen::Vector2f *jte)
+{
+	float c = rs + 0.5f * rct;
+	float r = 0.5f * rct;
+	float cost = 0;
+	if(jtj) {
+		jtj->setZero();
+		jte->setZero();
+	}
+	for(int i = 0; i < m; i++) {
+		float dx = r_data[i] * scale - c;
+		float y = i_data[i] * scale;
+		float d = sqrtf(dx * dx + y * y);
+		float e = d - r;
+		cost += e * e;
+		if(jtj) {
+			float u = d > 0 ? dx / d : 0;   // d = 0 only for a point exactly at the centre
+			Eigen::Vector2f j(-0.5f * u - 0.5f, -u);
+			*jtj += j * j.transpose();
+			*jte += j * e;
+		}
+	}
+	return 0.5f * cost;
+}
+
+//=================================================================================================================
+// fit_Randles
+// Description: See lma.h. Marquardt's damping (lambda * diag(J'J)), lambda divided by 10 after an accepted step and
+//              multiplied by 10 after a rejected one. The data are scaled by the largest |Z| so the float sums stay
+//              well conditioned whatever the cell's impedance.
+//=================================================================================================================
+randlesFit fit_Randles(float rct_estimate, float rs_estimate, const float *r_data, const float *i_data, int m)
+{
+	randlesFit fit = {rct_estimate, rs_estimate, 0, 0, 0, 0, LM_IMPROPER_INPUT};
+	if(m < 2 || !isfinite(rct_estimate) || !isfinite(rs_estimate)) {
+		status = fit.status;
+		return fit;
+	}
+
+	float zMax = 0;
+	for(int i = 0; i < m; i++) {
+		zMax = fmaxf(zMax, fabsf(r_data[i]));
+		zMax = fmaxf(zMax, fabsf(i_data[i]));
+	}
+	float scale = zMax > 0 ? 1.0f / zMax : 1.0f;
+
+	Eigen::Vector2f p(rct_estimate * scale, rs_estimate * scale);
+	Eigen::Matrix2f jtj;
+	Eigen::Vector2f jte;
+	float lambda = 1e-3f;
+	float cost = randlesResiduals(p(0), p(1), r_data, i_data, m, scale, &jtj, &jte);
+	fit.evaluations = 1;
+	fit.status = LM_TOO_MANY_EVALUATIONS;
+
+	while(fit.iterations < RANDLES_MAX_ITER) {
+		fit.iterations++;
+		if(jte.cwiseAbs().maxCoeff() <= 1e-12f) {
+			fit.status = LM_GTOL_SMALL;
+			break;
+		}
+
+		/* Raise lambda until a step lowers the cost */
+		bool accepted = false;
+		float newCost = cost;
+		Eigen::Vector2f step;
+		while(lambda < 1e10f) {
+			Eigen::Matrix2f a = jtj;
+			a(0, 0) += lambda * fmaxf(jtj(0, 0), 1e-12f);
+			a(1, 1) += lambda * fmaxf(jtj(1, 1), 1e-12f);
+			step = a.inverse() * -jte;
+			newCost = randlesResiduals(p(0) + step(0), p(1) + step(1), r_data, i_data, m, scale, NULL, NULL);
+			fit.evaluations++;
+			if(newCost < cost) {
+				accepted = true;
+				lambda = fmaxf(lambda * 0.1f, 1e-7f);
+				break;
+			}
+			lambda *= 10.0f;
+		}
+		if(!accepted) {
+			fit.status = LM_RELATIVE_REDUCTION_SMALL;  // No step helps: at the minimum to float precision
+			break;
+		}
+
+		p += step;
+		float reduction = (cost - newCost) / fmaxf(cost, 1e-30f);
+		cost = randlesResiduals(p(0), p(1), r_data, i_data, m, scale, &jtj, &jte);
+		fit.evaluations++;
+		if(step.norm() <= RANDLES_XTOL * (p.norm() + RANDLES_XTOL)) {
+			fit.status = LM_RELATIVE_ERROR_SMALL;
+			break;
+		}
+		if(reduction <= RANDLES_FTOL) {
+			fit.status = LM_RELATIVE_REDUCTION_SMALL;
+			break;
+		}
+	}
+
+	fit.rct = p(0) / scale;
+	fit.rs = p(1) / scale;
+	fit.cost = cost / (scale * scale);
+	fit.rmsError = sqrtf(2.0f * fit.cost / m);
+	status = fit.status;
+	return fit;
+}
+
+randlesFit fit_Randles(float rct_estimate, float rs_estimate, const std::vector<float> &r_data,
+                       const std::vector<float> &i_data)
+{
+	int m = r_data.size() < i_data.size() ? r_data.size() : i_data.size();
+	return fit_Randles(rct_estimate, rs_estimate, r_data.data(), i_data.data(), m);
+}
+
+void randles_online_reset(randlesOnline *pOnline)
+{
+	memset(pOnline, 0, sizeof(*pOnline));
+}
+
+void randles_online_add(randlesOnline *pOnline, float re, float im)
+{
+	double x = re;
+	double z = x * x + (double)im * im;
+	pOnline->sx += x;
+	pOnline->sxx += x * x;
+	pOnline->sz += z;
+	pOnline->sxz += x * z;
+	pOnline->n++;
+}
+
+bool randles_online_estimate(const randlesOnline *pOnline, float *pRct, float *pRs)
+{
+	if(pOnline->n < 3) return false;
+	/* [sxx sx; sx n] [a; b] = [sxz; sz] */
+	double n = pOnline->n;
+	double det = pOnline->sxx * n - pOnline->sx * pOnline->sx;
+	if(!(det > 1e-9 * pOnline->sxx * n)) return false;
+	double a = (pOnline->sxz * n - pOnline->sx * pOnline->sz) / det;
+	double b = (pOnline->sxx * pOnline->sz - pOnline->sx * pOnline->sxz) / det;
+	double c = 0.5 * a;
+	double r2 = b + c * c;
+	if(!(r2 > 0)) return false;
+	double r = sqrt(r2);
+	*pRct = 2.0 * r;
+	*pRs = c - r;
+	return true;
+}
+
+int get_LM_status(void)
+{
+	return status;
+}
@@ -24,9 +24,95 @@
 //   Rct by roughly 10kOhm. To compromise, both equations were used; the first for calculating Rct and the second
 //   for calculating Rs.
 //=================================================================================================================
+#ifndef LMA_H
+#define LMA_H
+
 #include <vector>
 #include "eigen.h"
 
+// Levenberg-Marquardt status, same numbering as Eigen::LevenbergMarquardtSpace::Status
+#define LM_NOT_STARTED              -2
+#define LM_IMPROPER_INPUT            0  // Fewer than two points, or a non-finite estimate
+#define LM_RELATIVE_REDUCTION_SMALL  1  // Converged: cost stopped dropping
+#define LM_RELATIVE_ERROR_SMALL      2  // Converged: step smaller than the tolerance
+#define LM_TOO_MANY_EVALUATIONS      5  // Hit RANDLES_MAX_ITER
+#define LM_GTOL_SMALL                8  // Converged: gradient vanished
+
+#define RANDLES_MAX_ITER  100     // Iteration limit for fit_Randles
+#define RANDLES_FTOL      1e-6f   // Relative cost reduction treated as converged
+#define RANDLES_XTOL      1e-5f   // Relative step treated as converged
+
+//=================================================================================================================
+// randlesFit
+// Description: Result of fit_Randles. converged() is true for the LM_RELATIVE_* / LM_GTOL_SMALL statuses.
+//=================================================================================================================
+typedef struct _randlesFit {
+	float rct;          // Charge transfer resistance (ohms)
+	float rs;           // Solution resistance (ohms)
+	int iterations;     // Jacobian evaluations
+	int evaluations;    // Residual evaluations (including rejected steps)
+	float cost;         // Final 0.5 * sum(residual^2), ohms^2
+	float rmsError;     // sqrt(2 * cost / points): typical distance of a point from the fitted semicircle (ohms)
+	int status;         // LM_* above
+	bool converged() const { return status == LM_RELATIVE_REDUCTION_SMALL || status == LM_RELATIVE_ERROR_SMALL ||
+	                                status == LM_GTOL_SMALL; }
+}randlesFit;
+
+//=================================================================================================================
+// fit_Randles
+// Description: Fits Rs and Rct together to the Randel cell's Nyquist semicircle (centre Rs + Rct/2 on the real
+//              axis, radius Rct/2). The residual of each point is its distance from the centre minus the radius,
+//              which is defined everywhere (no sqrt of a negative number) and puts equal weight on both
+//              resistances. The Jacobian is closed-form and the normal equations are a fixed 2x2 system, so an
+//              iteration is a single pass over the data with no allocation.
+// Inputs:
+// * float rct_estimate  - Initial estimate for Rct (charge transfer resistance) in ohms
+// * float rs_estimate   - Initial estimate for Rs  (solution resistance) in ohms
+// * const float *r_data - Real impedence data in ohms
+// * const float *i_data - Imaginary impedence data in ohms (sign does not matter)
+// * int m               - Number of points
+// Output:
+// * randlesFit          - Rct, Rs, iteration count, final cost and status
+//=================================================================================================================
+randlesFit fit_Randles(float rct_estimate, float rs_estimate, const float *r_data, const float *i_data, int m);
+randlesFit fit_Randles(float rct_estimate, float rs_estimate, const std::vector<float> &r_data,
+                       const std::vector<float> &i_data);
+
+//=================================================================================================================
+// randlesOnline
+// Description: Running sums for an algebraic semicircle fit that is updated one point at a time. With the centre
+//              c on the real axis, (x - c)^2 + y^2 = r^2 is linear in a = 2c and b = r^2 - c^2:
+//                x^2 + y^2 = a * x + b
+//              so the least-squares (a, b) only need sums of x, x^2, z = x^2 + y^2 and x * z. Each point costs a
+//              handful of multiply-adds and any number of points can be solved in O(1). The algebraic fit leans
+//              towards the larger points with noise, so it is a provisional value and the starting point for
+//              fit_Randles, which then needs only an iteration or two.
+//=================================================================================================================
+typedef struct _randlesOnline {
+	double sx;          // Sums in double: x * z grows like |Z|^3
+	double sxx;
+	double sz;
+	double sxz;
+	uint32_t n;
+}randlesOnline;
+
+void randles_online_reset(randlesOnline *pOnline);
+void randles_online_add(randlesOnline *pOnline, float re, float im);
+
+//=================================================================================================================
+// randles_online_estimate
+// Description: Rct and Rs from the points added so far. Returns false (outputs untouched) with fewer than three
+//              points or while they do not yet describe an arc (all at one real value, or r^2 <= 0).
+//=================================================================================================================
+bool randles_online_estimate(const randlesOnline *pOnline, float *pRct, float *pRs);
+
+//=================================================================================================================
+// get_LM_status
+// Description: Status (LM_* / Eigen LevenbergMarquardtSpace::Status) of the last calculate_Rct, calculate_Rs or
+//              fit_Randles call.
+//=================================================================================================================
+int get_LM_status(void);
+
 //=================================================================================================================
 // calculate_Rct
 // Description: Given real and imaginary impedence data, this function calculates and returns the optimal Rct value
@@ -34,12 +120,12 @@
 // Inputs:
 // * float rct_estimate        - Initial estimate for Rct (charge transfer resistance) in ohms
 // * float rs_estimate         - Initial estimate for Rs  (solution resistance) in ohms
-// * std::vector<float> r_data - Vector of real impedence data in ohms
-// * std::vector<float> i_data - Vector of imaginary impedence data in ohms
+// * const std::vector<float> &r_data - Vector of real impedence data in ohms
+// * const std::vector<float> &i_data - Vector of imaginary impedence data in ohms
 // Output:
 // * float Rct                 - Optimized value for Rct (charge transfer resistance) in ohms
 //=================================================================================================================
-float calculate_Rct(float rct_estimate, float rs_estimate, std::vector<float> r_data, std::vector<float> i_data);
+float calculate_Rct(float rct_estimate, float rs_estimate, const std::vector<float> &r_data, const std::vector<float> &i_data);
 
 //=================================================================================================================
 // calculate_Rs
@@ -48,9 +134,11 @@ float calculate_Rct(float rct_estimate, float rs_estimate, std::vector<float> r_
 // Inputs:
 // * float rct_estimate        - Initial estimate for Rct (charge transfer resistance) in ohms
 // * float rs_estimate         - Initial estimate for Rs  (series resistance) in ohms
-// * std::vector<float> r_data - Vector of real impedence data in ohms
-// * std::vector<float> i_data - Vector of imaginary impedence data in ohms
+// * const std::vector<float> &r_data - Vector of real impedence data in ohms
+// * const std::vector<float> &i_data - Vector of imaginary impedence data in ohms
 // Output:
 // * float Rs                  - Optimized value for Rs (solution resistance) in ohms
 //=================================================================================================================
-float calculate_Rs(float rct_estimate, float rs_estimate, std::vector<float> r_data, std::vector<float> i_data);
\ No newline at end of file
+float calculate_Rs(float rct_estimate, float rs_estimate, const std::vector<float> &r_data, const std::vector<float> &i_data);
+
+#endif /* LMA_H */
@@ -0,0 +1,69 @@
+/*
+    FILENAME: pointqueue.h
+
+    Lock-free single-producer / single-consumer ring of logPoint records
+    (sessionlog.h). The measurement loop pushes each finished point and the
+    storage task pops them on the other core, so neither ever waits on a lock.
+
+    Only the producer writes head and only the consumer writes tail. The
+    release store of head publishes the record written before it; the release
+    store of tail hands the slot back. size must be a power of two; the ring
+    holds size - 1 records.
+*/
+
+#ifndef POINTQUEUE_H
+#define POINTQUEUE_H
+
+#include "sessionlog.h"
+
+typedef struct _pointQueue {
+    logPoint *pBuf;
+    uint32_t size;          // Slots, power of two
+    uint32_t head;          // Next slot to write (producer)
+    uint32_t tail;          // Next slot to read (consumer)
+    uint32_t maxDepth;      // Deepest the ring got (producer)
+}pointQueue;
+
+static inline void pointQueueInit(pointQueue *pQueue, logPoint *pBuf, uint32_t size)
+{
+    pQueue->pBuf = pBuf;
+    pQueue->size = size;
+    pQueue->head = 0;
+    pQueue->tail = 0;
+    pQueue->maxDepth = 0;
+}
+
+static inline uint32_t pointQueueDepth(pointQueue *pQueue)
+{
+    uint32_t head = __atomic_load_n(&pQueue->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&pQueue->tail, __ATOMIC_ACQUIRE);
+    return (head - tail) & (pQueue->size - 1);
+}
+
+/* Producer side. Returns 0 if the ring is full */
+static inline int pointQueuePush(pointQueue *pQueue, const logPoint *pPoint)
+{
+    uint32_t head = pQueue->head;
+    uint32_t next = (head + 1) & (pQueue->size - 1);
+    uint32_t tail = __atomic_load_n(&pQueue->tail, __ATOMIC_ACQUIRE);
+    if(next == tail) return 0;
+    pQueue->pBuf[head] = *pPoint;
+    __atomic_store_n(&pQueue->head, next, __ATOMIC_RELEASE);
+
+    uint32_t depth = (next - tail) & (pQueue->size - 1);
+    if(depth > pQueue->maxDepth) pQueue->maxDepth = depth;
+    return 1;
+}
+
+/* Consumer side. Returns 0 if the ring is empty */
+static inline int pointQueuePop(pointQueue *pQueue, logPoint *pPoint)
+{
+    uint32_t tail = pQueue->tail;
+    uint32_t head = __atomic_load_n(&pQueue->head, __ATOMIC_ACQUIRE);
+    if(tail == head) return 0;
+    *pPoint = pQueue->pBuf[tail];
+    __atomic_store_n(&pQueue->tail, (tail + 1) & (pQueue->size - 1), __ATOMIC_RELEASE);
+    return 1;
+}
+
+#endif /* POINTQUEUE_H */
@@ -0,0 +1,152 @@
+/*
+    FILENAME: sessionlog.h
+
+    Binary session log (.hsl) written to the SD card while a sweep runs, and the
+    raw DFT record the results are stored as. Plain C with no Arduino
+    dependencies so host tools (Software/HostSim/tools/hsl2csv.cpp) read the
+    same definitions as the firmware.
+
+    A log is a sequence of blocks:
+
+        logBlockHdr | payload (length bytes) | CRC-32 of header + payload
+
+    The first block is LOG_BLOCK_SESSION (logSessionHdr: configuration, gain
+    table, firmware version). Then LOG_BLOCK_POINTS blocks of count logPoint
+    records, written as points complete, and LOG_BLOCK_END when the run
+    finishes. A run that dies part-way leaves every block up to the last flush
+    readable; a block with a bad CRC is skipped by finding the next magic.
+
+    A cycle that fails the Kramers-Kronig test (HELPStat::setKKTest) is
+    measured again and its points are logged again with the next attempt
+    number; readers keep, for each cycle, the points of its last attempt.
+    Format 1 logs have 28-byte points without the attempt (always 0).
+
+    All fields are little-endian, as on the ESP32-S3.
+*/
+
+#ifndef SESSIONLOG_H
+#define SESSIONLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOG_MAGIC           0x42534C48  // "HLSB"
+#define LOG_FORMAT_VERSION  2
+
+#define LOG_BLOCK_SESSION   1
+#define LOG_BLOCK_POINTS    2
+#define LOG_BLOCK_END       3
+
+#define LOG_MAX_GAINS       16    // Gain table entries kept in the session header
+
+/* Compact result record: sweep point + the raw Rcal / Rz DFT pair (HELPStat::decodeRecord) */
+#define DFTREC_VALID  0x01   // Point was measured
+#define DFTREC_SYNTH  0x02   // Pair synthesized from a computed ratio (AD5940_DFTMeasureEIS)
+#define DFTREC_CAL    0x04   // Rcal half from the calibration table and / or open / short compensated
+#define DFTREC_MSINE  0x08   // Both halves are tone bins of a multisine acquisition (AD5940_MultisineMeasure)
+#define DFTREC_FAILED 0x10   // Point was attempted but no impedance came of it (DFT timeout, zero leg); not VALID
+
+typedef struct _dftRecord {
+    uint16_t freqIdx;   // Sweep point; the frequency comes from the sweep setup (sweepFreq)
+    uint8_t dft[9];     // Rcal real, Rcal imag, Rz real, Rz imag: 18-bit two's complement, LSB first
+    uint8_t flags;      // DFTREC_*
+}dftRecord;
+
+typedef struct _logBlockHdr {
+    uint32_t magic;     // LOG_MAGIC
+    uint16_t type;      // LOG_BLOCK_*
+    uint16_t count;     // Records in the payload
+    uint32_t seq;       // Block number, 0 = session header
+    uint32_t length;    // Payload bytes
+}logBlockHdr;
+
+typedef struct _logGain {
+    float freq;
+    int32_t rTIA;
+}logGain;
+
+typedef struct _logSessionHdr {
+    uint32_t version;       // LOG_FORMAT_VERSION
+    char firmware[16];      // HELPSTAT_FW_VERSION
+    uint32_t startMs;       // millis() when the log was opened
+    float startFreq;
+    float endFreq;
+    uint32_t numPoints;     // Points per decade
+    uint32_t sweepPoints;   // Points per cycle
+    uint32_t numCycles;     // Cycles after the first (runSweep numCycles)
+    uint32_t delaySecs;
+    float rcalVal;
+    float biasVolt;
+    float zeroVolt;
+    int32_t extGain;
+    int32_t dacGain;
+    uint32_t gainArrSize;
+    logGain gains[LOG_MAX_GAINS];
+}logSessionHdr;
+
+typedef struct _logPoint {
+    uint32_t timeMs;        // millis() when the point completed
+    float freq;
+    uint16_t cycle;
+    uint8_t settleStatus;   // SETTLE_*
+    uint8_t range;          // RTIA / gains the point was measured with (logRangePack), 0 = not recorded
+    float settleMs;
+    dftRecord rec;
+    uint8_t attempt;        // 0, or the repeat of the cycle after a failed KK test
+    uint8_t reserved[3];
+}logPoint;
+
+#define LOG_POINT_SIZE_V1   28    // logPoint up to the attempt, as written by format 1
+
+typedef struct _logEnd {
+    uint32_t points;        // Points logged in the session
+    uint32_t endMs;
+}logEnd;
+
+/* logPoint.range: HSTIARTIA_xxx in the low bits, EXCITBUFGAIN_0P25 / HSDACGAIN_0P2 as flags */
+#define LOG_RANGE_RTIA  0x0F
+#define LOG_RANGE_EXT   0x10
+#define LOG_RANGE_DAC   0x20
+#define LOG_RANGE_SET   0x80
+
+static inline uint8_t logRangePack(int rTIA, int extGain, int dacGain)
+{
+    return (uint8_t)(LOG_RANGE_SET | (rTIA & LOG_RANGE_RTIA) | (extGain ? LOG_RANGE_EXT : 0) |
+                     (dacGain ? LOG_RANGE_DAC : 0));
+}
+
+/* CRC-32 (IEEE 802.3, reflected 0xEDB88320). Pass 0 to start, the previous result to continue. */
+static inline uint32_t logCrc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while(len--) {
+        crc ^= *p++;
+        for(int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+/* Packs the four DFT values (18-bit two's complement, as read from the AFE) back to back, LSB first */
+static inline void dftRecordPack(dftRecord *pRec, uint16_t freqIdx, const int32_t *pDft, uint8_t flags)
+{
+    uint64_t lo = 0;
+    for(int i = 0; i < 4; i++)
+        lo |= (uint64_t)(pDft[i] & 0x3ffff) << (18 * i);   // 72 bits: 64 here, 8 in the top byte
+    for(int i = 0; i < 8; i++) pRec->dft[i] = (uint8_t)(lo >> (8 * i));
+    pRec->dft[8] = (uint8_t)((pDft[3] & 0x3ffff) >> 10);
+    pRec->freqIdx = freqIdx;
+    pRec->flags = flags;
+}
+
+static inline void dftRecordUnpack(const dftRecord *pRec, int32_t *pDft)
+{
+    uint64_t lo = 0;
+    for(int i = 0; i < 8; i++) lo |= (uint64_t)pRec->dft[i] << (8 * i);
+    for(int i = 0; i < 3; i++) pDft[i] = (int32_t)((lo >> (18 * i)) & 0x3ffff);
+    pDft[3] = (int32_t)((lo >> 54) | ((uint32_t)pRec->dft[8] << 10));
+    for(int i = 0; i < 4; i++)
+        if(pDft[i] & (1L<<17)) pDft[i] |= (int32_t)0xfffc0000; /* Bit17 is the sign bit */
+}
+
+#endif /* SESSIONLOG_H */
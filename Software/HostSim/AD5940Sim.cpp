@@ -0,0 +1,667 @@
+/*
+    FILENAME: AD5940Sim.cpp
+
+    See AD5940Sim.h. Register addresses and bit fields come straight from
+    ad5940.h so the model stays in step with the ADI library HELPStat uses.
+*/
+
+#include "AD5940Sim.h"
+#include "Arduino.h"
+
+extern "C" {
+#include <ad5940.h>
+}
+
+#define SIM_SYSCLK_HZ     16000000.0   // WG / system clock in both LP and HP mode
+#define SIM_ADC_FS_VOLTS  0.9          // +/- full scale at PGA = 1
+#define SIM_ADC_FS_CODES  32767.0
+#define SIM_ADC_MID_CODE  32768.0      // ADC code at 0 V (ADCMIN / ADCMAX compare against it +/- the input)
+#define SIM_DFT_GAIN      8.0          // |DFT| = SIM_DFT_GAIN * fundamental amplitude in ADC codes
+#define SIM_DFT_MAX       131071       // 18-bit two's complement
+#define SIM_SYS_DELAY_S   0.25e-6      // Fixed analog path delay, same for both legs
+#define SIM_MIN_LOAD_OHMS 1e-3         // A shorted fixture with no lead resistance still has a little
+#define SIM_DFT_LATENCY_US 4.0         // Filter pipeline latency before DFTRDY (inside the
+                                       // margin AD5940_ClksCalculate leaves for SEQ_WAIT)
+
+static const double kRtiaTable[] = {200, 1000, 5000, 10000, 20000, 40000, 80000, 160000};
+static const uint32_t kSinc2Osr[] = {22, 44, 89, 178, 267, 533, 640, 667, 800, 889, 1067, 1333};
+static const uint32_t kSinc3Osr[] = {5, 4, 2, 2};
+
+AD5940Sim &AD5940Sim::instance(void) {
+  static AD5940Sim sim;
+  return sim;
+}
+
+AD5940Sim::AD5940Sim() {
+  configure(SimConfig());
+}
+
+void AD5940Sim::configure(const SimConfig &cfg) {
+  _cfg = cfg;
+  _rng = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)cfg.seed << 1);
+  if(_rng == 0) _rng = 1;
+  _eventUs = _loadUs = (double)_now;
+  _vDl = 0;
+  powerOnReset();
+}
+
+void AD5940Sim::powerOnReset(void) {
+  _regs.clear();
+  _regs[REG_AFECON_ADIID]     = AD5940_ADIID;
+  _regs[REG_AFECON_CHIPID]    = 0x5502;
+  _regs[REG_AFECON_CLKCON0]   = REG_AFECON_CLKCON0_RESET;
+  _regs[REG_ALLON_OSCCON]     = REG_ALLON_OSCCON_RESET;
+  _regs[REG_AFE_AFECON]       = REG_AFE_AFECON_RESET;
+  _regs[REG_AFE_SEQCON]       = REG_AFE_SEQCON_RESET;
+  _regs[REG_AFE_FIFOCON]      = REG_AFE_FIFOCON_RESET;
+  _regs[REG_AFE_SWCON]        = REG_AFE_SWCON_RESET;
+  _regs[REG_AFE_HSDACCON]     = REG_AFE_HSDACCON_RESET;
+  _regs[REG_AFE_WGCON]        = REG_AFE_WGCON_RESET;
+  _regs[REG_AFE_HSDACDAT]     = REG_AFE_HSDACDAT_RESET;
+  _regs[REG_AFE_HSRTIACON]    = REG_AFE_HSRTIACON_RESET;
+  _regs[REG_AFE_ADCFILTERCON] = REG_AFE_ADCFILTERCON_RESET;
+  _regs[REG_AFE_DFTCON]       = REG_AFE_DFTCON_RESET;
+  _regs[REG_AFE_CMDDATACON]   = REG_AFE_CMDDATACON_RESET;
+  _regs[REG_AFE_PMBW]         = REG_AFE_PMBW_RESET;
+  _regs[REG_INTC_INTCSEL0]    = REG_INTC_INTCSEL0_RESET;
+
+  _fifo.clear();
+  _dftRunning = false;
+  _seqRunning = false;
+  _sampling = false;
+  _charge = 0;
+  _asleep = false;
+  _lastDisturbUs = _now;
+  if(_irqLow) {
+    _irqLow = false;
+    HostSim::setPinLevel(_irqPin, HIGH);
+  }
+}
+
+/* ---------------------------------------------------------------- SPI */
+
+void AD5940Sim::csLow(void) {
+  if(_sdBus) _stats.busConflicts++;
+  _stats.csFrames++;
+  _spiState = SPI_IDLE;
+  _spiIndex = 0;
+}
+
+void AD5940Sim::csHigh(void) {
+  /* Any chip-select activity brings the AFE out of hibernate */
+  if(_asleep) {
+    _asleep = false;
+    _stats.wakeups++;
+  }
+  _spiState = SPI_IDLE;
+}
+
+void AD5940Sim::sdBus(bool held) {
+  if(held) _stats.busLocks++;
+  _sdBus = held;
+}
+
+void AD5940Sim::transfer(const uint8_t *tx, uint8_t *rx, unsigned long n) {
+  _stats.spiTransfers++;
+  _stats.spiBytes += n;
+
+  for(unsigned long i = 0; i < n; i++) {
+    uint8_t in = tx ? tx[i] : 0;
+    uint8_t out = 0;
+    uint32_t idx = _spiIndex++;
+
+    if(_inReset) {
+      if(rx) rx[i] = 0;
+      continue;
+    }
+
+    if(idx == 0) {
+      switch(in) {
+        case SPICMD_SETADDR:  _spiState = SPI_SETADDR; _shift = 0; break;
+        case SPICMD_WRITEREG: _spiState = SPI_WRITE; _shift = 0; break;
+        case SPICMD_READREG:  _spiState = SPI_READ; break;
+        case SPICMD_READFIFO: _spiState = SPI_FIFO; break;
+        default:              _spiState = SPI_DONE; break;
+      }
+    }
+    else switch(_spiState) {
+      case SPI_SETADDR:
+        _shift = (_shift << 8) | in;
+        if(idx == 2) {
+          _addr = (uint16_t)_shift;
+          _spiState = SPI_DONE;
+        }
+        break;
+
+      case SPI_WRITE: {
+        uint32_t width = is32Bit(_addr) ? 4 : 2;
+        _shift = (_shift << 8) | in;
+        if(idx == width) {
+          /* A hibernating AFE ignores the frame that wakes it */
+          if(!_asleep) writeReg(_addr, _shift);
+          _spiState = SPI_DONE;
+        }
+        break;
+      }
+
+      case SPI_READ: {
+        uint32_t width = is32Bit(_addr) ? 4 : 2;
+        if(idx == 1) _readLatch = _asleep ? 0 : readReg(_addr); /* dummy byte */
+        else if(idx - 2 < width) out = (uint8_t)(_readLatch >> (8 * (width - 1 - (idx - 2))));
+        break;
+      }
+
+      case SPI_FIFO:
+        if(idx >= 7) {
+          uint32_t k = (idx - 7) & 3;
+          if(k == 0) _readLatch = _asleep ? 0 : popFifo();
+          out = (uint8_t)(_readLatch >> (8 * (3 - k)));
+        }
+        break;
+
+      default:
+        break;
+    }
+    if(rx) rx[i] = out;
+  }
+}
+
+void AD5940Sim::resetPin(bool asserted) {
+  if(asserted && !_inReset) powerOnReset();
+  _inReset = asserted;
+}
+
+/* ---------------------------------------------------------- Registers */
+
+uint32_t AD5940Sim::peek(uint16_t addr) const {
+  if(addr == REG_AFE_FIFOCNTSTA) return (uint32_t)_fifo.size() << BITP_AFE_FIFOCNTSTA_DATAFIFOCNTSTA;
+  if(addr == REG_ALLON_OSCCON) {
+    auto it = _regs.find(addr);
+    return (it == _regs.end() ? 0 : it->second) |
+      BITM_ALLON_OSCCON_HFXTALOK | BITM_ALLON_OSCCON_HFOSCOK | BITM_ALLON_OSCCON_LFOSCOK;
+  }
+  auto it = _regs.find(addr);
+  return it == _regs.end() ? 0 : it->second;
+}
+
+uint32_t AD5940Sim::readReg(uint16_t addr) {
+  _stats.regReads++;
+  if(addr == REG_AFE_DATAFIFORD) return popFifo();
+  return peek(addr);
+}
+
+void AD5940Sim::writeReg(uint16_t addr, uint32_t val) {
+  _stats.regWrites++;
+  uint32_t old = peek(addr);
+  advanceLoad(_eventUs); /* The loop ran on the old settings up to this write */
+
+  switch(addr) {
+    case REG_INTC_INTCCLR:
+      _regs[REG_INTC_INTCFLAG0] = peek(REG_INTC_INTCFLAG0) & ~val;
+      _regs[REG_INTC_INTCFLAG1] = peek(REG_INTC_INTCFLAG1) & ~val;
+      updateIrqLine();
+      return;
+
+    case REG_AFECON_SWRSTCON:
+      if(val == AD5940_SWRST) powerOnReset();
+      return;
+
+    case REG_AFE_CMDFIFOWADDR:
+      _seqWriteAddr = val % (sizeof(_seqRam) / sizeof(_seqRam[0]));
+      _regs[addr] = val;
+      return;
+
+    case REG_AFE_CMDFIFOWRITE:
+      _seqRam[_seqWriteAddr] = val;
+      return;
+
+    case REG_AFECON_TRIGSEQ:
+      for(uint32_t id = 0; id < 4; id++)
+        if(val & (1UL << id)) {
+          startSeq(id);
+          break;
+        }
+      return;
+
+    case REG_AFE_DATAFIFORD:
+    case REG_AFE_FIFOCNTSTA:
+    case REG_AFECON_CHIPID:
+    case REG_AFECON_ADIID:
+      return; /* read-only */
+
+    case REG_AFE_SEQTRGSLP:
+      if((val & 1) && peek(REG_AFE_SEQSLPLOCK) == SLPKEY_UNLOCK) {
+        _asleep = true;
+        if(_dftRunning) {
+          _dftRunning = false;
+          _stats.dftAborted++;
+        }
+        _regs[REG_AFE_AFECON] = REG_AFE_AFECON_RESET;
+      }
+      _regs[addr] = val;
+      return;
+
+    default:
+      break;
+  }
+
+  _regs[addr] = val;
+
+  switch(addr) {
+    case REG_AFE_AFECON: {
+      const uint32_t run = BITM_AFE_AFECON_ADCCONVEN | BITM_AFE_AFECON_DFTEN;
+      if((val & BITM_AFE_AFECON_WAVEGENEN) && !(old & BITM_AFE_AFECON_WAVEGENEN)) disturb();
+      if((val & run) == run && !_dftRunning) startDft();
+      else if((val & run) != run && _dftRunning) {
+        _dftRunning = false;
+        _stats.dftAborted++;
+      }
+      updateSampling();
+      break;
+    }
+
+    case REG_AFE_SWCON:
+    case REG_AFE_DSWFULLCON:
+    case REG_AFE_PSWFULLCON:
+    case REG_AFE_NSWFULLCON:
+    case REG_AFE_TSWFULLCON:
+    case REG_AFE_WGFCW:
+    case REG_AFE_WGAMPLITUDE:
+    case REG_AFE_HSRTIACON:
+    case REG_AFE_HSDACCON:
+      if(val != old) disturb();
+      break;
+
+    case REG_AFE_FIFOCON:
+      if(!(val & BITM_AFE_FIFOCON_DATAFIFOEN)) _fifo.clear();
+      updateSampling();
+      break;
+
+    case REG_AFE_SEQCON:
+      /* SEQ_STOP() from the sequence itself, or the MCU disabling it */
+      if(!(val & BITM_AFE_SEQCON_SEQEN) && _seqRunning) stopSeq();
+      break;
+
+    default:
+      break;
+  }
+}
+
+/* ---------------------------------------------------------------- DFT */
+
+double AD5940Sim::wgFrequency(void) const {
+  return peek(REG_AFE_WGFCW) * SIM_SYSCLK_HZ / (double)(1UL << 30);
+}
+
+std::complex<double> AD5940Sim::cellImpedance(double freq) const {
+  const RandlesCell &c = _cfg.cell;
+  const std::complex<double> j(0.0, 1.0);
+  double w = 2.0 * M_PI * freq;
+
+  std::complex<double> zFaradaic = cellRct();
+  if(c.sigmaW > 0.0f) zFaradaic += (double)c.sigmaW * (1.0 - j) / sqrt(w);
+
+  std::complex<double> yDl = (double)c.cdl * std::pow(j * w, (double)c.cpeN);
+  return (double)c.rs + 1.0 / (1.0 / zFaradaic + yDl);
+}
+
+/* Rct with drift and step applied at the current time */
+double AD5940Sim::cellRct(void) const {
+  const RandlesCell &c = _cfg.cell;
+  double rct = c.rct * (1.0 + c.rctDrift * (_now * 1e-6));
+  if(c.rctStep != 0.0f && _now * 1e-6 >= c.rctStepS) rct *= 1.0 + c.rctStep;
+  return rct;
+}
+
+/* What CE0/SE0 see: the fixture (cell, open or short) with the stray capacitance across it, behind the leads */
+std::complex<double> AD5940Sim::loadAdmittance(double freq) const {
+  const std::complex<double> j(0.0, 1.0);
+  std::complex<double> yFixture = j * (2.0 * M_PI * freq) * (double)_cfg.strayPf * 1e-12;
+  if(_cfg.fixture == SIM_FIXTURE_SHORT) return 1.0 / fmax((double)_cfg.leadOhms, SIM_MIN_LOAD_OHMS);
+  if(_cfg.fixture == SIM_FIXTURE_CELL) yFixture += 1.0 / cellImpedance(freq);
+  if(std::abs(yFixture) == 0.0) return 0.0;
+  std::complex<double> zLoad = (double)_cfg.leadOhms + 1.0 / yFixture;
+  return 1.0 / (std::abs(zLoad) < SIM_MIN_LOAD_OHMS ? SIM_MIN_LOAD_OHMS : zLoad);
+}
+
+/* Output rate of the filter stage a DFT (DFTSRC_*) or FIFO (FIFOSRC_SINC2NOTCH) reads from */
+double AD5940Sim::filterRate(uint32_t src) const {
+  uint32_t filt = peek(REG_AFE_ADCFILTERCON);
+
+  double adcRate = (filt & BITM_AFE_ADCFILTERCON_ADCCLK) ? 800e3 : 1.6e6;
+  uint32_t osr3 = kSinc3Osr[(filt & BITM_AFE_ADCFILTERCON_SINC3OSR) >> BITP_AFE_ADCFILTERCON_SINC3OSR];
+  uint32_t osr2Idx = (filt & BITM_AFE_ADCFILTERCON_SINC2OSR) >> BITP_AFE_ADCFILTERCON_SINC2OSR;
+  uint32_t osr2 = kSinc2Osr[osr2Idx < 12 ? osr2Idx : 11];
+
+  switch(src) {
+    case DFTSRC_SINC2NOTCH: return adcRate / osr3 / osr2;
+    case DFTSRC_ADCRAW:     return adcRate;
+    default:                return adcRate / osr3;
+  }
+}
+
+double AD5940Sim::dftDurationUs(void) const {
+  uint32_t dft = peek(REG_AFE_DFTCON);
+  uint32_t numIdx = (dft & BITM_AFE_DFTCON_DFTNUM) >> BITP_AFE_DFTCON_DFTNUM;
+  double points = (double)(4UL << (numIdx < 13 ? numIdx : 12));
+  double rate = filterRate((dft & BITM_AFE_DFTCON_DFTINSEL) >> BITP_AFE_DFTCON_DFTINSEL);
+  return points / rate * 1e6 + SIM_DFT_LATENCY_US;
+}
+
+/* Volts at the HSDAC output per unit of full-scale code, from the HSDAC gain stages */
+double AD5940Sim::excitationScale(void) const {
+  uint32_t dacCon = peek(REG_AFE_HSDACCON);
+  double bufGain = (dacCon & BITM_AFE_HSDACCON_INAMPGNMDE) ? 0.25 : 2.0;
+  double dacGain = (dacCon & BITM_AFE_HSDACCON_ATTENEN) ? 0.2 : 1.0;
+  return 0.2 * bufGain * dacGain;
+}
+
+void AD5940Sim::startDft(void) {
+  _dftRunning = true;
+  _dftStartUs = _now;
+  _dftEndUs = _now + (uint64_t)dftDurationUs();
+}
+
+void AD5940Sim::finishDft(void) {
+  _dftRunning = false;
+
+  const std::complex<double> j(0.0, 1.0);
+  double freq = wgFrequency();
+
+  /* A dead point: no result, no DFTRDY, the firmware has to time out */
+  if(_cfg.deadFreq > 0.0f && fabs(freq - _cfg.deadFreq) <= 0.005 * _cfg.deadFreq &&
+     (_cfg.deadUntilS <= 0.0f || _dftEndUs * 1e-6 < _cfg.deadUntilS)) {
+    _stats.dftDead++;
+    return;
+  }
+  _stats.dftCount++;
+  double w = 2.0 * M_PI * freq;
+
+  /* Excitation amplitude from WG amplitude word and HSDAC gain stages */
+  double vPeak = (peek(REG_AFE_WGAMPLITUDE) & 0x7FF) / 2047.0 * excitationScale();
+
+  /* Which load is in the excitation loop */
+  uint32_t dsw = peek(REG_AFE_DSWFULLCON);
+  bool onCell = (dsw & SWD_CE0) != 0;
+  std::complex<double> current = 0.0;
+  if(dsw & SWD_RCAL0) current = vPeak / (double)_cfg.rcal;
+  else if(onCell) current = vPeak * loadAdmittance(freq);
+
+  /* HSTIA: RTIA in parallel with CTIA */
+  uint32_t tiaCon = peek(REG_AFE_HSRTIACON);
+  uint32_t rtiaSel = tiaCon & BITM_AFE_HSRTIACON_RTIACON;
+  double rtia = rtiaSel < 8 ? kRtiaTable[rtiaSel] : 1e9;
+  double ctia = (((tiaCon & BITM_AFE_HSRTIACON_CTIACON) >> BITP_AFE_HSRTIACON_CTIACON) + 2) * 1e-12;
+  std::complex<double> zTia = rtia / (1.0 + j * w * rtia * ctia);
+
+  std::complex<double> vTia = current * zTia;
+  double amp = std::abs(vTia) / SIM_ADC_FS_VOLTS * SIM_ADC_FS_CODES;
+
+  /* ADC digital comparator on the peaks of the input. ADCMAX resets to 0, which is taken as off */
+  uint32_t adcMax = peek(REG_AFE_ADCMAX) & BITM_AFE_ADCMAX_MAXVAL;
+  uint32_t adcMin = peek(REG_AFE_ADCMIN) & BITM_AFE_ADCMIN_MINVAL;
+  bool maxErr = adcMax != 0 && fmin(SIM_ADC_MID_CODE + amp, 65535.0) > adcMax;
+  bool minErr = fmax(SIM_ADC_MID_CODE - amp, 0.0) < adcMin;
+  if(maxErr) raiseInt(AFEINTSRC_ADCMAXERR);
+  if(minErr) raiseInt(AFEINTSRC_ADCMINERR);
+  if(maxErr || minErr) _stats.adcCompTrips++;
+
+  if(amp > SIM_ADC_FS_CODES) {
+    /* Fundamental of a symmetrically clipped sine */
+    double r = SIM_ADC_FS_CODES / amp;
+    amp = 2.0 * amp / M_PI * (asin(r) + r * sqrt(1.0 - r * r));
+    _stats.adcClipped++;
+  }
+
+  double phase = std::arg(vTia) - w * SIM_SYS_DELAY_S;
+  std::complex<double> x = SIM_DFT_GAIN * amp * std::exp(j * phase);
+
+  /* Settling error decays from the last disturbance, evaluated mid-window */
+  double tau = _cfg.settleCycles / (freq > 0 ? freq : 1.0);
+  if(onCell && _cfg.fixture == SIM_FIXTURE_CELL) tau += _cfg.cell.cdl * _cfg.cell.rct;
+  double t = ((double)_dftStartUs - (double)_lastDisturbUs + ((double)_dftEndUs - (double)_dftStartUs) / 2.0) * 1e-6;
+  x *= 1.0 + _cfg.settleAmp * exp(-t / tau) * std::exp(j * 0.7);
+
+  if(_cfg.noiseCodes > 0.0f) {
+    uint32_t numIdx = (peek(REG_AFE_DFTCON) & BITM_AFE_DFTCON_DFTNUM) >> BITP_AFE_DFTCON_DFTNUM;
+    double sigma = SIM_DFT_GAIN * _cfg.noiseCodes / sqrt((double)(4UL << numIdx) / 4.0);
+    x += std::complex<double>(sigma * gaussian(), sigma * gaussian());
+  }
+
+  /* atan2(-imag, real) recovers the phase, as in HELPStat::getMagPhase */
+  long re = lround(x.real());
+  long im = lround(-x.imag());
+  if(re > SIM_DFT_MAX) re = SIM_DFT_MAX;
+  if(re < -SIM_DFT_MAX) re = -SIM_DFT_MAX;
+  if(im > SIM_DFT_MAX) im = SIM_DFT_MAX;
+  if(im < -SIM_DFT_MAX) im = -SIM_DFT_MAX;
+
+  _regs[REG_AFE_DFTREAL] = (uint32_t)re & 0x3FFFF;
+  _regs[REG_AFE_DFTIMAG] = (uint32_t)im & 0x3FFFF;
+
+  uint32_t fifoCon = peek(REG_AFE_FIFOCON);
+  if((fifoCon & BITM_AFE_FIFOCON_DATAFIFOEN) &&
+     ((fifoCon & BITM_AFE_FIFOCON_DATAFIFOSRCSEL) >> BITP_AFE_FIFOCON_DATAFIFOSRCSEL) == FIFOSRC_DFT) {
+    pushFifo(_regs[REG_AFE_DFTREAL]);
+    pushFifo(_regs[REG_AFE_DFTIMAG]);
+  }
+
+  raiseInt(AFEINTSRC_DFTRDY);
+}
+
+/* ------------------------------------------------------- Time domain */
+
+/* HSDAC output in MMR mode: HSDACDAT around mid-scale, 0 unless the WG is on and set to MMR */
+double AD5940Sim::mmrVolts(void) const {
+  if(!(peek(REG_AFE_AFECON) & BITM_AFE_AFECON_WAVEGENEN)) return 0.0;
+  if(((peek(REG_AFE_WGCON) & BITM_AFE_WGCON_TYPESEL) >> BITP_AFE_WGCON_TYPESEL) != WGTYPE_MMR) return 0.0;
+  double code = (double)(peek(REG_AFE_HSDACDAT) & 0xFFF);
+  return (code - 2048.0) / 2047.0 * excitationScale();
+}
+
+/* Integrates the loop from _loadUs to tUs with the DAC held (the registers have not changed in between):
+   the double layer charges exponentially and the charge into the HSTIA accumulates for the next sample */
+void AD5940Sim::advanceLoad(double tUs) {
+  double dt = (tUs - _loadUs) * 1e-6;
+  if(dt <= 0.0) return;
+  _loadUs = tUs;
+
+  const RandlesCell &c = _cfg.cell;
+  double rct = cellRct();
+  double v = mmrVolts();
+  uint32_t dsw = peek(REG_AFE_DSWFULLCON);
+
+  if(!(dsw & SWD_RCAL0) && (dsw & SWD_CE0) && _cfg.fixture == SIM_FIXTURE_CELL) {
+    /* v -> Rs + leads -> Rct || Cdl: the capacitor relaxes towards the divider voltage with tau = Cdl (Rs || Rct) */
+    double rsLead = fmax((double)c.rs + _cfg.leadOhms, SIM_MIN_LOAD_OHMS);
+    double g = 1.0 / rct + 1.0 / rsLead;
+    double tau = c.cdl / g;
+    double vInf = v / rsLead / g;
+    double e = exp(-dt / tau);
+    double vDlInt = vInf * dt + (_vDl - vInf) * tau * (1.0 - e);
+    _charge += (v * dt - vDlInt) / rsLead;
+    _vDl = vInf + (_vDl - vInf) * e;
+    return;
+  }
+
+  if(dsw & SWD_RCAL0) _charge += v / (double)_cfg.rcal * dt;
+  else if((dsw & SWD_CE0) && _cfg.fixture == SIM_FIXTURE_SHORT)
+    _charge += v / fmax((double)_cfg.leadOhms, SIM_MIN_LOAD_OHMS) * dt;
+  _vDl *= exp(-dt / (c.cdl * rct)); /* Not driven: the double layer discharges through Rct */
+}
+
+/* SINC2 samples run while the ADC converts with the FIFO fed from SINC2 (notch bypassed) */
+void AD5940Sim::updateSampling(void) {
+  uint32_t fifoCon = peek(REG_AFE_FIFOCON);
+  bool want = (peek(REG_AFE_AFECON) & BITM_AFE_AFECON_ADCCONVEN) &&
+              ((fifoCon & BITM_AFE_FIFOCON_DATAFIFOSRCSEL) >> BITP_AFE_FIFOCON_DATAFIFOSRCSEL) == FIFOSRC_SINC2NOTCH;
+  if(want == _sampling) return;
+  _sampling = want;
+  if(want) {
+    _sampleNextUs = _eventUs + 1e6 / filterRate(DFTSRC_SINC2NOTCH);
+    _charge = 0;
+  }
+}
+
+void AD5940Sim::finishSample(void) {
+  double ts = 1e6 / filterRate(DFTSRC_SINC2NOTCH);
+  advanceLoad(_eventUs);
+  _sampleNextUs += ts;
+
+  /* The SINC2 output is the average over the sample; CTIA does not matter this far below its corner */
+  uint32_t rtiaSel = peek(REG_AFE_HSRTIACON) & BITM_AFE_HSRTIACON_RTIACON;
+  double rtia = rtiaSel < 8 ? kRtiaTable[rtiaSel] : 1e9;
+  double vTia = _charge / (ts * 1e-6) * rtia;
+  _charge = 0;
+
+  double code = vTia / SIM_ADC_FS_VOLTS * SIM_ADC_FS_CODES;
+  if(_cfg.noiseCodes > 0.0f) code += _cfg.noiseCodes * gaussian();
+  if(fabs(code) > SIM_ADC_FS_CODES) {
+    code = code > 0 ? SIM_ADC_FS_CODES : -SIM_ADC_FS_CODES;
+    _stats.adcClipped++;
+  }
+  _stats.adcSamples++;
+
+  /* A stalled stream: the multisine legs have to time out */
+  if(_cfg.sinc2DeadUntilS > 0.0f && _eventUs * 1e-6 < _cfg.sinc2DeadUntilS) return;
+  uint32_t fifoCon = peek(REG_AFE_FIFOCON);
+  if(fifoCon & BITM_AFE_FIFOCON_DATAFIFOEN) pushFifo((uint32_t)lround(SIM_ADC_MID_CODE + code) & 0xFFFF);
+}
+
+void AD5940Sim::tick(uint64_t nowUs) {
+  /* Run DFT completions, sequencer commands and SINC2 samples in time order up to nowUs */
+  for(;;) {
+    double dftAt = _dftRunning ? (double)_dftEndUs : INFINITY;
+    double seqAt = _seqRunning ? _seqNextUs : INFINITY;
+    double sampleAt = _sampling ? _sampleNextUs : INFINITY;
+    double next = fmin(dftAt, fmin(seqAt, sampleAt));
+    if(next > (double)nowUs) break;
+
+    _now = (uint64_t)next;
+    _eventUs = next;
+    if(dftAt == next) finishDft();
+    else if(seqAt == next) stepSeq();
+    else finishSample();
+  }
+  _now = nowUs;
+  _eventUs = (double)nowUs;
+}
+
+uint64_t AD5940Sim::nextEventUs(void) const {
+  uint64_t next = UINT64_MAX;
+  if(_dftRunning) next = _dftEndUs;
+  if(_seqRunning) {
+    uint64_t seq = (uint64_t)ceil(_seqNextUs);
+    if(seq < next) next = seq;
+  }
+  if(_sampling) {
+    uint64_t sample = (uint64_t)ceil(_sampleNextUs);
+    if(sample < next) next = sample;
+  }
+  return next;
+}
+
+/* ---------------------------------------------------------- Sequencer */
+
+void AD5940Sim::startSeq(uint32_t seqId) {
+  static const uint16_t infoRegs[] = {REG_AFE_SEQ0INFO, REG_AFE_SEQ1INFO, REG_AFE_SEQ2INFO, REG_AFE_SEQ3INFO};
+  if(_asleep || _seqRunning || !(peek(REG_AFE_SEQCON) & BITM_AFE_SEQCON_SEQEN)) return;
+
+  uint32_t info = peek(infoRegs[seqId]);
+  _seqPc = info & 0x7FF;
+  _seqEnd = _seqPc + ((info >> 16) & 0x7FF);
+  _seqNextUs = (double)_now;
+  _seqRunning = true;
+  _stats.seqRuns++;
+}
+
+void AD5940Sim::stepSeq(void) {
+  const uint32_t ramWords = sizeof(_seqRam) / sizeof(_seqRam[0]);
+  if(_seqPc >= _seqEnd || _seqPc >= ramWords) {
+    stopSeq();
+    return;
+  }
+
+  uint32_t cmd = _seqRam[_seqPc++];
+  double clk = 1e6 / SIM_SYSCLK_HZ;
+  _stats.seqCommands++;
+
+  if(cmd & 0x80000000) {
+    /* SEQ_WR: 7-bit word offset from 0x2000, 24-bit data */
+    uint16_t addr = (uint16_t)(0x2000 + (((cmd >> 24) & 0x7F) << 2));
+    _eventUs = _seqNextUs;
+    _seqNextUs += clk;
+    writeReg(addr, cmd & 0xFFFFFF);
+  }
+  else if(cmd & 0x40000000) {
+    _seqNextUs += clk; /* SEQ_TOUT only arms a timer we do not model */
+  }
+  else {
+    uint32_t clks = cmd & 0x3FFFFFFF;
+    _seqNextUs += (clks ? clks : 1) * clk;
+  }
+}
+
+void AD5940Sim::stopSeq(void) {
+  _seqRunning = false;
+  raiseInt(AFEINTSRC_ENDSEQ);
+}
+
+/* --------------------------------------------------------------- FIFO */
+
+uint32_t AD5940Sim::fifoCapacity(void) const {
+  static const uint32_t words[] = {8, 512, 1024, 1536};
+  uint32_t sel = (peek(REG_AFE_CMDDATACON) >> BITP_AFE_CMDDATACON_DATA_MEM_SEL) & 0x3;
+  return words[sel];
+}
+
+void AD5940Sim::pushFifo(uint32_t word) {
+  if(_fifo.size() >= fifoCapacity()) {
+    raiseInt(AFEINTSRC_DATAFIFOOF);
+    return;
+  }
+  _fifo.push_back(word);
+  uint32_t thresh = peek(REG_AFE_DATAFIFOTHRES) >> BITP_AFE_DATAFIFOTHRES_HIGHTHRES;
+  if(thresh && _fifo.size() >= thresh) raiseInt(AFEINTSRC_DATAFIFOTHRESH);
+}
+
+uint32_t AD5940Sim::popFifo(void) {
+  if(_fifo.empty()) {
+    raiseInt(AFEINTSRC_DATAFIFOUF);
+    return 0;
+  }
+  uint32_t w = _fifo.front();
+  _fifo.pop_front();
+  _stats.fifoWords++;
+  return w;
+}
+
+/* ---------------------------------------------------------- Interrupts */
+
+void AD5940Sim::raiseInt(uint32_t src) {
+  _regs[REG_INTC_INTCFLAG0] = peek(REG_INTC_INTCFLAG0) | (src & peek(REG_INTC_INTCSEL0));
+  _regs[REG_INTC_INTCFLAG1] = peek(REG_INTC_INTCFLAG1) | (src & peek(REG_INTC_INTCSEL1));
+  updateIrqLine();
+}
+
+void AD5940Sim::updateIrqLine(void) {
+  /* GPIO0 is configured as the INT0 output: active low while any INTC0 flag is set */
+  bool low = peek(REG_INTC_INTCFLAG0) != 0;
+  if(low == _irqLow) return;
+  _irqLow = low;
+  if(low) _stats.irqCount++;
+  HostSim::setPinLevel(_irqPin, low ? LOW : HIGH);
+}
+
+double AD5940Sim::gaussian(void) {
+  /* xorshift64* feeding Box-Muller; deterministic for a given seed */
+  auto next = [this]() {
+    _rng ^= _rng >> 12;
+    _rng ^= _rng << 25;
+    _rng ^= _rng >> 27;
+    return ((_rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+  };
+  double u1 = next(), u2 = next();
+  if(u1 < 1e-300) u1 = 1e-300;
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
@@ -0,0 +1,213 @@
+/*
+    FILENAME: AD5940Sim.h
+
+    Register-level model of the AD5940/AD5941 as seen over SPI. It decodes the
+    SETADDR / READREG / WRITEREG / READFIFO frames that ad5940.c produces, keeps
+    a register file, and runs the parts of the AFE the HELPStat code depends on:
+
+      - waveform generator frequency / amplitude (WGFCW, WGAMPLITUDE, HSDACCON)
+      - switch matrix (RCAL vs CE0/SE0 path) and HSTIA gain (HSRTIACON)
+      - DFT engine timing from ADCFILTERCON / DFTCON and the AFECON start bits
+      - DFTRDY in INTCFLAG0/1 and the GPIO0 interrupt line to the MCU
+      - the ADC digital comparator (ADCMIN / ADCMAX -> ADCMINERR / ADCMAXERR)
+      - the data FIFO (DFT or SINC2 source) with threshold / overflow flags
+      - the HSDAC in MMR mode (WGCON, HSDACDAT): the loop is integrated in time
+        for the piecewise-constant DAC output and SINC2 samples (the average
+        HSTIA output over each sample) are streamed while the ADC converts
+      - the sequencer: command SRAM, SEQxINFO, TRIGSEQ, SEQ_WR / SEQ_WAIT /
+        SEQ_STOP timed on the 16 MHz system clock, ENDSEQ interrupt
+      - hibernate / wakeup, hardware and software reset
+
+    The load on CE0/SE0 is a Randles cell, Rs + (Rct [+ Warburg]) || Cdl/CPE,
+    behind optional lead resistance and stray capacitance; an open or shorted
+    fixture can take the cell's place for open / short compensation.
+    DFT results carry an exponential settling error that decays from the last
+    switch / frequency / gain change, plus optional seeded Gaussian noise, so
+    the settling delays in HELPStat.cpp actually matter in simulation. The
+    time-domain path charges an ideal Cdl (cpeN taken as 1, no Warburg or
+    stray capacitance, which only matter above the band it is used in) and
+    adds the same noise to each SINC2 sample.
+
+    All timing is virtual (see HostSim::nowUs in shim/Arduino.h).
+*/
+
+#ifndef AD5940SIM_H
+#define AD5940SIM_H
+
+#include <stdint.h>
+#include <complex>
+#include <deque>
+#include <map>
+
+typedef struct _RandlesCell {
+  float rs     = 150.0f;      // Solution resistance (ohms)
+  float rct    = 1500.0f;     // Charge transfer resistance (ohms)
+  float cdl    = 1.0e-6f;     // Double layer capacitance (F), or CPE Q when cpeN != 1
+  float cpeN   = 1.0f;        // CPE exponent, 1 = ideal capacitor
+  float sigmaW = 0.0f;        // Warburg coefficient (ohm*s^-1/2), 0 = no diffusion
+  float rctDrift = 0.0f;      // Relative change of Rct per second of simulated time, 0 = steady
+  float rctStep  = 0.0f;      // Relative jump of Rct at rctStepS (a disturbed cell), 0 = none
+  float rctStepS = 0.0f;      // Simulated time of the jump (s)
+}RandlesCell;
+
+#define SIM_FIXTURE_CELL   0   // The Randles cell is on CE0/SE0
+#define SIM_FIXTURE_OPEN   1   // Nothing connected (leads only)
+#define SIM_FIXTURE_SHORT  2   // Leads shorted together
+
+typedef struct _SimConfig {
+  RandlesCell cell;
+  int fixture           = SIM_FIXTURE_CELL;
+  float leadOhms        = 0.0f;     // Series resistance of leads and switches in the CE0/SE0 path
+  float strayPf         = 0.0f;     // Stray capacitance across the cell, behind the leads (pF)
+  float rcal            = 1000.0f;  // Actual value of the on-board calibration resistor
+  float noiseCodes      = 2.0f;     // ADC input noise (RMS, in ADC codes), 0 = noiseless
+  float settleAmp       = 0.05f;    // Relative error right after a disturbance
+  float settleCycles    = 0.5f;     // Front-end settling time constant, in excitation periods
+  float spiClockHz      = 15.0e6f;  // SPI clock (240 MHz / 16 on the ESP32-S3)
+  float spiTxnOverheadUs = 1.0f;    // Cost of each SPI begin/endTransaction pair
+  float spiBurstOverheadUs = 2.0f;  // Cost of setting up one DMA transaction (AD5940_ReadWriteBurst)
+  float deadFreq        = 0.0f;     // DFTs at this excitation frequency (within 0.5 %) never finish, 0 = none
+  float deadUntilS      = 0.0f;     // ... only before this simulated time (s), 0 = for the whole run
+  float sinc2DeadUntilS = 0.0f;     // SINC2 samples never reach the data FIFO before this simulated time (s), 0 = none
+  uint32_t seed         = 1;
+}SimConfig;
+
+typedef struct _SimStats {
+  uint64_t spiBytes     = 0;   // Bytes clocked over SPI
+  uint64_t spiTransfers = 0;   // AD5940_ReadWriteNBytes / AD5940_ReadWriteBurst calls
+  uint64_t csFrames     = 0;   // Chip-select low periods
+  uint64_t regReads     = 0;
+  uint64_t regWrites    = 0;
+  uint64_t fifoWords    = 0;   // Words read from the data FIFO
+  uint64_t dftCount     = 0;   // Completed DFTs
+  uint64_t dftAborted   = 0;   // DFTs stopped before completion
+  uint64_t dftDead      = 0;   // DFTs that never finished (SimConfig::deadFreq)
+  uint64_t adcSamples   = 0;   // SINC2 samples taken in the time domain (HSDAC MMR mode)
+  uint64_t irqCount     = 0;   // Falling edges on the MCU interrupt line
+  uint64_t adcClipped   = 0;   // DFTs / SINC2 samples where the ADC input exceeded full scale
+  uint64_t adcCompTrips = 0;   // DFTs that tripped the ADC digital comparator (ADCMIN / ADCMAX)
+  uint64_t wakeups      = 0;
+  uint64_t seqRuns      = 0;   // Sequences triggered through TRIGSEQ
+  uint64_t seqCommands  = 0;   // Sequencer commands executed
+  uint64_t busLocks     = 0;   // AD5940_BusLock hand-overs to the SD card
+  uint64_t busConflicts = 0;   // AD5940 frames started while the SD card held the bus
+}SimStats;
+
+class AD5940Sim {
+  public:
+    static AD5940Sim &instance(void);
+
+    void configure(const SimConfig &cfg);
+    const SimConfig &config(void) const { return _cfg; }
+    /* Swaps what is on CE0/SE0 (SIM_FIXTURE_*) without resetting the part */
+    void setFixture(int fixture) { advanceLoad(_eventUs); _cfg.fixture = fixture; disturb(); }
+    /* Keeps SINC2 samples out of the data FIFO until untilS of simulated time */
+    void setSinc2Dead(float untilS) { _cfg.sinc2DeadUntilS = untilS; }
+    void setIrqPin(uint8_t pin) { _irqPin = pin; }
+
+    /* Port layer hooks */
+    void csLow(void);
+    void csHigh(void);
+    void transfer(const uint8_t *tx, uint8_t *rx, unsigned long n);
+    void resetPin(bool asserted);
+    void sdBus(bool held);
+    void tick(uint64_t nowUs);
+    /* Time of the next DFT completion, sequencer command or SINC2 sample, UINT64_MAX if idle */
+    uint64_t nextEventUs(void) const;
+
+    /* Direct access for tests / benchmarks (no SPI accounting) */
+    uint32_t peek(uint16_t addr) const;
+    void poke(uint16_t addr, uint32_t val) { writeReg(addr, val); }
+    void fillFifo(uint32_t word) { pushFifo(word); }
+
+    const SimStats &stats(void) const { return _stats; }
+    void clearStats(void) { _stats = SimStats(); }
+
+    /* Ideal impedance of the simulated cell at freq (Hz) */
+    std::complex<double> cellImpedance(double freq) const;
+    /* Admittance on CE0/SE0 at freq: cell or fixture, stray capacitance and leads */
+    std::complex<double> loadAdmittance(double freq) const;
+    /* Excitation frequency currently programmed into the waveform generator */
+    double wgFrequency(void) const;
+
+  private:
+    AD5940Sim();
+
+    enum SpiState { SPI_IDLE, SPI_SETADDR, SPI_WRITE, SPI_READ, SPI_FIFO, SPI_DONE };
+
+    void powerOnReset(void);
+    uint32_t readReg(uint16_t addr);
+    void writeReg(uint16_t addr, uint32_t val);
+    static bool is32Bit(uint16_t addr) { return addr >= 0x1000 && addr <= 0x3014; }
+
+    void startDft(void);
+    void finishDft(void);
+    double dftDurationUs(void) const;
+    void disturb(void) { _lastDisturbUs = _now; }
+
+    double filterRate(uint32_t src) const;
+    double excitationScale(void) const;
+    double cellRct(void) const;
+
+    /* Time-domain loop: HSDAC MMR output into the load, SINC2 samples of the HSTIA */
+    double mmrVolts(void) const;
+    void advanceLoad(double tUs);
+    void updateSampling(void);
+    void finishSample(void);
+
+    void startSeq(uint32_t seqId);
+    void stepSeq(void);
+    void stopSeq(void);
+
+    void pushFifo(uint32_t word);
+    uint32_t popFifo(void);
+    uint32_t fifoCapacity(void) const;
+
+    void raiseInt(uint32_t src);
+    void updateIrqLine(void);
+    double gaussian(void);
+
+    SimConfig _cfg;
+    SimStats _stats;
+    std::map<uint16_t, uint32_t> _regs;
+
+    /* SPI frame decoder */
+    SpiState _spiState = SPI_IDLE;
+    uint32_t _spiIndex = 0;
+    uint16_t _addr = 0;
+    uint32_t _shift = 0;
+    uint32_t _readLatch = 0;
+
+    uint64_t _now = 0;
+    bool _inReset = false;
+    bool _asleep = false;
+    bool _sdBus = false;       // SD card holds the shared SPI bus (AD5940_BusLock)
+    bool _irqLow = false;
+    uint8_t _irqPin = 0xFF;
+
+    bool _dftRunning = false;
+    uint64_t _dftStartUs = 0;
+    uint64_t _dftEndUs = 0;
+    uint64_t _lastDisturbUs = 0;
+
+    double _eventUs = 0;        // Exact time of the event or register write being handled
+    double _loadUs = 0;         // Time the loop state below was brought up to
+    double _vDl = 0;            // Voltage across the double layer
+    double _charge = 0;         // Charge into the HSTIA since the last SINC2 sample
+    bool _sampling = false;     // ADC converting with the FIFO on the SINC2 source
+    double _sampleNextUs = 0;
+
+    std::deque<uint32_t> _fifo;
+
+    /* Sequencer: 6 kB SRAM shared with the data FIFO, addressed in words */
+    uint32_t _seqRam[1536] = {0};
+    uint32_t _seqWriteAddr = 0;
+    bool _seqRunning = false;
+    uint32_t _seqPc = 0;
+    uint32_t _seqEnd = 0;
+    double _seqNextUs = 0;      // When the next command executes (fractional us)
+
+    uint64_t _rng;
+};
+
+#endif // AD5940SIM_H
@@ -0,0 +1,189 @@
+// Host replacement for HELPStatLib/ad594x.cpp
+
+/*
+Same port functions as the ESP32 version, but SPI frames and the reset line go
+to AD5940Sim instead of the SPI peripheral, and delays advance the virtual
+clock. The interrupt still arrives through attachInterrupt() on
+ESP32_INTERRUPT, so interruptISR / uCInterrupt behave exactly as on the board.
+AD5940_WaitMCUIntFlag stands in for the FreeRTOS semaphore wait: it jumps the
+virtual clock from one AFE event to the next until the ISR has run.
+
+Each AD5940_ReadWriteNBytes() call is charged one begin/endTransaction
+overhead plus 8 bits per byte at the configured SPI clock.
+AD5940_ReadWriteBurst() models the ESP32 DMA transaction instead: chip-select
+is driven by the "peripheral" and each call is charged spiBurstOverheadUs.
+
+As on the board, a mutex is held for every AD5940 frame (burst: first to last
+call of a frame, byte-wise: CsClr to CsSet) and by AD5940_BusLock /
+AD5940_BusUnlock, which the storage task calls from its own thread. The model
+is told when the SD card owns the bus and counts any AD5940 frame started in
+between as a bus conflict.
+*/
+
+#include "Arduino.h"
+#include "SPI.h"
+#include <constants.h>
+#include "AD5940Sim.h"
+#include <mutex>
+
+extern "C" {
+#include <ad5940.h>
+}
+
+
+volatile uint32_t uCInterrupt = 0;
+volatile uint32_t uCInterruptUs = 0;
+void IRAM_ATTR interruptISR();
+
+static double spiCarryUs = 0.0; // sub-microsecond SPI time not yet applied to the clock
+
+static std::mutex spiBusMutex;   // One AD5940 frame or SD access at a time
+static bool frameHeld = false;   // AD5940 frame in progress holds spiBusMutex
+
+static void frameBegin()
+{
+    if(!frameHeld) {
+        spiBusMutex.lock();
+        frameHeld = true;
+    }
+}
+
+static void frameEnd()
+{
+    if(frameHeld) {
+        frameHeld = false;
+        spiBusMutex.unlock();
+    }
+}
+
+static void simTick(uint64_t nowUs)
+{
+    AD5940Sim::instance().tick(nowUs);
+}
+
+void AD5940_RstClr()
+{
+    digitalWrite(RESET, LOW);
+    AD5940Sim::instance().resetPin(true);
+}
+
+void AD5940_RstSet()
+{
+    digitalWrite(RESET, HIGH);
+    AD5940Sim::instance().resetPin(false);
+}
+
+void AD5940_CsClr()
+{
+    frameBegin();
+    digitalWrite(CS, LOW);
+    AD5940Sim::instance().csLow();
+}
+
+void AD5940_CsSet()
+{
+    digitalWrite(CS, HIGH);
+    AD5940Sim::instance().csHigh();
+    frameEnd();
+}
+
+void AD5940_Delay10us(uint32_t iTime)
+{
+    delayMicroseconds(iTime * 10);
+}
+
+void AD5940_ReadWriteNBytes(unsigned char *pSendBuffer, unsigned char *pRecvBuff, unsigned long numBytes)
+{
+    AD5940Sim &sim = AD5940Sim::instance();
+    sim.transfer(pSendBuffer, pRecvBuff, numBytes);
+
+    spiCarryUs += sim.config().spiTxnOverheadUs + numBytes * 8.0 * 1e6 / sim.config().spiClockHz;
+    if(spiCarryUs >= 1.0) {
+        uint64_t whole = (uint64_t)spiCarryUs;
+        spiCarryUs -= whole;
+        HostSim::advanceUs(whole);
+    }
+}
+
+static bool burstCsHeld = false;
+
+void AD5940_ReadWriteBurst(unsigned char *pSendBuffer, unsigned char *pRecvBuff, unsigned long numBytes, BoolFlag bKeepCs)
+{
+    AD5940Sim &sim = AD5940Sim::instance();
+    frameBegin();
+    if(!burstCsHeld) sim.csLow();
+    sim.transfer(pSendBuffer, pRecvBuff, numBytes);
+    burstCsHeld = (bKeepCs == bTRUE);
+    if(!burstCsHeld) sim.csHigh();
+
+    spiCarryUs += sim.config().spiBurstOverheadUs + numBytes * 8.0 * 1e6 / sim.config().spiClockHz;
+    if(spiCarryUs >= 1.0) {
+        uint64_t whole = (uint64_t)spiCarryUs;
+        spiCarryUs -= whole;
+        HostSim::advanceUs(whole);
+    }
+    if(!burstCsHeld) frameEnd();
+}
+
+void AD5940_SPIRelease()
+{
+}
+
+void AD5940_BusLock()
+{
+    spiBusMutex.lock();
+    AD5940Sim::instance().sdBus(true);
+}
+
+void AD5940_BusUnlock()
+{
+    AD5940Sim::instance().sdBus(false);
+    spiBusMutex.unlock();
+}
+
+/* IINTERRUPT FUNCTIONS */
+void IRAM_ATTR interruptISR() {
+    uCInterrupt = 1;
+    uCInterruptUs = (uint32_t)HostSim::nowUs(); // micros() would move the clock from inside tick()
+}
+
+uint32_t AD5940_ClrMCUIntFlag() {
+    uCInterrupt = 0;
+    return 0;
+}
+
+uint32_t AD5940_GetMCUIntFlag() {
+    return uCInterrupt;
+}
+
+uint32_t AD5940_WaitMCUIntFlag(uint32_t timeoutMs) {
+    uint64_t deadline = HostSim::nowUs() + (uint64_t)timeoutMs * 1000;
+    while(!uCInterrupt && HostSim::nowUs() < deadline) {
+        uint64_t now = HostSim::nowUs();
+        uint64_t next = AD5940Sim::instance().nextEventUs();
+        if(next > deadline) next = deadline;
+        HostSim::idleUs(next > now ? next - now : 1);
+    }
+    return uCInterrupt;
+}
+
+uint32_t AD5940_GetMCUIntTimeUs() {
+    return uCInterruptUs;
+}
+
+uint32_t AD5940_MCUResourceInit() {
+    Serial.begin(SERIAL_BAUD);
+
+    HostSim::setTickHook(simTick);
+    AD5940Sim::instance().setIrqPin(ESP32_INTERRUPT);
+
+    pinMode(CS, OUTPUT);
+    pinMode(RESET, OUTPUT);
+    pinMode(ESP32_INTERRUPT, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(ESP32_INTERRUPT), interruptISR, FALLING);
+
+    AD5940_RstSet();
+    AD5940_CsSet();
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*
+    FILENAME: bench_common.h
+
+    Shared by the HELPStat host benches: the demo gain table, the HELPStat
+    instance and quiet(), which sends stdout (HELPStat's own printing) to
+    /dev/null around the calls being measured.
+*/
+
+#ifndef HOSTSIM_BENCH_COMMON_H
+#define HOSTSIM_BENCH_COMMON_H
+
+#include "HELPStat.h"
+#include "AD5940Sim.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Same gain table as AD594x_EIS_Demo.ino */
+inline calHSTIA gainTable[] = {
+  {0.51,   HSTIARTIA_40K},
+  {1.5,    HSTIARTIA_10K},
+  {20,     HSTIARTIA_5K},
+  {150,    HSTIARTIA_5K},
+  {400,    HSTIARTIA_1K},
+  {100000, HSTIARTIA_200}
+};
+
+static HELPStat helpstat; // Large (noise buffer), keep it off the stack
+
+inline int quietFd = -1;
+
+inline void quiet(bool enable) {
+  fflush(stdout);
+  if(enable) {
+    quietFd = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+  }
+  else if(quietFd >= 0) {
+    dup2(quietFd, STDOUT_FILENO);
+    close(quietFd);
+    quietFd = -1;
+  }
+}
+
+#endif /* HOSTSIM_BENCH_COMMON_H */
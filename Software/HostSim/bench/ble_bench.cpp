@@ -0,0 +1,277 @@
+/*
+    FILENAME: ble_bench.cpp
+
+    Runs a sweep against the simulated AD5940, then BLE_transmitResults to a
+    simulated central and decodes what went over the air. With the bulk
+    characteristic subscribed (default) every frame is checked with
+    bleFrameDecode (CRC, sequence numbers, point indices) and the points are
+    compared with getResult; --legacy leaves it unsubscribed so the ASCII
+    characteristics are used instead, for comparison.
+
+    With --stream the points are streamed while runSweep runs
+    (setBleStreaming); every point must arrive before the sweep returns,
+    provisional Rct / Rs (online fit) must have been sent on the RCT / RS
+    characteristics, and BLE_transmitResults must only add the summary frame.
+    --step fraction / --step-at s turn the Kramers-Kronig gate on and step Rct
+    part-way through a cycle: the repeat of that cycle must be sent again from
+    its first point with a higher attempt number, and the points the central
+    keeps (highest attempt per index) must be the stored results.
+    --dead-freq makes every DFT at that frequency hang; the failed points
+    must not be sent, on either path, and their indices are the only gaps.
+
+    With --config the sweep settings come over BLE instead: a full CONFIG
+    write, a NUMPOINTS write on top of it, a corrupt CONFIG write that must be
+    rejected, then START; BLE_settings must return at once with exactly those
+    settings applied, and the sweep is run from them (AD5940_TDD(gainArr, n)).
+
+    Usage: ble_bench [--check] [--legacy] [--s16] [--stream] [--config] [--mtu n]
+                     [--points per-decade] [--cycles n] [--congest-every n] [--expect-fallback]
+                     [--step fraction] [--step-at s] [--dead-freq Hz]
+
+    --mtu is the ATT MTU the central asks for (23 = no MTU exchange, which is
+    too small for a frame; --expect-fallback checks the ASCII path was used).
+    --congest-every n makes every nth notification fail as if the controller's
+    buffers were full; those frames must be retried, not lost.
+*/
+
+#include "bench_common.h"
+
+#include <vector>
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  uint32_t numPoints = 6, numCycles = 0, congestEvery = 0;
+  uint16_t mtu = BLE_MTU;
+  bool check = false, legacy = false, s16 = false, stream = false, config = false, expectFallback = false;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--legacy")) legacy = true;
+    else if(!strcmp(a, "--s16")) s16 = true;
+    else if(!strcmp(a, "--stream")) stream = true;
+    else if(!strcmp(a, "--config")) config = true;
+    else if(!strcmp(a, "--expect-fallback")) expectFallback = true;
+    else if(!strcmp(a, "--mtu")) { mtu = atoi(v); i++; }
+    else if(!strcmp(a, "--points")) { numPoints = atoi(v); i++; }
+    else if(!strcmp(a, "--cycles")) { numCycles = atoi(v); i++; }
+    else if(!strcmp(a, "--congest-every")) { congestEvery = atoi(v); i++; }
+    else if(!strcmp(a, "--step")) { cfg.cell.rctStep = atof(v); i++; }
+    else if(!strcmp(a, "--step-at")) { cfg.cell.rctStepS = atof(v); i++; }
+    else if(!strcmp(a, "--dead-freq")) { cfg.deadFreq = atof(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+
+  AD5940Sim::instance().configure(cfg);
+  quiet(true);
+  helpstat.BLE_setup();
+  BLEServer *pServer = BLEDevice::createServer();
+  BLECharacteristic *pBulk = pServer->getServiceByIndex(0)->getCharacteristic(CHARACTERISTIC_UUID_BULK);
+  pServer->hostConnect(mtu);
+  if(!legacy) ((BLE2902 *)pBulk->getDescriptorByUUID("2902"))->setNotifications(true);
+  /* The ASCII characteristics are always subscribed; they must stay quiet in bulk mode */
+  const char *asciiUuids[] = {CHARACTERISTIC_UUID_RCT, CHARACTERISTIC_UUID_RS, CHARACTERISTIC_UUID_CURRENTFREQ,
+                              CHARACTERISTIC_UUID_REAL, CHARACTERISTIC_UUID_IMAG, CHARACTERISTIC_UUID_PHASE,
+                              CHARACTERISTIC_UUID_MAGNITUDE};
+  std::vector<BLECharacteristic *> ascii;
+  for(const char *uuid : asciiUuids) {
+    BLECharacteristic *c = pServer->getServiceByIndex(0)->getCharacteristic(uuid);
+    ((BLE2902 *)c->getDescriptorByUUID("2902"))->setNotifications(true);
+    ascii.push_back(c);
+  }
+  BLECharacteristic *pIndex = pServer->getServiceByIndex(0)->getCharacteristic(CHARACTERISTIC_UUID_SWEEPINDEX);
+  ((BLE2902 *)pIndex->getDescriptorByUUID("2902"))->setNotifications(true);
+  pBulk->hostCapture(true);
+  pBulk->hostCongestEvery(congestEvery);
+  if(s16) helpstat.setBleFormat(BLE_FRAME_POINTS_S16);
+  helpstat.setBleStreaming(stream);
+  helpstat.setKKTest(cfg.cell.rctStep != 0);
+
+  bool configOk = true;
+  double settingsMs = 0;
+  if(config) {
+    BLEService *pService = pServer->getServiceByIndex(0);
+    bleConfig want = {0};
+    want.rctEstimate = 1000;
+    want.rsEstimate = 100;
+    want.numCycles = numCycles;
+    want.numPoints = numPoints + 3;   // Overwritten by the NUMPOINTS write below
+    want.startFreq = 100000;
+    want.endFreq = 1;
+    want.rcalVal = cfg.rcal;
+    want.extGain = 1;
+    want.dacGain = 1;
+    strcpy(want.folderName, "ble-config");
+    strcpy(want.fileName, "run-1");
+    uint8_t buf[BLE_CONFIG_SIZE];
+    bleConfigEncode(buf, &want);
+    pService->getCharacteristic(CHARACTERISTIC_UUID_CONFIG)->hostWrite(buf, sizeof(buf));
+
+    char text[16];
+    snprintf(text, sizeof(text), "%u", numPoints);
+    pService->getCharacteristic(CHARACTERISTIC_UUID_NUMPOINTS)->hostWrite((const uint8_t *)text, strlen(text));
+    want.numPoints = numPoints;
+
+    bleConfig bad = want;
+    bad.numPoints = 99;
+    bleConfigEncode(buf, &bad);
+    buf[10] ^= 0x01;
+    pService->getCharacteristic(CHARACTERISTIC_UUID_CONFIG)->hostWrite(buf, sizeof(buf));
+
+    /* CONFIG reads back what is pending: the corrupt write must not have landed */
+    BLECharacteristic *pConfig = pService->getCharacteristic(CHARACTERISTIC_UUID_CONFIG);
+    bleConfig pending;
+    configOk = bleConfigDecode(pConfig->getData(), pConfig->getLength(), &pending) == BLE_FRAME_OK &&
+               pending.numPoints == numPoints;
+
+    const uint8_t start = 1;
+    pService->getCharacteristic(CHARACTERISTIC_UUID_START)->hostWrite(&start, 1);
+    uint64_t s0 = HostSim::nowUs();
+    helpstat.BLE_settings();
+    settingsMs = (HostSim::nowUs() - s0) * 1e-3;
+
+    bleConfig got = helpstat.getBleConfig();
+    configOk = configOk && got.numPoints == want.numPoints && got.numCycles == want.numCycles &&
+               got.startFreq == want.startFreq && got.endFreq == want.endFreq && got.rcalVal == want.rcalVal &&
+               got.rctEstimate == want.rctEstimate && got.rsEstimate == want.rsEstimate &&
+               !strcmp(got.folderName, want.folderName) && !strcmp(got.fileName, want.fileName);
+  }
+
+  helpstat.AD5940Start();
+  if(config) {
+    helpstat.AD5940_TDD(gainTable, sizeof(gainTable) / sizeof(gainTable[0]));
+    helpstat.runSweep();
+  }
+  else {
+    helpstat.AD5940_TDD(100000, 1, numPoints, 0.0, 0.0, cfg.rcal,
+                        gainTable, sizeof(gainTable) / sizeof(gainTable[0]), 1, 1);
+    helpstat.runSweep(numCycles, 0);
+  }
+  size_t liveFrames = pBulk->hostSent().size();
+  bleStats streamStats = helpstat.getBleStats();
+
+  uint64_t asciiBefore = 0;
+  for(BLECharacteristic *c : ascii) asciiBefore += c->notifyCount();
+  uint32_t provisional = ascii[0]->notifyCount(); // RCT
+  uint64_t t0 = HostSim::nowUs();
+  helpstat.BLE_transmitResults();
+  double txMs = (HostSim::nowUs() - t0) * 1e-3;
+  quiet(false);
+
+  /* Failed points (decoded with freq 0) are not sent */
+  uint32_t total = helpstat.getSweepPoints() * (numCycles + 1), valid = 0;
+  std::vector<bool> failed(total);
+  for(uint32_t i = 0; i < total; i++) {
+    failed[i] = helpstat.getResult(i).freq <= 0;
+    if(!failed[i]) valid++;
+  }
+  auto allFailed = [&](uint32_t from, uint32_t to) {
+    for(uint32_t i = from; i < to; i++)
+      if(!failed[i]) return false;
+    return true;
+  };
+  uint64_t asciiNotifies = 0, asciiBytes = 0;
+  for(BLECharacteristic *c : ascii) {
+    asciiNotifies += c->notifyCount();
+    asciiBytes += c->notifyBytes();
+  }
+  asciiNotifies -= asciiBefore;
+
+  printf("HELPStat host BLE transfer benchmark (%s)\n", legacy || !pBulk->notifyCount() ? "ASCII characteristics" : s16 ? "bulk, int16" : "bulk, float32");
+  printf("  results         : %u points x %u cycle(s), %u failed\n", helpstat.getSweepPoints(), numCycles + 1,
+         total - valid);
+  printf("  ATT MTU         : %u\n", mtu);
+  printf("  virtual time    : %.1f ms (%.2f ms / point)\n", txMs, total ? txMs / total : 0.0);
+  printf("  notifications   : %llu ASCII (%llu bytes), %u bulk (%llu bytes)\n",
+         (unsigned long long)asciiNotifies, (unsigned long long)asciiBytes, pBulk->notifyCount(),
+         (unsigned long long)pBulk->notifyBytes());
+  if(config)
+    printf("  BLE settings    : %s, applied %.1f ms after START\n", configOk ? "ok" : "MISMATCH", settingsMs);
+  if(check && (!configOk || settingsMs > BLE_BUTTON_POLL_MS)) {
+    printf("CHECK FAILED\n");
+    return 1;
+  }
+  if(legacy || expectFallback) {
+    if(check && (asciiNotifies != 2 + 5 * valid || pBulk->notifyCount())) {
+      printf("CHECK FAILED\n");
+      return 1;
+    }
+    return 0;
+  }
+
+  bleStats bs = helpstat.getBleStats();
+  printf("  congested       : %u notifications retried (%u reported)\n", bs.retries, pBulk->hostCongested());
+  if(stream)
+    printf("  streamed        : %zu frames during the sweep, %u SWEEPINDEX / %u provisional RCT updates, %u from the store, %u sent again, worst latency %lu ms\n",
+           liveFrames, pIndex->notifyCount(), provisional, streamStats.requeued, streamStats.resent, streamStats.maxLatencyMs);
+
+  /* Decode everything the central received. Frames follow on from the last one (skipping only failed
+     points), or go back to the first sent point of a cycle with a higher attempt (KK repeat); the
+     highest attempt of each index is kept */
+  int fails = 0;
+  uint32_t received = 0, expectSeq = 0, next = 0, repeats = 0;
+  bool gotSummary = false;
+  double maxErr = 0;
+  bleSummary summary = {0};
+  std::vector<blePoint> kept(total);
+  std::vector<int> keptAttempt(total, -1);
+  for(const std::vector<uint8_t> &frame : pBulk->hostSent()) {
+    bleFrameHdr hdr;
+    blePoint pts[BLE_FRAME_MAX_COUNT];
+    int rc = bleFrameDecode(frame.data(), frame.size(), &hdr, pts, BLE_FRAME_MAX_COUNT, &summary);
+    if(rc != BLE_FRAME_OK) { printf("  frame %u: decode error %d\n", expectSeq, rc); fails++; continue; }
+    if(hdr.seq != expectSeq++) { printf("  frame %u: sequence %u\n", expectSeq - 1, hdr.seq); fails++; }
+    if(hdr.type == BLE_FRAME_SUMMARY) { gotSummary = (hdr.flags & BLE_FRAME_LAST) != 0; continue; }
+    int attempt = bleFrameAttempt(hdr.flags);
+    bool rewind = hdr.first < next && hdr.first < total && allFailed(hdr.first - hdr.first % hdr.sweepPoints, hdr.first) &&
+                  attempt > keptAttempt[hdr.first];
+    if(rewind) repeats++;
+    else if(hdr.first < next || hdr.first > total || !allFailed(next, hdr.first)) { printf("  frame %u: first %u, expected %u\n", hdr.seq, hdr.first, next); fails++; }
+    for(uint32_t k = 0; k < hdr.count && hdr.first + k < total; k++) {
+      if(failed[hdr.first + k]) { printf("  frame %u: failed point %u sent\n", hdr.seq, hdr.first + k); fails++; }
+      if(keptAttempt[hdr.first + k] < 0) received++;
+      else if(attempt <= keptAttempt[hdr.first + k]) { printf("  frame %u: index %u sent again at attempt %d\n", hdr.seq, hdr.first + k, attempt); fails++; }
+      kept[hdr.first + k] = pts[k];
+      keptAttempt[hdr.first + k] = attempt;
+    }
+    next = hdr.first + hdr.count;
+  }
+  for(uint32_t i = 0; i < total; i++) {
+    if(keptAttempt[i] < 0) continue;
+    impStruct r = helpstat.getResult(i);
+    double mag = sqrt(r.real * r.real + r.imag * r.imag);
+    double err = fmax(fabs(kept[i].real - r.real), fabs(kept[i].imag - r.imag)) / (mag > 0 ? mag : 1);
+    if(kept[i].freq != r.freq) err = 1;
+    if(err > maxErr) maxErr = err;
+  }
+
+  /* A flipped bit anywhere in a frame must be caught */
+  bool crcCaught = true;
+  if(!pBulk->hostSent().empty()) {
+    std::vector<uint8_t> bad = pBulk->hostSent()[0];
+    bad[bad.size() / 2] ^= 0x10;
+    bleFrameHdr hdr;
+    crcCaught = bleFrameDecode(bad.data(), bad.size(), &hdr, NULL, 0, NULL) == BLE_FRAME_ERR_CRC;
+  }
+
+  printf("  frames          : %u (%.1f points / frame), %u bytes, %.1f bytes / point\n", bs.frames,
+         bs.frames > 1 ? (double)bs.points / (bs.frames - 1) : 0.0, bs.bytes, total ? (double)bs.bytes / total : 0.0);
+  printf("  decoded         : %u / %u points, %u cycle(s) sent again, summary %s (Rct %g, Rs %g), max error %.2e\n",
+         received, valid, repeats, gotSummary ? "ok" : "missing", summary.rct, summary.rs, maxErr);
+
+  if(check) {
+    double tol = s16 ? 1e-4 : 0;
+    if(fails || !gotSummary || received != valid || summary.points != valid || maxErr > tol || !crcCaught ||
+       asciiNotifies != 2 || !bs.complete || (congestEvery && !bs.retries) ||
+       (stream && (liveFrames + 1 != pBulk->hostSent().size() || !pIndex->notifyCount() || !provisional)) ||
+       (stream && cfg.cell.rctStep != 0 && (!repeats || !bs.resent))) {
+      printf("CHECK FAILED\n");
+      return 1;
+    }
+  }
+  return 0;
+}
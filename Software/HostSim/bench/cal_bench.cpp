@@ -0,0 +1,162 @@
+/*
+    FILENAME: cal_bench.cpp
+
+    Persistent RTIA calibration against the simulated AD5940. Measures one
+    cycle two-leg as the reference, characterises every RTIA over the sweep
+    (calibrateRtia), optionally the open and shorted leads (--open-short, with
+    the simulated fixture swapped in), saves the table to NVS, drops it from
+    memory, loads it back and measures the cycle again single-leg
+    (setCalibration). The simulated cell can sit behind lead resistance
+    (--lead) and stray capacitance (--stray) for the compensation to remove.
+    Reports the time, DFT count and the worst |Z| / phase error against the
+    bare cell for both runs.
+
+    Usage: cal_bench [--check] [--open-short] [--mismatch] [--points per-decade]
+                     [--lead ohm] [--stray pF] [--rs ohm] [--rct ohm] [--noise codes]
+                     [--seed n] [--verbose]
+
+    --check exits non-zero unless the table came back from NVS and: every
+    point was measured single-leg in at most 60 % of the reference time,
+    within 2 % / 2 deg of the cell (with --open-short, of the cell without
+    the leads, where the reference must be more than twice as far off); or,
+    with --mismatch (the sweep changes after calibrating), no point used the
+    table and the results are still within 2 % / 2 deg.
+*/
+
+#include "bench_common.h"
+#include "Preferences.h"
+
+typedef struct {
+  double seconds;         // Virtual time of the cycle
+  uint64_t dfts;          // DFTs the simulated AFE ran (settling checks included)
+  double magErrPct;       // Worst |Z| error against the bare cell
+  double phaseErrDeg;     // Worst phase error
+  uint32_t calFlagged;    // Records marked DFTREC_CAL
+} runResult;
+
+static runResult measure(float startFreq, float endFreq, uint32_t numPoints, float rcal, bool verbose) {
+  runResult res = {0};
+  AD5940Sim &sim = AD5940Sim::instance();
+
+  quiet(true);
+  helpstat.AD5940_TDD(startFreq, endFreq, numPoints, 0.0, 0.0, rcal,
+                      gainTable, sizeof(gainTable) / sizeof(gainTable[0]), 1, 1);
+  sim.clearStats();
+  uint64_t start = HostSim::nowUs();
+  helpstat.runSweep(0, 0);
+  res.seconds = (HostSim::nowUs() - start) * 1e-6;
+  res.dfts = sim.stats().dftCount;
+  quiet(false);
+
+  for(uint32_t i = 0; i < helpstat.getSweepPoints(); i++) {
+    impStruct eis = helpstat.getResult(i);
+    std::complex<double> z = sim.cellImpedance(eis.freq);
+    double magErr = fabs(eis.magnitude - std::abs(z)) / std::abs(z) * 100;
+    double phaseErr = fabs(eis.phaseDeg - std::arg(z) * 180 / M_PI);
+    res.magErrPct = fmax(res.magErrPct, magErr);
+    res.phaseErrDeg = fmax(res.phaseErrDeg, phaseErr);
+    if(helpstat.getRecord(i).flags & DFTREC_CAL) res.calFlagged++;
+    if(verbose)
+      printf("    %10.2f Hz : |Z| %9.2f (cell %9.2f, %+.3f %%), phase %+.2f deg (%+.2f)%s\n", eis.freq, eis.magnitude,
+             std::abs(z), magErr, eis.phaseDeg, std::arg(z) * 180 / M_PI,
+             (helpstat.getRecord(i).flags & DFTREC_CAL) ? ", calibrated" : "");
+  }
+  return res;
+}
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  uint32_t numPoints = 6;
+  bool check = false, openShort = false, mismatch = false, verbose = false;
+  const float startFreq = 100000, endFreq = 1;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--open-short")) openShort = true;
+    else if(!strcmp(a, "--mismatch")) mismatch = true;
+    else if(!strcmp(a, "--verbose")) verbose = true;
+    else if(!strcmp(a, "--points")) { numPoints = atoi(v); i++; }
+    else if(!strcmp(a, "--lead")) { cfg.leadOhms = atof(v); i++; }
+    else if(!strcmp(a, "--stray")) { cfg.strayPf = atof(v); i++; }
+    else if(!strcmp(a, "--rs")) { cfg.cell.rs = atof(v); i++; }
+    else if(!strcmp(a, "--rct")) { cfg.cell.rct = atof(v); i++; }
+    else if(!strcmp(a, "--noise")) { cfg.noiseCodes = atof(v); i++; }
+    else if(!strcmp(a, "--seed")) { cfg.seed = atoi(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+
+  AD5940Sim &sim = AD5940Sim::instance();
+  sim.configure(cfg);
+  HostSim::nvsErase();
+
+  printf("HELPStat host RTIA calibration benchmark\n");
+  printf("  cell            : Rs=%g Rct=%g Cdl=%g, leads %g ohm, stray %g pF, noise=%g codes\n", cfg.cell.rs,
+         cfg.cell.rct, cfg.cell.cdl, cfg.leadOhms, cfg.strayPf, cfg.noiseCodes);
+
+  quiet(true);
+  helpstat.AD5940Start();
+  quiet(false);
+  if(verbose) printf("  two-leg:\n");
+  runResult ref = measure(startFreq, endFreq, numPoints, cfg.rcal, verbose);
+
+  /* Characterise, then the leads on their own */
+  quiet(true);
+  helpstat.AD5940_TDD(startFreq, endFreq, numPoints, 0.0, 0.0, cfg.rcal,
+                      gainTable, sizeof(gainTable) / sizeof(gainTable[0]), 1, 1);
+  uint64_t calStart = HostSim::nowUs();
+  bool calOk = helpstat.calibrateRtia();
+  if(openShort) {
+    sim.setFixture(SIM_FIXTURE_OPEN);
+    calOk = calOk && helpstat.calibrateFixture(CAL_FIXTURE_OPEN);
+    sim.setFixture(SIM_FIXTURE_SHORT);
+    calOk = calOk && helpstat.calibrateFixture(CAL_FIXTURE_SHORT);
+    sim.setFixture(SIM_FIXTURE_CELL);
+  }
+  double calSeconds = (HostSim::nowUs() - calStart) * 1e-6;
+  bool saved = calOk && helpstat.saveCalibration();
+
+  /* As after a power cycle: only what is in NVS */
+  helpstat.clearCalibration();
+  bool loaded = helpstat.loadCalibration();
+  helpstat.setCalibration(true, openShort);
+  quiet(false);
+
+  uint32_t rtiaCount = 0;
+  for(uint32_t i = 0; i < helpstat.getSweepPoints(); i++)
+    rtiaCount += __builtin_popcount(helpstat.getCalPoint(i).rtiaMask);
+  printf("  calibration     : %s, %.1f s, %u RTIA settings over %u points, %s / %s NVS\n", calOk ? "done" : "FAILED",
+         calSeconds, rtiaCount, helpstat.getSweepPoints(), saved ? "saved to" : "NOT saved to",
+         loaded ? "loaded from" : "NOT loaded from");
+
+  if(verbose) printf("  single-leg:\n");
+  runResult cal = measure(startFreq, mismatch ? endFreq * 2 : endFreq, numPoints, cfg.rcal, verbose);
+  calStats cs = helpstat.getCalStats();
+
+  printf("  two-leg         : %.1f s, %llu DFTs, |Z| error %.3f %%, phase error %.3f deg\n", ref.seconds,
+         (unsigned long long)ref.dfts, ref.magErrPct, ref.phaseErrDeg);
+  printf("  single-leg      : %.1f s, %llu DFTs, |Z| error %.3f %%, phase error %.3f deg\n", cal.seconds,
+         (unsigned long long)cal.dfts, cal.magErrPct, cal.phaseErrDeg);
+  printf("  points          : %u single-leg, %u two-leg, %u compensated, %u records flagged\n", cs.singleLeg,
+         cs.twoLeg, cs.compensated, cal.calFlagged);
+
+  if(check) {
+    uint32_t points = helpstat.getSweepPoints();
+    bool ok = calOk && saved && loaded && cal.magErrPct <= 2.0 && cal.phaseErrDeg <= 2.0;
+    if(mismatch) ok = ok && cs.singleLeg == 0 && cs.twoLeg == points && cs.compensated == 0 && cal.calFlagged == 0;
+    else {
+      ok = ok && cs.singleLeg == points && cs.twoLeg == 0 && cal.calFlagged == points &&
+           cal.seconds <= 0.6 * ref.seconds;
+      if(openShort) ok = ok && cs.compensated == points && ref.magErrPct > 2 * cal.magErrPct;
+    }
+    if(!ok) {
+      printf("CHECK FAILED\n");
+      return 1;
+    }
+  }
+  return 0;
+}
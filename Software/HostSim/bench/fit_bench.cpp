@@ -0,0 +1,291 @@
+/*
+    FILENAME: fit_bench.cpp
+
+    Runs a sweep against the simulated Randles cell, then fits Rs and Rct to
+    the results two ways: the old pair of Levenberg-Marquardt passes
+    (calculate_Rct + calculate_Rs, numerical Jacobians) and the joint
+    fit_Randles used by calculateResistors. Reports the fitted values against
+    the simulated cell, iterations / evaluations, and host time per fit.
+
+    calculateResistors() starts from the online fit built while the sweep ran
+    (setOnlineFit, randlesOnline in lma.h); --cold turns that off so it starts
+    from HELPStat's default estimates instead.
+
+    With --circuit the complex CNLS fit (fit_CNLS / fitCircuit, cnls.h) is
+    run as well, for model rc, cpe, warburg or cpe+warburg; --cpe-n and
+    --sigma give the simulated cell a CPE and a Warburg tail. The same circuit
+    is also fitted as a compile-time model (fit_circuit, circuit.h).
+
+    --per-cycle fits every cycle on its own as it finishes (setCycleFit) and
+    prints the Rs / Rct series; --drift makes the cell's Rct change by that
+    fraction per second of simulated time.
+
+    --dead-freq makes every DFT at that frequency hang, so each cycle holds a
+    DFTREC_FAILED point; the benchmark fits and the library leave it out.
+
+    Usage: fit_bench [--check] [--points per-decade] [--cycles n] [--rs ohm] [--rct ohm]
+                     [--cdl F] [--cpe-n n] [--sigma ohm/sqrt(s)] [--noise codes] [--seed n]
+                     [--rct-est ohm] [--rs-est ohm] [--reps n] [--tol pct] [--cold] [--circuit model]
+                     [--per-cycle] [--drift fraction/s] [--dead-freq Hz]
+
+    --check exits non-zero unless the joint fit converged (from the given
+    estimates and from HELPStat's defaults) within --tol percent (default 2)
+    of the simulated Rs and Rct, and (without --cold) calculateResistors
+    needed at most two iterations. With --circuit only the CNLS fit is checked:
+    Rs, Rct and Q within --tol percent, n within 0.01 and sigma within --tol
+    percent of the cell, and the compile-time model must agree with fit_CNLS
+    to 0.1 percent. With --per-cycle every cycle must be fitted, in time
+    order, and each cycle's Rct must lie within --tol percent of the range the
+    drifting cell passed through while that cycle was measured. With
+    --dead-freq the failed points must also be missing from the data (one
+    per cycle).
+*/
+
+#include "bench_common.h"
+
+#include <chrono>
+#include <vector>
+
+static double pctErr(double v, double ref) { return fabs(v - ref) / ref * 100.0; }
+
+/* The CNLS models as compile-time circuits (circuit.h), parameters in element order */
+using circuit::R;
+using circuit::C;
+using circuit::CPE;
+using circuit::W;
+using circuit::Series;
+using circuit::Parallel;
+typedef Series<R, Parallel<C, R> > ModelRC;                           // Rs, Cdl, Rct
+typedef Series<R, Parallel<CPE, R> > ModelCPE;                        // Rs, Q, n, Rct
+typedef Series<R, Parallel<C, Series<R, W> > > ModelWarburg;          // Rs, Cdl, Rct, sigma
+typedef Series<R, Parallel<CPE, Series<R, W> > > ModelCPEWarburg;     // Rs, Q, n, Rct, sigma
+
+/* Runs fit_circuit<Model> from the CNLS starting point and reports it as a cnlsFit */
+template<class Model>
+static cnlsFit templateFit(const std::vector<float> &freq, const std::vector<float> &re, const std::vector<float> &im,
+                           int model, uint32_t reps, double *pUs) {
+  cnlsParams init = cnls_estimate(freq.data(), re.data(), im.data(), freq.size());
+  bool cpe = model & CNLS_MODEL_CPE, warburg = model & CNLS_MODEL_WARBURG;
+  float p0[Model::N];
+  int k = 0;
+  p0[k++] = init.rs;
+  p0[k++] = init.q;
+  if(cpe) p0[k++] = init.n;
+  p0[k++] = init.rct;
+  if(warburg) p0[k++] = 0.01f * init.rct; // Log-parameterised: sigma cannot start at 0
+
+  circuit::fit<Model> fit;
+  auto t0 = std::chrono::steady_clock::now();
+  for(uint32_t r = 0; r < reps; r++) fit = fit_circuit<Model>(freq.data(), re.data(), im.data(), freq.size(), p0);
+  *pUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / reps;
+
+  cnlsFit out = {};
+  k = 0;
+  out.p.rs = fit.p[k++];
+  out.p.q = fit.p[k++];
+  out.p.n = cpe ? fit.p[k++] : 1.0f;
+  out.p.rct = fit.p[k++];
+  out.p.sigma = warburg ? fit.p[k++] : 0.0f;
+  out.model = model;
+  out.chi2 = fit.chi2;
+  out.rmsRel = fit.rmsRel;
+  out.iterations = fit.iterations;
+  out.evaluations = fit.evaluations;
+  out.status = fit.status;
+  return out;
+}
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  uint32_t numPoints = 6, numCycles = 0, reps = 200;
+  float rctEst = 1000, rsEst = 100, tol = 2;
+  bool check = false, cold = false, perCycle = false;
+  int circuit = -1;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--cold")) cold = true;
+    else if(!strcmp(a, "--per-cycle")) perCycle = true;
+    else if(!strcmp(a, "--points")) { numPoints = atoi(v); i++; }
+    else if(!strcmp(a, "--cycles")) { numCycles = atoi(v); i++; }
+    else if(!strcmp(a, "--rs")) { cfg.cell.rs = atof(v); i++; }
+    else if(!strcmp(a, "--rct")) { cfg.cell.rct = atof(v); i++; }
+    else if(!strcmp(a, "--cdl")) { cfg.cell.cdl = atof(v); i++; }
+    else if(!strcmp(a, "--cpe-n")) { cfg.cell.cpeN = atof(v); i++; }
+    else if(!strcmp(a, "--sigma")) { cfg.cell.sigmaW = atof(v); i++; }
+    else if(!strcmp(a, "--drift")) { cfg.cell.rctDrift = atof(v); i++; }
+    else if(!strcmp(a, "--dead-freq")) { cfg.deadFreq = atof(v); i++; }
+    else if(!strcmp(a, "--circuit")) {
+      if(!strcmp(v, "rc")) circuit = CNLS_MODEL_RC;
+      else if(!strcmp(v, "cpe")) circuit = CNLS_MODEL_CPE;
+      else if(!strcmp(v, "warburg")) circuit = CNLS_MODEL_WARBURG;
+      else if(!strcmp(v, "cpe+warburg")) circuit = CNLS_MODEL_CPE | CNLS_MODEL_WARBURG;
+      else {
+        fprintf(stderr, "Unknown circuit: %s\n", v);
+        return 2;
+      }
+      i++;
+    }
+    else if(!strcmp(a, "--noise")) { cfg.noiseCodes = atof(v); i++; }
+    else if(!strcmp(a, "--seed")) { cfg.seed = atoi(v); i++; }
+    else if(!strcmp(a, "--rct-est")) { rctEst = atof(v); i++; }
+    else if(!strcmp(a, "--rs-est")) { rsEst = atof(v); i++; }
+    else if(!strcmp(a, "--reps")) { reps = atoi(v); i++; }
+    else if(!strcmp(a, "--tol")) { tol = atof(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+  if(reps < 1) reps = 1;
+
+  AD5940Sim::instance().configure(cfg);
+  quiet(true);
+  helpstat.setOnlineFit(!cold);
+  helpstat.setCycleFit(perCycle);
+  helpstat.AD5940Start();
+  helpstat.AD5940_TDD(100000, 1, numPoints, 0.0, 0.0, cfg.rcal,
+                      gainTable, sizeof(gainTable) / sizeof(gainTable[0]), 1, 1);
+  helpstat.runSweep(numCycles, 0);
+  quiet(false);
+
+  /* A failed point decodes with freq 0 and is left out, as calculateResistors does */
+  uint32_t stored = helpstat.getSweepPoints() * (numCycles + 1);
+  std::vector<float> freq, re, im;
+  for(uint32_t i = 0; i < stored; i++) {
+    impStruct r = helpstat.getResult(i);
+    if(r.freq <= 0) continue;
+    freq.push_back(r.freq);
+    re.push_back(r.real);
+    im.push_back(r.imag);
+  }
+
+  /* Old: two independent passes */
+  float oldRct = 0, oldRs = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for(uint32_t k = 0; k < reps; k++) {
+    oldRct = calculate_Rct(rctEst, rsEst, re, im);
+    oldRs = calculate_Rs(rctEst, rsEst, re, im);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  int oldStatus = get_LM_status();
+
+  /* New: one joint fit */
+  randlesFit fit = {0};
+  for(uint32_t k = 0; k < reps; k++) fit = fit_Randles(rctEst, rsEst, re, im);
+  auto t2 = std::chrono::steady_clock::now();
+  double oldUs = std::chrono::duration<double, std::micro>(t1 - t0).count() / reps;
+  double newUs = std::chrono::duration<double, std::micro>(t2 - t1).count() / reps;
+
+  /* Through the library: warm from the online fit, or from HELPStat's default estimates */
+  float provRct = 0, provRs = 0;
+  bool prov = helpstat.getProvisionalFit(&provRct, &provRs);
+  quiet(true);
+  helpstat.calculateResistors();
+  quiet(false);
+  randlesFit lib = helpstat.getRandlesFit();
+  uint32_t total = freq.size();
+  bool deadLeftOut = stored - total == (cfg.deadFreq > 0 ? numCycles + 1 : 0);
+
+  printf("HELPStat host Rs / Rct fit benchmark\n");
+  printf("  cell            : Rs=%g Rct=%g Cdl=%g n=%g sigma=%g, noise=%g codes\n", cfg.cell.rs, cfg.cell.rct,
+         cfg.cell.cdl, cfg.cell.cpeN, cfg.cell.sigmaW, cfg.noiseCodes);
+  printf("  data            : %u points (%u failed), estimates Rct=%g Rs=%g\n", total, stored - total, rctEst,
+         rsEst);
+  printf("  two passes      : Rct=%.2f (%.2f %%) Rs=%.2f (%.2f %%), status %d, %.1f us / fit\n",
+         oldRct, pctErr(oldRct, cfg.cell.rct), oldRs, pctErr(oldRs, cfg.cell.rs), oldStatus, oldUs);
+  printf("  joint fit       : Rct=%.2f (%.2f %%) Rs=%.2f (%.2f %%), status %d, %d iterations, %d evaluations, "
+         "rms %.3f ohm, %.1f us / fit\n",
+         fit.rct, pctErr(fit.rct, cfg.cell.rct), fit.rs, pctErr(fit.rs, cfg.cell.rs), fit.status, fit.iterations,
+         fit.evaluations, fit.rmsError, newUs);
+  if(prov)
+    printf("  online (sweep)  : Rct=%.2f (%.2f %%) Rs=%.2f (%.2f %%) provisional\n", provRct,
+           pctErr(provRct, cfg.cell.rct), provRs, pctErr(provRs, cfg.cell.rs));
+  printf("  calculateResistors: Rct=%.2f Rs=%.2f, status %d, %d iterations (%s start)\n", lib.rct, lib.rs, lib.status,
+         lib.iterations, prov ? "warm" : "cold");
+
+  if(perCycle) {
+    /* Rct of the drifting cell at a given millis() */
+    auto cellRct = [&](unsigned long ms) { return cfg.cell.rct * (1.0 + cfg.cell.rctDrift * ms * 1e-3); };
+    uint32_t count = helpstat.getCycleFitCount();
+    bool ok = count == numCycles + 1 && deadLeftOut;
+    unsigned long prevMs = 0;
+    printf("  per cycle       : %u of %u cycles fitted, drift %g / s\n", count, numCycles + 1, cfg.cell.rctDrift);
+    for(uint32_t c = 0; c < count; c++) {
+      cycleFit cf = helpstat.getCycleFit(c);
+      double lo = fmin(cellRct(prevMs), cellRct(cf.timeMs)) * (1 - tol / 100);
+      double hi = fmax(cellRct(prevMs), cellRct(cf.timeMs)) * (1 + tol / 100);
+      bool inRange = cf.converged() && cf.rct >= lo && cf.rct <= hi && pctErr(cf.rs, cfg.cell.rs) <= tol;
+      printf("    cycle %2u at %8lu ms: Rct=%.2f (cell %.2f..%.2f) Rs=%.2f, %d iterations, %lu us%s\n", cf.cycle,
+             cf.timeMs, cf.rct, cellRct(prevMs), cellRct(cf.timeMs), cf.rs, cf.iterations, cf.fitUs,
+             inRange ? "" : "  <--");
+      ok = ok && inRange && cf.cycle == c && (c == 0 || cf.timeMs > prevMs);
+      prevMs = cf.timeMs;
+    }
+    if(check && !ok) {
+      printf("CHECK FAILED\n");
+      return 1;
+    }
+    return 0;
+  }
+
+  if(circuit >= 0) {
+    static cnlsWorkspace work;
+    cnlsFit cf = {};
+    auto c0 = std::chrono::steady_clock::now();
+    for(uint32_t k = 0; k < reps; k++)
+      cf = fit_CNLS(freq.data(), re.data(), im.data(), total, circuit, NULL, NULL, &work);
+    double cnlsUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - c0).count() / reps;
+    quiet(true);
+    cnlsFit libFit = helpstat.fitCircuit(circuit);
+    quiet(false);
+
+    printf("  CNLS fit        : Rs=%.2f (%.2f %%) Rct=%.2f (%.2f %%) Q=%.4g (%.2f %%) n=%.4f sigma=%.2f\n",
+           cf.p.rs, pctErr(cf.p.rs, cfg.cell.rs), cf.p.rct, pctErr(cf.p.rct, cfg.cell.rct), cf.p.q,
+           pctErr(cf.p.q, cfg.cell.cdl), cf.p.n, cf.p.sigma);
+    printf("                    status %d, %d iterations, %d evaluations, rms %.3f %%, %.1f us / fit\n",
+           cf.status, cf.iterations, cf.evaluations, cf.rmsRel * 100, cnlsUs);
+    printf("  fitCircuit      : Rs=%.2f Rct=%.2f, status %d, %d iterations\n", libFit.p.rs, libFit.p.rct,
+           libFit.status, libFit.iterations);
+
+    double tplUs = 0;
+    cnlsFit tf;
+    if(circuit == CNLS_MODEL_RC) tf = templateFit<ModelRC>(freq, re, im, circuit, reps, &tplUs);
+    else if(circuit == CNLS_MODEL_CPE) tf = templateFit<ModelCPE>(freq, re, im, circuit, reps, &tplUs);
+    else if(circuit == CNLS_MODEL_WARBURG) tf = templateFit<ModelWarburg>(freq, re, im, circuit, reps, &tplUs);
+    else tf = templateFit<ModelCPEWarburg>(freq, re, im, circuit, reps, &tplUs);
+    printf("  fit_circuit<>   : Rs=%.2f Rct=%.2f Q=%.4g n=%.4f sigma=%.2f\n", tf.p.rs, tf.p.rct, tf.p.q, tf.p.n,
+           tf.p.sigma);
+    printf("                    status %d, %d iterations, %d evaluations, rms %.3f %%, %.1f us / fit\n", tf.status,
+           tf.iterations, tf.evaluations, tf.rmsRel * 100, tplUs);
+    if(check) {
+      bool ok = cf.converged() && libFit.converged() && pctErr(cf.p.rs, cfg.cell.rs) <= tol &&
+                pctErr(cf.p.rct, cfg.cell.rct) <= tol && pctErr(cf.p.q, cfg.cell.cdl) <= tol &&
+                fabs(cf.p.n - cfg.cell.cpeN) <= 0.01 &&
+                (cfg.cell.sigmaW > 0 ? pctErr(cf.p.sigma, cfg.cell.sigmaW) <= tol : cf.p.sigma == 0) &&
+                libFit.p.rct == cf.p.rct && tf.converged() && pctErr(tf.p.rs, cf.p.rs) <= 0.1 &&
+                pctErr(tf.p.rct, cf.p.rct) <= 0.1 && pctErr(tf.p.q, cf.p.q) <= 0.1 &&
+                fabs(tf.p.n - cf.p.n) <= 0.001 && (cf.p.sigma > 0 ? pctErr(tf.p.sigma, cf.p.sigma) <= 0.1 : true) &&
+                deadLeftOut;
+      if(!ok) {
+        printf("CHECK FAILED\n");
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  if(check) {
+    bool ok = fit.converged() && lib.converged() &&
+              pctErr(fit.rct, cfg.cell.rct) <= tol && pctErr(fit.rs, cfg.cell.rs) <= tol &&
+              pctErr(lib.rct, cfg.cell.rct) <= tol && pctErr(lib.rs, cfg.cell.rs) <= tol &&
+              (cold ? !prov : prov && lib.iterations <= 2) && deadLeftOut;
+    if(!ok) {
+      printf("CHECK FAILED\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+/*
+    FILENAME: kk_bench.cpp
+
+    Runs a multi-cycle sweep with the Kramers-Kronig quality gate on
+    (setKKTest, kk.h) against the simulated Randles cell, optionally drifting
+    (--drift, fraction of Rct per second) or with a step change of Rct at a
+    given time (--step fraction, --step-at seconds of simulated time), or
+    with one frequency whose DFTs never finish (--dead-freq Hz). Reports each
+    cycle's verdict, attempts and residuals. --log writes the binary session
+    log, where a repeated cycle appears once per attempt (hsl2csv keeps the
+    last).
+
+    Usage: kk_bench [--check] [--expect-fail] [--cycles n] [--points per-decade] [--noise codes]
+                    [--drift fraction/s] [--step fraction] [--step-at s] [--repeats n]
+                    [--max-residual pct] [--dead-freq Hz] [--log] [--seed n] [--verbose]
+
+    --check exits non-zero unless every cycle was tested, its per-point
+    residuals agree with the verdict, and: every cycle passed with one attempt
+    (steady cell); or, with --step, the cycle that saw the step was measured a
+    second time and then passed, and calculateResistors (warm-started from
+    the online fit, which must have dropped the failed attempt) found the
+    stepped Rct within 2 percent; or, with --expect-fail, at least one cycle
+    still failed after all its repeats; or, with --dead-freq, every cycle
+    passed at the first attempt with the dead point left out of the test,
+    and kk_test fails the cycle's data once fewer than 3 usable points are
+    left.
+*/
+
+#include "bench_common.h"
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  uint32_t numPoints = 6, numCycles = 3, repeats = KK_MAX_REPEATS;
+  float maxResidualPct = KK_MAX_RESIDUAL * 100;
+  bool check = false, expectFail = false, verbose = false, sessionLog = false;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--expect-fail")) expectFail = true;
+    else if(!strcmp(a, "--verbose")) verbose = true;
+    else if(!strcmp(a, "--log")) sessionLog = true;
+    else if(!strcmp(a, "--cycles")) { numCycles = atoi(v); i++; }
+    else if(!strcmp(a, "--points")) { numPoints = atoi(v); i++; }
+    else if(!strcmp(a, "--noise")) { cfg.noiseCodes = atof(v); i++; }
+    else if(!strcmp(a, "--drift")) { cfg.cell.rctDrift = atof(v); i++; }
+    else if(!strcmp(a, "--step")) { cfg.cell.rctStep = atof(v); i++; }
+    else if(!strcmp(a, "--step-at")) { cfg.cell.rctStepS = atof(v); i++; }
+    else if(!strcmp(a, "--repeats")) { repeats = atoi(v); i++; }
+    else if(!strcmp(a, "--max-residual")) { maxResidualPct = atof(v); i++; }
+    else if(!strcmp(a, "--dead-freq")) { cfg.deadFreq = atof(v); i++; }
+    else if(!strcmp(a, "--seed")) { cfg.seed = atoi(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+
+  AD5940Sim::instance().configure(cfg);
+  quiet(true);
+  helpstat.setKKTest(true, maxResidualPct / 100, repeats);
+  helpstat.setSessionLog(sessionLog);
+  helpstat.AD5940Start();
+  helpstat.AD5940_TDD(100000, 1, numPoints, 0.0, 0.0, cfg.rcal,
+                      gainTable, sizeof(gainTable) / sizeof(gainTable[0]), 1, 1);
+  helpstat.runSweep(numCycles, 0);
+  quiet(false);
+
+  uint32_t points = helpstat.getSweepPoints();
+  printf("HELPStat host Kramers-Kronig gate benchmark\n");
+  printf("  cell            : Rs=%g Rct=%g Cdl=%g, drift %g / s, step %g at %g s, noise=%g codes\n", cfg.cell.rs,
+         cfg.cell.rct, cfg.cell.cdl, cfg.cell.rctDrift, cfg.cell.rctStep, cfg.cell.rctStepS, cfg.noiseCodes);
+  printf("  gate            : max residual %.2f %%, %u repeats, %u points per cycle\n", maxResidualPct, repeats, points);
+
+  bool consistent = true, deadLeftOut = true;
+  uint32_t failed = 0, repeated = 0, tested = 0;
+  for(uint32_t c = 0; c <= numCycles; c++) {
+    kkCycle kc = helpstat.getKKResult(c);
+    if(kc.attempts) tested++;
+    if(!kc.kk.pass) failed++;
+    if(kc.attempts > 1) repeated++;
+    printf("  cycle %2u        : %s after %u attempt%s, max residual %.3f %%, rms %.3f %%, mu %.2f, %d RC\n", c,
+           kc.kk.pass ? "pass" : "FAIL", kc.attempts, kc.attempts == 1 ? "" : "s", kc.kk.maxResidual * 100,
+           kc.kk.rmsResidual * 100, kc.kk.mu, kc.kk.rcCount);
+
+    /* The stored residuals must be the ones the verdict came from */
+    float worst = 0;
+    for(uint32_t k = 0; k < points; k++) {
+      float re = 0, im = 0;
+      if(!helpstat.getKKResidual(c * points + k, &re, &im)) consistent = false;
+      worst = fmaxf(worst, fmaxf(fabsf(re), fabsf(im)));
+      if(verbose)
+        printf("    %10.2f Hz : %+.3f %% %+.3f %%\n", helpstat.getResult(c * points + k).freq, re * 100, im * 100);
+    }
+    if(worst != kc.kk.maxResidual) consistent = false;
+    if(kc.kk.points != (int)points - (cfg.deadFreq > 0 ? 1 : 0) || kc.kk.rcCount == 0) deadLeftOut = false;
+  }
+
+  /* Failed points go into the test as zero impedance: with fewer than 3 usable ones left it must fail */
+  bool tooFewFails = true;
+  if(cfg.deadFreq > 0) {
+    std::vector<float> freq(points), re(points), im(points);
+    for(uint32_t k = 0; k < points; k++) {
+      impStruct eis = helpstat.getResult(k);
+      freq[k] = eis.freq;
+      re[k] = k < 2 ? eis.real : 0;
+      im[k] = k < 2 ? eis.imag : 0;
+    }
+    kkResult few = kk_test(freq.data(), re.data(), im.data(), points, maxResidualPct / 100, NULL, NULL);
+    re[2] = NAN;
+    kkResult nan = kk_test(freq.data(), re.data(), im.data(), points, maxResidualPct / 100, NULL, NULL);
+    tooFewFails = !few.pass && few.points == 2 && !nan.pass && nan.points == 2;
+    printf("  dead point      : %g Hz left out: %s; 2 usable points left: %s\n", cfg.deadFreq,
+           deadLeftOut ? "yes" : "NO", tooFewFails ? "FAIL" : "pass (WRONG)");
+  }
+
+  /* A repeated attempt must be gone from the online fit calculateResistors starts from */
+  float provRct = 0, provRs = 0;
+  bool prov = helpstat.getProvisionalFit(&provRct, &provRs);
+  quiet(true);
+  helpstat.calculateResistors();
+  quiet(false);
+  randlesFit fit = helpstat.getRandlesFit();
+  double stepRct = cfg.cell.rct * (1.0 + cfg.cell.rctStep);
+  printf("  calculateResistors: Rct=%.2f Rs=%.2f, %d iterations (%s start)\n", fit.rct, fit.rs, fit.iterations,
+         prov ? "warm" : "cold");
+
+  if(check) {
+    bool ok = consistent && tested == numCycles + 1;
+    if(expectFail) ok = ok && failed > 0;
+    else if(cfg.deadFreq > 0) ok = ok && failed == 0 && repeated == 0 && deadLeftOut && tooFewFails;
+    else if(cfg.cell.rctStep != 0)
+      ok = ok && failed == 0 && repeated == 1 && prov && fit.iterations <= 2 && fabs(fit.rct - stepRct) <= 0.02 * stepRct;
+    else ok = ok && failed == 0 && repeated == 0;
+    if(!ok) {
+      printf("CHECK FAILED\n");
+      return 1;
+    }
+  }
+  return 0;
+}
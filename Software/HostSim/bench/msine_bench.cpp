@@ -0,0 +1,157 @@
+/*
+    FILENAME: msine_bench.cpp
+
+    Multisine acquisition of the sub-hertz band against the simulated AD5940.
+    Sweeps the same band twice over a Randles cell with a large double layer
+    (--cdl), so its arc sits below 1 Hz: point by point with a DFT each, then
+    with setMultisine, which measures the points at or below --max-freq as
+    groups of tones of one waveform streamed through the FIFO. Reports the
+    time, acquisitions and the worst |Z| / phase error against the cell for
+    both runs.
+
+    --stall s keeps the SINC2 samples out of the FIFO for the first s seconds
+    of the multisine run, so the groups measured in that time time out and
+    fall back to AD5940_DFTMeasure at their planned frequencies.
+
+    Usage: msine_bench [--check] [--points per-decade] [--start Hz] [--end Hz] [--max-freq Hz]
+                       [--cdl F] [--rct ohm] [--rs ohm] [--noise codes] [--seed n] [--stall s] [--verbose]
+
+    --check exits non-zero unless every point of the multisine run at or
+    below --max-freq was measured as a multisine (and none above it), every
+    point is within 2 % / 2 deg of the cell, the run took at most half
+    the point-by-point time, and the multisine legs slept on the FIFO
+    threshold / end-of-sequence interrupt with no wait timing out. Every
+    point must be reported at its tone frequency if it is a multisine point
+    and at its planned frequency if not. With --stall a group must have
+    fallen back instead, its points (at least one of them off its tone
+    frequency) within the same error limits, and the time and wait limits
+    do not apply.
+*/
+
+#include "bench_common.h"
+
+typedef struct {
+  double seconds;         // Virtual time of the sweep
+  uint64_t dfts;          // DFTs the simulated AFE ran
+  uint64_t samples;       // SINC2 samples it streamed
+  double magErrPct;       // Worst |Z| error against the cell
+  double phaseErrDeg;     // Worst phase error
+  uint32_t flagged;       // Records marked DFTREC_MSINE
+  bool flagsMatch;        // Flagged exactly when at or below the multisine band edge
+  bool labelsMatch;       // Reported at the tone frequency when flagged, at the planned one if not
+  uint32_t fellBack;      // Multisine band points measured point by point, tone and plan apart
+}runResult;
+
+static runResult measure(float startFreq, float endFreq, uint32_t numPoints, float rcal, float maxFreq,
+                         bool verbose) {
+  runResult res = {0};
+  res.flagsMatch = true;
+  res.labelsMatch = true;
+  AD5940Sim &sim = AD5940Sim::instance();
+
+  quiet(true);
+  helpstat.AD5940_TDD(startFreq, endFreq, numPoints, 0.0, 0.0, rcal,
+                      gainTable, sizeof(gainTable) / sizeof(gainTable[0]), 1, 1);
+  sim.clearStats();
+  uint64_t start = HostSim::nowUs();
+  helpstat.runSweep(0, 0);
+  res.seconds = (HostSim::nowUs() - start) * 1e-6;
+  res.dfts = sim.stats().dftCount;
+  res.samples = sim.stats().adcSamples;
+  quiet(false);
+
+  for(uint32_t i = 0; i < helpstat.getSweepPoints(); i++) {
+    impStruct eis = helpstat.getResult(i);
+    bool msine = (helpstat.getRecord(i).flags & DFTREC_MSINE) != 0;
+    std::complex<double> z = sim.cellImpedance(eis.freq);
+    double magErr = fabs(eis.magnitude - std::abs(z)) / std::abs(z) * 100;
+    double phaseErr = fabs(eis.phaseDeg - std::arg(z) * 180 / M_PI);
+    res.magErrPct = fmax(res.magErrPct, magErr);
+    res.phaseErrDeg = fmax(res.phaseErrDeg, phaseErr);
+    planStruct plan = helpstat.getPlanEntry(i);
+    if(msine) res.flagged++;
+    if(msine != (plan.freq <= maxFreq)) res.flagsMatch = false;
+    if(eis.freq != (msine ? plan.msFreq : plan.freq)) res.labelsMatch = false;
+    if(!msine && plan.msGroup && plan.msFreq != plan.freq) res.fellBack++;
+    if(verbose)
+      printf("    %10.4f Hz : |Z| %9.2f (cell %9.2f, %+.3f %%), phase %+.2f deg (%+.2f)%s\n", eis.freq, eis.magnitude,
+             std::abs(z), magErr, eis.phaseDeg, std::arg(z) * 180 / M_PI, msine ? ", multisine" : "");
+  }
+  return res;
+}
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  uint32_t numPoints = 5;
+  float startFreq = 10, endFreq = 0.1f, maxFreq = MSINE_MAX_FREQ, stall = 0;
+  bool check = false, verbose = false;
+  cfg.cell.cdl = 100e-6f;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--verbose")) verbose = true;
+    else if(!strcmp(a, "--points")) { numPoints = atoi(v); i++; }
+    else if(!strcmp(a, "--start")) { startFreq = atof(v); i++; }
+    else if(!strcmp(a, "--end")) { endFreq = atof(v); i++; }
+    else if(!strcmp(a, "--max-freq")) { maxFreq = atof(v); i++; }
+    else if(!strcmp(a, "--cdl")) { cfg.cell.cdl = atof(v); i++; }
+    else if(!strcmp(a, "--rct")) { cfg.cell.rct = atof(v); i++; }
+    else if(!strcmp(a, "--rs")) { cfg.cell.rs = atof(v); i++; }
+    else if(!strcmp(a, "--noise")) { cfg.noiseCodes = atof(v); i++; }
+    else if(!strcmp(a, "--seed")) { cfg.seed = atoi(v); i++; }
+    else if(!strcmp(a, "--stall")) { stall = atof(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+
+  AD5940Sim::instance().configure(cfg);
+  printf("HELPStat host multisine benchmark\n");
+  printf("  cell            : Rs=%g Rct=%g Cdl=%g, noise=%g codes\n", cfg.cell.rs, cfg.cell.rct, cfg.cell.cdl,
+         cfg.noiseCodes);
+  printf("  sweep           : %g -> %g Hz, %u points per decade, multisine at or below %g Hz\n", startFreq, endFreq,
+         numPoints, maxFreq);
+
+  quiet(true);
+  helpstat.AD5940Start();
+  quiet(false);
+
+  if(verbose) printf("  point by point:\n");
+  helpstat.setMultisine(false);
+  runResult ref = measure(startFreq, endFreq, numPoints, cfg.rcal, maxFreq, verbose);
+  ref.flagsMatch = ref.flagged == 0;
+
+  if(verbose) printf("  multisine:\n");
+  helpstat.setMultisine(true, maxFreq);
+  helpstat.clearWaitStats();
+  if(stall > 0) AD5940Sim::instance().setSinc2Dead(HostSim::nowUs() * 1e-6 + stall);
+  runResult ms = measure(startFreq, endFreq, numPoints, cfg.rcal, maxFreq, verbose);
+  msineStats stats = helpstat.getMultisineStats();
+  waitStats waits = helpstat.getWaitStats();
+
+  printf("  point by point  : %.1f s, %llu DFTs, |Z| error %.3f %%, phase error %.3f deg\n", ref.seconds,
+         (unsigned long long)ref.dfts, ref.magErrPct, ref.phaseErrDeg);
+  printf("  multisine       : %.1f s, %llu DFTs + %llu samples, |Z| error %.3f %%, phase error %.3f deg\n",
+         ms.seconds, (unsigned long long)ms.dfts, (unsigned long long)ms.samples, ms.magErrPct, ms.phaseErrDeg);
+  printf("  acquisitions    : %u covering %u points (%u flagged), %u remeasured, %u measured point by point\n",
+         stats.acquisitions, stats.points, ms.flagged, stats.remeasures, stats.failures);
+  printf("  FIFO interrupts : %u waits for %llu samples, %u wait timeouts in the run\n", stats.fifoWaits,
+         (unsigned long long)stats.samples, waits.timeouts);
+  printf("  frequencies     : %s, %u fallback points off their tone frequency\n",
+         ms.labelsMatch && ref.labelsMatch ? "as measured" : "MISLABELLED", ms.fellBack);
+
+  if(check) {
+    bool ok = ms.labelsMatch && ref.labelsMatch && ms.magErrPct <= 2.0 && ms.phaseErrDeg <= 2.0;
+    if(stall > 0) ok = ok && stats.failures > 0 && ms.fellBack > 0;
+    else ok = ok && ms.flagsMatch && ms.flagged > 0 && stats.failures == 0 && ms.seconds <= 0.5 * ref.seconds &&
+              stats.fifoWaits > 0 && waits.timeouts == 0;
+    if(!ok) {
+      printf("CHECK FAILED\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+    FILENAME: queue_bench.cpp
+
+    Exercises the single-producer / single-consumer point queue (pointqueue.h)
+    that feeds the SD storage task, with the producer and consumer on two real
+    host threads. The producer stands in for the sweep and the consumer for the
+    storage task, which now and then stalls like a slow FAT cluster allocation.
+
+    Usage: queue_bench [--check] [--points n] [--depth n] [--stall-every n] [--stall-us n]
+
+    Every point carries its sequence number, so --check exits non-zero if the
+    consumer sees one lost, duplicated or out of order.
+*/
+
+#include "pointqueue.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+int main(int argc, char **argv) {
+  uint32_t numPoints = 1000000, depth = 64, stallEvery = 5000, stallUs = 2000;
+  bool check = false;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--points")) { numPoints = atoi(v); i++; }
+    else if(!strcmp(a, "--depth")) { depth = atoi(v); i++; }
+    else if(!strcmp(a, "--stall-every")) { stallEvery = atoi(v); i++; }
+    else if(!strcmp(a, "--stall-us")) { stallUs = atoi(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+  if(depth < 2 || (depth & (depth - 1))) {
+    fprintf(stderr, "--depth must be a power of two\n");
+    return 2;
+  }
+
+  std::vector<logPoint> mem(depth);
+  pointQueue queue;
+  pointQueueInit(&queue, mem.data(), depth);
+
+  uint32_t producerStalls = 0, received = 0, bad = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  std::thread consumer([&]() {
+    logPoint p;
+    while(received < numPoints) {
+      if(!pointQueuePop(&queue, &p)) {
+        std::this_thread::yield();
+        continue;
+      }
+      uint32_t seq = p.timeMs;
+      if(seq != received || p.rec.freqIdx != (uint16_t)seq || p.cycle != (uint16_t)(seq >> 16)) bad++;
+      received++;
+      if(stallEvery && received % stallEvery == 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(stallUs));
+    }
+  });
+
+  logPoint p;
+  memset(&p, 0, sizeof(p));
+  for(uint32_t k = 0; k < numPoints; k++) {
+    p.timeMs = k;
+    p.rec.freqIdx = (uint16_t)k;
+    p.cycle = (uint16_t)(k >> 16);
+    if(!pointQueuePush(&queue, &p)) {
+      producerStalls++;
+      while(!pointQueuePush(&queue, &p)) std::this_thread::yield();
+    }
+  }
+  consumer.join();
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  printf("HELPStat point queue benchmark\n");
+  printf("  points          : %u pushed, %u received, %u bad / out of order\n", numPoints, received, bad);
+  printf("  queue           : %u slots, max depth %u, %u producer stalls\n", depth, queue.maxDepth, producerStalls);
+  printf("  wall time       : %.3f ms (%.1f ns / point)\n", ms, numPoints ? ms * 1e6 / numPoints : 0.0);
+
+  if(check && (received != numPoints || bad != 0)) {
+    printf("CHECK FAILED\n");
+    return 1;
+  }
+  return 0;
+}
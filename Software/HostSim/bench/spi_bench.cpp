@@ -0,0 +1,96 @@
+/*
+    FILENAME: spi_bench.cpp
+
+    Runs HELPStat::spiBenchmark against the simulated AD5940 and reports the
+    virtual cost of register reads / writes and data FIFO drains for whichever
+    SPI path this binary was built with (spi_bench: burst, spi_bench_bytewise:
+    AD5940_SPI_BYTEWISE).
+
+    Usage: spi_bench [--quiet] [--check] [--ops n] [--words n]
+
+    --check also pushes a known pattern into the FIFO and reads it back with
+    AD5940_FIFORd at sizes that cover every framing case (1, 2, 3 words, one
+    burst, burst boundaries) and exits non-zero on any mismatch.
+*/
+
+#include "bench_common.h"
+
+/* Pushes count words into the simulated FIFO and reads them back through the driver */
+static bool fifoRoundTrip(AD5940Sim &sim, uint32_t count) {
+  static uint32_t buff[SPI_BENCH_FIFO_WORDS];
+  for(uint32_t i = 0; i < count; i++) sim.fillFifo(0xA5000000u | (count << 12) | i);
+  AD5940_FIFORd(buff, count);
+  for(uint32_t i = 0; i < count; i++) {
+    if(buff[i] != (0xA5000000u | (count << 12) | i)) {
+      printf("FIFO round trip of %u words: word %u is 0x%08X\n", count, i, (unsigned)buff[i]);
+      return false;
+    }
+  }
+  return AD5940_FIFOGetCnt() == 0;
+}
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  uint32_t numOps = 1000, fifoWords = SPI_BENCH_FIFO_WORDS;
+  bool beQuiet = false, check = false;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--quiet")) beQuiet = true;
+    else if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--ops")) { numOps = atoi(v); i++; }
+    else if(!strcmp(a, "--words")) { fifoWords = atoi(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+  if(fifoWords > SPI_BENCH_FIFO_WORDS) fifoWords = SPI_BENCH_FIFO_WORDS;
+
+  AD5940Sim &sim = AD5940Sim::instance();
+  sim.configure(cfg);
+
+  if(beQuiet) quiet(true);
+  helpstat.AD5940Start();
+  if(beQuiet) quiet(false);
+
+  FIFOCfg_Type fifo_cfg;
+  fifo_cfg.FIFOEn = bTRUE;
+  fifo_cfg.FIFOMode = FIFOMODE_FIFO;
+  fifo_cfg.FIFOSize = FIFOSIZE_4KB;
+  fifo_cfg.FIFOSrc = FIFOSRC_DFT;
+  fifo_cfg.FIFOThresh = 0;
+  AD5940_FIFOCfg(&fifo_cfg);
+
+  for(uint32_t i = 0; i < fifoWords; i++) sim.fillFifo(i);
+  sim.clearStats();
+
+  if(beQuiet) quiet(true);
+  spiBenchStruct b = helpstat.spiBenchmark(numOps, fifoWords);
+  if(beQuiet) quiet(false);
+  const SimStats &st = sim.stats();
+
+#ifdef AD5940_SPI_BYTEWISE
+  printf("HELPStat host SPI benchmark (byte-wise)\n");
+#else
+  printf("HELPStat host SPI benchmark (burst)\n");
+#endif
+  printf("  register read   : %.3f us\n", b.regReadUs);
+  printf("  register write  : %.3f us\n", b.regWriteUs);
+  printf("  FIFO drain      : %.3f us / word, %.2f MB/s (%u words)\n", b.fifoWordUs, b.fifoMBs, fifoWords);
+  printf("  SPI transfers   : %llu for %llu bytes\n", (unsigned long long)st.spiTransfers,
+         (unsigned long long)st.spiBytes);
+
+  if(check) {
+    static const uint32_t sizes[] = {1, 2, 3, 4, 63, 64, 65, 66, 127, 128, 130, 200, 256};
+    for(uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      if(!fifoRoundTrip(sim, sizes[i])) {
+        printf("CHECK FAILED\n");
+        return 1;
+      }
+    }
+    printf("  FIFO round trip : ok\n");
+  }
+  return 0;
+}
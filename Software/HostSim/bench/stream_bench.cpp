@@ -0,0 +1,138 @@
+/*
+    FILENAME: stream_bench.cpp
+
+    Drives the streaming FIFO reader in Impedance.c (AppIMPStreamISR / AppIMPStreamGet)
+    against the simulated data FIFO. Rcal/Rz DFT groups are pushed into the FIFO as the
+    sequencer would, the AFE interrupt runs the ISR side, and the consumer only drains the
+    published buffers every n-th group so it can fall behind.
+
+    Usage: stream_bench [--check] [--groups n] [--thresh words] [--buffers n]
+                        [--buff-words n] [--consumer-every n] [--small-fifo]
+
+    Each group encodes its index in Rz, so the consumer can tell if a result was lost,
+    duplicated or reordered. --check exits non-zero if that happens while the AFE FIFO
+    did not overflow, or if an overflow happened without being reported.
+*/
+
+#include "bench_common.h"
+
+#define RCAL_DFT  4000   // Rcal DFT real part, imag 0
+#define RCAL_OHM  1000.0f
+
+/* Rz DFT of group k: |Z| = RCAL_OHM * RCAL_DFT / (k + 1) */
+static void pushGroup(AD5940Sim &sim, uint32_t k) {
+  sim.fillFifo(RCAL_DFT);
+  sim.fillFifo(0);
+  sim.fillFifo(k + 1);
+  sim.fillFifo(0);
+}
+
+static uint32_t streamMem[IMPSTREAM_MAX_BUFF * 512];
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  uint32_t numGroups = 2000, thresh = 4, numBuff = 2, buffWords = 64, consumerEvery = 1;
+  bool check = false, smallFifo = false;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--small-fifo")) smallFifo = true;
+    else if(!strcmp(a, "--groups")) { numGroups = atoi(v); i++; }
+    else if(!strcmp(a, "--thresh")) { thresh = atoi(v); i++; }
+    else if(!strcmp(a, "--buffers")) { numBuff = atoi(v); i++; }
+    else if(!strcmp(a, "--buff-words")) { buffWords = atoi(v); i++; }
+    else if(!strcmp(a, "--consumer-every")) { consumerEvery = atoi(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+  if(buffWords > 512) buffWords = 512;
+  if(consumerEvery == 0) consumerEvery = 1;
+
+  AD5940Sim &sim = AD5940Sim::instance();
+  sim.configure(cfg);
+
+  quiet(true);
+  helpstat.AD5940Start();
+  quiet(false);
+
+  AppIMPCfg_Type *pCfg;
+  AppIMPGetCfg(&pCfg);
+  pCfg->SweepCfg.SweepEn = bFALSE;
+  pCfg->SinFreq = 1000.0;
+  pCfg->RcalVal = RCAL_OHM;
+  pCfg->NumOfData = -1;
+
+  FIFOCfg_Type fifo_cfg;
+  fifo_cfg.FIFOEn = bTRUE;
+  fifo_cfg.FIFOMode = FIFOMODE_FIFO;
+  fifo_cfg.FIFOSize = smallFifo ? FIFOSIZE_32B : FIFOSIZE_4KB;
+  fifo_cfg.FIFOSrc = FIFOSRC_DFT;
+  fifo_cfg.FIFOThresh = thresh;
+  AD5940_FIFOCfg(&fifo_cfg);
+  AD5940_INTCCfg(AFEINTC_0, AFEINTSRC_DATAFIFOTHRESH | AFEINTSRC_DATAFIFOOF, bTRUE);
+  AD5940_INTCClrFlag(AFEINTSRC_ALLINT);
+  AD5940_ClrMCUIntFlag();
+
+  IMPStream_Type stream;
+  if(AppIMPStreamInit(&stream, streamMem, buffWords, numBuff) != AD5940ERR_OK) {
+    fprintf(stderr, "Bad stream configuration\n");
+    return 2;
+  }
+
+  uint32_t expected = 0, received = 0, bad = 0, busyErrors = 0;
+  auto consume = [&]() {
+    fImpPol_Type *pRes;
+    float freq;
+    uint32_t n;
+    while((n = AppIMPStreamGet(&stream, &pRes, &freq)) != 0) {
+      for(uint32_t i = 0; i < n; i++) {
+        float want = RCAL_OHM * RCAL_DFT / (expected + 1);
+        if(fabs(pRes[i].Magnitude - want) > want * 1e-4 || freq != 1000.0f) bad++;
+        expected++;
+      }
+      received += n;
+      AppIMPStreamRelease(&stream);
+    }
+  };
+
+  for(uint32_t k = 0; k < numGroups; k++) {
+    pushGroup(sim, k);
+    if(AD5940_GetMCUIntFlag()) {
+      AD5940_ClrMCUIntFlag();
+      if(AppIMPStreamISR(&stream) == AD5940ERR_BUFF) busyErrors++;
+    }
+    if((k + 1) % consumerEvery == 0) consume();
+  }
+  /* Sequencer done: flush what is left like a final threshold / end-of-sequence interrupt */
+  for(uint32_t i = 0; i < 64 && received < numGroups; i++) {
+    consume();
+    AppIMPStreamISR(&stream);
+    AppIMPStreamFlush(&stream);
+  }
+  consume();
+
+  printf("HELPStat FIFO stream benchmark\n");
+  printf("  groups          : %u pushed, %u received, %u bad / out of order\n", numGroups, received, bad);
+  printf("  stream          : %u x %u words, threshold %u, consumer every %u group(s)\n",
+         numBuff, stream.BuffWords, thresh, consumerEvery);
+  printf("  words read      : %u, max %u buffers pending\n", stream.WordsRead, stream.MaxPending);
+  printf("  overruns        : %u (FIFO overflows %u), %u calls returned AD5940ERR_BUFF\n",
+         stream.Overruns, stream.FifoOverflows, busyErrors);
+
+  if(check) {
+    bool lost = received != numGroups || bad != 0;
+    if(lost && stream.FifoOverflows == 0) {
+      printf("CHECK FAILED\n");
+      return 1;
+    }
+    if(smallFifo && consumerEvery > 1 && stream.FifoOverflows == 0) {
+      printf("CHECK FAILED (expected an overflow to be reported)\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,271 @@
+/*
+    FILENAME: sweep_bench.cpp
+
+    Runs AD5940_TDD + runSweep (or runSweepSeq with --seq) against the simulated AD5940 and reports how
+    long the sweep takes on the host (wall), how long it would take on the
+    board (virtual), and how much SPI traffic it generates.
+
+    Usage: sweep_bench [--quiet] [--check] [--csv] [--seq] [--fixed-settle] [--no-rcal-cache] [--plan] [--no-shadow] [--start Hz] [--end Hz]
+                       [--points per-decade] [--cycles n] [--rs ohm] [--rct ohm]
+                       [--cdl F] [--rcal ohm] [--noise codes] [--seed n]
+                       [--ext-gain 0|1] [--dac-gain 0|1] [--psram bytes] [--expect-no-room]
+                       [--assumed-rcal ohm] [--correct-rcal] [--log]
+                       [--rtia code] [--autorange] [--comparator] [--dead-freq Hz] [--inline]
+
+    --check exits non-zero if any point is further than 2 % / 2 deg from the
+    simulated cell, so the benchmark doubles as an end-to-end regression test.
+    With --expect-no-room it instead checks that a run too big for the result
+    store (see --psram) is refused without storing anything.
+    --assumed-rcal tells HELPStat a wrong Rcal value; --correct-rcal re-decodes
+    the stored DFT records with the simulated one after the run.
+    --log writes the binary session log during the run and the saveDataEIS CSV
+    after it (both under ./sdcard/folder-name-here) and compares their sizes.
+    --rtia measures every frequency with one HSTIARTIA_xxx code instead of the
+    demo gain table (deliberately wrong for most of the band); --autorange
+    turns on setAutorange (with the ADC comparator if --comparator) and --check
+    then also requires every kept point to be within the headroom limits,
+    or at the end of the RTIA / excitation range, with no comparator trip.
+    --dead-freq makes every DFT at that frequency hang (no DFTRDY); --check
+    then requires those points, and only those, to be stored DFTREC_FAILED
+    and the rest of the run to be unaffected. --inline runs the storage task's
+    work on the sweep thread (the fallback when the task cannot be created).
+*/
+
+#include "bench_common.h"
+
+#include <chrono>
+#include <sys/stat.h>
+
+int main(int argc, char **argv) {
+  SimConfig cfg;
+  float startFreq = 100000, endFreq = 1;
+  uint32_t numPoints = 6, numCycles = 0;
+  int extGain = 1, dacGain = 1;
+  bool beQuiet = false, check = false, csv = false, useSeq = false, fixedSettle = false, rcalCache = true, dumpPlan = false, shadow = true;
+  bool expectNoRoom = false, correctRcal = false, sessionLog = false, autorange = false, comparator = false;
+  int fixedRtia = -1;
+  float assumedRcal = 0;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "--quiet")) beQuiet = true;
+    else if(!strcmp(a, "--check")) check = true;
+    else if(!strcmp(a, "--csv")) csv = true;
+    else if(!strcmp(a, "--seq")) useSeq = true;
+    else if(!strcmp(a, "--fixed-settle")) fixedSettle = true;
+    else if(!strcmp(a, "--no-rcal-cache")) rcalCache = false;
+    else if(!strcmp(a, "--plan")) dumpPlan = true;
+    else if(!strcmp(a, "--no-shadow")) shadow = false;
+    else if(!strcmp(a, "--expect-no-room")) expectNoRoom = true;
+    else if(!strcmp(a, "--correct-rcal")) correctRcal = true;
+    else if(!strcmp(a, "--log")) sessionLog = true;
+    else if(!strcmp(a, "--autorange")) autorange = true;
+    else if(!strcmp(a, "--comparator")) comparator = true;
+    else if(!strcmp(a, "--inline")) HostSim::setTasksEnabled(false);
+    else if(!strcmp(a, "--rtia")) { fixedRtia = atoi(v); i++; }
+    else if(!strcmp(a, "--dead-freq")) { cfg.deadFreq = atof(v); i++; }
+    else if(!strcmp(a, "--assumed-rcal")) { assumedRcal = atof(v); i++; }
+    else if(!strcmp(a, "--psram")) { HostSim::setPsramSize(atol(v)); i++; }
+    else if(!strcmp(a, "--start")) { startFreq = atof(v); i++; }
+    else if(!strcmp(a, "--end")) { endFreq = atof(v); i++; }
+    else if(!strcmp(a, "--points")) { numPoints = atoi(v); i++; }
+    else if(!strcmp(a, "--cycles")) { numCycles = atoi(v); i++; }
+    else if(!strcmp(a, "--rs")) { cfg.cell.rs = atof(v); i++; }
+    else if(!strcmp(a, "--rct")) { cfg.cell.rct = atof(v); i++; }
+    else if(!strcmp(a, "--cdl")) { cfg.cell.cdl = atof(v); i++; }
+    else if(!strcmp(a, "--rcal")) { cfg.rcal = atof(v); i++; }
+    else if(!strcmp(a, "--noise")) { cfg.noiseCodes = atof(v); i++; }
+    else if(!strcmp(a, "--seed")) { cfg.seed = atoi(v); i++; }
+    else if(!strcmp(a, "--ext-gain")) { extGain = atoi(v); i++; }
+    else if(!strcmp(a, "--dac-gain")) { dacGain = atoi(v); i++; }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+
+  AD5940Sim &sim = AD5940Sim::instance();
+  sim.configure(cfg);
+
+  if(beQuiet) quiet(true);
+  helpstat.AD5940Start();
+  if(beQuiet) quiet(false);
+
+  AD5940_ShadowCtrl(shadow ? bTRUE : bFALSE);
+  helpstat.setAdaptiveSettling(!fixedSettle);
+  helpstat.setRcalCache(rcalCache, RCAL_REFRESH_CYCLES, RCAL_DRIFT_PCT);
+  helpstat.setSessionLog(sessionLog);
+  helpstat.setAutorange(autorange, comparator);
+  calHSTIA fixedTable[] = {{(float)(startFreq > endFreq ? startFreq : endFreq), fixedRtia}};
+  calHSTIA *pGains = fixedRtia >= 0 ? fixedTable : gainTable;
+  int gainCount = fixedRtia >= 0 ? 1 : sizeof(gainTable) / sizeof(gainTable[0]);
+  sim.clearStats();
+  helpstat.clearWaitStats();
+  uint64_t virtStart = HostSim::nowUs();
+  auto wallStart = std::chrono::steady_clock::now();
+
+  if(beQuiet) quiet(true);
+  helpstat.AD5940_TDD(startFreq, endFreq, numPoints, 0.0, 0.0, assumedRcal > 0 ? assumedRcal : cfg.rcal,
+                      pGains, gainCount, extGain, dacGain);
+  if(beQuiet) quiet(false);
+  if(dumpPlan) helpstat.printSweepPlan();
+  if(beQuiet) quiet(true);
+  if(useSeq) helpstat.runSweepSeq(numCycles, 0);
+  else helpstat.runSweep(numCycles, 0);
+  if(beQuiet) quiet(false);
+
+  auto wallEnd = std::chrono::steady_clock::now();
+  double wallMs = std::chrono::duration<double, std::milli>(wallEnd - wallStart).count();
+  double virtS = (HostSim::nowUs() - virtStart) * 1e-6;
+
+  if(correctRcal) helpstat.setResultRcal(cfg.rcal);
+  if(sessionLog) {
+    if(beQuiet) quiet(true);
+    helpstat.saveDataEIS();
+    if(beQuiet) quiet(false);
+  }
+
+  uint32_t points = helpstat.getSweepPoints();
+  uint32_t total = points * (numCycles + 1);
+  const SimStats &st = sim.stats();
+
+  double maxMagErr = 0, maxPhaseErr = 0, settleMs = 0;
+  uint32_t settleCount[3] = {0}, settleChecks = 0;
+  uint32_t rangeCount[5] = {0}, remeasures = 0, outOfRange = 0;
+  float minHeadroom = 1e9f, maxHeadroom = 0;
+  uint32_t failed = 0, wrongFailed = 0;
+  if(csv) printf("cycle,index,freq,real,imag,magnitude,phaseDeg,trueMagnitude,truePhaseDeg,settleMs,settleStatus\n");
+  for(uint32_t i = 0; i < total; i++) {
+    impStruct r = helpstat.getResult(i);
+    settleStruct se = helpstat.getSettle(i);
+    settleMs += se.settleMs;
+    settleChecks += se.checks;
+    if(se.status < 3) settleCount[se.status]++;
+    rangeStruct rg = helpstat.getRange(i);
+    if(rg.status < 5) rangeCount[rg.status]++;
+    remeasures += rg.remeasures;
+    minHeadroom = fminf(minHeadroom, rg.headroom);
+    maxHeadroom = fmaxf(maxHeadroom, rg.headroom);
+    /* Out of range is only acceptable at the end of the range (the smallest gain, or the largest RTIA),
+       or low when the Rcal leg already takes the headroom the next RTIA step would need */
+    if(rg.clipped || (rg.status == RANGE_HIGH && !(rg.rTIA == HSTIARTIA_200 && rg.extGain && rg.dacGain)) ||
+       (rg.status == RANGE_LOW && rg.rTIA != HSTIARTIA_160K && rg.headroom < AUTORANGE_HIGH / 4) ||
+       (autorange && rg.status == RANGE_FIXED))
+      outOfRange++;
+    /* Only the dead frequency may fail, always as DFTREC_FAILED and never decoded */
+    dftRecord rec = helpstat.getRecord(i);
+    float f = helpstat.sweepFreq(i % points);
+    bool dead = cfg.deadFreq > 0 && fabsf(f - cfg.deadFreq) <= 0.005f * cfg.deadFreq;
+    if(!(rec.flags & DFTREC_VALID)) {
+      failed++;
+      if(!dead || !(rec.flags & DFTREC_FAILED) || r.freq != 0 || helpstat.getMagnitude(i) != 0) wrongFailed++;
+      if(csv) printf("%u,%u,%.3f,failed\n", i / points, i % points, f);
+      continue;
+    }
+    if(dead) wrongFailed++;
+    std::complex<double> z = sim.cellImpedance(r.freq);
+    /* HELPStat reports phase as arg(Z) and imag as -Im(Z) */
+    double trueMag = std::abs(z);
+    double truePhaseDeg = std::arg(z) * 180.0 / M_PI;
+    double magErr = fabs(r.magnitude - trueMag) / trueMag * 100.0;
+    double phaseErr = fabs(r.phaseDeg - truePhaseDeg);
+    if(magErr > maxMagErr) maxMagErr = magErr;
+    if(phaseErr > maxPhaseErr) maxPhaseErr = phaseErr;
+    if(csv)
+      printf("%u,%u,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.1f,%u\n", i / points, i % points, r.freq,
+             r.real, r.imag, r.magnitude, r.phaseDeg, trueMag, truePhaseDeg, se.settleMs, se.status);
+  }
+
+  printf("HELPStat host sweep benchmark (%s)\n", useSeq ? "runSweepSeq" : "runSweep");
+  printf("  cell            : Rs=%g Rct=%g Cdl=%g, Rcal=%g, noise=%g codes\n",
+         cfg.cell.rs, cfg.cell.rct, cfg.cell.cdl, cfg.rcal, cfg.noiseCodes);
+  printf("  sweep           : %g -> %g Hz, %u pts/decade, %u points x %u cycle(s)\n",
+         startFreq, endFreq, numPoints, points, numCycles + 1);
+  printf("  wall time       : %.3f ms\n", wallMs);
+  printf("  virtual time    : %.3f s\n", virtS);
+  printf("  time / point    : %.3f s virtual, %.4f ms wall\n",
+         total ? virtS / total : 0.0, total ? wallMs / total : 0.0);
+  printf("  SPI bytes       : %llu (%.1f / point)\n",
+         (unsigned long long)st.spiBytes, total ? (double)st.spiBytes / total : 0.0);
+  printf("  SPI transfers   : %llu\n", (unsigned long long)st.spiTransfers);
+  printf("  CS frames       : %llu\n", (unsigned long long)st.csFrames);
+  printf("  register R / W  : %llu / %llu\n", (unsigned long long)st.regReads, (unsigned long long)st.regWrites);
+  printf("  DFTs            : %llu (%llu aborted, %llu clipped, %llu dead)\n", (unsigned long long)st.dftCount,
+         (unsigned long long)st.dftAborted, (unsigned long long)st.adcClipped, (unsigned long long)st.dftDead);
+  printf("  failed points   : %u\n", failed);
+  printf("  interrupts      : %llu\n", (unsigned long long)st.irqCount);
+  printf("  sequencer       : %llu runs, %llu commands\n", (unsigned long long)st.seqRuns,
+         (unsigned long long)st.seqCommands);
+  waitStats ws = helpstat.getWaitStats();
+  printf("  interrupt waits : %u (%u timed out), %.3f s blocked, max %.3f ms, max wake latency %u us\n",
+         ws.count, ws.timeouts, ws.totalWaitUs * 1e-6, ws.maxWaitUs * 1e-3, ws.maxLatencyUs);
+  if(!useSeq)
+    printf("  settling        : %.3f s, %u short DFTs, %u converged / %u min-wait only / %u capped\n",
+           settleMs * 1e-3, settleChecks, settleCount[SETTLE_CONVERGED], settleCount[SETTLE_UNCHECKED],
+           settleCount[SETTLE_CAPPED]);
+  if(!useSeq)
+    printf("  range           : %u in range / %u high / %u low / %u fixed, %u re-measures, headroom %.1f-%.1f %%, %llu comparator trips\n",
+           rangeCount[RANGE_OK], rangeCount[RANGE_HIGH], rangeCount[RANGE_LOW], rangeCount[RANGE_FIXED], remeasures,
+           minHeadroom * 100, maxHeadroom * 100, (unsigned long long)st.adcCompTrips);
+  if(!useSeq) {
+    rcalCacheStats rc = helpstat.getRcalCacheStats();
+    printf("  Rcal cache      : %u hits, %u misses (%u refreshed, %u drift resets)\n",
+           rc.hits, rc.misses, rc.refreshes, rc.drifts);
+  }
+  RegShadowStat_Type sh;
+  AD5940_ShadowGetStat(&sh);
+  printf("  register shadow : %u reads / %u writes avoided, %u invalidations\n",
+         sh.ReadsAvoided, sh.WritesAvoided, sh.Invalidations);
+  printf("  result store    : %u points x %u bytes\n", helpstat.getResultCapacity(),
+         (unsigned)(sizeof(dftRecord) + sizeof(settleStruct)));
+  if(sessionLog) {
+    struct stat logSt, csvSt;
+    bool haveLog = stat(HostSim::sdPath("/folder-name-here/file-name-here.hsl").c_str(), &logSt) == 0;
+    bool haveCsv = stat(HostSim::sdPath("/folder-name-here/file-name-here.csv").c_str(), &csvSt) == 0;
+    printf("  session log     : %lld bytes (%.1f / point), saveDataEIS CSV %lld bytes\n",
+           haveLog ? (long long)logSt.st_size : -1LL, haveLog && total ? (double)logSt.st_size / total : 0.0,
+           haveCsv ? (long long)csvSt.st_size : -1LL);
+    storageStats ss = helpstat.getStorageStats();
+    printf("  storage         : %s, %u points, queue max %u / %u, %u stalls, worst SD access %lu us, %llu bus hand-overs, %llu conflicts\n",
+           ss.background ? "task" : "inline", ss.queued, ss.maxDepth, LOG_QUEUE_DEPTH - 1, ss.stalls, ss.maxWriteUs,
+           (unsigned long long)st.busLocks, (unsigned long long)st.busConflicts);
+    if(check && st.busConflicts) {
+      printf("CHECK FAILED (AD5940 frame while the SD card held the bus)\n");
+      return 1;
+    }
+    if(check && !haveLog) {
+      printf("CHECK FAILED (no session log)\n");
+      return 1;
+    }
+  }
+  printf("  max |Z| error   : %.3f %%\n", maxMagErr);
+  printf("  max phase error : %.3f deg\n", maxPhaseErr);
+
+  if(check && expectNoRoom) {
+    bool stored = false;
+    for(uint32_t i = 0; i < helpstat.getResultCapacity(); i++)
+      if(helpstat.getResult(i).freq != 0) stored = true;
+    if(helpstat.getResultCapacity() >= total || stored) {
+      printf("CHECK FAILED (run should have been refused)\n");
+      return 1;
+    }
+    return 0;
+  }
+
+  if(check && (wrongFailed || (cfg.deadFreq > 0) != (failed > 0))) {
+    printf("CHECK FAILED (%u failed points, %u not at the dead frequency)\n", failed, wrongFailed);
+    return 1;
+  }
+
+  if(check && autorange && outOfRange) {
+    printf("CHECK FAILED (%u points kept out of range)\n", outOfRange);
+    return 1;
+  }
+
+  if(check && (total == 0 || maxMagErr > 2.0 || maxPhaseErr > 2.0)) {
+    printf("CHECK FAILED\n");
+    return 1;
+  }
+  return 0;
+}
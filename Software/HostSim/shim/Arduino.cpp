@@ -0,0 +1,283 @@
+/*
+    FILENAME: Arduino.cpp (host shim)
+
+    Virtual clock, pins, Serial and FreeRTOS tasks for the host build. Nothing
+    here sleeps; every delay simply moves the simulated clock forward and lets
+    the AD5940 model (registered through HostSim::setTickHook) catch up. Tasks
+    run on their own threads but never move the clock (see Arduino.h).
+*/
+
+#include "Arduino.h"
+#include "SPI.h"
+#include <stdarg.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+namespace {
+  std::atomic<uint64_t> s_nowUs{0};
+  HostSim::TickHook s_tickHook = nullptr;
+  bool s_serialEnabled = true;
+  size_t s_psramSize = 8 * 1024 * 1024;   // 8 MB OPI PSRAM on the HELPStat ESP32-S3
+  bool s_tasksEnabled = true;
+
+  /* Notification state of one task, or of any other thread that takes notifications. Never
+     freed: FreeRTOS tasks here are never deleted either */
+  struct HostTask {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notified = 0;
+    bool task = false;     // Created by xTaskCreatePinnedToCore, does not drive the clock
+    bool parked = false;   // Blocked in ulTaskNotifyTake
+    uint64_t deadlineUs = 0;  // Virtual time a timed ulTaskNotifyTake gives up, 0 = none
+  };
+  thread_local HostTask *t_self = nullptr;
+  std::mutex s_tasksMutex;  // Taken before any HostTask::mutex
+  std::vector<HostTask *> s_tasks;
+  std::atomic<uint64_t> s_nextDeadlineUs{UINT64_MAX};
+  std::atomic<bool> s_exiting{false};
+
+  HostTask *selfTask(void) {
+    if(!t_self) t_self = new HostTask();
+    return t_self;
+  }
+
+  bool onTask(void) { return t_self && t_self->task; }
+
+  /* Wakes the tasks whose timed wait ran out as the clock passed its deadline */
+  void wakeExpired(uint64_t nowUs) {
+    std::lock_guard<std::mutex> tasksLock(s_tasksMutex);
+    uint64_t next = UINT64_MAX;
+    for(HostTask *t : s_tasks) {
+      std::lock_guard<std::mutex> lock(t->mutex);
+      if(t->deadlineUs == 0) continue;
+      if(t->deadlineUs <= nowUs) t->cv.notify_all();
+      else if(t->deadlineUs < next) next = t->deadlineUs;
+    }
+    s_nextDeadlineUs = next;
+  }
+
+  /* Copy of s_tasks, so the tasks can be waited on without holding s_tasksMutex */
+  std::vector<HostTask *> taskList(void) {
+    std::lock_guard<std::mutex> tasksLock(s_tasksMutex);
+    return std::vector<HostTask *>(s_tasks);
+  }
+
+  /* Waits until every task is back in ulTaskNotifyTake with nothing to do at the current time */
+  void syncTasks(void) {
+    uint64_t now = s_nowUs;
+    std::vector<HostTask *> tasks = taskList();
+    for(HostTask *t : tasks) {
+      std::unique_lock<std::mutex> lock(t->mutex);
+      t->cv.wait(lock, [t, now] {
+        return s_exiting || (t->parked && !t->notified && !(t->deadlineUs && t->deadlineUs <= now));
+      });
+    }
+  }
+
+  /* At exit, before the statics the tasks use are destroyed: wait for every task to be back
+     in ulTaskNotifyTake, where it then stays */
+  void parkTasks(void) {
+    s_exiting = true;
+    std::vector<HostTask *> tasks = taskList();
+    for(HostTask *t : tasks) {
+      std::unique_lock<std::mutex> lock(t->mutex);
+      t->cv.wait(lock, [t] { return t->parked; });
+    }
+  }
+
+  struct PinState {
+    int level = HIGH;
+    int irqMode = 0;
+    void (*isr)(void) = nullptr;
+  };
+  PinState s_pins[64];
+}
+
+namespace HostSim {
+  uint64_t nowUs(void) { return s_nowUs; }
+
+  void advanceUs(uint64_t us) {
+    if(onTask()) return;
+    uint64_t now = s_nowUs += us;
+    if(now >= s_nextDeadlineUs.load(std::memory_order_relaxed)) wakeExpired(now);
+    if(s_tickHook) s_tickHook(now);
+  }
+
+  void idleUs(uint64_t us) {
+    if(onTask()) {
+      std::this_thread::yield();
+      return;
+    }
+    uint64_t target = s_nowUs + us;
+    for(;;) {
+      uint64_t next = s_nextDeadlineUs;
+      if(next > target) break;
+      if(next > s_nowUs) advanceUs(next - s_nowUs);
+      else wakeExpired(s_nowUs);
+      syncTasks();
+    }
+    if(target > s_nowUs) advanceUs(target - s_nowUs);
+    syncTasks();
+  }
+
+  void setTickHook(TickHook hook) { s_tickHook = hook; }
+  void resetClock(void) { s_nowUs = 0; }
+
+  void setPinLevel(uint8_t pin, int level) {
+    if(pin >= 64) return;
+    PinState &p = s_pins[pin];
+    int old = p.level;
+    p.level = level;
+    if(!p.isr || old == level) return;
+    if((p.irqMode == FALLING && level == LOW) ||
+       (p.irqMode == RISING && level == HIGH) ||
+       (p.irqMode == CHANGE))
+      p.isr();
+  }
+
+  void setSerialEnabled(bool enabled) { s_serialEnabled = enabled; }
+  void setPsramSize(size_t bytes) { s_psramSize = bytes; }
+  void setTasksEnabled(bool enabled) { s_tasksEnabled = enabled; }
+}
+
+bool psramFound(void) { return s_psramSize != 0; }
+void *ps_malloc(size_t size) { return size <= s_psramSize ? malloc(size) : nullptr; }
+void *ps_realloc(void *ptr, size_t size) { return size <= s_psramSize ? realloc(ptr, size) : nullptr; }
+
+void delay(uint32_t ms) { HostSim::idleUs((uint64_t)ms * 1000); }
+
+BaseType_t xTaskCreatePinnedToCore(void (*pTask)(void *), const char *pName, uint32_t stackDepth,
+                                   void *pArg, uint32_t priority, TaskHandle_t *pHandle, BaseType_t coreId) {
+  (void)pName; (void)stackDepth; (void)priority; (void)coreId;
+  if(pHandle) *pHandle = nullptr;
+  if(!s_tasksEnabled) return pdFAIL;
+
+  HostTask *t = new HostTask();
+  t->task = true;
+  {
+    std::lock_guard<std::mutex> tasksLock(s_tasksMutex);
+    if(s_tasks.empty()) atexit(parkTasks);
+    s_tasks.push_back(t);
+  }
+  std::thread([t, pTask, pArg] {
+    t_self = t;
+    pTask(pArg);
+  }).detach();
+  if(pHandle) *pHandle = t;
+  return pdPASS;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  HostTask *t = (HostTask *)task;
+  if(!t) return;
+  std::lock_guard<std::mutex> lock(t->mutex);
+  t->notified++;
+  t->cv.notify_all();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  HostTask *t = selfTask();
+  if(t->task && ticks != portMAX_DELAY) {
+    /* The timeout runs on the virtual clock, which advanceUs checks against s_nextDeadlineUs */
+    std::lock_guard<std::mutex> tasksLock(s_tasksMutex);
+    std::lock_guard<std::mutex> lock(t->mutex);
+    t->deadlineUs = s_nowUs + (uint64_t)ticks * 1000;
+    if(t->deadlineUs < s_nextDeadlineUs) s_nextDeadlineUs = t->deadlineUs;
+  }
+
+  std::unique_lock<std::mutex> lock(t->mutex);
+  if(!t->task && ticks != portMAX_DELAY && !t->notified) {
+    /* Nothing else moves the clock: wait in virtual time, then take whatever arrived meanwhile */
+    lock.unlock();
+    delay(ticks);
+    lock.lock();
+  }
+  else {
+    auto ready = [t] { return (t->notified != 0 || (t->deadlineUs && s_nowUs >= t->deadlineUs)) && !s_exiting; };
+    t->parked = true;
+    t->cv.notify_all(); // parkTasks may be waiting for this
+    t->cv.wait(lock, ready);
+    while(s_exiting && t->task) t->cv.wait(lock);
+    t->parked = false;
+    t->deadlineUs = 0;
+  }
+  uint32_t count = t->notified;
+  if(clearOnExit) t->notified = 0;
+  else if(count) t->notified--;
+  return count;
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return selfTask(); }
+
+void portENTER_CRITICAL(portMUX_TYPE *pMux) {
+  while(pMux->locked.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+}
+
+void portEXIT_CRITICAL(portMUX_TYPE *pMux) {
+  pMux->locked.store(false, std::memory_order_release);
+}
+
+void delayMicroseconds(uint32_t us) {
+  if(onTask()) std::this_thread::yield();
+  else HostSim::advanceUs(us);
+}
+
+/* Busy-wait loops on millis() must make progress, so each call costs 1 us (except on a task) */
+unsigned long millis(void) { HostSim::advanceUs(1); return (unsigned long)(s_nowUs / 1000); }
+unsigned long micros(void) { HostSim::advanceUs(1); return (unsigned long)s_nowUs; }
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if(pin < 64 && mode == INPUT_PULLUP) s_pins[pin].level = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if(pin < 64) s_pins[pin].level = val;
+}
+
+int digitalRead(uint8_t pin) { return pin < 64 ? s_pins[pin].level : LOW; }
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  if(pin >= 64) return;
+  s_pins[pin].isr = isr;
+  s_pins[pin].irqMode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if(pin < 64) s_pins[pin].isr = nullptr;
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *sout) {
+  sprintf(sout, "%*.*f", width, prec, val);
+  return sout;
+}
+
+size_t Print::printf(const char *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if(n < 0) return 0;
+  return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+size_t Print::printFmt(const char *fmt, ...) {
+  char buf[64];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if(n < 0) return 0;
+  return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len) {
+  if(!s_serialEnabled) return len;
+  return fwrite(buf, 1, len, stdout);
+}
@@ -0,0 +1,190 @@
+/*
+    FILENAME: Arduino.h (host shim)
+
+    Minimal stand-in for the ESP32 Arduino core so HELPStatLib can be built and
+    run natively. Time is virtual: delay(), delayMicroseconds() and SPI traffic
+    advance a simulated clock (see HostSim::advanceUs) instead of sleeping, so a
+    full EIS sweep that takes minutes on hardware runs in milliseconds here.
+*/
+
+#ifndef HOSTSIM_ARDUINO_H
+#define HOSTSIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __cplusplus
+#include <string>
+#include <atomic>
+
+#define IRAM_ATTR
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define digitalPinToInterrupt(p) (p)
+
+typedef uint8_t byte;
+
+/* Virtual time - all in microseconds */
+namespace HostSim {
+  typedef void (*TickHook)(uint64_t nowUs);
+
+  uint64_t nowUs(void);
+  void advanceUs(uint64_t us);
+  /* advanceUs for a thread with nothing to do (delay, interrupt waits): the tasks get to run at
+     each of their timeouts on the way, and have caught up when it returns */
+  void idleUs(uint64_t us);
+  void setTickHook(TickHook hook);
+  void resetClock(void);
+
+  /* Drives an input pin from the simulated hardware (fires attached ISRs) */
+  void setPinLevel(uint8_t pin, int level);
+  void setSerialEnabled(bool enabled);
+  /* Largest block ps_malloc / ps_realloc will hand out, 0 = no PSRAM */
+  void setPsramSize(size_t bytes);
+  /* false makes xTaskCreatePinnedToCore fail, so callers take their inline fallback */
+  void setTasksEnabled(bool enabled);
+}
+
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+unsigned long millis(void);
+unsigned long micros(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+/* FreeRTOS, which the ESP32 core pulls in through Arduino.h. Each task is a std::thread, so
+   the storage, BLE and fit workers run alongside the sweep. The virtual clock belongs to the
+   threads that were not created as tasks: on a task delay() only yields and millis() / micros()
+   read the clock without moving it. A task's ulTaskNotifyTake times out on the virtual clock,
+   and HostSim::idleUs lets the tasks run before time moves on. */
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+#define pdPASS  1
+#define pdFAIL  0
+#define pdTRUE  1
+#define pdFALSE 0
+#define portMAX_DELAY 0xffffffffu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+BaseType_t xTaskCreatePinnedToCore(void (*pTask)(void *), const char *pName, uint32_t stackDepth,
+                                   void *pArg, uint32_t priority, TaskHandle_t *pHandle, BaseType_t coreId);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+/* Spinlock critical sections */
+typedef struct {
+  std::atomic<bool> locked{false};
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {}
+void portENTER_CRITICAL(portMUX_TYPE *pMux);
+void portEXIT_CRITICAL(portMUX_TYPE *pMux);
+
+/* esp32-hal-psram.h */
+bool psramFound(void);
+void *ps_malloc(size_t size);
+void *ps_realloc(void *ptr, size_t size);
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *sout);
+
+class String {
+  public:
+    String() {}
+    String(const char *s) : _s(s ? s : "") {}
+    String(const std::string &s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    String(int v) : _s(std::to_string(v)) {}
+    String(unsigned int v) : _s(std::to_string(v)) {}
+    String(long v) : _s(std::to_string(v)) {}
+    String(unsigned long v) : _s(std::to_string(v)) {}
+    String(float v, unsigned int prec = 2) { fromDouble(v, prec); }
+    String(double v, unsigned int prec = 2) { fromDouble(v, prec); }
+
+    const char *c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.length(); }
+    bool isEmpty() const { return _s.empty(); }
+    float toFloat() const { return (float)atof(_s.c_str()); }
+    long toInt() const { return atol(_s.c_str()); }
+
+    String &operator+=(const String &rhs) { _s += rhs._s; return *this; }
+    friend String operator+(const String &lhs, const String &rhs) { return String(lhs._s + rhs._s); }
+    friend String operator+(const String &lhs, const char *rhs) { return String(lhs._s + rhs); }
+    friend String operator+(const char *lhs, const String &rhs) { return String(lhs + rhs._s); }
+
+    bool operator==(const String &rhs) const { return _s == rhs._s; }
+    bool operator!=(const String &rhs) const { return _s != rhs._s; }
+    /* ESP32 BLE code compares getValue() against NULL - treat as "has content" */
+    bool operator==(const char *rhs) const { return rhs ? _s == rhs : _s.empty(); }
+    bool operator!=(const char *rhs) const { return !(*this == rhs); }
+    char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+
+  private:
+    void fromDouble(double v, unsigned int prec) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "%.*f", (int)prec, v);
+      _s = buf;
+    }
+    std::string _s;
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(const uint8_t *buf, size_t len) = 0;
+    size_t write(uint8_t c) { return write(&c, 1); }
+
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return printFmt("%d", v); }
+    size_t print(unsigned int v) { return printFmt("%u", v); }
+    size_t print(long v) { return printFmt("%ld", v); }
+    size_t print(unsigned long v) { return printFmt("%lu", v); }
+    size_t print(double v, int prec = 2) { return printFmt("%.*f", prec, v); }
+
+    size_t println(void) { return print("\r\n"); }
+    template <typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+    size_t println(double v, int prec) { size_t n = print(v, prec); return n + println(); }
+
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  private:
+    size_t printFmt(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end(void) {}
+    int available(void) { return 0; }
+    int read(void) { return -1; }
+    void flush(void) {}
+    operator bool() const { return true; }
+    size_t write(const uint8_t *buf, size_t len) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif /* __cplusplus */
+
+#endif /* HOSTSIM_ARDUINO_H */
@@ -0,0 +1,20 @@
+/*
+    FILENAME: BLE2902.h (host shim)
+*/
+
+#ifndef HOSTSIM_BLE2902_H
+#define HOSTSIM_BLE2902_H
+
+#include "BLEDevice.h"
+
+class BLE2902 : public BLEDescriptor {
+  public:
+    BLE2902() : BLEDescriptor(BLEUUID("2902")) {}
+    void setNotifications(bool enable) { _notify = enable; }
+    bool getNotifications(void) const { return _notify; }
+    bool hostNotifyEnabled(void) const override { return _notify; }
+  private:
+    bool _notify = false;
+};
+
+#endif /* HOSTSIM_BLE2902_H */
@@ -0,0 +1,244 @@
+/*
+    FILENAME: BLEDevice.h (host shim)
+
+    In-memory GATT model. Characteristics keep their last value and count
+    notifications so host runs can check what would have been sent over the air.
+    hostWrite() plays the role of a central writing a characteristic.
+
+    notify() behaves like the ESP32 stack: it is dropped (ERROR_NOTIFY_DISABLED) while
+    a BLE2902 on the characteristic has notifications off, truncated to MTU - 3, and
+    reports the outcome through onStatus. Each notification sent costs
+    bleLink().notifyUs + bleLink().byteUs per byte of virtual time. hostCongestEvery(n)
+    makes every nth notification fail with ERROR_GATT, as when the controller's
+    buffers are full.
+*/
+
+#ifndef HOSTSIM_BLEDEVICE_H
+#define HOSTSIM_BLEDEVICE_H
+
+#include "Arduino.h"
+#include <vector>
+
+class BLEServer;
+class BLECharacteristic;
+
+/* Link model shared by all characteristics */
+struct BLEHostLink {
+  uint16_t localMtu = 23;     // BLEDevice::setMTU
+  uint16_t peerMtu = 23;      // What the central asked for (BLEServer::hostConnect)
+  uint32_t notifyUs = 1250;   // Per notification: one per 7.5 ms connection event, ~6 per event
+  float byteUs = 8.0f;        // 1M PHY
+};
+inline BLEHostLink &bleLink(void) { static BLEHostLink link; return link; }
+inline uint16_t bleMtu(void) { return bleLink().localMtu < bleLink().peerMtu ? bleLink().localMtu : bleLink().peerMtu; }
+
+class BLEUUID {
+  public:
+    BLEUUID() {}
+    BLEUUID(const char *uuid) : _uuid(uuid ? uuid : "") {}
+    std::string toString(void) const { return _uuid; }
+    bool operator==(const BLEUUID &rhs) const { return _uuid == rhs._uuid; }
+  private:
+    std::string _uuid;
+};
+
+class BLEDescriptor {
+  public:
+    explicit BLEDescriptor(const BLEUUID &uuid = BLEUUID()) : _uuid(uuid) {}
+    virtual ~BLEDescriptor() {}
+    BLEUUID getUUID(void) const { return _uuid; }
+    virtual bool hostNotifyEnabled(void) const { return true; }
+  private:
+    BLEUUID _uuid;
+};
+
+class BLECharacteristicCallbacks {
+  public:
+    typedef enum {
+      SUCCESS_INDICATE,
+      SUCCESS_NOTIFY,
+      ERROR_INDICATE_DISABLED,
+      ERROR_NOTIFY_DISABLED,
+      ERROR_GATT,
+      ERROR_NO_CLIENT,
+      ERROR_INDICATE_TIMEOUT,
+      ERROR_INDICATE_FAILURE
+    } Status;
+
+    virtual ~BLECharacteristicCallbacks() {}
+    virtual void onStatus(BLECharacteristic *pCharacteristic, Status s, uint32_t code) {
+      (void)pCharacteristic; (void)s; (void)code;
+    }
+    virtual void onWrite(BLECharacteristic *pCharacteristic) { (void)pCharacteristic; }
+    virtual void onRead(BLECharacteristic *pCharacteristic) { (void)pCharacteristic; }
+    virtual void onNotify(BLECharacteristic *pCharacteristic) { (void)pCharacteristic; }
+};
+
+class BLECharacteristic {
+  public:
+    static const uint32_t PROPERTY_READ     = 1 << 0;
+    static const uint32_t PROPERTY_WRITE    = 1 << 1;
+    static const uint32_t PROPERTY_NOTIFY   = 1 << 2;
+    static const uint32_t PROPERTY_BROADCAST = 1 << 3;
+    static const uint32_t PROPERTY_INDICATE = 1 << 4;
+    static const uint32_t PROPERTY_WRITE_NR = 1 << 5;
+
+    BLECharacteristic(const BLEUUID &uuid, uint32_t properties) : _uuid(uuid), _properties(properties) {}
+
+    BLEUUID getUUID(void) const { return _uuid; }
+    void setCallbacks(BLECharacteristicCallbacks *pCallbacks) { _callbacks = pCallbacks; }
+    void addDescriptor(BLEDescriptor *pDescriptor) { _descriptors.push_back(pDescriptor); }
+    BLEDescriptor *getDescriptorByUUID(const char *uuid) {
+      for(BLEDescriptor *d : _descriptors)
+        if(d->getUUID() == BLEUUID(uuid)) return d;
+      return nullptr;
+    }
+
+    void setValue(const uint8_t *data, size_t len) { _value.assign(data, data + len); }
+    void setValue(const char *s) { setValue((const uint8_t *)s, strlen(s)); }
+    void setValue(const String &s) { setValue(s.c_str()); }
+    void setValue(const std::string &s) { setValue((const uint8_t *)s.data(), s.size()); }
+    void setValue(float v) { setValue((const uint8_t *)&v, sizeof(v)); }
+    void setValue(uint32_t v) { setValue((const uint8_t *)&v, sizeof(v)); }
+
+    String getValue(void) const { return String(std::string(_value.begin(), _value.end())); }
+    size_t getLength(void) const { return _value.size(); }
+    uint8_t *getData(void) {
+      static uint8_t empty = 0; /* a fresh characteristic still reads as 0 */
+      return _value.empty() ? &empty : _value.data();
+    }
+
+    void notify(bool is_notification = true) {
+      (void)is_notification;
+      for(BLEDescriptor *d : _descriptors)
+        if(!d->hostNotifyEnabled()) {
+          status(BLECharacteristicCallbacks::ERROR_NOTIFY_DISABLED);
+          return;
+        }
+      if(_callbacks) _callbacks->onNotify(this);
+      if(_congestEvery && ++_sinceCongest >= _congestEvery) {
+        _sinceCongest = 0;
+        _congested++;
+        status(BLECharacteristicCallbacks::ERROR_GATT);
+        return;
+      }
+      size_t len = _value.size();
+      if(len > (size_t)bleMtu() - 3) len = bleMtu() - 3;
+      _notifyCount++;
+      _notifyBytes += len;
+      if(_capture) _sent.push_back(std::vector<uint8_t>(_value.begin(), _value.begin() + len));
+      HostSim::advanceUs(bleLink().notifyUs + (uint64_t)(bleLink().byteUs * len));
+      status(BLECharacteristicCallbacks::SUCCESS_NOTIFY);
+    }
+    void indicate(void) { notify(false); }
+
+    /* Host-side helpers */
+    void hostWrite(const uint8_t *data, size_t len) {
+      setValue(data, len);
+      if(_callbacks) _callbacks->onWrite(this);
+    }
+    uint32_t notifyCount(void) const { return _notifyCount; }
+    uint64_t notifyBytes(void) const { return _notifyBytes; }
+    void hostCapture(bool enable) { _capture = enable; _sent.clear(); }
+    const std::vector<std::vector<uint8_t>> &hostSent(void) const { return _sent; }
+    void hostCongestEvery(uint32_t n) { _congestEvery = n; _sinceCongest = 0; }
+    uint32_t hostCongested(void) const { return _congested; }
+
+  private:
+    void status(BLECharacteristicCallbacks::Status s) {
+      if(_callbacks) _callbacks->onStatus(this, s, s == BLECharacteristicCallbacks::ERROR_GATT ? 0x8f : 0);
+    }
+
+    BLEUUID _uuid;
+    uint32_t _properties;
+    std::vector<uint8_t> _value;
+    std::vector<BLEDescriptor *> _descriptors;
+    BLECharacteristicCallbacks *_callbacks = nullptr;
+    uint32_t _notifyCount = 0;
+    uint64_t _notifyBytes = 0;
+    bool _capture = false;
+    std::vector<std::vector<uint8_t>> _sent;
+    uint32_t _congestEvery = 0;
+    uint32_t _sinceCongest = 0;
+    uint32_t _congested = 0;
+};
+
+class BLEService {
+  public:
+    explicit BLEService(const BLEUUID &uuid) : _uuid(uuid) {}
+    BLECharacteristic *createCharacteristic(const char *uuid, uint32_t properties) {
+      return createCharacteristic(BLEUUID(uuid), properties);
+    }
+    BLECharacteristic *createCharacteristic(const BLEUUID &uuid, uint32_t properties) {
+      BLECharacteristic *c = new BLECharacteristic(uuid, properties);
+      _chars.push_back(c);
+      return c;
+    }
+    BLECharacteristic *getCharacteristic(const char *uuid) {
+      for(BLECharacteristic *c : _chars)
+        if(c->getUUID() == BLEUUID(uuid)) return c;
+      return nullptr;
+    }
+    void start(void) {}
+  private:
+    BLEUUID _uuid;
+    std::vector<BLECharacteristic *> _chars;
+};
+
+class BLEServerCallbacks {
+  public:
+    virtual ~BLEServerCallbacks() {}
+    virtual void onConnect(BLEServer *pServer) { (void)pServer; }
+    virtual void onDisconnect(BLEServer *pServer) { (void)pServer; }
+};
+
+class BLEServer {
+  public:
+    void setCallbacks(BLEServerCallbacks *pCallbacks) { _callbacks = pCallbacks; }
+    BLEService *createService(const char *uuid) { return createService(BLEUUID(uuid)); }
+    BLEService *createService(const BLEUUID &uuid, uint32_t numHandles = 15, uint8_t instId = 0) {
+      (void)numHandles; (void)instId;
+      BLEService *s = new BLEService(uuid);
+      _services.push_back(s);
+      return s;
+    }
+    BLEService *getServiceByIndex(size_t i) { return i < _services.size() ? _services[i] : nullptr; }
+    void startAdvertising(void) {}
+    uint32_t getConnectedCount(void) const { return _connected; }
+    uint16_t getConnId(void) const { return 0; }
+    uint16_t getPeerMTU(uint16_t connId) const { (void)connId; return _connected ? bleMtu() : 0; }
+
+    /* Host-side helpers. peerMtu is the ATT MTU the central requests after connecting */
+    void hostConnect(uint16_t peerMtu = 23) {
+      bleLink().peerMtu = peerMtu;
+      _connected++;
+      if(_callbacks) _callbacks->onConnect(this);
+    }
+    void hostDisconnect(void) { if(_connected) _connected--; if(_callbacks) _callbacks->onDisconnect(this); }
+
+  private:
+    BLEServerCallbacks *_callbacks = nullptr;
+    std::vector<BLEService *> _services;
+    uint32_t _connected = 0;
+};
+
+class BLEAdvertising {
+  public:
+    void addServiceUUID(const char *uuid) { (void)uuid; }
+    void addServiceUUID(const BLEUUID &uuid) { (void)uuid; }
+    void setScanResponse(bool enable) { (void)enable; }
+    void setMinPreferred(uint16_t v) { (void)v; }
+    void start(void) {}
+};
+
+class BLEDevice {
+  public:
+    static void init(const char *name) { (void)name; }
+    static BLEServer *createServer(void) { static BLEServer server; return &server; }
+    static BLEAdvertising *getAdvertising(void) { static BLEAdvertising adv; return &adv; }
+    static void startAdvertising(void) {}
+    static void setMTU(uint16_t mtu) { bleLink().localMtu = mtu; }
+    static uint16_t getMTU(void) { return bleLink().localMtu; }
+};
+
+#endif /* HOSTSIM_BLEDEVICE_H */
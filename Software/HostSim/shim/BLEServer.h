@@ -0,0 +1,5 @@
+/*
+    FILENAME: BLEServer.h (host shim) - everything lives in BLEDevice.h
+*/
+
+#include "BLEDevice.h"
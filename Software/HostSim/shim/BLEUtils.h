@@ -0,0 +1,5 @@
+/*
+    FILENAME: BLEUtils.h (host shim) - everything lives in BLEDevice.h
+*/
+
+#include "BLEDevice.h"
@@ -0,0 +1,50 @@
+/*
+    FILENAME: FS.cpp (host shim)
+*/
+
+#include "SD.h"
+#include <sys/stat.h>
+
+SDFS SD;
+
+namespace {
+  std::string s_sdRoot = "sdcard";
+}
+
+namespace HostSim {
+  void setSdRoot(const char *path) { s_sdRoot = path; }
+
+  std::string sdPath(const char *path) {
+    std::string p = path ? path : "";
+    if(p.empty() || p[0] != '/') p = "/" + p;
+    return s_sdRoot + p;
+  }
+}
+
+namespace fs {
+  File FS::open(const char *path, const char *mode) {
+    std::string host = HostSim::sdPath(path);
+    /* Arduino FILE_WRITE on ESP32 truncates, FILE_APPEND appends */
+    const char *m = mode;
+    if(strcmp(mode, FILE_WRITE) == 0) m = "wb+";
+    else if(strcmp(mode, FILE_APPEND) == 0) m = "ab+";
+    else if(strcmp(mode, FILE_READ) == 0) m = "rb";
+    return File(fopen(host.c_str(), m));
+  }
+
+  bool FS::exists(const char *path) {
+    struct stat st;
+    return stat(HostSim::sdPath(path).c_str(), &st) == 0;
+  }
+
+  bool FS::mkdir(const char *path) {
+    std::string host = HostSim::sdPath(path);
+    /* Create the root too so a fresh checkout works out of the box */
+    ::mkdir(s_sdRoot.c_str(), 0755);
+    return ::mkdir(host.c_str(), 0755) == 0 || exists(path);
+  }
+
+  bool FS::remove(const char *path) {
+    return ::remove(HostSim::sdPath(path).c_str()) == 0;
+  }
+}
@@ -0,0 +1,67 @@
+/*
+    FILENAME: FS.h (host shim)
+
+    File handle backed by a stdio FILE*. Paths are rooted at the directory set
+    by HostSim::setSdRoot() (default "./sdcard") so the host run never touches
+    anything outside its own scratch folder.
+*/
+
+#ifndef HOSTSIM_FS_H
+#define HOSTSIM_FS_H
+
+#include "Arduino.h"
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace HostSim {
+  void setSdRoot(const char *path);
+  std::string sdPath(const char *path);
+}
+
+class File : public Print {
+  public:
+    File() {}
+    explicit File(FILE *fp) : _fp(fp) {}
+
+    size_t write(const uint8_t *buf, size_t len) override {
+      return _fp ? fwrite(buf, 1, len, _fp) : 0;
+    }
+    using Print::write;
+
+    int read(void) { return _fp ? fgetc(_fp) : -1; }
+    size_t read(uint8_t *buf, size_t len) { return _fp ? fread(buf, 1, len, _fp) : 0; }
+    bool seek(uint32_t pos) { return _fp && fseek(_fp, (long)pos, SEEK_SET) == 0; }
+    size_t position(void) { return _fp ? (size_t)ftell(_fp) : 0; }
+    size_t size(void) {
+      if(!_fp) return 0;
+      long cur = ftell(_fp);
+      fseek(_fp, 0, SEEK_END);
+      long end = ftell(_fp);
+      fseek(_fp, cur, SEEK_SET);
+      return (size_t)end;
+    }
+    void flush(void) { if(_fp) fflush(_fp); }
+    void close(void) { if(_fp) fclose(_fp); _fp = nullptr; }
+    operator bool() const { return _fp != nullptr; }
+
+  private:
+    FILE *_fp = nullptr;
+};
+
+namespace fs {
+  class FS {
+    public:
+      File open(const char *path, const char *mode = FILE_READ);
+      File open(const String &path, const char *mode = FILE_READ) { return open(path.c_str(), mode); }
+      bool exists(const char *path);
+      bool exists(const String &path) { return exists(path.c_str()); }
+      bool mkdir(const char *path);
+      bool mkdir(const String &path) { return mkdir(path.c_str()); }
+      bool remove(const char *path);
+      bool remove(const String &path) { return remove(path.c_str()); }
+  };
+}
+
+#endif /* HOSTSIM_FS_H */
@@ -0,0 +1,68 @@
+/*
+    FILENAME: Preferences.cpp (host shim)
+*/
+
+#include "Preferences.h"
+#include <map>
+#include <vector>
+
+namespace {
+  std::map<std::string, std::vector<uint8_t>> s_nvs;  // "namespace/key" -> blob
+}
+
+namespace HostSim {
+  void nvsErase(void) { s_nvs.clear(); }
+}
+
+bool Preferences::begin(const char *name, bool readOnly, const char *partition) {
+  (void)partition;
+  if(!name || !*name || strlen(name) > NVS_KEY_NAME_MAX) return false;
+  _ns = name;
+  _readOnly = readOnly;
+  _open = true;
+  return true;
+}
+
+void Preferences::end(void) {
+  _open = false;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  if(!_open || _readOnly || !key || strlen(key) > NVS_KEY_NAME_MAX || (!value && len)) return 0;
+  const uint8_t *p = (const uint8_t *)value;
+  s_nvs[_ns + "/" + key].assign(p, p + len);
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  if(!_open || !key) return 0;
+  auto it = s_nvs.find(_ns + "/" + key);
+  return it == s_nvs.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  if(!_open || !key) return 0;
+  auto it = s_nvs.find(_ns + "/" + key);
+  if(it == s_nvs.end() || it->second.size() > maxLen) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+bool Preferences::isKey(const char *key) {
+  return _open && key && s_nvs.count(_ns + "/" + key) != 0;
+}
+
+bool Preferences::remove(const char *key) {
+  if(!_open || _readOnly || !key) return false;
+  return s_nvs.erase(_ns + "/" + key) != 0;
+}
+
+bool Preferences::clear(void) {
+  if(!_open || _readOnly) return false;
+  std::string prefix = _ns + "/";
+  for(auto it = s_nvs.begin(); it != s_nvs.end(); ) {
+    if(it->first.compare(0, prefix.size(), prefix) == 0) it = s_nvs.erase(it);
+    else ++it;
+  }
+  return true;
+}
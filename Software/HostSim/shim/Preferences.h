@@ -0,0 +1,39 @@
+/*
+    FILENAME: Preferences.h (host shim)
+
+    Key-value store with the ESP32 Preferences (NVS) API, kept in memory for the
+    life of the process. A namespace / key pair holds one blob; the typed put /
+    get calls HELPStat does not use are left out. HostSim::nvsErase() models a
+    freshly flashed board.
+*/
+
+#ifndef HOSTSIM_PREFERENCES_H
+#define HOSTSIM_PREFERENCES_H
+
+#include "Arduino.h"
+
+#define NVS_KEY_NAME_MAX 15   // Longest namespace or key NVS accepts
+
+namespace HostSim {
+  void nvsErase(void);
+}
+
+class Preferences {
+  public:
+    bool begin(const char *name, bool readOnly = false, const char *partition = NULL);
+    void end(void);
+
+    size_t putBytes(const char *key, const void *value, size_t len);
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buf, size_t maxLen);
+    bool isKey(const char *key);
+    bool remove(const char *key);
+    bool clear(void);
+
+  private:
+    std::string _ns;
+    bool _open = false;
+    bool _readOnly = false;
+};
+
+#endif /* HOSTSIM_PREFERENCES_H */
@@ -0,0 +1,22 @@
+/*
+    FILENAME: SD.h (host shim)
+*/
+
+#ifndef HOSTSIM_SD_H
+#define HOSTSIM_SD_H
+
+#include "FS.h"
+#include "SPI.h"
+
+class SDFS : public fs::FS {
+  public:
+    bool begin(uint8_t ssPin = 0, SPIClass &spi = SPI, uint32_t frequency = 4000000) {
+      (void)ssPin; (void)spi; (void)frequency;
+      return mkdir("/");
+    }
+    void end(void) {}
+};
+
+extern SDFS SD;
+
+#endif /* HOSTSIM_SD_H */
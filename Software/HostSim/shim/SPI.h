@@ -0,0 +1,42 @@
+/*
+    FILENAME: SPI.h (host shim)
+
+    The simulated AD5940 port does not go through SPIClass; this only exists so
+    code that includes SPI.h (and the SPIMODE/BITS constants) compiles.
+*/
+
+#ifndef HOSTSIM_SPI_H
+#define HOSTSIM_SPI_H
+
+#include "Arduino.h"
+
+#define MSBFIRST  1
+#define LSBFIRST  0
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+
+class SPISettings {
+  public:
+    SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0)
+      : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+class SPIClass {
+  public:
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {
+      (void)sck; (void)miso; (void)mosi; (void)ss;
+    }
+    void end(void) {}
+    void beginTransaction(SPISettings settings) { (void)settings; }
+    void endTransaction(void) {}
+    uint8_t transfer(uint8_t data) { (void)data; return 0xFF; }
+};
+
+extern SPIClass SPI;
+
+#endif /* HOSTSIM_SPI_H */
@@ -0,0 +1,14 @@
+/*
+    FILENAME: eigen.h (host shim)
+
+    On the ESP32 this is the LinnesLab Eigen-Port; on the host the system Eigen
+    provides the same headers, including the unsupported nonlinear solvers.
+*/
+
+#ifndef HOSTSIM_EIGEN_H
+#define HOSTSIM_EIGEN_H
+
+#include <Eigen/Dense>
+#include <unsupported/Eigen/NonLinearOptimization>
+
+#endif /* HOSTSIM_EIGEN_H */
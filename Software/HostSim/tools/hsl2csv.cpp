@@ -0,0 +1,193 @@
+/*
+    FILENAME: hsl2csv.cpp
+
+    Converts a HELPStat binary session log (.hsl, see HELPStatLib/sessionlog.h)
+    to CSV. The log is memory-mapped and walked block by block; a block whose
+    CRC does not match is skipped by searching for the next block magic, so a
+    log cut short by a reset or power loss still gives every point up to the
+    last flush. A cycle that was measured again after failing the
+    Kramers-Kronig test is in the log once per attempt; only its last attempt
+    is written, unless --all-attempts is given.
+
+    Usage: hsl2csv <log.hsl> [-o out.csv] [--rcal ohm] [--max-bytes n]
+                   [--corrupt offset] [--all-attempts] [--expect-points n]
+
+    --rcal re-decodes the points with a different calibration resistor than
+    the one in the session header. --max-bytes only reads the first n bytes
+    (a run that stopped part-way) and --corrupt flips one byte of the mapped
+    copy, to exercise recovery. --expect-points exits non-zero unless exactly
+    n points were written.
+*/
+
+#include "sessionlog.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static_assert(sizeof(dftRecord) == 12, "dftRecord layout changed");
+static_assert(sizeof(logBlockHdr) == 16, "logBlockHdr layout changed");
+static_assert(sizeof(logPoint) == 32, "logPoint layout changed");
+
+/* Same calculation as HELPStat::decodeRecord */
+static void writePoint(FILE *out, const logPoint *p, float rcalVal) {
+  int32_t dft[4];
+  dftRecordUnpack(&p->rec, dft);
+  float magRcal = sqrt((float)dft[0]*dft[0] + (float)dft[1]*dft[1]);
+  float phaseRcal = atan2(-dft[1], dft[0]);
+  float magRz = sqrt((float)dft[2]*dft[2] + (float)dft[3]*dft[3]);
+  float phaseRz = atan2(-dft[3], dft[2]);
+
+  float magnitude = 0, phaseRad = 0;
+  if((p->rec.flags & DFTREC_VALID) && magRz > 0) {
+    magnitude = (magRcal / magRz) * rcalVal;
+    phaseRad = phaseRcal - phaseRz;
+  }
+  float real = magnitude * cos(phaseRad);
+  float imag = magnitude * sin(phaseRad) * -1;
+  fprintf(out, "%u,%u,%u,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.1f,%u,%u,", p->cycle, p->rec.freqIdx, p->timeMs,
+          p->freq, real, imag, magnitude, phaseRad, phaseRad * 180 / M_PI, p->settleMs,
+          p->settleStatus, p->rec.flags);
+  if(p->range & LOG_RANGE_SET)
+    fprintf(out, "%u,%u,%u,", p->range & LOG_RANGE_RTIA, (p->range & LOG_RANGE_EXT) ? 1 : 0,
+            (p->range & LOG_RANGE_DAC) ? 1 : 0);
+  else fprintf(out, ",,,");
+  fprintf(out, "%u\n", p->attempt);
+}
+
+int main(int argc, char **argv) {
+  const char *inPath = NULL, *outPath = NULL;
+  float rcalOverride = 0;
+  long maxBytes = -1, corruptAt = -1, expectPoints = -1;
+  bool allAttempts = false;
+
+  for(int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : "0";
+    if(!strcmp(a, "-o")) { outPath = v; i++; }
+    else if(!strcmp(a, "--rcal")) { rcalOverride = atof(v); i++; }
+    else if(!strcmp(a, "--max-bytes")) { maxBytes = atol(v); i++; }
+    else if(!strcmp(a, "--corrupt")) { corruptAt = atol(v); i++; }
+    else if(!strcmp(a, "--all-attempts")) allAttempts = true;
+    else if(!strcmp(a, "--expect-points")) { expectPoints = atol(v); i++; }
+    else if(a[0] != '-' && !inPath) inPath = a;
+    else {
+      fprintf(stderr, "Unknown option: %s\n", a);
+      return 2;
+    }
+  }
+  if(!inPath) {
+    fprintf(stderr, "Usage: hsl2csv <log.hsl> [-o out.csv] [--rcal ohm] [--max-bytes n] [--corrupt offset] [--all-attempts] [--expect-points n]\n");
+    return 2;
+  }
+
+  int fd = open(inPath, O_RDONLY);
+  struct stat st;
+  if(fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "Cannot open %s\n", inPath);
+    return 2;
+  }
+  size_t size = (size_t)st.st_size;
+  if(maxBytes >= 0 && (size_t)maxBytes < size) size = (size_t)maxBytes;
+  if(size == 0) {
+    fprintf(stderr, "%s is empty\n", inPath);
+    return 1;
+  }
+  /* Private writable mapping so --corrupt never touches the file */
+  uint8_t *base = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED) {
+    fprintf(stderr, "Cannot map %s\n", inPath);
+    return 2;
+  }
+  if(corruptAt >= 0 && (size_t)corruptAt < size) base[corruptAt] ^= 0xFF;
+
+  FILE *out = outPath ? fopen(outPath, "w") : stdout;
+  if(!out) {
+    fprintf(stderr, "Cannot write %s\n", outPath);
+    return 2;
+  }
+
+  logSessionHdr session;
+  bool haveSession = false, ended = false;
+  uint32_t points = 0, blocks = 0, badBlocks = 0, skippedBytes = 0, expectSeq = 0, seqGaps = 0;
+  std::vector<logPoint> logged;
+  memset(&session, 0, sizeof(session));
+  session.rcalVal = 1000;
+
+  size_t pos = 0;
+  while(pos + sizeof(logBlockHdr) + sizeof(uint32_t) <= size) {
+    logBlockHdr blk;
+    memcpy(&blk, base + pos, sizeof(blk));
+    bool ok = blk.magic == LOG_MAGIC && blk.length <= size - pos - sizeof(blk) - sizeof(uint32_t);
+    if(ok) {
+      uint32_t crc;
+      memcpy(&crc, base + pos + sizeof(blk) + blk.length, sizeof(crc));
+      ok = logCrc32(0, base + pos, sizeof(blk) + blk.length) == crc;
+    }
+    if(!ok) {
+      if(blk.magic == LOG_MAGIC) badBlocks++;
+      pos++;        // Resync on the next magic
+      skippedBytes++;
+      continue;
+    }
+
+    const uint8_t *payload = base + pos + sizeof(blk);
+    blocks++;
+    if(blk.seq != expectSeq) seqGaps++;
+    expectSeq = blk.seq + 1;
+
+    if(blk.type == LOG_BLOCK_SESSION && blk.length >= sizeof(session)) {
+      memcpy(&session, payload, sizeof(session));
+      haveSession = true;
+    }
+    else if(blk.type == LOG_BLOCK_POINTS &&
+            (blk.length == blk.count * sizeof(logPoint) || blk.length == blk.count * LOG_POINT_SIZE_V1)) {
+      size_t size = blk.length == blk.count * sizeof(logPoint) ? sizeof(logPoint) : LOG_POINT_SIZE_V1;
+      for(uint32_t i = 0; i < blk.count; i++) {
+        logPoint p = {};   // Format 1: attempt 0
+        memcpy(&p, payload + i * size, size);
+        logged.push_back(p);
+      }
+    }
+    else if(blk.type == LOG_BLOCK_END) ended = true;
+    pos += sizeof(blk) + blk.length + sizeof(uint32_t);
+  }
+
+  /* Last attempt of each cycle; earlier ones failed the KK test and were measured again */
+  std::vector<uint8_t> lastAttempt;
+  for(const logPoint &p : logged) {
+    if(p.cycle >= lastAttempt.size()) lastAttempt.resize(p.cycle + 1, 0);
+    if(p.attempt > lastAttempt[p.cycle]) lastAttempt[p.cycle] = p.attempt;
+  }
+  fprintf(out, "cycle,index,timeMs,freq,real,imag,magnitude,phaseRad,phaseDeg,settleMs,settleStatus,flags,rTIA,extGain,dacGain,attempt\n");
+  for(const logPoint &p : logged) {
+    if(!allAttempts && p.attempt != lastAttempt[p.cycle]) continue;
+    writePoint(out, &p, rcalOverride > 0 ? rcalOverride : session.rcalVal);
+    points++;
+  }
+  if(out != stdout) fclose(out);
+  munmap(base, size);
+
+  if(haveSession)
+    fprintf(stderr, "%s: firmware %s, format %u, %g -> %g Hz, %u points x %u cycle(s), Rcal %g, %u gain entries\n",
+            inPath, session.firmware, session.version, session.startFreq, session.endFreq,
+            session.sweepPoints, session.numCycles + 1, session.rcalVal, session.gainArrSize);
+  else
+    fprintf(stderr, "%s: no session header\n", inPath);
+  fprintf(stderr, "  %u points written (%u logged) in %u blocks, %u bad block(s), %u byte(s) skipped, %u sequence gap(s), %s\n",
+          points, (uint32_t)logged.size(), blocks, badBlocks, skippedBytes + (uint32_t)(size - pos), seqGaps,
+          ended ? "closed" : "not closed (run stopped part-way?)");
+
+  if(expectPoints >= 0 && points != (uint32_t)expectPoints) {
+    fprintf(stderr, "CHECK FAILED (expected %ld points)\n", expectPoints);
+    return 1;
+  }
+  return 0;
+}